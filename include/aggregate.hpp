@@ -0,0 +1,219 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "xbase.hpp"
+#include "expr.hpp"
+#include "cond.hpp"
+
+// Accumulators and hash grouping for SUM / AVERAGE / CALCULATE and TOTAL.
+//
+// An item is one aggregate over one expression. A bare N / F field is read
+// as fixed point straight from the record bytes and totalled in 128-bit
+// integers, so its SUM, MIN and MAX are exact; anything else is evaluated
+// to a double (expr::Program::number) and summed with compensation.
+//
+// Scans fold each block of records into accumulators of its own on a pool
+// thread, keyed by group when there is a GROUP BY / TOTAL ON key, and the
+// blocks are merged in record order, so results do not depend on SET
+// THREADS. The merged groups live in an open-addressing hash table
+// (GroupTable); HashAgg spills it to partition files when it outgrows SET
+// SORTMEM and regroups the partitions one at a time at the end.
+namespace aggregate {
+
+// 128-bit two's-complement total: exact for any run of int64 addends.
+struct Wide {
+    uint64_t lo{0}, hi{0};
+
+    void add(int64_t v);
+    void add(const Wide& w);
+    bool negative() const { return (hi >> 63) != 0; }
+    double toDouble() const;
+    // Decimal text of the total scaled down by 10^dec.
+    std::string text(int dec) const;
+};
+
+// An N / F field's text as an integer scaled by 10^dec, read straight from
+// the record bytes: blanks around, an optional sign, digits and at most one
+// '.'; digits past `dec` decimals are dropped. Blank is 0. False for any
+// other text (an overflow "***", an exponent) or more than 18 significant
+// digits.
+bool fixedValue(const char* p, size_t len, int dec, int64_t& out);
+
+enum class Fn { Sum, Avg, Min, Max, Cnt, Std, Var };
+
+// SUM AVG MIN MAX CNT STD VAR; false if `name` is none of them.
+bool fnNamed(const std::string& name, Fn& fn);
+
+struct Item {
+    Fn fn{Fn::Sum};
+    std::string label;   // column heading
+    bool fixed{false};   // bare N / F field at off, len, dec
+    size_t off{0}, len{0};
+    int dec{0};
+    std::unique_ptr<expr::Program> prog; // otherwise (not for CNT)
+};
+
+// Resolve `text` against `a` into `it` (fn and label are left alone);
+// false + err if it is not a numeric expression.
+bool bindItem(Item& it, const std::string& text, const xbase::DbArea& a, std::string& err);
+
+// Running totals of one item over some records. Plain bytes, so spilled
+// groups can be written and read back as they are.
+struct Acc {
+    int64_t n{0};
+    int64_t unreadable{0};    // field values that are no number (an overflowed
+                              // "****"): left out of n and every result
+    Wide exact;               // fixed-point values, scaled by 10^dec
+    double sum{0}, comp{0};   // other values: Neumaier-compensated total
+    bool inexact{false};      // a fixed-point field value went to `sum`
+    double lo{std::numeric_limits<double>::infinity()};
+    double hi{-std::numeric_limits<double>::infinity()};
+    int64_t flo{std::numeric_limits<int64_t>::max()};
+    int64_t fhi{std::numeric_limits<int64_t>::min()};
+    double mean{0}, m2{0};    // Welford, for STD / VAR
+
+    void add(const Item& it, const char* rec);
+    void merge(const Acc& o);
+};
+
+// The item's result as text: exact for fixed-point SUM / MIN / MAX, the
+// field's decimals (at least 2 for AVG) for fields, up to 6 decimals for
+// expressions. STD / VAR are over the population.
+std::string result(const Item& it, const Acc& a);
+// The total of a SUM item as a double (TOTAL writes it into a field).
+double total(const Item& it, const Acc& a);
+
+// Group key of a record: the raw bytes of a bare field, else the
+// expression's DISPLAY text.
+struct Key {
+    std::string label;
+    bool raw{false};
+    size_t off{0}, len{0};
+    std::unique_ptr<expr::Program> prog;
+
+    void bytes(const char* rec, std::string& out) const;
+};
+bool bindKey(Key& k, const std::string& text, const xbase::DbArea& a, std::string& err);
+
+uint64_t hashKey(const char* p, size_t n);
+
+// Open-addressing (linear probing) hash table from key bytes to groups;
+// each group has its first record number and one Acc per item.
+class GroupTable {
+public:
+    explicit GroupTable(size_t items) : items_(items) {}
+
+    // The group of `key` (hash h); if new, it starts with `first` and empty
+    // accumulators.
+    size_t group(const char* key, size_t len, uint64_t h, int32_t first);
+
+    size_t size() const { return first_.size(); }
+    size_t items() const { return items_; }
+    std::string key(size_t g) const { return keys_.substr(keyAt_[g], keyAt_[g + 1] - keyAt_[g]); }
+    const char* keyData(size_t g) const { return keys_.data() + keyAt_[g]; }
+    size_t keySize(size_t g) const { return keyAt_[g + 1] - keyAt_[g]; }
+    uint64_t hash(size_t g) const { return hash_[g]; }
+    int32_t& first(size_t g) { return first_[g]; }
+    int32_t first(size_t g) const { return first_[g]; }
+    Acc* accs(size_t g) { return accs_.data() + g * items_; }
+    const Acc* accs(size_t g) const { return accs_.data() + g * items_; }
+
+    // Fold every group of `o` (same items) in: new keys are added, known
+    // ones merged, keeping the lower first record.
+    void merge(const GroupTable& o);
+
+    // Memory held, roughly.
+    size_t bytes() const;
+    void clear();
+
+private:
+    size_t items_;
+    std::vector<uint32_t> slots_; // group + 1, 0 = empty; size a power of two
+    std::vector<uint64_t> hash_;
+    std::vector<size_t> keyAt_{0}; // keys_ offsets, one past each group
+    std::string keys_;
+    std::vector<int32_t> first_;
+    std::vector<Acc> accs_;
+
+    void grow_();
+};
+
+// Hash aggregation bounded by `memBytes`: groups are merged into one
+// GroupTable; when it grows past the budget every group is appended to one
+// of kParts partition files (by hash) and the table starts over. finish()
+// then regroups each partition in turn (splitting it again by further hash
+// bits if it is still too big) and hands every group on in key order.
+class HashAgg {
+public:
+    static constexpr unsigned kParts = 16;
+
+    // Partition files are "<spillStem>.grp<n>.tmp" and are removed again.
+    HashAgg(size_t items, size_t memBytes, std::string spillStem);
+    ~HashAgg();
+
+    HashAgg(const HashAgg&) = delete;
+    HashAgg& operator=(const HashAgg&) = delete;
+
+    void merge(const GroupTable& part);
+    bool spilled() const { return spills_ > 0; }
+
+    // fn(key, first record, accumulators) for every group, ascending by
+    // key bytes; false if a partition file could not be written or read.
+    bool finish(const std::function<void(const std::string&, int32_t, const Acc*)>& fn);
+
+private:
+    size_t items_;
+    size_t mem_;
+    std::string stem_;
+    GroupTable table_;
+    unsigned spills_{0};
+    unsigned files_{0};
+    std::vector<std::string> paths_; // every file created, removed at the end
+    std::vector<std::FILE*> parts_;  // open partitions of the first split
+    bool ok_{true};
+
+    std::string newPath_();
+    bool spill_(GroupTable& t, std::vector<std::FILE*>& out, std::vector<std::string>& names, unsigned shift);
+    bool finishPart_(const std::string& path, unsigned shift, std::vector<std::string>& runs);
+};
+
+// Fold the live records from..to that pass `filter` (bound; nullptr =
+// all) into groups of `key` (nullptr = one group), a block at a time on
+// the pool. With `whileCond` the records stop before the first live one
+// where it is false. Each block's table goes to merge() on the calling
+// thread in record order.
+void scan(xbase::DbArea& a, const std::vector<Item>& items, const Key* key,
+          const cond::Node* filter, const cond::Node* whileCond, int32_t from, int32_t to,
+          const std::function<void(const GroupTable&)>& merge);
+
+// Aggregate commands' clauses, in any order after the head:
+//   [ALL | REST | NEXT <n>] [FOR <cond>] [WHILE <cond>] plus `words`
+// (e.g. ON, TO, FIELDS, GROUP) whose text is returned in `clause`.
+struct Clauses {
+    enum Scope { Default, All, Rest, Next } scope{Default};
+    int32_t next{0};
+    std::string head;                         // text before the first clause
+    std::map<std::string, std::string> clause; // word -> its text (FOR, WHILE, ...)
+};
+bool parseClauses(const std::string& line, const std::vector<std::string>& words,
+                  Clauses& out, std::string& err);
+
+// Split at top-level commas (outside quotes and brackets), trimmed.
+std::vector<std::string> splitList(const std::string& list);
+
+// Records from..to of the scope: ALL from the top, REST / NEXT / WHILE
+// from the current record on.
+void scopeRange(const xbase::DbArea& a, const Clauses& c, bool hasWhile, int32_t& from, int32_t& to);
+
+// May TOTAL / SORT write the TO table `dest` (with .dbf)? Not while any
+// work area has it open, nor, under SET SAFETY ON, if the file exists.
+bool checkTarget(const xbase::XBaseEngine& eng, const std::string& dest, std::string& err);
+
+} // namespace aggregate
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace textio {
+
+// Case-insensitive substring search (ASCII letters, like std::toupper in
+// the "C" locale) with the needle prepared once: upper-cased, and its first
+// and last bytes turned into a 16-byte SSE2 filter. A haystack is scanned
+// in place, never copied: candidate positions are those where both end
+// bytes match, and only they are compared in full. Used for $ / CONTAINS
+// and FIND, where the same needle meets every record of a scan.
+class CiSearch {
+public:
+    static constexpr size_t npos = std::string::npos;
+
+    CiSearch() = default;
+    explicit CiSearch(const std::string& needle);
+
+    bool   empty() const { return up_.empty(); }
+    size_t size() const  { return up_.size(); }
+
+    // Offset in [b, e) of the first match, or npos. An empty needle
+    // matches at 0.
+    size_t find(const char* b, const char* e) const;
+    bool   in(const char* b, const char* e) const { return find(b, e) != npos; }
+    bool   in(const std::string& hay) const { return in(hay.data(), hay.data() + hay.size()); }
+
+private:
+    std::string up_;  // upper-cased needle
+    // Filter on the end bytes: (byte | mask) == want, with mask 0x20 for a
+    // letter (so both cases pass) and 0 otherwise.
+    unsigned char firstWant_{0}, firstMask_{0}, lastWant_{0}, lastMask_{0};
+
+    bool matchAt(const char* p) const;
+};
+
+} // namespace textio
@@ -1,5 +1,6 @@
 #pragma once
 #include <atomic>
+#include <cstddef>
 
 namespace cli {
 
@@ -7,6 +8,15 @@ namespace cli {
 // Defaults follow classic FoxPro expectations: deleted = ON (hidden).
 struct Settings {
     std::atomic<bool> deleted_on{true}; // ON => hide deleted records
+    // SET DUPLICATES SKIP: a write that would break a UNIQUE tag is skipped
+    // (and counted) instead of stopping the command with an error.
+    std::atomic<bool> duplicates_skip{false};
+    // SET SORTMEM: megabytes SORT / TOTAL / GROUP BY hold in memory
+    // before spilling to temporary files.
+    std::atomic<unsigned> sort_mem_mb{64};
+    // SET SAFETY ON: commands that write a new table (TOTAL, SORT) refuse
+    // to replace an existing file.
+    std::atomic<bool> safety_on{true};
 
     // singleton instance
     static Settings& instance() {
@@ -21,6 +31,27 @@ struct Settings {
     static void setDeleted(bool on) {
         instance().deleted_on.store(on);
     }
+    static bool duplicatesSkip() {
+        return instance().duplicates_skip.load();
+    }
+    static void setDuplicatesSkip(bool skip) {
+        instance().duplicates_skip.store(skip);
+    }
+    static unsigned sortMemMB() {
+        return instance().sort_mem_mb.load();
+    }
+    static size_t sortMemBytes() {
+        return static_cast<size_t>(sortMemMB()) << 20;
+    }
+    static void setSortMemMB(unsigned mb) {
+        instance().sort_mem_mb.store(mb);
+    }
+    static bool safetyOn() {
+        return instance().safety_on.load();
+    }
+    static void setSafety(bool on) {
+        instance().safety_on.store(on);
+    }
 };
 
 } // namespace cli
@@ -0,0 +1,86 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "xbase.hpp"
+#include "predicates.hpp"
+#include "expr.hpp"
+#include "xindex/roaring.hpp"
+
+// Compound FOR conditions:
+//   <term> [ .AND. | .OR. ] ...   with .NOT. / ! and ( ... )
+// A term is either a simple <fld> <op> <value>, where the value is taken as
+// written (quoted or bare words), or any other xBase expression such as
+// UPPER(LAST_NAME) = "DOE", GPA * 2 > 7 or IS_ACTIVE (see expr.hpp).
+// Simple terms are evaluated by predicates::eval, so each keeps its existing
+// semantics (numeric when both sides parse, else case-insensitive text);
+// bitmap indexes, filtered tags and covering tags only understand those.
+// bind() compiles the leaves against a table (predicates::Compiled,
+// expr::Program) so that a scan compares record bytes instead of re-parsing
+// each term per record.
+namespace cond {
+
+struct Node {
+    enum class Kind { Term, Expr, And, Or, Not };
+    Kind kind{Kind::Term};
+
+    // Term
+    std::string fld, op, val; // op upper-cased, val unquoted
+    std::unique_ptr<const predicates::Compiled> pred; // set by bind()
+
+    // Expr: logical expression and its source text
+    std::shared_ptr<const expr::Node> ast;
+    std::string text;
+    std::unique_ptr<const expr::Program> prog; // set by bind()
+
+    // And/Or use lhs+rhs, Not uses lhs
+    std::unique_ptr<Node> lhs, rhs;
+};
+
+// Parse a condition; nullptr + err on syntax error.
+std::unique_ptr<Node> parse(const std::string& text, std::string& err);
+
+// Compile every term for scans of `a`; eval(n, a) must then only be used
+// with that table. Simple terms on unknown fields are left unbound (still
+// false, as always); false + err if an expression term does not compile
+// or is not logical.
+bool bind(Node& n, const xbase::DbArea& a, std::string& err);
+
+// True if the condition has expression terms (only simple terms can be
+// answered from index entries).
+bool hasExpr(const Node& n);
+
+// Evaluate against the current record (short-circuits).
+bool eval(const Node& n, const xbase::DbArea& a);
+// Evaluate a bound condition against a record image of the table it was
+// bound to (e.g. from DbArea::readRecords); unbound terms are false.
+bool eval(const Node& n, const char* rec);
+
+// Evaluate against values supplied by the caller: value(fieldName) returns
+// the field's value or nullptr if unknown (the term is then false).
+// Expression terms are false here; see hasExpr().
+using ValueFn = std::function<const std::string*(const std::string& fld)>;
+bool eval(const Node& n, const ValueFn& value);
+
+// The top-level .AND. terms of `n` (just `n` if it is not an .AND.).
+void conjuncts(const Node& n, std::vector<const Node*>& out);
+
+// Field names referenced by the condition (as written, may repeat).
+void fieldNames(const Node& n, std::vector<std::string>& out);
+
+// Answer the condition from bitmap indexes alone, if every term is an
+// equality / inequality on a field that has one. Result covers live
+// (non-deleted) records only. nullopt = needs a record scan.
+std::optional<xindex::RoaringBitmap> bitmapEval(const Node& n, const xbase::DbArea& a);
+
+// Filtered-index matching. A tag whose FOR condition is one of the query's
+// top-level .AND. terms (or several of them) holds a superset of the query's
+// records, so scanning just the tag and re-checking the query is enough.
+// Returns the smallest such tag, or nullptr. `exact` is set when the tag's
+// condition is the whole query (its size is then the answer to COUNT).
+bool tagCovers(const xbase::DbArea::IndexTag& t, const Node& query, bool* exact = nullptr);
+const xbase::DbArea::IndexTag* coveringTag(const xbase::DbArea& a, const Node& query, bool* exact = nullptr);
+
+} // namespace cond
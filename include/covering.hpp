@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+#include "xbase.hpp"
+#include "cond.hpp"
+
+// Index-only reads through covering tags (INDEX ON ... INCLUDE ...).
+// When every field a command needs is stored in a tag's leaf entries, rows
+// come straight from the index and the DBF is never read.
+namespace covering {
+
+struct Plan {
+    const xbase::DbArea::IndexTag* tag{nullptr};
+    std::vector<size_t> slots; // requested field i -> position in tag->include
+};
+
+// Pick the smallest tag that can answer `fields` (1-based) for every live
+// record matching `filter` (nullptr = all live records): the projection and
+// every field the filter mentions must be INCLUDEd, and the tag must hold all
+// candidates (unfiltered, or its FOR is among the filter's .AND. terms).
+std::optional<Plan> plan(const xbase::DbArea& a, const std::vector<int>& fields,
+                         const cond::Node* filter);
+
+// Matching rows with recno >= fromRec, in record-number order:
+// fn(recno, values) with values in the order of the planned fields;
+// return false to stop.
+void scan(const xbase::DbArea& a, const Plan& p, const cond::Node* filter, int32_t fromRec,
+          const std::function<bool(int32_t, const std::vector<std::string>&)>& fn);
+
+// Parse "f1, f2 ,f3" into 1-based field indexes; false + bad name on error.
+bool parseFieldList(const xbase::DbArea& a, const std::string& text,
+                    std::vector<int>& out, std::string& bad);
+
+} // namespace covering
@@ -0,0 +1,61 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "xbase.hpp"
+
+// xBase expressions for FOR / WHILE conditions:
+//
+//   literals   12  3.5  "text"  'text'  .T.  .F.  {^2024-01-31}  {01/31/2024}
+//   fields     LAST_NAME, GPA, DOB, IS_ACTIVE (typed by the table: C N D L)
+//   operators  + - * / % ^   = == != <> # < > <= >= $   .AND. .OR. .NOT. !
+//   functions  UPPER LOWER TRIM RTRIM LTRIM ALLTRIM LEN SUBSTR LEFT RIGHT AT
+//              STR VAL ABS INT ROUND MOD MIN MAX DTOS STOD CTOD DATE YEAR
+//              MONTH DAY DOW EMPTY IIF DELETED
+//
+// Text comparisons ignore case and surrounding blanks, and `a $ b` means
+// "a contains b", as in cond's simple terms. Dates are day numbers: date -
+// date gives days, date + n moves by n days.
+//
+// parse() builds a syntax tree that does not depend on any table; compile()
+// resolves it against one table into a tree of typed evaluators that read
+// fields straight from the record bytes (DbArea::recordBytes()), with
+// constant sub-expressions folded and .AND. / .OR. / IIF short-circuiting.
+namespace expr {
+
+enum class Type { Num, Str, Date, Bool };
+
+struct Node; // syntax tree node
+struct Op;   // compiled evaluator node
+
+// Parse one operand of a FOR condition starting at text[pos]: a comparison
+// such as UPPER(LAST_NAME) = "DOE", or any single expression. .AND. / .OR.
+// and an unmatched ')' end it (they belong to the caller), though both may
+// appear inside parentheses and function arguments. On success `pos` is
+// where parsing stopped; nullptr + err on a syntax error.
+std::shared_ptr<const Node> parse(const std::string& text, size_t& pos, std::string& err);
+// A whole expression; anything left over is an error.
+std::shared_ptr<const Node> parse(const std::string& text, std::string& err);
+
+// Field names referenced (as written, may repeat).
+void fieldNames(const Node& n, std::vector<std::string>& out);
+
+class Program {
+public:
+    // nullptr + err if a field is unknown, a function is misused or the
+    // operand types do not fit.
+    static std::unique_ptr<Program> compile(const Node& n, const xbase::DbArea& a, std::string& err);
+    ~Program();
+
+    Type type() const;
+    // `rec` is a record image of the table compiled against.
+    bool        test(const char* rec) const;   // Bool
+    double      number(const char* rec) const; // Num
+    std::string text(const char* rec) const;   // any type, as DISPLAY would show it
+
+private:
+    Program() = default;
+    std::unique_ptr<const Op> root_;
+};
+
+} // namespace expr
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "xbase.hpp"
+#include "cond.hpp"
+
+// Block-at-a-time record scans for COUNT / LIST / DELETE ... FOR.
+// Records are read kBlock at a time straight from the table file
+// (DbArea::readRecords) and the condition is evaluated over the whole block
+// into a selection bitmap, one bit per record; only selected records are
+// handed on. Text = / <> terms run as byte-compare kernels over the field
+// bytes in place (SSE2, or AVX2 when the CPU has it, else scalar); other
+// terms run their compiled form per record. .AND. / .OR. only evaluate
+// their right side on the records the left side leaves undecided.
+//
+// A scan of more than one block is split across threads() on the shared
+// pool (xindex::ThreadPool): each task takes whole blocks and reads them
+// from a read-only mapping of the table file (DbArea::mapRecords), and the
+// blocks are handed on in record order on the calling thread.
+namespace kernels {
+
+constexpr int32_t kBlock = 4096;
+
+enum class Deleted { Skip, Only, Any };
+
+// One bit per record of a block.
+struct Selection {
+    std::vector<uint64_t> words;
+    size_t n{0};
+
+    void reset(size_t count, bool value);
+    bool test(size_t i) const { return (words[i >> 6] >> (i & 63)) & 1u; }
+    void set(size_t i) { words[i >> 6] |= uint64_t{1} << (i & 63); }
+    size_t count() const;
+};
+
+// Records `from`..`to` that pass `filter` (bound against `a` with
+// cond::bind; nullptr = all) and the delete-flag test, in record order.
+// fn(recno) returns false to stop; it may move the cursor and write the
+// record it is given. Returns the number of records passed to fn.
+int64_t forEach(xbase::DbArea& a, const cond::Node* filter, Deleted mode,
+                int32_t from, int32_t to, const std::function<bool(int32_t)>& fn);
+
+// Matching records of the whole table.
+int64_t count(xbase::DbArea& a, const cond::Node* filter, Deleted mode);
+
+// One block of raw records as transform() hands it over.
+struct BlockView {
+    int32_t first;       // recno of record 0
+    const char* base;    // records, cpr bytes each
+    size_t cpr;
+    const Selection* sel; // the records that passed
+    const char* rec(size_t i) const { return base + i * cpr; }
+};
+
+// Block-parallel map over the records forEach would visit: work(block,
+// out) turns a block's selected records into text, on pool threads and
+// several blocks at once (it must only read); emit(out) then gets each
+// block's text on the calling thread in record order, and returns false
+// to stop.
+void transform(xbase::DbArea& a, const cond::Node* filter, Deleted mode, int32_t from, int32_t to,
+               const std::function<void(const BlockView&, std::string&)>& work,
+               const std::function<bool(std::string&)>& emit);
+
+// Block-parallel fold over the same records: work(block) runs on pool
+// threads, several blocks at once (it must only read), typically folding
+// the block into a partial result of its own; done(first recno of the
+// block) then runs on the calling thread in record order, where partials
+// are merged, and returns false to stop.
+void forEachBlock(xbase::DbArea& a, const cond::Node* filter, Deleted mode, int32_t from, int32_t to,
+                  const std::function<void(const BlockView&)>& work,
+                  const std::function<bool(int32_t)>& done);
+
+// Kernel set picked at startup: "AVX2", "SSE2" or "scalar".
+const char* isa();
+
+// Threads a scan may use (the shared pool's, see SET THREADS).
+unsigned threads();
+
+} // namespace kernels
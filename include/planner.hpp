@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+#include "xbase.hpp"
+#include "cond.hpp"
+#include "covering.hpp"
+#include "xindex/roaring.hpp"
+
+// Access-path choice for FOR conditions over live records (COUNT, LIST,
+// EXPLAIN). Each path that can answer the condition is costed and the
+// cheapest one runs:
+//
+//   BITMAP    cond::bitmapEval answers it from bitmap indexes
+//   COVERING  every field needed is INCLUDEd in one tag (covering.hpp)
+//   TAG       a filtered tag whose FOR is among the condition's .AND. terms
+//   INDEX     a seek or key range on a bare-field tag, for one .AND. term
+//             comparing a character field with a constant
+//   SCAN      all records, a block at a time (filter_kernels.hpp)
+//
+// Costs are in sequential record reads: a block-scanned record costs 1, a
+// record fetched by number kRandomRead, an index entry decoded kEntry.
+// INDEX is costed by walking its key range, up to the point where it would
+// lose to a scan; the records found are kept for the run.
+namespace planner {
+
+constexpr double kRandomRead = 50.0;
+constexpr double kEntry      = 3.0;
+constexpr double kBitmapRec  = 0.01;
+
+enum class Path { Bitmap, Covering, Tag, Index, Scan };
+const char* name(Path p);
+
+struct Choice {
+    Path path{Path::Scan};
+    bool usable{false};
+    double rows{0.0};   // records (or entries) it hands on
+    double cost{0.0};
+    std::string detail; // what it would use, or why it cannot
+};
+
+struct Plan {
+    Path path{Path::Scan};
+    std::vector<Choice> considered; // one per Path, in Path order
+
+    std::optional<xindex::RoaringBitmap> bitmap;   // BITMAP
+    std::optional<covering::Plan> cover;           // COVERING
+    const xbase::DbArea::IndexTag* tag{nullptr};   // TAG, INDEX
+    bool exact{false};                             // TAG: its FOR is the whole condition
+    std::vector<int32_t> recnos;                   // INDEX: candidates, ascending
+};
+
+// Table statistics the costs are based on. `live` is exact when a bitmap
+// index or an unfiltered tag holds every live record, else -1.
+struct Stats {
+    int32_t records{0};
+    int64_t live{-1};
+    int cpr{0};
+};
+Stats stats(const xbase::DbArea& a);
+
+// `filter` is bound (cond::bind), nullptr = every live record. `fields`
+// are what the command reads from each record (for COVERING); countOnly
+// when it only needs how many (COUNT), so BITMAP and an exact TAG cost
+// nothing per record.
+Plan choose(const xbase::DbArea& a, const cond::Node* filter,
+            const std::vector<int>& fields, bool countOnly);
+
+// The live records matching `filter` under a BITMAP, TAG, INDEX or SCAN
+// plan, from recno `from` on, in record order; fn(recno) runs with the
+// area positioned there and returns false to stop. COVERING rows come
+// from covering::scan instead.
+int64_t forEach(xbase::DbArea& a, const Plan& p, const cond::Node* filter, int32_t from,
+                const std::function<bool(int32_t)>& fn);
+
+// EXPLAIN text: statistics, every path considered with its cost, the choice.
+std::string explain(const xbase::DbArea& a, const Plan& p);
+
+} // namespace planner
@@ -1,9 +1,11 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <memory>
 #include <cstdlib>
 #include <algorithm>
 #include "xbase.hpp"
+#include "ci_search.hpp"
 
 namespace predicates {
 
@@ -12,5 +14,47 @@ bool eval(const xbase::DbArea& a,
           const std::string& fld,
           const std::string& op,
           const std::string& val);
+bool compare(const std::string& lhs,
+             const std::string& op,
+             const std::string& rhs);
+
+// A "FIELD OP VALUE" term prepared once for a scan: the field resolved to
+// its bytes in the record, the operator to a comparator, and the value
+// trimmed, upper-cased and parsed as a number up front. Per record, test()
+// only reads the field bytes in place; results match eval().
+class Compiled {
+public:
+    // nullptr if `fld` is not a field of `a` or `op` is not an operator.
+    static std::unique_ptr<Compiled> compile(const xbase::DbArea& a,
+                                             const std::string& fld,
+                                             const std::string& op,
+                                             const std::string& val);
+
+    // Current record of the area it was compiled against.
+    bool test(const xbase::DbArea& a) const;
+    // A value of the field the caller already has (e.g. from a covering index).
+    bool test(const std::string& lhs) const;
+    // A record image of that table (DbArea::recordBytes() layout).
+    bool testRecord(const char* rec) const { return test_(rec + off_, rec + off_ + len_); }
+
+    // True if this is a text = / <> (the constant is not a number), the
+    // shape filter_kernels.hpp runs as a byte compare: field bytes at
+    // `off`, `len` wide, against `rhs` (upper-cased); `negated` for <>.
+    bool textEquality(size_t& off, size_t& len, std::string& rhs, bool& negated) const;
+    // True if the constant is not a number, so the term compares text:
+    // `op` is one of = <> > < >= <= $ and `rhs` the upper-cased constant.
+    bool textCompare(std::string& op, std::string& rhs) const;
+
+private:
+    enum class Op { Eq, Ne, Gt, Lt, Ge, Le, Contains };
+    Op          op_{Op::Eq};
+    size_t      off_{0}, len_{0}; // field bytes within DbArea::recordBytes()
+    std::string rhs_;             // trimmed, upper-cased
+    double      rnum_{0.0};
+    bool        rhsNum_{false};   // rhs parses as a number
+    textio::CiSearch search_;     // rhs, for Contains
+
+    bool test_(const char* b, const char* e) const;
+};
 
 } // namespace predicates
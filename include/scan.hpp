@@ -1,17 +1,18 @@
 #pragma once
 #include <algorithm>
 #include <cctype>
+#include <memory>
 #include <optional>
 #include <string>
 #include "xbase.hpp"
 #include "scan_options.hpp"
-#include "predicates.hpp"  // header-only: provides predicates::eval(...)
+#include "predicates.hpp"
 
 struct ScanStats { int visited=0, tested=0, matched=0, acted=0; };
 
-// Parse "FIELD OP VALUE" and evaluate via predicates::eval.
-// VALUE may be quoted; OP is case-insensitive. (predicates::eval handles unquote)
-inline bool eval_cond_inline(const xbase::DbArea& A, const std::string& expr) {
+// Parse "FIELD OP VALUE" and compile it for A (predicates::Compiled);
+// nullptr if it is malformed or names no field of A.
+inline std::unique_ptr<predicates::Compiled> compile_cond_inline(const xbase::DbArea& A, const std::string& expr) {
     size_t i = 0, n = expr.size();
     auto ws = [&](char c){ return std::isspace(static_cast<unsigned char>(c)); };
     auto skip = [&]{ while (i < n && ws(expr[i])) ++i; };
@@ -20,10 +21,15 @@ inline bool eval_cond_inline(const xbase::DbArea& A, const std::string& expr) {
     skip(); b = i;        while (i < n && !ws(expr[i])) ++i; std::string op  = expr.substr(b, i - b);
     skip();               std::string val = (i < n) ? expr.substr(i) : std::string();
 
-    if (fld.empty() || op.empty() || val.empty()) return false;
+    if (fld.empty() || op.empty() || val.empty()) return nullptr;
+    return predicates::Compiled::compile(A, fld, op, val);
+}
 
-    for (char& c : op) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
-    return predicates::eval(A, fld, op, val);
+// One-off evaluation of "FIELD OP VALUE" on the current record; loops
+// should compile once with compile_cond_inline instead.
+inline bool eval_cond_inline(const xbase::DbArea& A, const std::string& expr) {
+    auto p = compile_cond_inline(A, expr);
+    return p && p->test(A);
 }
 
 template <class Action>
@@ -42,9 +48,13 @@ ScanStats scan_records(xbase::DbArea& A, const ScanOptions& opt, Action per_reco
         return true;
     };
 
-    auto cond_ok = [&](const std::optional<std::string>& expr)->bool {
+    // FOR / WHILE are compiled once for the whole scan.
+    const auto for_pred   = opt.for_expr   ? compile_cond_inline(A, *opt.for_expr)   : nullptr;
+    const auto while_pred = opt.while_expr ? compile_cond_inline(A, *opt.while_expr) : nullptr;
+    auto cond_ok = [&](const std::optional<std::string>& expr,
+                       const std::unique_ptr<predicates::Compiled>& pred)->bool {
         if (!expr) return true;
-        return eval_cond_inline(A, *expr);
+        return pred && pred->test(A);
     };
 
     int start = A.recno();
@@ -55,7 +65,7 @@ ScanStats scan_records(xbase::DbArea& A, const ScanOptions& opt, Action per_reco
         if (!A.gotoRec(opt.n)) return st;
         st.visited++; (void)A.readCurrent();
         bool isDel = false; // TODO: wire actual deleted flag if/when exposed
-        if (passes_del(isDel) && cond_ok(opt.while_expr) && cond_ok(opt.for_expr)) {
+        if (passes_del(isDel) && cond_ok(opt.while_expr, while_pred) && cond_ok(opt.for_expr, for_pred)) {
             st.tested++; st.matched++;
             if (per_record(A)) st.acted++;
         }
@@ -80,8 +90,8 @@ ScanStats scan_records(xbase::DbArea& A, const ScanOptions& opt, Action per_reco
 
         if (passes_del(isDel)) {
             st.tested++;
-            if (!cond_ok(opt.while_expr)) break;
-            if (cond_ok(opt.for_expr)) {
+            if (!cond_ok(opt.while_expr, while_pred)) break;
+            if (cond_ok(opt.for_expr, for_pred)) {
                 st.matched++;
                 if (!per_record(A)) break;
                 st.acted++;
@@ -166,4 +166,25 @@ inline std::vector<std::string> tokenize(std::istringstream& iss) {
     return tokenize(rest);
 }
 
+// Split "<head> WORD <tail>" at the first whitespace-delimited WORD
+// (case-insensitive). Returns false, head = whole line, when WORD is absent.
+inline bool split_word(const std::string& line, const std::string& word,
+                       std::string& head, std::string& tail) {
+    std::istringstream ss(line);
+    std::string w;
+    while (true) {
+        ss >> std::ws;
+        const auto at = ss.tellg();
+        if (!(ss >> w)) break;
+        if (ieq(w, word)) {
+            head = trim(line.substr(0, static_cast<size_t>(at)));
+            tail = trim(line.substr(static_cast<size_t>(at) + word.size()));
+            return true;
+        }
+    }
+    head = trim(line);
+    tail.clear();
+    return false;
+}
+
 } // namespace textio
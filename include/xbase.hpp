@@ -7,13 +7,18 @@
 #include <memory>
 #include <stdexcept>
 #include <optional>
+#include <functional>
 
 // [INDEX PATCH]
 #include "xindex/index_manager.hpp"
+#include "xindex/bitmap_index.hpp"
+#include "xindex/mapped_file.hpp"
 
 
 namespace xbase {
 
+class KeyExpr; // xbase/key_expr.hpp
+
 constexpr int MAX_FIELDS = 128;
 constexpr int MAX_INDEX  = 5;
 constexpr int MAX_AREA   = 10;
@@ -59,9 +64,16 @@ public:
     DbArea(DbArea&&) = default;
     DbArea& operator=(DbArea&&) = default;
 
-    void open(const std::string& filename);
+    // readOnly (USE ... NOUPDATE): the table is opened for reading only,
+    // record writes fail, and index tags attach to their existing files
+    // read-only (memory-mapped) instead of being built.
+    // close() saves every tag's pending writes, then closes the table even
+    // if one fails, and throws naming the tags that could not be saved (so
+    // open() does too, for the table it was closing).
+    void open(const std::string& filename, bool readOnly = false);
     void close();
     bool isOpen() const noexcept { return static_cast<bool>(_fp); }
+    bool readOnly() const noexcept { return _readOnly; }
     bool isDeleted() const;
 
     // Navigation
@@ -70,7 +82,8 @@ public:
     bool bottom();
     bool skip(int delta);
 
-    // Record IO
+    // Record IO. writeCurrent/appendBlank return false without writing if
+    // the record would break a UNIQUE tag (see uniqueConflict).
     bool readCurrent();
     bool writeCurrent();
     bool appendBlank();
@@ -80,6 +93,117 @@ public:
     const std::vector<FieldDef>& fields() const { return _fields; }
     std::string get(int idx) const;            // 1-based
     bool set(int idx, const std::string& val); // 1-based
+    // Raw image of the current record as last read or written: the delete
+    // flag, then each field at full width, cpr() bytes. Field `idx` (1-based)
+    // starts at fieldOffset(idx); 0 if there is no such field.
+    const char* recordBytes() const { return _recbuf.data(); }
+    size_t fieldOffset(int idx) const;
+    // Bulk read for scans: raw images of records first, first+1, ... (at
+    // most `count`, clamped to the table) into `out`, cpr() bytes each.
+    // The cursor and current record are left alone. Returns records read.
+    int32_t readRecords(int32_t first, int32_t count, char* out);
+
+    // Raw records of the table file, memory-mapped read-only, for scans
+    // that read from several threads at once: each reads its own records
+    // by number, with no shared stream or cursor. It shows the records
+    // that exist when it is made (writes through the area are flushed, so
+    // it sees them) and stays valid after later writes; records appended
+    // since are not in it.
+    class RecordMap {
+    public:
+        int32_t count() const { return count_; }
+        // 1-based, cpr() bytes; recno must be in 1..count().
+        const char* record(int32_t recno) const {
+            return base_ + static_cast<size_t>(recno - 1) * cpr_;
+        }
+        // Mapped bytes left from `p` to the end of the file.
+        size_t bytesFrom(const char* p) const { return static_cast<size_t>(end_ - p); }
+    private:
+        friend class DbArea;
+        xindex::MappedFile file_;
+        const char* base_{nullptr};
+        const char* end_{nullptr};
+        size_t cpr_{0};
+        int32_t count_{0};
+    };
+    // nullptr if the area is closed or the file cannot be mapped.
+    std::unique_ptr<RecordMap> mapRecords() const;
+
+    // [INDEX PATCH] Bitmap indexes over low-cardinality fields.
+    // Session-scoped: built on demand, kept in step by writeCurrent/appendBlank/
+    // deleteCurrent, dropped on close. Deleted records are never indexed.
+    bool buildBitmapIndex(int idx);                         // 1-based field
+    const xindex::BitmapIndex* bitmapIndex(int idx) const;  // nullptr if none
+
+    // [INDEX PATCH] Tagged B+tree indexes, "<stem>.<TAG>.idx", at most MAX_INDEX.
+    // A tag may carry a FOR filter: only live records passing it are indexed,
+    // and records move in/out as writes flip the predicate. The filter is
+    // supplied by the caller (the CLI's condition evaluator) and is run
+    // against this area's current record.
+    using RecordFilter = std::function<bool(const DbArea&)>;
+    struct IndexTag {
+        std::string name;     // upper-case tag name
+        std::shared_ptr<const KeyExpr> key; // compiled key expression
+        int field{0};         // 1-based key field when the key is a bare field, else 0
+        std::string forExpr;  // FOR text as given; empty = unfiltered
+        RecordFilter filter;  // empty = unfiltered
+        std::vector<int> include; // 1-based fields stored in each leaf entry (covering)
+        bool unique{false};   // no two records in the tag share a key
+        std::unique_ptr<xindex::IndexManager> mgr;
+    };
+    // How a tag's index is kept (see xindex::KeyDesc).
+    struct TagOptions {
+        bool bloom{false};         // key bloom filter (IndexManager::mayContain)
+        bool staticLayout{false};  // read-optimized snapshot (StaticIndex)
+        std::string backend;       // USING kind; empty = BPTREE
+        bool unique{false};        // IndexTag::unique; fails if the table has duplicates
+    };
+    // Build (or rebuild) a tag keyed on `keyExpr` (a field name or a
+    // key expression, see KeyExpr); false + err on failure. Cursor is preserved.
+    // On a read-only area the tag's existing file is attached instead
+    // (IndexManager::openReadOnly): it must have been built from the same
+    // key, INCLUDE and FOR and saved since the table last changed (both are
+    // stored in the file), else err says why; the options come from the
+    // file. Tags on a memory-only backend have no file and are built there
+    // as well.
+    bool createIndexTag(const std::string& tag, const std::string& keyExpr,
+                        const std::vector<int>& include,
+                        const std::string& forExpr, RecordFilter filter,
+                        const TagOptions& opts, std::string& err);
+    // Rebuild every tag from the table. Each one is built on the side and
+    // swapped in whole (IndexManager::rebuild), so its current index keeps
+    // answering until then; false + err names the first tag that failed.
+    bool reindex(std::string& err);
+    const std::vector<IndexTag>& indexTags() const { return _tags; }
+    const IndexTag* indexTag(const std::string& tag) const; // case-insensitive; nullptr if none
+    // Key bytes `value` would have in `t` (for seeks on bare-field tags).
+    std::vector<uint8_t> tagKey(const IndexTag& t, const std::string& value) const;
+    // Decode a leaf payload of `t` into its INCLUDE values, in include order,
+    // right-trimmed like get().
+    std::vector<std::string> tagPayload(const IndexTag& t, const std::vector<uint8_t>& payload) const;
+
+    // [INDEX PATCH] UNIQUE tags. A record's values as get() returns them
+    // (slot 0 unused) are one "row". uniqueConflict() names the first
+    // UNIQUE tag in which `row`, stored live as record `recno` (0 = new),
+    // would share its key with another record; empty if none. Each check
+    // is one index probe. writeCurrent/appendBlank refuse such writes.
+    using Row = std::vector<std::string>;
+    std::string uniqueConflict(const Row& row, int32_t recno);
+    // Batch form for bulk appends: positions in `rows` that would conflict
+    // if the others were appended in order, i.e. whose key is already in a
+    // tag or on an earlier row of the batch that is itself appended (a row
+    // turned away by one tag takes no key in another). Keys are sorted per
+    // tag first, so the index is probed in key order. Ascending; `tags`
+    // gets each one's tag.
+    std::vector<size_t> uniqueConflicts(const std::vector<Row>& rows, std::vector<std::string>* tags = nullptr);
+    // Append `rows` as new live records: one write each, the header once,
+    // indexes kept in step. Does not check UNIQUE tags (uniqueConflicts()
+    // first). Leaves the cursor on the last record appended.
+    bool appendRecords(const std::vector<Row>& rows);
+
+    // Re-read the current record after a command wrote it behind our back
+    // (REPLACE, RECALL) and bring attached indexes up to date.
+    bool refreshCurrent();
 
     // Info
     int32_t recno() const { return _crn; }
@@ -91,6 +215,7 @@ public:
 private:
     std::fstream _fp;
     std::string _db_name;
+    bool _readOnly{false};
     HeaderRec _hdr{};
     std::vector<FieldDef> _fields;
     std::vector<FieldRec> _rawFields;
@@ -100,12 +225,21 @@ private:
     std::vector<std::string> _fd;
     // [INDEX PATCH] snapshot of values last read from disk (for oldKey on write)
     std::vector<std::string> _fd_snapshot;
+    std::vector<char> _recbuf_snapshot; // raw bytes of the same image (key expressions)
+    char _del_snapshot{NOT_DELETED};
 
     int32_t _crn{0};
     char _del{NOT_DELETED};
 
-    // [INDEX PATCH] per-area index manager
-    std::unique_ptr<xindex::IndexManager> _idx;
+    // [INDEX PATCH] per-area index tags
+    std::vector<IndexTag> _tags;
+
+    // [INDEX PATCH] bitmap indexes, one per field at most
+    struct BitmapTag {
+        int field{0}; // 1-based
+        std::unique_ptr<xindex::BitmapIndex> bmp;
+    };
+    std::vector<BitmapTag> _bitmaps;
 
     // internals
     void readHeader();
@@ -117,9 +251,19 @@ private:
     // [INDEX PATCH] key helpers
     int  findFieldCI(const std::string& name) const; // returns 1-based idx or 0
     int  firstCharField() const;                     // 1-based idx or 0
-    std::vector<uint8_t> encodeKeyFrom(const std::vector<std::string>& vals) const;
-    std::vector<uint8_t> currentKey() const { return encodeKeyFrom(_fd); }
-    std::vector<uint8_t> snapshotKey() const { return encodeKeyFrom(_fd_snapshot); }
+    bool tagAccepts(const IndexTag& t, bool snapshot); // FOR filter on current or snapshot image
+    // fn(tagIndex, key) for each UNIQUE tag that would hold `row` as a live
+    // record; the current record's state is left as it was.
+    void uniqueKeys(const Row& row, const std::function<void(size_t, std::vector<uint8_t>)>& fn);
+    std::vector<uint8_t> payloadFrom(const std::vector<std::string>& vals, const IndexTag& t) const;
+    // One pass over the table into t.mgr: create() with `opts` when
+    // `create`, else a shadow rebuild(). Cursor is preserved; index errors
+    // are rethrown.
+    void fillTag(IndexTag& t, bool create, const TagOptions& opts);
+
+    // [INDEX PATCH] apply the snapshot -> current change to every attached
+    // index, then take a new snapshot. `fresh` = record did not exist before.
+    void syncIndexes(bool fresh);
 };
 
 class XBaseEngine {
@@ -128,6 +272,9 @@ public:
     DbArea& area(int idx) { if (idx<0 || idx>=MAX_AREA) throw std::out_of_range("area"); return *_areas[idx]; }
     void selectArea(int idx) { if (idx<0 || idx>=MAX_AREA) throw std::out_of_range("area"); _current = idx; }
     int currentArea() const { return _current; }
+    // The area that has the table at `dbfPath` open (the same file, however
+    // the path is spelled), or -1.
+    int areaOf(const std::string& dbfPath) const;
 private:
     std::array<std::unique_ptr<DbArea>, MAX_AREA> _areas;
     int _current{0};
@@ -135,4 +282,8 @@ private:
 
 // Helpers
 std::string dbNameWithExt(std::string s); // ensure .dbf
+// Fingerprint of a table file as it is on disk (index tags store it, see
+// xindex::KeyDesc::tableStamp): the header's record count and last-update
+// date, the file's size and its modification time. Empty if unreadable.
+std::string tableStamp(const std::string& dbfPath);
 } // namespace xbase
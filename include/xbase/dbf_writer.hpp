@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "xbase.hpp"
+
+namespace xbase {
+
+// Writes a new table (dBase III, no memo) of the given structure, records
+// appended as raw images: the delete flag, then each field at full width,
+// as DbArea::recordBytes() has them. The header's record count and date are
+// set by close(). Used by commands that produce a table from another one's
+// records (TOTAL).
+class DbfWriter {
+public:
+    // Creates (truncates) `path`; throws std::runtime_error if it cannot.
+    DbfWriter(const std::string& path, const std::vector<FieldDef>& fields);
+    ~DbfWriter();
+
+    DbfWriter(const DbfWriter&) = delete;
+    DbfWriter& operator=(const DbfWriter&) = delete;
+
+    int cpr() const { return _cpr; }
+    int32_t count() const { return _count; }
+
+    // `rec` is cpr() bytes.
+    bool append(const char* rec);
+    // Finish the header and the end-of-file marker; false if any write failed.
+    bool close();
+
+private:
+    std::ofstream _out;
+    int _cpr{1};
+    int32_t _count{0};
+    bool _closed{false};
+};
+
+} // namespace xbase
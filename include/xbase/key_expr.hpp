@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "xbase.hpp"
+
+namespace xbase {
+
+// Index key expressions, compiled once per tag:
+//
+//   <term> [+ <term> ...]
+//   term := <field> | "literal" | UPPER(<expr>) | SUBSTR(<expr>, <start>[, <len>])
+//         | DTOS(<date field>) | STR(<numeric field>[, <len>[, <dec>]])
+//
+// Every term has a fixed width (fields keep their padding), so keys built
+// from concatenations sort column by column. A bare field name keeps the
+// classic tag behaviour: its value, upper-cased.
+//
+// The compiled form is a short postfix program run directly over the raw
+// DBF record bytes, so build and maintenance never decode the record.
+class KeyExpr {
+public:
+    // nullptr + err on a syntax error or unknown field.
+    static std::unique_ptr<KeyExpr> compile(const std::string& text,
+                                            const std::vector<FieldDef>& fields,
+                                            std::string& err);
+
+    // Key bytes for a raw record (delete flag at rec[0]); always width() bytes.
+    std::vector<uint8_t> eval(const char* rec) const;
+
+    // A SEEK value in the key's case: the bytes at key positions the
+    // expression upper-cases (all of them for a bare field) are upper-cased.
+    std::string fold(std::string value) const;
+
+    size_t width() const { return width_; }
+    const std::string& text() const { return text_; }
+    // 1-based field when the expression is just a field name, else 0.
+    int field() const { return field_; }
+
+private:
+    enum class Op : uint8_t {
+        Load,    // push rec[a .. a+b)
+        Lit,     // push lits_[a]
+        Upper,
+        Substr,  // top = top.substr(a, b)
+        Str,     // top = number formatted to width a, b decimals
+        Concat   // pop two, push their concatenation
+    };
+    struct Ins { Op op; uint32_t a{0}, b{0}; };
+
+    std::vector<Ins> prog_;
+    std::vector<std::string> lits_;
+    size_t width_{0};
+    int field_{0};
+    std::string text_;
+
+    friend class KeyExprCompiler;
+};
+
+} // namespace xbase
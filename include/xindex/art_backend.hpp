@@ -0,0 +1,56 @@
+#pragma once
+#include "xindex/key_common.hpp"
+#include "xindex/index_backend.hpp"
+
+#include <cstddef>
+#include <memory>
+
+namespace xindex {
+
+// In-memory adaptive radix tree (Leis et al., ICDE 2013).
+//
+// Inner nodes grow/shrink between 4, 16, 48 and 256 fan-out and compress
+// single-child paths into a prefix, so a C-field tag costs roughly one byte of
+// branching per distinct key byte instead of a full key copy per map node.
+// Keys need not be prefix-free: a key that ends inside the tree hangs off the
+// inner node where it ends ("terminal" leaf). Duplicate keys share one leaf
+// holding a sorted recno list.
+//
+// Memory-only like BptMemBackend: open/close do not touch disk.
+class ArtBackend : public IIndexBackend {
+public:
+    ArtBackend() = default;
+    ~ArtBackend() override;
+
+    ArtBackend(const ArtBackend&) = delete;
+    ArtBackend& operator=(const ArtBackend&) = delete;
+
+    bool open(const std::string& /*path*/) override { stale_ = false; return true; }
+    void close() override { /* nothing to release */ }
+
+    void setFingerprint(std::uint32_t /*fp*/) override { /* noop */ }
+    bool wasStale() const override { return stale_; }
+
+    void rebuild() override { /* noop: nothing to rebuild for memory-only */ }
+
+    void upsert(const Key& key, RecNo rec) override;
+    void erase (const Key& key, RecNo rec) override;
+
+    std::unique_ptr<Cursor> seek(const Key& key) const override;
+    std::unique_ptr<Cursor> scan(const Key& low, const Key& high) const override;
+
+    // Ordered cursor over every entry whose key starts with `prefix`.
+    std::unique_ptr<Cursor> seekPrefix(const Key& prefix) const;
+
+    void        clear();
+    std::size_t size() const override { return entries_; } // (key, recno) pairs
+
+    struct Node; // defined in art_backend.cpp
+
+private:
+    Node*       root_{nullptr};
+    std::size_t entries_{0};
+    bool        stale_{false};
+};
+
+} // namespace xindex
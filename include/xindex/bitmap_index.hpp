@@ -0,0 +1,41 @@
+#pragma once
+#include "xindex/roaring.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace xindex {
+
+// One roaring bitmap of record numbers per distinct field value.
+//
+// Meant for low-cardinality fields (L flags, short status/region codes) where
+// a B+tree entry per record is mostly duplicate keys. Combining bitmaps with
+// &, | and - answers conjunctions of equality tests without reading records.
+class BitmapIndex {
+public:
+    // Canonical value key shared by index maintenance and query literals,
+    // mirroring predicates::eval's "=": trimmed and upper-cased, or a
+    // canonical number when the text parses as one ("5", "5.00" -> "5").
+    static std::string normalize(const std::string& raw);
+
+    void insert(const std::string& value, std::uint32_t rec);
+    void erase (const std::string& value, std::uint32_t rec);
+    void update(const std::string& oldValue, const std::string& newValue, std::uint32_t rec);
+
+    // Records holding `value` (already normalized); nullptr if none.
+    const RoaringBitmap* lookup(const std::string& value) const;
+
+    // Every indexed record (union over all values).
+    RoaringBitmap all() const;
+
+    std::size_t distinct() const { return values_.size(); }
+    const std::map<std::string, RoaringBitmap>& values() const { return values_; }
+    void clear() { values_.clear(); }
+
+private:
+    std::map<std::string, RoaringBitmap> values_;
+};
+
+} // namespace xindex
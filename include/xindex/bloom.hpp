@@ -0,0 +1,138 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace xindex {
+
+// Bloom filter over byte-string keys: kBitsPerKey bits per expected key and
+// kProbes probes by double hashing, about 1% false positives at capacity.
+// Keys can only be added; a filter that has taken more than its capacity
+// still answers correctly, just less sharply, so owners rebuild it then.
+// A default-constructed (disabled) filter says "maybe" to everything.
+class BloomFilter {
+public:
+    static constexpr std::uint32_t kBitsPerKey = 10;
+    static constexpr std::uint32_t kProbes     = 7;
+
+    BloomFilter() = default;
+    explicit BloomFilter(std::size_t capacity) { reset(capacity); }
+
+    // Empty filter sized for `capacity` distinct keys.
+    void reset(std::size_t capacity) {
+        capacity_ = capacity;
+        added_ = 0;
+        bits_ = static_cast<std::uint32_t>(
+            std::max<std::size_t>(64, (capacity * kBitsPerKey + 63) / 64 * 64));
+        words_.assign(bits_ / 64, 0);
+        dirty_.assign(pageCount(), 1);
+    }
+    void disable() { bits_ = 0; capacity_ = added_ = 0; words_.clear(); dirty_.clear(); }
+
+    bool enabled() const { return bits_ != 0; }
+    bool saturated() const { return added_ > capacity_; }
+    std::size_t added() const { return added_; }
+
+    // FNV-1a, then a splitmix finalizer so short keys spread over all 64 bits.
+    static std::uint64_t hash(const std::uint8_t* p, std::size_t n) {
+        std::uint64_t h = 1469598103934665603ull;
+        for (std::size_t i = 0; i < n; ++i) { h ^= p[i]; h *= 1099511628211ull; }
+        h ^= h >> 30; h *= 0xbf58476d1ce4e5b9ull;
+        h ^= h >> 27; h *= 0x94d049bb133111ebull;
+        return h ^ (h >> 31);
+    }
+    static std::uint64_t hash(const std::vector<std::uint8_t>& k) { return hash(k.data(), k.size()); }
+
+    // The kProbes bit positions of h in a filter of `bits` bits;
+    // fn(bit) returns false to stop early. Returns false if stopped.
+    template <class Fn>
+    static bool forEachProbe(std::uint64_t h, std::uint32_t bits, Fn fn) {
+        const std::uint64_t h2 = (h >> 32) | 1;
+        for (std::uint32_t i = 0; i < kProbes; ++i)
+            if (!fn((h + i * h2) % bits)) return false;
+        return true;
+    }
+
+    void addHash(std::uint64_t h) {
+        if (!enabled()) return;
+        forEachProbe(h, bits_, [&](std::uint64_t bit){
+            words_[bit >> 6] |= 1ull << (bit & 63);
+            dirty_[(bit >> 6) / kWordsPerPage] = 1;
+            return true;
+        });
+        ++added_;
+    }
+    void add(const std::vector<std::uint8_t>& k) { addHash(hash(k)); }
+
+    bool mayContainHash(std::uint64_t h) const {
+        if (!enabled()) return true;
+        return forEachProbe(h, bits_, [&](std::uint64_t bit){ return ((words_[bit >> 6] >> (bit & 63)) & 1) != 0; });
+    }
+    bool mayContain(const std::vector<std::uint8_t>& k) const { return mayContainHash(hash(k)); }
+
+    // u32 bits | u64 capacity | u64 added | bits/64 x u64 words
+    void save(std::vector<std::uint8_t>& out) const {
+        put_(out, bits_);
+        put_(out, static_cast<std::uint64_t>(capacity_));
+        put_(out, static_cast<std::uint64_t>(added_));
+        for (std::uint64_t w : words_) put_(out, w);
+    }
+    void load(const std::uint8_t*& p, const std::uint8_t* end) {
+        const auto bits = take_<std::uint32_t>(p, end);
+        if (bits % 64) throw std::runtime_error("bloom: bad size");
+        capacity_ = static_cast<std::size_t>(take_<std::uint64_t>(p, end));
+        added_ = static_cast<std::size_t>(take_<std::uint64_t>(p, end));
+        if (static_cast<std::size_t>(end - p) / 8 < bits / 64) throw std::runtime_error("bloom: truncated");
+        bits_ = bits;
+        words_.resize(bits / 64);
+        for (auto& w : words_) w = take_<std::uint64_t>(p, end);
+        dirty_.assign(pageCount(), 1);
+    }
+
+    // Paged persistence (TreeFile): the words in pages of kWordsPerPage,
+    // each marked dirty when a bit in it is set, until clearDirty().
+    static constexpr std::size_t kWordsPerPage = 64;
+
+    std::uint32_t bits() const { return bits_; }
+    std::size_t capacity() const { return capacity_; }
+    const std::vector<std::uint64_t>& words() const { return words_; }
+    std::size_t pageCount() const { return (words_.size() + kWordsPerPage - 1) / kWordsPerPage; }
+    bool pageDirty(std::size_t pg) const { return dirty_[pg] != 0; }
+    void clearDirty() { std::fill(dirty_.begin(), dirty_.end(), 0); }
+
+    void restore(std::uint32_t bits, std::size_t capacity, std::size_t added, std::vector<std::uint64_t> words) {
+        if (bits % 64 || words.size() != bits / 64) throw std::runtime_error("bloom: bad size");
+        bits_ = bits;
+        capacity_ = capacity;
+        added_ = added;
+        words_ = std::move(words);
+        dirty_.assign(pageCount(), 0);
+    }
+
+private:
+    std::uint32_t bits_{0};
+    std::size_t   capacity_{0};
+    std::size_t   added_{0};
+    std::vector<std::uint64_t> words_;
+    std::vector<std::uint8_t>  dirty_;  // per page of words
+
+    template <class T>
+    static void put_(std::vector<std::uint8_t>& out, T v) {
+        const auto* b = reinterpret_cast<const std::uint8_t*>(&v);
+        out.insert(out.end(), b, b + sizeof v);
+    }
+    template <class T>
+    static T take_(const std::uint8_t*& p, const std::uint8_t* end) {
+        if (end - p < static_cast<std::ptrdiff_t>(sizeof(T))) throw std::runtime_error("bloom: truncated");
+        T v;
+        std::memcpy(&v, p, sizeof v);
+        p += sizeof v;
+        return v;
+    }
+};
+
+} // namespace xindex
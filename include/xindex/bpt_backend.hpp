@@ -2,6 +2,7 @@
 #include "xindex/key_common.hpp"
 #include "xindex/index_backend.hpp"
 
+#include <cstddef>
 #include <map>
 #include <memory>
 
@@ -28,6 +29,8 @@ public:
     std::unique_ptr<Cursor> seek(const Key& key) const override;
     std::unique_ptr<Cursor> scan(const Key& low, const Key& high) const override;
 
+    std::size_t size() const override { return map_.size(); }
+
 private:
     using Map = std::multimap<Key, RecNo, KeyLess>;
     Map map_{};
@@ -5,212 +5,626 @@
 #include <optional>
 #include <stdexcept>
 #include <limits>
-#include <iosfwd>
+#include <iterator>
+#include <istream>
+#include <ostream>
+#include "xindex/posting.hpp"
 
 namespace xindex {
 
-struct Key {
-    std::vector<uint8_t> bytes;
-    bool operator<(const Key& o) const noexcept { return bytes < o.bytes; }
-    bool operator==(const Key& o) const noexcept { return bytes == o.bytes; }
-};
-
 class BPlusTree {
 public:
+    // Nested so it does not collide with xindex::Key (key_common.hpp).
+    struct Key {
+        std::vector<uint8_t> bytes;
+        bool operator<(const Key& o) const noexcept { return bytes < o.bytes; }
+        bool operator==(const Key& o) const noexcept { return bytes == o.bytes; }
+    };
+
     explicit BPlusTree(int order = 64) : order_(std::max(8, order)) { newRootLeaf_(); }
 
-    void clear() { nodes_.clear(); root_ = newRootLeaf_(); }
+    void clear() { nodes_.clear(); dirty_.clear(); root_ = newRootLeaf_(); count_ = 0; }
 
-    void insert(const std::vector<uint8_t>& k, int32_t v) {
+    // Number of (key, value) entries, duplicates included.
+    size_t size() const { return count_; }
+
+    // `payload` is opaque bytes carried in the leaf entry next to the value
+    // (covering-index columns); empty for plain indexes.
+    void insert(const std::vector<uint8_t>& k, int32_t v, std::vector<uint8_t> payload = {}) {
         Key key{k};
-        auto split = insertRec_(root_, key, v);
+        ++count_;
+        auto split = insertRec_(root_, key, v, payload);
         if (split.has_value()) {
             int parent = newInternal_();
             nodes_[parent].keys = {split->firstKey};
+            nodes_[parent].firsts = {split->firstRec};
             nodes_[parent].children = {root_, split->newRight};
-            nodes_[parent].isLeaf = false;
             root_ = parent;
         }
     }
 
+    // Entries for insertBatch(), sorted by (key, value).
+    struct BatchEntry {
+        Key key;
+        int32_t value;
+        std::vector<uint8_t> payload;
+    };
+
+    // Insert a sorted batch in one pass: each affected leaf is reached once,
+    // takes its whole share of the batch and is then split as often as needed.
+    void insertBatch(std::vector<BatchEntry>& batch) {
+        if (batch.empty()) return;
+        count_ += batch.size();
+        auto splits = insertRange_(root_, batch.data(), batch.data() + batch.size());
+        while (!splits.empty()) {
+            int parent = newInternal_();
+            Node& P = nodes_[parent];
+            P.children.push_back(root_);
+            for (auto& sp : splits) {
+                P.keys.push_back(std::move(sp.firstKey));
+                P.firsts.push_back(sp.firstRec);
+                P.children.push_back(sp.newRight);
+            }
+            root_ = parent;
+            splits = splitInternalMany_(parent);
+        }
+    }
+
     void erase(const std::vector<uint8_t>& k, int32_t v) {
         Key key{k};
-        eraseRec_(root_, key, v);
-        if (!nodes_[root_].isLeaf && nodes_[root_].children.size() == 1)
-            root_ = nodes_[root_].children[0];
+        int n = descend_(key, v);
+        Node& L = nodes_[n];
+        const size_t pos = upperEntry_(L, key, v);
+        if (pos == 0 || !(L.keys[pos - 1] == key)) return;
+        PostingChunk& c = L.chunks[pos - 1];
+        if (!c.erase(v)) return;
+        --count_;
+        touch_(n);
+        if (c.count == 0) {
+            L.keys.erase(L.keys.begin() + static_cast<long>(pos - 1));
+            L.chunks.erase(L.chunks.begin() + static_cast<long>(pos - 1));
+        }
     }
 
     std::optional<int32_t> seekGE(const std::vector<uint8_t>& target) const {
-        Key key{target};
-        int n = root_;
-        while (!nodes_[n].isLeaf) {
-            const auto& K = nodes_[n].keys;
-            auto it = std::lower_bound(K.begin(), K.end(), key);
-            size_t idx = static_cast<size_t>(it - K.begin());
-            if (idx >= nodes_[n].children.size()) idx = nodes_[n].children.size() - 1;
-            n = nodes_[n].children[idx];
-        }
-        const auto& K = nodes_[n].keys;
-        const auto& V = nodes_[n].values;
-        auto it = std::lower_bound(K.begin(), K.end(), key);
-        if (it == K.end()) {
-            int next = nodes_[n].nextLeaf;
-            if (next < 0) return std::nullopt;
-            if (!nodes_[next].keys.empty()) return nodes_[next].values[0];
-            return std::nullopt;
+        std::optional<int32_t> hit;
+        scanFrom(target, [&](const std::vector<uint8_t>&, int32_t v){ hit = v; return false; });
+        return hit;
+    }
+
+    // Visit (key, value) pairs in key order (values ascending within a key)
+    // starting at the first key >= lo; fn returns false to stop.
+    template <class Fn>
+    void scanFrom(const std::vector<uint8_t>& lo, Fn fn) const {
+        scanEntries(lo, [&](const std::vector<uint8_t>& k, int32_t v, const std::vector<uint8_t>&){ return fn(k, v); });
+    }
+
+    template <class Fn>
+    void forEach(Fn fn) const { scanFrom({}, fn); }
+
+    // As scanFrom, with the entry payload: fn(key, value, payload).
+    template <class Fn>
+    void scanEntries(const std::vector<uint8_t>& lo, Fn fn) const {
+        Key key{lo};
+        int n = descend_(key, std::numeric_limits<int32_t>::min());
+        const auto& K0 = nodes_[n].keys;
+        size_t i = static_cast<size_t>(std::lower_bound(K0.begin(), K0.end(), key) - K0.begin());
+        for (; n >= 0; n = nodes_[n].nextLeaf, i = 0) {
+            const Node& L = nodes_[n];
+            for (; i < L.keys.size(); ++i) {
+                const PostingChunk& c = L.chunks[i];
+                const auto& kb = L.keys[i].bytes;
+                if (!c.forEach([&](int32_t r, size_t j){ return fn(kb, r, c.payload(j)); })) return;
+            }
         }
-        size_t i = static_cast<size_t>(it - K.begin());
-        return V[i];
     }
 
+    // BPT3: one key per posting chunk, recnos as varint deltas. BPT1/BPT2
+    // files (a key and a 4-byte value per entry) still load.
     void save(std::ostream& os) const {
-        writeU32_(os, 'B'<<24 | 'P'<<16 | 'T'<<8 | '1');
+        writeU32_(os, magic_('3'));
         writeI32_(os, order_);
         writeI32_(os, root_);
         writeI32_(os, static_cast<int32_t>(nodes_.size()));
         for (const auto& n : nodes_) {
             writeU8_(os, n.isLeaf ? 1 : 0);
             writeI32_(os, n.nextLeaf);
-            writeI32_(os, static_cast<int32_t>(n.keys.size()));
-            for (const auto& k : n.keys) {
-                writeI32_(os, static_cast<int32_t>(k.bytes.size()));
-                if (!k.bytes.empty())
-                    os.write(reinterpret_cast<const char*>(k.bytes.data()),
-                             static_cast<std::streamsize>(k.bytes.size()));
-            }
+            writeVarint_(os, static_cast<uint32_t>(n.keys.size()));
+            for (const auto& k : n.keys) writeBytes_(os, k.bytes);
             if (n.isLeaf) {
-                for (int32_t v : n.values) writeI32_(os, v);
+                for (const auto& c : n.chunks) {
+                    writeI32_(os, c.first);
+                    writeVarint_(os, c.count);
+                    writeBytes_(os, c.deltas);
+                    writeU8_(os, c.payloads.empty() ? 0 : 1);
+                    for (const auto& p : c.payloads) writeBytes_(os, p);
+                }
             } else {
-                writeI32_(os, static_cast<int32_t>(n.children.size()));
+                for (int32_t f : n.firsts) writeI32_(os, f);
                 for (int c : n.children) writeI32_(os, c);
             }
         }
     }
 
     void load(std::istream& is) {
+        const uint32_t magic = readU32_(is);
+        if (magic == magic_('1') || magic == magic_('2')) { loadLegacy_(is, magic == magic_('2')); return; }
+        if (magic != magic_('3')) throw std::runtime_error("BPlusTree: bad magic");
+
         nodes_.clear();
-        uint32_t magic = readU32_(is);
-        if (magic != (static_cast<uint32_t>('B')<<24 | static_cast<uint32_t>('P')<<16 |
-                      static_cast<uint32_t>('T')<<8  | static_cast<uint32_t>('1')))
-            throw std::runtime_error("BPlusTree: bad magic");
         order_ = readI32_(is);
         root_  = readI32_(is);
         int32_t N = readI32_(is);
-        nodes_.resize(N);
-        for (int i = 0; i < N; ++i) {
-            auto& n = nodes_[i];
+        if (N <= 0) throw std::runtime_error("BPlusTree: bad node count");
+        nodes_.resize(static_cast<size_t>(N));
+        count_ = 0;
+        for (auto& n : nodes_) {
             n.isLeaf  = (readU8_(is) != 0);
             n.nextLeaf = readI32_(is);
-            int32_t kc = readI32_(is);
+            const uint32_t kc = readVarint_(is);
             n.keys.resize(kc);
-            for (int j = 0; j < kc; ++j) {
-                int32_t L = readI32_(is);
-                if (L < 0) throw std::runtime_error("BPlusTree: bad key length");
-                n.keys[j].bytes.resize(static_cast<size_t>(L));
-                if (L) is.read(reinterpret_cast<char*>(n.keys[j].bytes.data()), L);
-            }
+            for (auto& k : n.keys) readBytes_(is, k.bytes);
             if (n.isLeaf) {
-                n.values.resize(kc);
-                for (int j = 0; j < kc; ++j) n.values[j] = readI32_(is);
+                n.chunks.resize(kc);
+                for (auto& c : n.chunks) {
+                    c.first = readI32_(is);
+                    c.count = readVarint_(is);
+                    readBytes_(is, c.deltas);
+                    if (readU8_(is)) {
+                        c.payloads.resize(c.count);
+                        for (auto& p : c.payloads) readBytes_(is, p);
+                    }
+                    count_ += c.count;
+                }
             } else {
-                int32_t cc = readI32_(is);
-                n.children.resize(cc);
-                for (int j = 0; j < cc; ++j) n.children[j] = readI32_(is);
+                n.firsts.resize(kc);
+                for (auto& f : n.firsts) f = readI32_(is);
+                n.children.resize(kc + 1);
+                for (auto& c : n.children) {
+                    c = readI32_(is);
+                    if (c < 0 || c >= N) throw std::runtime_error("BPlusTree: bad child id");
+                }
+            }
+        }
+        if (root_ < 0 || root_ >= N) throw std::runtime_error("BPlusTree: bad root id");
+        dirty_.assign(nodes_.size(), 0);
+    }
+
+    // ---- paged persistence (TreeFile) ----
+    // Nodes are numbered 0..nodeCount()-1 for good; a node is dirty from
+    // the moment it is created or changed until clearDirty().
+
+    int    order() const { return order_; }
+    int    root() const { return root_; }
+    size_t nodeCount() const { return nodes_.size(); }
+    bool   nodeDirty(size_t id) const { return dirty_[id] != 0; }
+    void   clearDirty() { std::fill(dirty_.begin(), dirty_.end(), 0); }
+
+    // Node image: u8 leaf | varint nextLeaf+1 | varint nkeys | keys, then
+    // per leaf chunk: varint first, count, deltas, u8 hasPayloads [payloads],
+    // or per internal node: varint firsts, children.
+    void encodeNode(size_t id, std::vector<uint8_t>& out) const {
+        const Node& n = nodes_[id];
+        out.clear();
+        out.push_back(n.isLeaf ? 1 : 0);
+        putVarint(out, static_cast<uint32_t>(n.nextLeaf + 1));
+        putVarint(out, static_cast<uint32_t>(n.keys.size()));
+        for (const auto& k : n.keys) putBytes_(out, k.bytes);
+        if (n.isLeaf) {
+            for (const auto& c : n.chunks) {
+                putVarint(out, static_cast<uint32_t>(c.first));
+                putVarint(out, c.count);
+                putBytes_(out, c.deltas);
+                out.push_back(c.payloads.empty() ? 0 : 1);
+                for (const auto& p : c.payloads) putBytes_(out, p);
             }
+        } else {
+            for (int32_t f : n.firsts) putVarint(out, static_cast<uint32_t>(f));
+            for (int c : n.children) putVarint(out, static_cast<uint32_t>(c));
+        }
+    }
+
+    // Start a load of `nodeCount` nodes; fill each with decodeNode(), then
+    // call finishLoad(). The tree comes out clean.
+    void beginLoad(int order, int root, size_t nodeCount) {
+        if (nodeCount == 0 || root < 0 || static_cast<size_t>(root) >= nodeCount)
+            throw std::runtime_error("BPlusTree: bad paged header");
+        order_ = std::max(8, order);
+        root_ = root;
+        nodes_.assign(nodeCount, Node{});
+        dirty_.assign(nodeCount, 0);
+        count_ = 0;
+    }
+
+    void decodeNode(size_t id, const uint8_t* p, const uint8_t* end) {
+        Node& n = nodes_[id];
+        if (p == end) throw std::runtime_error("BPlusTree: empty node image");
+        n.isLeaf = *p++ != 0;
+        n.nextLeaf = static_cast<int>(getVarint(p, end)) - 1;
+        const uint32_t kc = getVarint(p, end);
+        n.keys.resize(kc);
+        for (auto& k : n.keys) takeBytes_(p, end, k.bytes);
+        if (n.isLeaf) {
+            n.chunks.resize(kc);
+            for (auto& c : n.chunks) {
+                c.first = static_cast<int32_t>(getVarint(p, end));
+                c.count = getVarint(p, end);
+                takeBytes_(p, end, c.deltas);
+                if (p == end) throw std::runtime_error("BPlusTree: truncated node");
+                if (*p++) {
+                    c.payloads.resize(c.count);
+                    for (auto& pl : c.payloads) takeBytes_(p, end, pl);
+                }
+                count_ += c.count;
+            }
+        } else {
+            n.firsts.resize(kc);
+            for (auto& f : n.firsts) f = static_cast<int32_t>(getVarint(p, end));
+            n.children.resize(kc + 1);
+            for (auto& c : n.children) c = static_cast<int>(getVarint(p, end));
+        }
+    }
+
+    void finishLoad() {
+        const int N = static_cast<int>(nodes_.size());
+        for (const auto& n : nodes_) {
+            for (int c : n.children)
+                if (c < 0 || c >= N) throw std::runtime_error("BPlusTree: bad child id");
+            if (n.nextLeaf < -1 || n.nextLeaf >= N) throw std::runtime_error("BPlusTree: bad leaf link");
         }
-        if (root_ < 0 || root_ >= static_cast<int>(nodes_.size()))
-            throw std::runtime_error("BPlusTree: bad root id");
     }
 
 private:
+    // Leaf entries are ordered by (key, chunk.first); internal separators
+    // carry the same pair, so a key with many duplicates can span leaves and
+    // still be located by (key, recno).
     struct Node {
         bool isLeaf{true};
         std::vector<Key> keys;
-        std::vector<int> children;   // internal only
-        std::vector<int32_t> values; // leaf only
-        int nextLeaf{-1};            // leaf chain
+        std::vector<int32_t> firsts;       // internal only, parallel to keys
+        std::vector<int> children;         // internal only
+        std::vector<PostingChunk> chunks;  // leaf only, parallel to keys
+        int nextLeaf{-1};                  // leaf chain
     };
 
     int order_;
     std::vector<Node> nodes_;
+    std::vector<uint8_t> dirty_;  // parallel to nodes_
     int root_{0};
+    size_t count_{0};
+
+    void touch_(int id) { dirty_[static_cast<size_t>(id)] = 1; }
+
+    static constexpr uint32_t magic_(char ver) {
+        return static_cast<uint32_t>('B')<<24 | static_cast<uint32_t>('P')<<16 |
+               static_cast<uint32_t>('T')<<8 | static_cast<uint32_t>(ver);
+    }
 
-    int newRootLeaf_() { nodes_.push_back(Node{}); root_ = static_cast<int>(nodes_.size()) - 1; return root_; }
-    int newLeaf_()     { nodes_.push_back(Node{}); return static_cast<int>(nodes_.size()) - 1; }
-    int newInternal_() { nodes_.push_back(Node{}); nodes_.back().isLeaf = false; return static_cast<int>(nodes_.size()) - 1; }
+    int newRootLeaf_() { root_ = newLeaf_(); return root_; }
+    int newLeaf_()     { nodes_.push_back(Node{}); dirty_.push_back(1); return static_cast<int>(nodes_.size()) - 1; }
+    int newInternal_() { const int id = newLeaf_(); nodes_.back().isLeaf = false; return id; }
 
-    struct SplitRet { Key firstKey; int newRight; };
+    static bool before_(const Key& a, int32_t af, const Key& b, int32_t bf) {
+        if (a < b) return true;
+        return a == b && af < bf;
+    }
 
-    std::optional<SplitRet> insertRec_(int nId, const Key& key, int32_t val) {
+    // Child holding (key, v): one past the last separator <= (key, v).
+    static size_t childFor_(const Node& n, const Key& key, int32_t v) {
+        size_t lo = 0, hi = n.keys.size();
+        while (lo < hi) {
+            const size_t m = (lo + hi) / 2;
+            if (before_(key, v, n.keys[m], n.firsts[m])) hi = m; else lo = m + 1;
+        }
+        return lo;
+    }
+
+    // Leaf entries before the result are <= (key, v).
+    static size_t upperEntry_(const Node& L, const Key& key, int32_t v) {
+        size_t lo = 0, hi = L.keys.size();
+        while (lo < hi) {
+            const size_t m = (lo + hi) / 2;
+            if (before_(key, v, L.keys[m], L.chunks[m].first)) hi = m; else lo = m + 1;
+        }
+        return lo;
+    }
+
+    int descend_(const Key& key, int32_t v) const {
+        int n = root_;
+        while (!nodes_[n].isLeaf) n = nodes_[n].children[childFor_(nodes_[n], key, v)];
+        return n;
+    }
+
+    struct SplitRet { Key firstKey; int32_t firstRec; int newRight; };
+
+    // Place one value in leaf L (no split): it joins the chunk of its key
+    // with the largest first <= val, else starts a new chunk there.
+    static void leafInsert_(Node& L, const Key& key, int32_t val, std::vector<uint8_t> payload) {
+        const size_t pos = upperEntry_(L, key, val);
+        if (pos > 0 && L.keys[pos - 1] == key) {
+            // Joins the chunk covering val; split it once it grows too long.
+            PostingChunk& c = L.chunks[pos - 1];
+            c.insert(val, std::move(payload));
+            if (c.count > PostingChunk::kMax) {
+                PostingChunk upper = c.splitHalf();
+                if (upper.count) {
+                    L.keys.insert(L.keys.begin() + static_cast<long>(pos), key);
+                    L.chunks.insert(L.chunks.begin() + static_cast<long>(pos), std::move(upper));
+                }
+            }
+        } else {
+            L.keys.insert(L.keys.begin() + static_cast<long>(pos), key);
+            L.chunks.insert(L.chunks.begin() + static_cast<long>(pos),
+                            PostingChunk::single(val, std::move(payload)));
+        }
+    }
+
+    std::optional<SplitRet> insertRec_(int nId, const Key& key, int32_t val, std::vector<uint8_t>& payload) {
         Node& n = nodes_[nId];
         if (n.isLeaf) {
-            auto it = std::lower_bound(n.keys.begin(), n.keys.end(), key);
-            size_t pos = static_cast<size_t>(it - n.keys.begin());
-            n.keys.insert(it, key);
-            n.values.insert(n.values.begin() + static_cast<long>(pos), val);
+            touch_(nId);
+            leafInsert_(n, key, val, std::move(payload));
             if (static_cast<int>(n.keys.size()) > order_) return splitLeaf_(nId);
             return std::nullopt;
         } else {
-            auto it = std::lower_bound(n.keys.begin(), n.keys.end(), key);
-            size_t idx = static_cast<size_t>(it - n.keys.begin());
-            if (idx >= n.children.size()) idx = n.children.size() - 1;
-            auto s = insertRec_(n.children[idx], key, val);
+            const size_t idx = childFor_(n, key, val);
+            auto s = insertRec_(n.children[idx], key, val, payload);
             if (!s) return std::nullopt;
-            n.keys.insert(n.keys.begin() + static_cast<long>(idx), s->firstKey);
-            n.children.insert(n.children.begin() + static_cast<long>(idx + 1), s->newRight);
-            if (static_cast<int>(n.children.size()) > order_ + 1) return splitInternal_(nId);
+            Node& m = nodes_[nId]; // recursion may have grown nodes_
+            touch_(nId);
+            m.keys.insert(m.keys.begin() + static_cast<long>(idx), s->firstKey);
+            m.firsts.insert(m.firsts.begin() + static_cast<long>(idx), s->firstRec);
+            m.children.insert(m.children.begin() + static_cast<long>(idx + 1), s->newRight);
+            if (static_cast<int>(m.children.size()) > order_ + 1) return splitInternal_(nId);
             return std::nullopt;
         }
     }
 
     std::optional<SplitRet> splitLeaf_(int nId) {
+        int RId = newLeaf_(); // allocate first: push_back invalidates references
         Node& L = nodes_[nId];
-        int total = static_cast<int>(L.keys.size());
-        int mid = total / 2;
-        int RId = newLeaf_();
         Node& R = nodes_[RId];
+        const long mid = static_cast<long>(L.keys.size()) / 2;
         R.keys.assign(L.keys.begin() + mid, L.keys.end());
-        R.values.assign(L.values.begin() + mid, L.values.end());
-        L.keys.resize(mid);
-        L.values.resize(mid);
+        R.chunks.assign(std::make_move_iterator(L.chunks.begin() + mid),
+                        std::make_move_iterator(L.chunks.end()));
+        L.keys.resize(static_cast<size_t>(mid));
+        L.chunks.resize(static_cast<size_t>(mid));
         R.nextLeaf = L.nextLeaf;
         L.nextLeaf = RId;
-        return SplitRet{ R.keys.front(), RId };
+        return SplitRet{ R.keys.front(), R.chunks.front().first, RId };
     }
 
     std::optional<SplitRet> splitInternal_(int nId) {
-        Node& P = nodes_[nId];
-        int midKeyIdx = static_cast<int>(P.keys.size()) / 2;
-        Key upKey = P.keys[midKeyIdx];
         int RId = newInternal_();
+        Node& P = nodes_[nId];
         Node& R = nodes_[RId];
+        const long midKeyIdx = static_cast<long>(P.keys.size()) / 2;
+        SplitRet up{ P.keys[static_cast<size_t>(midKeyIdx)], P.firsts[static_cast<size_t>(midKeyIdx)], RId };
         R.keys.assign(P.keys.begin() + (midKeyIdx + 1), P.keys.end());
-        P.keys.resize(midKeyIdx);
+        R.firsts.assign(P.firsts.begin() + (midKeyIdx + 1), P.firsts.end());
         R.children.assign(P.children.begin() + (midKeyIdx + 1), P.children.end());
-        P.children.resize(midKeyIdx + 1);
-        return SplitRet{ upKey, RId };
+        P.keys.resize(static_cast<size_t>(midKeyIdx));
+        P.firsts.resize(static_cast<size_t>(midKeyIdx));
+        P.children.resize(static_cast<size_t>(midKeyIdx + 1));
+        return up;
     }
 
-    bool eraseRec_(int nId, const Key& key, int32_t val) {
+    // ---- batch insert ----
+
+    std::vector<SplitRet> insertRange_(int nId, BatchEntry* b, BatchEntry* e) {
+        if (nodes_[nId].isLeaf) {
+            touch_(nId);
+            batchLeaf_(nodes_[nId], b, e);
+            return splitLeafMany_(nId);
+        }
+        // Children's shares are contiguous runs of the sorted batch.
+        std::vector<std::pair<size_t, std::vector<SplitRet>>> childSplits;
+        for (BatchEntry* p = b; p != e; ) {
+            const Node& n = nodes_[nId];
+            const size_t idx = childFor_(n, p->key, p->value);
+            BatchEntry* q = e;
+            if (idx < n.keys.size()) {
+                const Key& sk = n.keys[idx];
+                const int32_t sf = n.firsts[idx];
+                q = std::partition_point(p, e, [&](const BatchEntry& x){ return before_(x.key, x.value, sk, sf); });
+            }
+            const int child = n.children[idx];
+            auto s = insertRange_(child, p, q); // may grow nodes_
+            if (!s.empty()) childSplits.emplace_back(idx, std::move(s));
+            p = q;
+        }
         Node& n = nodes_[nId];
-        if (n.isLeaf) {
-            auto it = std::lower_bound(n.keys.begin(), n.keys.end(), key);
-            if (it == n.keys.end()) return false;
-            size_t i = static_cast<size_t>(it - n.keys.begin());
-            while (i < n.keys.size() && !(key < n.keys[i]) && !(n.keys[i] < key)) {
-                if (n.values[i] == val) {
-                    n.keys.erase(n.keys.begin() + static_cast<long>(i));
-                    n.values.erase(n.values.begin() + static_cast<long>(i));
-                    return true;
+        if (!childSplits.empty()) touch_(nId);
+        for (auto it = childSplits.rbegin(); it != childSplits.rend(); ++it) {
+            const long at = static_cast<long>(it->first);
+            std::vector<Key> ks;
+            std::vector<int32_t> fs;
+            std::vector<int> cs;
+            for (auto& sp : it->second) {
+                ks.push_back(std::move(sp.firstKey));
+                fs.push_back(sp.firstRec);
+                cs.push_back(sp.newRight);
+            }
+            n.keys.insert(n.keys.begin() + at, std::make_move_iterator(ks.begin()), std::make_move_iterator(ks.end()));
+            n.firsts.insert(n.firsts.begin() + at, fs.begin(), fs.end());
+            n.children.insert(n.children.begin() + at + 1, cs.begin(), cs.end());
+        }
+        return splitInternalMany_(nId);
+    }
+
+    // Leaf share of a batch. A run of values bound for the same chunk is
+    // merged into it with one re-encode; the chunk is then cut back to kMax.
+    static void batchLeaf_(Node& L, BatchEntry* b, BatchEntry* e) {
+        std::vector<std::pair<int32_t, std::vector<uint8_t>>> run;
+        for (BatchEntry* p = b; p != e; ) {
+            size_t pos = upperEntry_(L, p->key, p->value);
+            if (pos == 0 || !(L.keys[pos - 1] == p->key)) {
+                L.keys.insert(L.keys.begin() + static_cast<long>(pos), p->key);
+                L.chunks.insert(L.chunks.begin() + static_cast<long>(pos),
+                                PostingChunk::single(p->value, std::move(p->payload)));
+                ++p;
+                ++pos;
+            }
+            const size_t at = pos - 1;
+            run.clear();
+            for (; p != e && p->key == L.keys[at] &&
+                   (pos == L.keys.size() || before_(p->key, p->value, L.keys[pos], L.chunks[pos].first)); ++p)
+                run.emplace_back(p->value, std::move(p->payload));
+            if (!run.empty()) L.chunks[at].insertSorted(run);
+            splitChunk_(L, at);
+        }
+    }
+
+    static void splitChunk_(Node& L, size_t at) {
+        if (L.chunks[at].count <= PostingChunk::kMax) return;
+        PostingChunk upper = L.chunks[at].splitHalf();
+        if (!upper.count) return;
+        L.keys.insert(L.keys.begin() + static_cast<long>(at + 1), L.keys[at]);
+        L.chunks.insert(L.chunks.begin() + static_cast<long>(at + 1), std::move(upper));
+        splitChunk_(L, at + 1);
+        splitChunk_(L, at);
+    }
+
+    // Split an overfull leaf into as many roughly equal leaves as needed.
+    std::vector<SplitRet> splitLeafMany_(int nId) {
+        const size_t n = nodes_[nId].keys.size();
+        const size_t cap = static_cast<size_t>(order_);
+        if (n <= cap) return {};
+        const size_t pieces = (n + cap - 1) / cap;
+        std::vector<int> ids{nId};
+        for (size_t j = 1; j < pieces; ++j) ids.push_back(newLeaf_()); // before taking references
+        Node& L = nodes_[nId];
+        std::vector<SplitRet> out;
+        const int tailNext = L.nextLeaf;
+        size_t at = n / pieces + (0 < n % pieces ? 1 : 0);
+        const size_t keep = at;
+        for (size_t j = 1; j < pieces; ++j) {
+            const size_t len = n / pieces + (j < n % pieces ? 1 : 0);
+            Node& R = nodes_[ids[j]];
+            R.keys.assign(std::make_move_iterator(L.keys.begin() + static_cast<long>(at)),
+                          std::make_move_iterator(L.keys.begin() + static_cast<long>(at + len)));
+            R.chunks.assign(std::make_move_iterator(L.chunks.begin() + static_cast<long>(at)),
+                            std::make_move_iterator(L.chunks.begin() + static_cast<long>(at + len)));
+            nodes_[ids[j - 1]].nextLeaf = ids[j];
+            out.push_back(SplitRet{ R.keys.front(), R.chunks.front().first, ids[j] });
+            at += len;
+        }
+        nodes_[ids.back()].nextLeaf = tailNext;
+        L.keys.resize(keep);
+        L.chunks.resize(keep);
+        return out;
+    }
+
+    // Split an overfull internal node into as many nodes as needed; the key
+    // between two pieces moves up.
+    std::vector<SplitRet> splitInternalMany_(int nId) {
+        const size_t m = nodes_[nId].children.size();
+        const size_t cap = static_cast<size_t>(order_) + 1;
+        if (m <= cap) return {};
+        const size_t pieces = (m + cap - 1) / cap;
+        std::vector<int> ids{nId};
+        for (size_t j = 1; j < pieces; ++j) ids.push_back(newInternal_());
+        Node& P = nodes_[nId];
+        std::vector<SplitRet> out;
+        size_t at = m / pieces + (0 < m % pieces ? 1 : 0); // children in piece 0
+        const size_t keep = at;
+        for (size_t j = 1; j < pieces; ++j) {
+            const size_t len = m / pieces + (j < m % pieces ? 1 : 0);
+            Node& R = nodes_[ids[j]];
+            // children [at, at+len), keys between them [at, at+len-1); key at-1 goes up
+            R.children.assign(P.children.begin() + static_cast<long>(at), P.children.begin() + static_cast<long>(at + len));
+            R.keys.assign(P.keys.begin() + static_cast<long>(at), P.keys.begin() + static_cast<long>(at + len - 1));
+            R.firsts.assign(P.firsts.begin() + static_cast<long>(at), P.firsts.begin() + static_cast<long>(at + len - 1));
+            out.push_back(SplitRet{ P.keys[at - 1], P.firsts[at - 1], ids[j] });
+            at += len;
+        }
+        P.children.resize(keep);
+        P.keys.resize(keep - 1);
+        P.firsts.resize(keep - 1);
+        return out;
+    }
+
+    // BPT1/BPT2: per-entry key + I32 value (+ I32-length payload in BPT2).
+    // Re-inserted entry by entry into the posting layout.
+    void loadLegacy_(std::istream& is, bool withPayloads) {
+        struct Entry { std::vector<uint8_t> key; int32_t v; std::vector<uint8_t> payload; };
+        std::vector<Entry> all;
+        const int order = readI32_(is);
+        readI32_(is); // root
+        const int32_t N = readI32_(is);
+        for (int32_t i = 0; i < N; ++i) {
+            const bool leaf = readU8_(is) != 0;
+            readI32_(is); // nextLeaf
+            const int32_t kc = readI32_(is);
+            if (kc < 0) throw std::runtime_error("BPlusTree: bad key count");
+            std::vector<std::vector<uint8_t>> keys(static_cast<size_t>(kc));
+            for (auto& k : keys) {
+                const int32_t L = readI32_(is);
+                if (L < 0) throw std::runtime_error("BPlusTree: bad key length");
+                k.resize(static_cast<size_t>(L));
+                if (L) is.read(reinterpret_cast<char*>(k.data()), L);
+            }
+            if (leaf) {
+                const size_t base = all.size();
+                for (auto& k : keys) all.push_back({std::move(k), readI32_(is), {}});
+                if (withPayloads) {
+                    for (size_t j = base; j < all.size(); ++j) {
+                        const int32_t L = readI32_(is);
+                        if (L < 0) throw std::runtime_error("BPlusTree: bad payload length");
+                        all[j].payload.resize(static_cast<size_t>(L));
+                        if (L) is.read(reinterpret_cast<char*>(all[j].payload.data()), L);
+                    }
                 }
-                ++i;
+            } else {
+                const int32_t cc = readI32_(is);
+                for (int32_t j = 0; j < cc; ++j) readI32_(is);
             }
-            return false;
-        } else {
-            auto it = std::lower_bound(n.keys.begin(), n.keys.end(), key);
-            size_t idx = static_cast<size_t>(it - n.keys.begin());
-            if (idx >= n.children.size()) idx = n.children.size() - 1;
-            return eraseRec_(n.children[idx], key, val);
+        }
+        if (!is) throw std::runtime_error("BPlusTree: EOF");
+        std::sort(all.begin(), all.end(), [](const Entry& a, const Entry& b){
+            return a.key < b.key || (a.key == b.key && a.v < b.v);
+        });
+        order_ = std::max(8, order);
+        clear();
+        for (auto& e : all) insert(e.key, e.v, std::move(e.payload));
+    }
+
+    static void putBytes_(std::vector<uint8_t>& out, const std::vector<uint8_t>& b) {
+        putVarint(out, static_cast<uint32_t>(b.size()));
+        out.insert(out.end(), b.begin(), b.end());
+    }
+    static void takeBytes_(const uint8_t*& p, const uint8_t* end, std::vector<uint8_t>& b) {
+        const uint32_t n = getVarint(p, end);
+        if (static_cast<size_t>(end - p) < n) throw std::runtime_error("BPlusTree: truncated node");
+        b.assign(p, p + n);
+        p += n;
+    }
+
+    static void writeVarint_(std::ostream& os, uint32_t v) {
+        std::vector<uint8_t> b;
+        putVarint(b, v);
+        os.write(reinterpret_cast<const char*>(b.data()), static_cast<std::streamsize>(b.size()));
+    }
+    static uint32_t readVarint_(std::istream& is) {
+        uint32_t v = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            const uint8_t b = readU8_(is);
+            v |= static_cast<uint32_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        throw std::runtime_error("BPlusTree: bad varint");
+    }
+    static void writeBytes_(std::ostream& os, const std::vector<uint8_t>& b) {
+        writeVarint_(os, static_cast<uint32_t>(b.size()));
+        if (!b.empty())
+            os.write(reinterpret_cast<const char*>(b.data()), static_cast<std::streamsize>(b.size()));
+    }
+    static void readBytes_(std::istream& is, std::vector<uint8_t>& b) {
+        b.resize(readVarint_(is));
+        if (!b.empty()) {
+            is.read(reinterpret_cast<char*>(b.data()), static_cast<std::streamsize>(b.size()));
+            if (!is) throw std::runtime_error("BPlusTree: EOF");
         }
     }
 
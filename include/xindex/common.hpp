@@ -17,6 +17,12 @@ inline constexpr uint32_t kFileVersion = 1;
 inline constexpr char kBackendKind_BPTREE[] = "BPTREE";
 // Name for the *in-memory* backend in this bundle
 inline constexpr char kBackendKind_BPTMEM[] = "BPTMEM";
+// Name for the *in-memory* adaptive radix tree backend
+inline constexpr char kBackendKind_ART[]    = "ART";
+// Name for the *persistent* log-structured merge backend
+inline constexpr char kBackendKind_LSM[]    = "LSM";
+// Name for the *in-memory* unordered hash backend (exact-key lookups only)
+inline constexpr char kBackendKind_HASH[]   = "HASH";
 
 struct Fingerprint {
     uint32_t codec_version{1};  // bump when key encoding changes
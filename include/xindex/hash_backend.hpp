@@ -0,0 +1,55 @@
+#pragma once
+#include "xindex/key_common.hpp"
+#include "xindex/index_backend.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace xindex {
+
+// In-memory hash index: key -> ascending recnos. An exact-key seek is one
+// hash probe however many keys there are, but there is no key order, so it
+// cannot answer ranges or key prefixes (ordered() is false and scan() only
+// takes the whole-index form).
+//
+// Memory-only like BptMemBackend: open/close do not touch disk.
+class HashBackend : public IIndexBackend {
+public:
+    HashBackend() = default;
+    ~HashBackend() override = default;
+
+    bool open(const std::string& /*path*/) override { stale_ = false; return true; }
+    void close() override { /* nothing to release */ }
+
+    void setFingerprint(std::uint32_t /*fp*/) override { /* noop */ }
+    bool wasStale() const override { return stale_; }
+
+    void rebuild() override { /* noop: nothing to rebuild for memory-only */ }
+
+    void upsert(const Key& key, RecNo rec) override;
+    void erase (const Key& key, RecNo rec) override;
+
+    std::unique_ptr<Cursor> seek(const Key& key) const override;
+    // scan({}, {}) visits every entry, grouped by key in no set order;
+    // throws std::logic_error for any bounded range.
+    std::unique_ptr<Cursor> scan(const Key& low, const Key& high) const override;
+
+    std::size_t size() const override { return entries_; }
+    bool ordered() const override { return false; }
+
+private:
+    struct KeyHash {
+        std::size_t operator()(const Key& k) const noexcept;
+    };
+    using Map = std::unordered_map<Key, std::vector<RecNo>, KeyHash>;
+    Map         map_{};
+    std::size_t entries_{0};
+    bool        stale_{false};
+
+    class MapCursor;
+    class ListCursor;
+};
+
+} // namespace xindex
@@ -1,6 +1,7 @@
 #pragma once
 #include "xindex/key_common.hpp"
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -31,8 +32,30 @@ struct IIndexBackend {
     virtual void upsert(const Key& key, RecNo rec) = 0;
     virtual void erase(const Key& key, RecNo rec) = 0;
 
+    // seek: entries with exactly `key`. scan: entries with low <= key <=
+    // high in key order (recnos ascending within a key); an empty `high`
+    // means no upper bound, so scan({}, {}) visits everything.
     virtual std::unique_ptr<Cursor> seek(const Key& key) const = 0;
     virtual std::unique_ptr<Cursor> scan(const Key& low, const Key& high) const = 0;
+
+    // (key, recno) pairs held.
+    virtual std::size_t size() const = 0;
+    // False for hash-style backends: seek() works, scan() only as
+    // scan({}, {}) and then in no particular order.
+    virtual bool ordered() const { return true; }
+    // Push buffered writes to disk; no-op for memory-only backends.
+    virtual void flush() {}
+    // True when the backend keeps its entries in files of its own under the
+    // path given to open() (LsmBackend), not in memory.
+    virtual bool onDisk() const { return false; }
+    // Close and delete every file the backend wrote.
+    virtual void drop() { close(); }
 };
 
+// Backend for a KeyDesc::backend name (kBackendKind_*, case-insensitive):
+// BPTMEM, ART or HASH (memory-only) or LSM (run files, see onDisk()).
+// Returns nullptr for BPTREE, which is IndexManager's own paged tree; throws
+// std::invalid_argument for any other name.
+std::unique_ptr<IIndexBackend> makeBackend(const std::string& kind);
+
 } // namespace xindex
@@ -3,47 +3,171 @@
 #include <vector>
 #include <optional>
 #include <functional>
+#include <memory>
 #include <cstdint>
 #include <fstream>
+#include <algorithm>
+#include "xindex/bloom.hpp"
 #include "xindex/bptree.hpp"
+#include "xindex/index_backend.hpp"
+#include "xindex/static_index.hpp"
+#include "xindex/tree_file.hpp"
+#include "xindex/tree_view.hpp"
 
 namespace xindex {
 
 struct KeyDesc {
-    // For v1 we’ll just use the first CHAR field (already supported by xbase::DbArea::firstCharField()).
-    // This struct leaves room to expand (compound keys, types) later.
+    // Tag name. Empty = the legacy single "<stem>.idx"; otherwise the index
+    // lives in "<stem>.<name>.idx" so several tags can sit next to one DBF.
     std::string name;
+    // Keep a bloom filter over the keys (persisted with the tree) so
+    // lookups of absent keys usually skip the tree; see mayContain().
+    bool bloom{false};
+    // Build a read-optimized StaticIndex snapshot instead of a B+tree, for
+    // tables that are rebuilt and then only read. Writes still work: they
+    // are logged and folded in by re-sealing the snapshot, which costs a
+    // full pass, so they should be rare.
+    bool staticLayout{false};
+    // Structure behind the tag, a kBackendKind_* name (common.hpp). Empty
+    // or BPTREE: the paged B+tree below, persisted in the .idx file. Any
+    // other kind is an IIndexBackend from makeBackend(): built from the
+    // table on open/create and kept in memory only, without covering
+    // payloads or staticLayout.
+    std::string backend;
+    // Refuse duplicate keys: a build (create/rebuild) that finds two
+    // records with one key throws before anything is written or swapped in.
+    bool unique{false};
+    // What the tag is built from, as the owner words it (key, FOR,
+    // INCLUDE). Stored in the file; openReadOnly() refuses a file built
+    // from another definition.
+    std::string definition;
+    // Fingerprint of the table's current state, asked for whenever the file
+    // is written and stored with it. close() saves a file whose stamp has
+    // changed even if its entries did not, so a stored stamp always means
+    // "up to date with the table as it was then"; openReadOnly() refuses a
+    // file whose stamp differs from the table's now. Empty = no stamp.
+    std::function<std::string()> tableStamp;
 };
 
 class IndexManager {
 public:
     IndexManager() = default;
-    ~IndexManager() { close(); }
+    // A failed save cannot be reported from here; owners that need to know
+    // call close() first.
+    ~IndexManager() { try { close(); } catch (...) {} dropBackend_(); }
 
-    // Open or create index file next to DBF. If file absent and allowBuild, rebuild via scanner().
-    // scanner(recno) must return {keyBytes, isDeleted}. It will be called from 1..recCount.
-    void open(const std::string& dbfPath,
-              const KeyDesc& key,
-              bool allowBuild,
-              std::function<std::optional<std::pair<std::vector<uint8_t>, bool>>(int32_t)> scanner);
+    // Build from scanner() and write the file, replacing whatever was there.
+    // scanner(recno) must return {keyBytes, isDeleted}; it is called from 1
+    // until it returns nullopt. payloadOf(recno), if set, is called right
+    // after scanner(recno) for each indexed record and its bytes are stored
+    // in the leaf entry.
+    void create(const std::string& dbfPath,
+                const KeyDesc& key,
+                std::function<std::optional<std::pair<std::vector<uint8_t>, bool>>(int32_t)> scanner,
+                std::function<std::vector<uint8_t>(int32_t)> payloadOf = nullptr);
 
+    // Attach the existing index file for reading only. A BPT4 file is
+    // memory-mapped and searched in place (TreeView), so nothing is parsed
+    // up front; older formats are loaded as usual. Point ops, rebuild and
+    // flush then throw; close() writes nothing. Throws if the file is
+    // missing or unreadable, or for any backend but BPTREE (no file); and
+    // if it was built from another KeyDesc::definition, is stale (its
+    // stamp is not KeyDesc::tableStamp()), or predates both being stored.
+    void openReadOnly(const std::string& dbfPath, const KeyDesc& key);
+    bool readOnly() const { return readOnly_; }
+    // True when reads are served from the mapped file.
+    bool mapped() const { return view_ != nullptr; }
+    // True when the tag is a StaticIndex snapshot (KeyDesc::staticLayout).
+    bool isStatic() const { return static_ != nullptr; }
+    // KeyDesc::backend, upper-cased; "BPTREE" for the built-in tree.
+    const std::string& backendKind() const { return key_.backend; }
+    // True for any backend but BPTREE: there is no .idx file, and the tag
+    // is built whenever it is created.
+    bool memoryOnly() const { return memoryOnly_; }
+    // Manifest of an on-disk backend (USING LSM): <stem>.<TAG>.lsm, or
+    // .lsm.2, ... while an older build still holds that name. Its run files
+    // share the prefix and are deleted with the tag. Empty otherwise.
+    const std::string& backendPath() const { return backendPath_; }
+    // False for unordered backends (HASH): lookups are exact-key only, see
+    // seekGE() and scanFrom().
+    bool ordered() const { return !backend_ || backend_->ordered(); }
+
+    // Save pending writes, or just a changed table stamp. Throws if the
+    // save fails; the tag then stays dirty.
     void close();
 
-    // Point ops from record lifecycle
-    void insert(const std::vector<uint8_t>& key, int32_t recno);
+    // Point ops from record lifecycle. They are appended to a delta log and
+    // reach the tree in sorted batches once kMergeBatch ops have piled up
+    // (or on flush/close), so each touched leaf is visited once per batch.
+    // Readers see tree and log merged.
+    static constexpr size_t kMergeBatch = 16384;
+    void insert(const std::vector<uint8_t>& key, int32_t recno,
+                std::vector<uint8_t> payload = {});
     void erase (const std::vector<uint8_t>& key, int32_t recno);
     void update(const std::vector<uint8_t>& oldKey,
                 const std::vector<uint8_t>& newKey,
                 int32_t recno);
+    // Re-key and/or replace the covering payload of one entry.
+    void update(const std::vector<uint8_t>& oldKey,
+                const std::vector<uint8_t>& newKey,
+                int32_t recno,
+                std::vector<uint8_t> payload);
 
-    // Navigation (basic)
+    // Navigation (basic). Unordered tags answer exact keys only.
     std::optional<int32_t> seekGE(const std::vector<uint8_t>& key) const;
 
-    // Maintenance
+    // Pull cursors, same contract as IIndexBackend::seek/scan, for every
+    // backend. The built-in tree's cursor reads ahead in batches through
+    // the merged tree + log view; any write invalidates it.
+    std::unique_ptr<Cursor> seek(const std::vector<uint8_t>& key) const;
+    std::unique_ptr<Cursor> scan(const std::vector<uint8_t>& low, const std::vector<uint8_t>& high) const;
+
+    // False only if no entry has exactly this key (bloom filter, no tree
+    // access); always true for tags without KeyDesc::bloom.
+    bool mayContain(const std::vector<uint8_t>& key) const {
+        return view_ ? view_->mayContain(key) : bloom_.mayContain(key);
+    }
+    // Exact-key membership, filter first.
+    bool contains(const std::vector<uint8_t>& key) const;
+    // True if an entry has exactly `key` and a recno other than `recno`
+    // (unique-key checks; recno 0 = a record not stored yet).
+    bool containsOther(const std::vector<uint8_t>& key, int32_t recno) const;
+    bool hasBloom() const { return view_ ? view_->hasBloom() : bloom_.enabled(); }
+
+    // Ordered iteration: fn(keyBytes, recno) returns false to stop. On an
+    // unordered tag forEach visits everything in no set order and
+    // scanFrom(lo) only the entries whose key is exactly lo.
+    template <class Fn> void forEach(Fn fn) const { scanFrom({}, fn); }
+    template <class Fn> void scanFrom(const std::vector<uint8_t>& lo, Fn fn) const {
+        scanEntries_(lo, [&](const std::vector<uint8_t>& k, int32_t r, const std::vector<uint8_t>&){ return fn(k, r); });
+    }
+    // fn(keyBytes, recno, payload)
+    template <class Fn> void forEachEntry(Fn fn) const { scanEntries_({}, fn); }
+
+    size_t size() const {
+        if (view_) return view_->size();
+        if (backend_) return backend_->size();
+        resolve_();
+        return (static_ ? static_->size() : tree_.size()) + adds_ - drops_;
+    }
+
+    // Logged point ops not yet in the tree; mergePending() applies them.
+    size_t pending() const { return log_.size(); }
+    void mergePending();
+
+    // Maintenance. Shadow rebuild: the new tree is built on the side and
+    // written to "<idx>.tmp" while the current one keeps answering; the
+    // side file is then read back and checked (entry count, key order),
+    // renamed over the index and the re-read tree swapped in. If anything
+    // fails the current tree and file are left as they were and the
+    // exception propagates.
     void rebuild(std::function<std::optional<std::pair<std::vector<uint8_t>, bool>>(int32_t)> scanner,
-                 int32_t recCount);
+                 int32_t recCount,
+                 std::function<std::vector<uint8_t>(int32_t)> payloadOf = nullptr);
 
-    // Persist now
+    // Persist now (as close()). Only the tree nodes (and bloom pages) changed since the
+    // last flush are written, through TreeFile's journal; a file that is
+    // mostly dirty or fragmented is rewritten whole instead.
     void flush();
 
     // File path used
@@ -54,10 +178,148 @@ private:
     KeyDesc     key_;
     BPlusTree   tree_;
     bool        dirty_{false};
+    BloomFilter bloom_;  // disabled unless key_.bloom
+    TreeFile    file_;
+    bool        readOnly_{false};
+    bool        hasFile_{false};  // idxPath_ holds this tag (built or attached)
+    std::string stamp_;           // table stamp stored in the file
+    std::unique_ptr<TreeView> view_;  // openReadOnly() on a BPT4 file
+    std::unique_ptr<StaticIndex> static_;  // replaces tree_ for staticLayout tags
+    std::unique_ptr<IIndexBackend> backend_;  // replaces all of the above for KeyDesc::backend
+    bool        memoryOnly_{false};           // key_.backend is not BPTREE
+    std::string backendPath_;                 // see backendPath()
+
+    class EntryCursor;
+
+    void checkWritable_() const;
+    std::string freshBackendPath_() const;
+    void dropBackend_() noexcept;
+
+    // IIndexBackend as a scanEntries() source (no payloads); scans from a
+    // key on an unordered backend stay on that key.
+    struct BackendSource {
+        const IIndexBackend& b;
+        size_t size() const { return b.size(); }
+        template <class Fn>
+        void scanEntries(const std::vector<uint8_t>& lo, Fn fn) const {
+            std::unique_ptr<Cursor> c;
+            if (lo.empty())       c = b.scan({}, {});
+            else if (b.ordered()) c = b.scan(lo, {});
+            else                  c = b.seek(lo);
+            const std::vector<uint8_t> none;
+            Key k;
+            RecNo r;
+            for (bool ok = c->first(k, r); ok; ok = c->next(k, r))
+                if (!fn(k, static_cast<int32_t>(r), none)) return;
+        }
+    };
+
+    // Size the filter for twice the tree's keys and fill it (log not included).
+    void rebuildBloom_() {
+        bloom_ = backend_ ? bloomFor_(BackendSource{*backend_}) : static_ ? bloomFor_(*static_) : bloomFor_(tree_);
+    }
+    template <class Src>
+    BloomFilter bloomFor_(const Src& t) const {
+        BloomFilter b;
+        if (!key_.bloom) return b;
+        b.reset(std::max<size_t>(1024, 2 * t.size()));
+        bool first = true;
+        std::vector<uint8_t> prev;
+        t.scanEntries({}, [&](const std::vector<uint8_t>& k, int32_t, const std::vector<uint8_t>&){
+            if (first || k != prev) { b.add(k); prev = k; first = false; }
+            return true;
+        });
+        return b;
+    }
+    // Entry count is `n` and (key, recno) ascending.
+    template <class Src>
+    static bool wellFormed_(const Src& t, size_t n) {
+        size_t seen = 0;
+        bool ordered = true, first = true;
+        std::vector<uint8_t> pk;
+        int32_t pr = 0;
+        t.scanEntries({}, [&](const std::vector<uint8_t>& k, int32_t r, const std::vector<uint8_t>&){
+            if (!first && (k < pk || (k == pk && r < pr))) { ordered = false; return false; }
+            pk = k; pr = r; first = false; ++seen;
+            return true;
+        });
+        return ordered && seen == n && t.size() == n;
+    }
+
+    // Logged op. resolve_() sorts the log by (key, recno), keeping op order
+    // within a pair, and folds each pair to at most [drop][add]: drop = the
+    // tree's entry goes, add = the entry the tree should end up with. An
+    // erase that follows a logged insert simply cancels it.
+    struct Op {
+        std::vector<uint8_t> key;
+        int32_t rec;
+        bool add;
+        std::vector<uint8_t> payload;
+    };
+    mutable std::vector<Op> log_;
+    mutable bool sorted_{true};
+    mutable size_t adds_{0}, drops_{0};
+
+    void log_op_(Op op);
+    void resolve_() const;
+    void clearLog_() { log_.clear(); sorted_ = true; adds_ = drops_ = 0; }
+
+    static bool before_(const Op& o, const std::vector<uint8_t>& k, int32_t r) {
+        return o.key < k || (o.key == k && o.rec < r);
+    }
+
+    template <class Fn>
+    void baseScan_(const std::vector<uint8_t>& lo, Fn fn) const {
+        if (static_) static_->scanEntries(lo, fn); else tree_.scanEntries(lo, fn);
+    }
+
+    // Tree entries from lo, with logged drops skipped and adds slotted in.
+    template <class Fn>
+    void scanEntries_(const std::vector<uint8_t>& lo, Fn fn) const {
+        if (view_) { view_->scanEntries(lo, fn); return; }
+        if (backend_) { BackendSource{*backend_}.scanEntries(lo, fn); return; }
+        if (log_.empty()) { baseScan_(lo, fn); return; }
+        resolve_();
+        auto d = std::lower_bound(log_.begin(), log_.end(), lo,
+                                  [](const Op& o, const std::vector<uint8_t>& k){ return o.key < k; });
+        bool stopped = false;
+        baseScan_(lo, [&](const std::vector<uint8_t>& k, int32_t r, const std::vector<uint8_t>& p){
+            for (; d != log_.end() && before_(*d, k, r); ++d)
+                if (d->add && !fn(d->key, d->rec, d->payload)) { stopped = true; return false; }
+            bool drop = false;
+            const Op* add = nullptr;
+            for (; d != log_.end() && d->rec == r && d->key == k; ++d) {
+                if (d->add) add = &*d; else drop = true;
+            }
+            if (!drop && !fn(k, r, p)) { stopped = true; return false; }
+            if (add && !fn(k, r, add->payload)) { stopped = true; return false; }
+            return true;
+        });
+        for (; !stopped && d != log_.end(); ++d)
+            if (d->add && !fn(d->key, d->rec, d->payload)) return;
+    }
 
     static std::string replaceExt_(const std::string& path, const std::string& newExt);
-    void load_();
     void save_();
+    std::string stampNow_() const { return key_.tableStamp ? key_.tableStamp() : std::string{}; }
+    // Definition and table stamp as stored in a file (TreeFile::setInfo,
+    // or ahead of the bloom filter in a snapshot's extra bytes).
+    std::string info_(const std::string& stamp) const;
+    // Throws unless `info` matches key_.definition and the table now.
+    void checkInfo_(const std::string& info) const;
+    void rebuildStatic_(std::function<std::optional<std::pair<std::vector<uint8_t>, bool>>(int32_t)> scanner,
+                        std::function<std::vector<uint8_t>(int32_t)> payloadOf);
+    // Snapshot + info + bloom filter as an "EYT1" file.
+    static void saveStatic_(const std::string& path, const StaticIndex& s, const BloomFilter& b,
+                            const std::string& info);
+    bool loadStatic_(bool wantBloom, std::string& info);
+    // Memory-only backend of key_.backend, filled from scanner().
+    void rebuildBackend_(std::function<std::optional<std::pair<std::vector<uint8_t>, bool>>(int32_t)> scanner,
+                         bool withPayloads);
+    // Common open/create/openReadOnly prologue.
+    void reset_(const std::string& dbfPath, const KeyDesc& kd, bool readOnly);
+    // Rename a finished side file over the index.
+    void install_(const std::string& side);
 };
 
 } // namespace xindex
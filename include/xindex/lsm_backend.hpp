@@ -0,0 +1,105 @@
+#pragma once
+#include "xindex/key_common.hpp"
+#include "xindex/index_backend.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace xindex {
+
+// Log-structured merge backend for append-heavy tags (O'Neil et al., 1996).
+//
+// upsert/erase only append to an in-memory memtable. Once it holds
+// kMemtableMax ops it is sorted and written out as an immutable run file
+// (<path>.<seq>.run): the entries in (key, recno) order, a sparse index of
+// every kBlockEntries-th entry, and a bloom filter over the run's keys.
+// Runs are never rewritten in place; an erase is a tombstone that shadows
+// older runs. A background thread merges all runs into one when kMaxRuns
+// have piled up, dropping tombstones and shadowed entries on the way.
+// <path> itself is a small manifest naming the live runs.
+//
+// Reads merge the memtable and the runs newest-first. seek() skips every
+// run whose bloom filter rules the key out, so a point lookup usually
+// touches one block of one run.
+class LsmBackend : public IIndexBackend {
+public:
+    static constexpr std::size_t kMemtableMax  = 64 * 1024;
+    static constexpr std::size_t kMaxRuns      = 4;
+    static constexpr std::size_t kStallRuns    = 16;  // flush waits for compaction past this
+    static constexpr std::size_t kBlockEntries = 128;
+
+    LsmBackend() = default;
+    ~LsmBackend() override;
+
+    LsmBackend(const LsmBackend&) = delete;
+    LsmBackend& operator=(const LsmBackend&) = delete;
+
+    bool open(const std::string& path) override;  // path to the manifest
+    void close() override;                        // flushes the memtable
+    bool onDisk() const override { return true; }
+    void drop() override;                         // removes the manifest and every run
+
+    void setFingerprint(std::uint32_t fp) override;
+    bool wasStale() const override { return stale_; }
+
+    void rebuild() override;                      // drops every run and the memtable
+
+    void upsert(const Key& key, RecNo rec) override;
+    void erase (const Key& key, RecNo rec) override;
+
+    std::unique_ptr<Cursor> seek(const Key& key) const override;
+    std::unique_ptr<Cursor> scan(const Key& low, const Key& high) const override;
+
+    // Counts by merging every run: O(entries).
+    std::size_t size() const override;
+
+    // Write the memtable out as a run now.
+    void flush() override;
+    // Merge all runs into one on the calling thread.
+    void compact();
+    std::size_t runCount() const;
+
+    struct Run;   // defined in lsm_backend.cpp
+    struct MemOp {
+        Key   key;
+        RecNo rec;
+        bool  live;  // false = tombstone
+    };
+
+private:
+    using RunList = std::vector<std::shared_ptr<const Run>>;  // oldest first
+
+    // Sorted by (key, recno), last op per pair; kept lazily.
+    mutable std::vector<MemOp> mem_;
+    mutable bool               memSorted_{true};
+    void sortMem_() const;
+
+    RunList                 runs_;
+    mutable std::mutex      mu_;        // runs_, nextSeq_, manifest writes
+    std::condition_variable cv_;
+    std::thread             worker_;
+    bool                    stop_{false};
+
+    std::string   path_;
+    std::uint64_t nextSeq_{1};
+    std::uint32_t fp_{0};
+    std::uint32_t fileFp_{0};
+    bool          stale_{false};
+
+    RunList snapshot_() const;
+    std::string runPath_(std::uint64_t seq) const;
+    void writeManifest_();              // mu_ held
+    void workerLoop_();
+    // Merge `in` (oldest first) into one run; nullptr when nothing is left.
+    std::shared_ptr<const Run> mergeRuns_(const RunList& in);
+    // Swap a merged prefix of runs_ for its result, unless runs_ moved on.
+    void install_(const RunList& merged, std::shared_ptr<const Run> out);
+};
+
+} // namespace xindex
@@ -0,0 +1,163 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace xindex {
+
+// LEB128 unsigned varint.
+inline void putVarint(std::vector<uint8_t>& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+inline uint32_t getVarint(const uint8_t*& p, const uint8_t* end) {
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (p == end) throw std::runtime_error("varint: truncated");
+        const uint8_t b = *p++;
+        v |= static_cast<uint32_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) return v;
+    }
+    throw std::runtime_error("varint: too long");
+}
+
+// A run of record numbers sharing one key: sorted ascending, stored as
+// varint deltas from `first`. `first` is a lower bound for the chunk (the
+// smallest recno when it was created) and is what the tree orders chunks of
+// the same key by, so it is left alone when that recno is erased.
+//
+// Long runs are split into several chunks of at most kMax recnos so an
+// insert or erase only re-encodes a bounded amount.
+struct PostingChunk {
+    static constexpr size_t kMax = 256;
+
+    int32_t first{0};
+    uint32_t count{0};
+    std::vector<uint8_t> deltas;
+    // Covering-index payloads, parallel to the recnos; empty when no entry
+    // in the chunk carries one.
+    std::vector<std::vector<uint8_t>> payloads;
+
+    static PostingChunk single(int32_t rec, std::vector<uint8_t> payload) {
+        PostingChunk c;
+        c.first = rec;
+        c.assign({rec});
+        if (!payload.empty()) c.payloads.push_back(std::move(payload));
+        return c;
+    }
+
+    std::vector<int32_t> decode() const {
+        std::vector<int32_t> out;
+        out.reserve(count);
+        forEach([&](int32_t r, size_t){ out.push_back(r); return true; });
+        return out;
+    }
+
+    // fn(recno, index); return false to stop. Returns false if stopped.
+    template <class Fn>
+    bool forEach(Fn fn) const {
+        const uint8_t* p = deltas.data();
+        const uint8_t* end = p + deltas.size();
+        int32_t r = first;
+        for (uint32_t i = 0; i < count; ++i) {
+            r += static_cast<int32_t>(getVarint(p, end));
+            if (!fn(r, static_cast<size_t>(i))) return false;
+        }
+        return true;
+    }
+
+    const std::vector<uint8_t>& payload(size_t i) const {
+        static const std::vector<uint8_t> none;
+        return payloads.empty() ? none : payloads[i];
+    }
+
+    void assign(const std::vector<int32_t>& recs) {
+        deltas.clear();
+        int32_t prev = first;
+        for (int32_t r : recs) {
+            putVarint(deltas, static_cast<uint32_t>(r - prev));
+            prev = r;
+        }
+        count = static_cast<uint32_t>(recs.size());
+    }
+
+    // rec >= first is required.
+    void insert(int32_t rec, std::vector<uint8_t> payload) {
+        auto recs = decode();
+        const auto at = std::upper_bound(recs.begin(), recs.end(), rec) - recs.begin();
+        recs.insert(recs.begin() + at, rec);
+        if (!payload.empty() && payloads.empty()) payloads.resize(count);
+        if (!payloads.empty()) payloads.insert(payloads.begin() + at, std::move(payload));
+        assign(recs);
+    }
+
+    // Several (recno, payload) pairs, ascending and each >= first, merged
+    // with one decode/re-encode.
+    void insertSorted(std::vector<std::pair<int32_t, std::vector<uint8_t>>>& add) {
+        const auto old = decode();
+        bool withPayloads = !payloads.empty();
+        for (const auto& a : add) withPayloads = withPayloads || !a.second.empty();
+        if (withPayloads && payloads.empty()) payloads.resize(count);
+
+        std::vector<int32_t> recs;
+        std::vector<std::vector<uint8_t>> pay;
+        recs.reserve(old.size() + add.size());
+        if (withPayloads) pay.reserve(old.size() + add.size());
+        size_t i = 0, j = 0;
+        while (i < old.size() || j < add.size()) {
+            if (j == add.size() || (i < old.size() && old[i] <= add[j].first)) {
+                recs.push_back(old[i]);
+                if (withPayloads) pay.push_back(std::move(payloads[i]));
+                ++i;
+            } else {
+                recs.push_back(add[j].first);
+                if (withPayloads) pay.push_back(std::move(add[j].second));
+                ++j;
+            }
+        }
+        payloads = std::move(pay);
+        assign(recs);
+    }
+
+    bool erase(int32_t rec) {
+        auto recs = decode();
+        auto it = std::lower_bound(recs.begin(), recs.end(), rec);
+        if (it == recs.end() || *it != rec) return false;
+        const auto at = it - recs.begin();
+        recs.erase(it);
+        if (!payloads.empty()) payloads.erase(payloads.begin() + at);
+        assign(recs);
+        return true;
+    }
+
+    // Move the upper half into a new chunk. Equal recnos stay together, so
+    // a chunk holding a single repeated recno is not split (count 0 back).
+    PostingChunk splitHalf() {
+        auto recs = decode();
+        size_t mid = recs.size() / 2;
+        while (mid < recs.size() && recs[mid] == recs[mid - 1]) ++mid;
+        if (mid == recs.size())
+            mid = static_cast<size_t>(std::lower_bound(recs.begin(), recs.end(), recs[recs.size() / 2]) - recs.begin());
+        PostingChunk r;
+        if (mid == 0) return r;
+        r.first = recs[mid];
+        r.assign(std::vector<int32_t>(recs.begin() + static_cast<long>(mid), recs.end()));
+        if (!payloads.empty()) {
+            r.payloads.assign(std::make_move_iterator(payloads.begin() + static_cast<long>(mid)),
+                              std::make_move_iterator(payloads.end()));
+            payloads.resize(mid);
+        }
+        recs.resize(mid);
+        assign(recs);
+        return r;
+    }
+};
+
+} // namespace xindex
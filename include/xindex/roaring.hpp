@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace xindex {
+
+// Compressed set of 32-bit record numbers, roaring style (Chambi et al. 2016).
+//
+// The value space is split by the high 16 bits into chunks of 65536. Each
+// non-empty chunk is a container holding the low 16 bits, either as a sorted
+// uint16 array (sparse, <= 4096 values) or as a 1024-word bitset (dense).
+// Set operations work container by container, so intersecting two bitmaps
+// only touches chunks present in both.
+class RoaringBitmap {
+public:
+    RoaringBitmap() = default;
+
+    // All values in [lo, hi).
+    static RoaringBitmap range(std::uint32_t lo, std::uint32_t hi);
+
+    void add(std::uint32_t v);
+    bool remove(std::uint32_t v);
+    bool contains(std::uint32_t v) const;
+
+    std::uint64_t cardinality() const;
+    bool empty() const { return cs_.empty(); }
+    void clear() { cs_.clear(); }
+
+    RoaringBitmap& operator&=(const RoaringBitmap& o); // AND
+    RoaringBitmap& operator|=(const RoaringBitmap& o); // OR
+    RoaringBitmap& operator-=(const RoaringBitmap& o); // AND NOT
+
+    friend RoaringBitmap operator&(RoaringBitmap a, const RoaringBitmap& b) { return a &= b; }
+    friend RoaringBitmap operator|(RoaringBitmap a, const RoaringBitmap& b) { return a |= b; }
+    friend RoaringBitmap operator-(RoaringBitmap a, const RoaringBitmap& b) { return a -= b; }
+
+    bool operator==(const RoaringBitmap& o) const;
+    bool operator!=(const RoaringBitmap& o) const { return !(*this == o); }
+
+    // Visit values in ascending order; fn(value) returns false to stop.
+    template <class Fn>
+    void forEach(Fn fn) const {
+        for (const auto& c : cs_) {
+            const std::uint32_t hi = static_cast<std::uint32_t>(c.key) << 16;
+            if (c.isBitset()) {
+                for (std::uint32_t w = 0; w < kWords; ++w) {
+                    std::uint64_t word = c.bits[w];
+                    while (word) {
+                        const std::uint32_t bit = lowestBit_(word);
+                        if (!fn(hi | (w * 64 + bit))) return;
+                        word &= word - 1;
+                    }
+                }
+            } else {
+                for (std::uint16_t lo : c.array)
+                    if (!fn(hi | lo)) return;
+            }
+        }
+    }
+
+    std::vector<std::uint32_t> toVector() const;
+
+private:
+    static constexpr std::uint32_t kWords = 1024;      // 65536 bits
+    static constexpr std::uint32_t kArrayMax = 4096;   // array <-> bitset threshold
+
+    struct Container {
+        std::uint16_t key{0};
+        std::uint32_t card{0};
+        std::vector<std::uint16_t> array; // sorted, used when bits is empty
+        std::vector<std::uint64_t> bits;  // kWords words when dense
+        bool isBitset() const { return !bits.empty(); }
+    };
+
+    std::vector<Container> cs_; // sorted by key
+
+    Container*       find_(std::uint16_t key);
+    const Container* find_(std::uint16_t key) const;
+
+    static void toBitset_(Container& c);
+    static void toArray_(Container& c);
+    static void normalize_(Container& c); // pick the cheaper representation
+
+    static Container and_(const Container& a, const Container& b);
+    static Container or_ (const Container& a, const Container& b);
+    static Container andNot_(const Container& a, const Container& b);
+
+    static std::uint32_t lowestBit_(std::uint64_t w);
+    static std::uint32_t popcount_(std::uint64_t w);
+};
+
+} // namespace xindex
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace xindex {
+
+// Read-optimized snapshot of a tag for tables that are rebuilt and then only
+// read (KeyDesc::staticLayout). Everything lives in flat arrays, no node
+// pointers:
+//
+//   keys      distinct keys, ascending, packed in one blob + offsets
+//   postings  per key a run of ascending recnos in one array
+//   payloads  optional, one blob + offsets parallel to the recnos
+//   eyt       the keys' next 8 bytes after what all keys have in common,
+//             big-endian, in Eytzinger (BFS)
+//             order, so a search walks k -> 2k / 2k+1 down an implicit tree
+//             whose top levels share a few cache lines; each step is a
+//             compare and a shift, no branch
+//
+// A lookup finds the first prefix >= the key's prefix in `eyt`, and only
+// keys sharing that prefix are compared in full. The structure cannot be
+// updated; IndexManager overlays writes and re-seals a new snapshot.
+class StaticIndex {
+public:
+    // Build: append every entry in (key, recno) order, then seal().
+    void append(const std::vector<uint8_t>& key, int32_t rec, const std::vector<uint8_t>& payload);
+    void seal();
+
+    size_t size() const { return recs_.size(); }
+    size_t keyCount() const { return keyOff_.size() - 1; }
+
+    // Index of the first key >= k, keyCount() if none.
+    size_t lowerBound(const std::vector<uint8_t>& k) const;
+    // Smallest recno of the first key >= k.
+    std::optional<int32_t> seekGE(const std::vector<uint8_t>& k) const;
+    bool contains(const std::vector<uint8_t>& k) const;
+
+    // Same contract as BPlusTree::scanEntries.
+    template <class Fn>
+    void scanEntries(const std::vector<uint8_t>& lo, Fn fn) const {
+        std::vector<uint8_t> kb, pay;
+        for (size_t i = lowerBound(lo); i < keyCount(); ++i) {
+            kb.assign(keyBytes_.begin() + keyOff_[i], keyBytes_.begin() + keyOff_[i + 1]);
+            for (uint32_t p = postStart_[i]; p < postStart_[i + 1]; ++p) {
+                if (!payOff_.empty()) pay.assign(payBytes_.begin() + payOff_[p], payBytes_.begin() + payOff_[p + 1]);
+                if (!fn(kb, recs_[p], pay)) return;
+            }
+        }
+    }
+
+    // "EYT1" file; the caller writes a temp file and renames it. `extra`
+    // is stored alongside for the owner (IndexManager keeps the tag's
+    // definition and bloom filter there). load() returns false if `path`
+    // is not one, throws if it is damaged.
+    void save(const std::string& path, const std::vector<uint8_t>& extra) const;
+    bool load(const std::string& path, std::vector<uint8_t>& extra);
+    static bool isStaticFile(const std::string& path);
+
+private:
+    std::vector<uint8_t>  keyBytes_;
+    std::vector<uint32_t> keyOff_{0};     // keyCount()+1
+    std::vector<uint32_t> postStart_{0};  // keyCount()+1, into recs_
+    std::vector<int32_t>  recs_;
+    std::vector<uint32_t> payOff_;        // size()+1 once any entry has a payload
+    std::vector<uint8_t>  payBytes_;
+
+    size_t lead_{0};              // leading bytes common to every key
+    std::vector<uint64_t> eyt_;   // 1-based BFS order; eyt_[0] unused
+    std::vector<uint32_t> rank_;  // eyt_ slot -> key index
+
+    static uint64_t prefix_(const uint8_t* p, size_t n);
+    uint64_t prefixAt_(size_t i) const {
+        return prefix_(keyBytes_.data() + keyOff_[i] + lead_, keyOff_[i + 1] - keyOff_[i] - lead_);
+    }
+    bool keyLess_(size_t i, const std::vector<uint8_t>& k) const;
+    bool keyEq_(size_t i, const std::vector<uint8_t>& k) const;
+    // Key index of the first prefix >= x.
+    size_t prefixLowerBound_(uint64_t x) const;
+};
+
+} // namespace xindex
@@ -0,0 +1,130 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace xindex {
+
+// Work-stealing thread pool shared by every parallel path of the engine
+// (scans, index builds, sorts, IMPORT / EXPORT), so they never spawn
+// threads of their own. Each worker owns a deque: tasks a worker submits go
+// on its own back and it takes from there (newest first, data still warm);
+// a worker with nothing left steals the oldest task from another's front.
+// Tasks submitted from outside the pool are dealt round robin.
+//
+// threads() counts the caller: parallel work is split threads() ways and
+// the submitting thread does a share while it waits (TaskGroup::wait), so
+// the pool runs threads() - 1 workers and threads() == 1 runs everything
+// inline.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads);
+    ~ThreadPool() { shutdown(); }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // The process-wide pool, sized to the machine's hardware threads.
+    static ThreadPool& shared();
+    static unsigned hardwareThreads();
+
+    unsigned threads() const { return static_cast<unsigned>(workers_.size()) + 1; }
+
+    // Finish queued tasks, then run with `threads` from now on (SET THREADS).
+    void resize(unsigned threads);
+    // Finish queued tasks and join the workers; until resized, tasks run
+    // inline on the submitting thread (QUIT).
+    void shutdown();
+
+    void submit(std::function<void()> task);
+    // Run one queued task on the calling thread; false if there was none.
+    bool runOne();
+
+private:
+    struct Queue {
+        std::mutex mu;
+        std::deque<std::function<void()>> tasks;
+    };
+    std::vector<std::unique_ptr<Queue>> queues_; // one per worker
+    std::vector<std::thread> workers_;
+    std::mutex mu_;                 // pending_, stop_
+    std::condition_variable wake_;
+    size_t pending_{0};             // tasks queued and not yet taken
+    std::atomic<size_t> next_{0};
+    bool stop_{false};
+
+    void start_(unsigned threads);
+    void work_(size_t self);
+    bool take_(size_t self, std::function<void()>& task);
+};
+
+// Tasks run on a pool and waited for together. The first exception a task
+// throws is rethrown by wait().
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool = ThreadPool::shared()) : pool_(pool) {}
+    ~TaskGroup() { wait_(); }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(std::function<void()> task);
+    // Until every task has finished, running queued tasks meanwhile.
+    void wait();
+
+private:
+    ThreadPool& pool_;
+    std::atomic<size_t> left_{0};
+    std::mutex mu_;
+    std::condition_variable done_;
+    std::exception_ptr error_;
+
+    void wait_();
+};
+
+// fn(i) for every i in [0, n), spread over the pool and the caller.
+void parallelFor(size_t n, const std::function<void(size_t)>& fn,
+                 ThreadPool& pool = ThreadPool::shared());
+
+// Below this many elements a sort is not worth splitting.
+constexpr size_t kParallelSortMin = 1 << 14;
+
+// std::sort (std::stable_sort if `stable`) of [first, last) split over the
+// pool: threads() runs are sorted at once, then merged pairwise in rounds.
+template <class It, class Less>
+void parallelSort(It first, It last, Less less, bool stable = false,
+                  ThreadPool& pool = ThreadPool::shared()) {
+    const size_t n = static_cast<size_t>(last - first);
+    const size_t parts = std::min<size_t>(pool.threads(), n / (kParallelSortMin / 2));
+    if (parts < 2) {
+        if (stable) std::stable_sort(first, last, less);
+        else        std::sort(first, last, less);
+        return;
+    }
+    std::vector<size_t> cut(parts + 1);
+    for (size_t i = 0; i <= parts; ++i) cut[i] = n * i / parts;
+    parallelFor(parts, [&](size_t i){
+        if (stable) std::stable_sort(first + cut[i], first + cut[i + 1], less);
+        else        std::sort(first + cut[i], first + cut[i + 1], less);
+    }, pool);
+    while (cut.size() > 2) {
+        const size_t runs = cut.size() - 1;
+        parallelFor(runs / 2, [&](size_t p){
+            std::inplace_merge(first + cut[2 * p], first + cut[2 * p + 1], first + cut[2 * p + 2], less);
+        }, pool);
+        std::vector<size_t> merged;
+        for (size_t i = 0; i < cut.size(); i += 2) merged.push_back(cut[i]);
+        if (runs % 2) merged.push_back(cut.back());
+        cut.swap(merged);
+    }
+}
+
+} // namespace xindex
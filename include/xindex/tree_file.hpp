@@ -0,0 +1,139 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "xindex/bloom.hpp"
+#include "xindex/bptree.hpp"
+
+namespace xindex {
+
+// On-disk home of an IndexManager tree ("BPT4"): a file of kPageSize pages
+// that can be updated in place, so a flush writes the nodes that changed
+// rather than the whole index.
+//
+//   page 0            header (layout, tree root/order/count, bloom shape)
+//   node extents      each node's image in one run of whole pages
+//   directory extent  node id -> (first page, pages, bytes), 12 bytes each
+//   bloom extent      the filter's words, BloomFilter::kWordsPerPage a page
+//   info extent       the owner's bytes (setInfo), rewritten when they change
+//
+// A node that outgrows its extent moves to the end of the file and its old
+// pages are counted as waste; once waste passes half the file, or most of
+// the tree is dirty anyway, the owner writes a fresh file instead
+// (canFlush() says which).
+//
+// Every in-place update goes through a redo journal, "<idx>.jnl": all new
+// page images plus a checksum are written there first, then copied into
+// the index, then the journal is removed. load() replays a complete
+// journal left by a crash and drops an incomplete one, so the index is
+// always either the old or the new state, never a mix.
+//
+// load() also reads the older whole-file formats (BPlusTree::load plus an
+// optional bloom trailer); such files are rewritten as BPT4 on next save.
+class TreeFile {
+public:
+    static constexpr uint32_t kPageSize = 512;
+
+    // Replay/drop a journal, then read `path` into t (and b when wantBloom).
+    // Returns false if b was wanted but the file has no filter.
+    bool load(const std::string& path, BPlusTree& t, BloomFilter& b, bool wantBloom);
+
+    // Write t and b as a fresh BPT4 file at `path` (callers write a temp
+    // file and install() it). Leaves t and b clean.
+    void write(const std::string& path, BPlusTree& t, BloomFilter& b);
+
+    // Rename the file this object describes to `path`, dropping any stale
+    // journal there first.
+    void install(const std::string& path);
+
+    // True if flush() may update the file in place for this tree.
+    bool canFlush(const BPlusTree& t) const;
+
+    // Write dirty nodes, the directory/bloom pages they touch and the
+    // header through the journal. Leaves t and b clean.
+    void flush(BPlusTree& t, BloomFilter& b);
+
+    // Bytes stored for the owner (IndexManager keeps what the tag was built
+    // from there); written by the next write() or flush(). load() reads
+    // them back; empty for files older than the info extent.
+    void setInfo(std::string info) { if (info != info_) { info_ = std::move(info); infoDirty_ = true; } }
+    const std::string& info() const { return info_; }
+
+    const std::string& path() const { return path_; }
+    // Pages written by the last flush() (journal copy not counted).
+    size_t lastFlushPages() const { return lastFlushPages_; }
+
+    // ---- format access (also used by TreeView) ----
+    struct Header {
+        int      order{0}, root{0};
+        uint64_t count{0};
+        uint32_t nodeCount{0};
+        uint32_t dirPage{0}, dirPages{0};
+        uint32_t bloomPage{0}, bloomPages{0};
+        uint32_t endPage{0}, waste{0};
+        uint32_t bloomBits{0};
+        uint64_t bloomCap{0}, bloomAdded{0};
+        uint32_t infoPage{0}, infoPages{0}, infoLen{0};
+    };
+    struct Extent {
+        uint32_t page{0};
+        uint32_t pages{0};
+        uint32_t len{0};
+    };
+    // Parse and check page 0 of a `size`-byte file image: false if it is
+    // not BPT4, throws if it is but the header or layout is damaged.
+    static bool readHeader(const uint8_t* file, size_t size, Header& h);
+    // Directory entry of node `id`, checked against the file size.
+    static Extent readExtent(const uint8_t* file, size_t size, const Header& h, uint32_t id);
+    // The info extent's bytes (see setInfo).
+    static std::string readInfo(const uint8_t* file, const Header& h);
+    static std::string journalPath(const std::string& path) { return path + ".jnl"; }
+
+    static uint32_t le32(const uint8_t* p) {
+        return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+    }
+    static uint64_t le64(const uint8_t* p) { return le32(p) | uint64_t(le32(p + 4)) << 32; }
+
+private:
+    static constexpr uint32_t kDirEntry   = 12;
+    static constexpr uint32_t kDirPerPage = kPageSize / kDirEntry;
+    static_assert(BloomFilter::kWordsPerPage * 8 == kPageSize, "one bloom page per index page");
+
+    using Pages = std::map<uint32_t, std::vector<uint8_t>>;  // page no -> image
+
+    std::string path_;
+    bool paged_{false};   // path_ is BPT4 and the fields below describe it
+    std::vector<Extent> ext_;
+    uint32_t dirPage_{0}, dirPages_{0};
+    uint32_t bloomPage_{0}, bloomPages_{0};
+    uint32_t infoPage_{0}, infoPages_{0};
+    std::string info_;
+    bool infoDirty_{false};  // info_ differs from the file's
+    uint32_t endPage_{1};
+    uint32_t waste_{0};
+    size_t lastFlushPages_{0};
+
+    static uint32_t pagesFor_(size_t bytes) {
+        return static_cast<uint32_t>(std::max<size_t>(1, (bytes + kPageSize - 1) / kPageSize));
+    }
+    uint32_t alloc_(uint32_t pages) { const uint32_t p = endPage_; endPage_ += pages; return p; }
+    void free_(uint32_t pages) { waste_ += pages; }
+
+    std::vector<uint8_t> header_(const BPlusTree& t, const BloomFilter& b) const;
+    std::vector<uint8_t> dirImage_(uint32_t i) const;
+    static std::vector<uint8_t> bloomImage_(const BloomFilter& b, uint32_t i);
+    static void stage_(Pages& out, uint32_t page, const std::vector<uint8_t>& bytes);
+
+    bool loadPaged_(const std::vector<uint8_t>& buf, const Header& h, BPlusTree& t, BloomFilter& b, bool wantBloom);
+    bool loadLegacy_(BPlusTree& t, BloomFilter& b, bool wantBloom);
+
+    // Journal: "JNL1" | u32 page size | u32 n | n x (u32 page, image) | u64 checksum
+    std::string journalPath_() const { return journalPath(path_); }
+    void commit_(const Pages& pages);
+    void recover_();
+    static void apply_(const std::string& path, const Pages& pages);
+};
+
+} // namespace xindex
@@ -0,0 +1,116 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "xindex/bloom.hpp"
+#include "xindex/mapped_file.hpp"
+#include "xindex/posting.hpp"
+#include "xindex/tree_file.hpp"
+
+namespace xindex {
+
+// Read-only BPT4 index (see TreeFile) walked in place from a memory-mapped
+// file. open() reads only the header; a lookup decodes just the nodes on
+// its path, straight from the mapped pages: node ids go through the
+// on-disk directory, keys are compared where they lie, integers are read
+// little-endian. Only the key/payload handed to each callback is copied,
+// so opening is instant and concurrent report processes share one copy of
+// the index in the OS page cache.
+//
+// The file must not be updated in place while mapped (a reader could see a
+// half-applied flush); a whole-file rewrite is renamed into place, which
+// leaves existing mappings on the old file.
+class TreeView {
+public:
+    // False if `path` is not a BPT4 file (older formats have to be loaded
+    // into a BPlusTree); throws if it is damaged or has an unapplied journal.
+    bool open(const std::string& path);
+
+    size_t size() const { return static_cast<size_t>(h_.count); }
+    bool hasBloom() const { return h_.bloomBits != 0; }
+    bool mayContain(const std::vector<uint8_t>& key) const;
+    // The owner's bytes from the info extent (TreeFile::setInfo).
+    std::string info() const { return TreeFile::readInfo(file_.data(), h_); }
+
+    // Same contract as BPlusTree::scanEntries: fn(key, recno, payload) from
+    // the first entry with key >= lo, in (key, recno) order, until false.
+    template <class Fn>
+    void scanEntries(const std::vector<uint8_t>& lo, Fn fn) const {
+        Node n = node_(static_cast<uint32_t>(h_.root));
+        while (!n.leaf) {
+            uint32_t i = 0;
+            bool below = true;
+            for (uint32_t k = 0; k < n.nkeys; ++k) {
+                const uint32_t len = getVarint(n.p, n.end);
+                const uint8_t* kp = take_(n.p, n.end, len);
+                if (below && less_(kp, len, lo)) ++i; else below = false;
+            }
+            for (uint32_t k = 0; k < n.nkeys; ++k) getVarint(n.p, n.end);  // firsts
+            uint32_t child = 0;
+            for (uint32_t k = 0; k <= i; ++k) child = getVarint(n.p, n.end);
+            n = node_(child);
+        }
+
+        std::vector<std::pair<const uint8_t*, uint32_t>> keys;
+        std::vector<uint8_t> kb, pay;
+        bool started = false;
+        for (;;) {
+            keys.clear();
+            for (uint32_t k = 0; k < n.nkeys; ++k) {
+                const uint32_t len = getVarint(n.p, n.end);
+                keys.emplace_back(take_(n.p, n.end, len), len);
+            }
+            for (const auto& [kp, kl] : keys) {
+                int32_t r = static_cast<int32_t>(getVarint(n.p, n.end));
+                const uint32_t count = getVarint(n.p, n.end);
+                const uint32_t dlen = getVarint(n.p, n.end);
+                const uint8_t* d = take_(n.p, n.end, dlen);
+                const uint8_t* dend = d + dlen;
+                if (n.p == n.end) throw std::runtime_error("TreeView: truncated node");
+                const bool hasPay = *n.p++ != 0;
+
+                started = started || !less_(kp, kl, lo);
+                if (!started) {
+                    if (hasPay) for (uint32_t j = 0; j < count; ++j) skip_(n.p, n.end);
+                    continue;
+                }
+                kb.assign(kp, kp + kl);
+                if (!hasPay) pay.clear();
+                for (uint32_t j = 0; j < count; ++j) {
+                    r += static_cast<int32_t>(getVarint(d, dend));
+                    if (hasPay) {
+                        const uint32_t plen = getVarint(n.p, n.end);
+                        const uint8_t* pp = take_(n.p, n.end, plen);
+                        pay.assign(pp, pp + plen);
+                    }
+                    if (!fn(kb, r, pay)) return;
+                }
+            }
+            if (n.next < 0) return;
+            n = node_(static_cast<uint32_t>(n.next));
+        }
+    }
+
+private:
+    MappedFile file_;
+    TreeFile::Header h_;
+
+    struct Node {
+        const uint8_t* p;    // just past the header fields
+        const uint8_t* end;
+        bool leaf;
+        int next;
+        uint32_t nkeys;
+    };
+    Node node_(uint32_t id) const;
+
+    // [p, p+n) < lo, as std::vector<uint8_t> compares.
+    static bool less_(const uint8_t* p, uint32_t n, const std::vector<uint8_t>& lo);
+    static const uint8_t* take_(const uint8_t*& p, const uint8_t* end, uint32_t n);
+    static void skip_(const uint8_t*& p, const uint8_t* end) { const uint32_t n = getVarint(p, end); take_(p, end, n); }
+};
+
+} // namespace xindex
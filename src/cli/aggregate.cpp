@@ -0,0 +1,650 @@
+#include "aggregate.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <queue>
+#include <sstream>
+#include <type_traits>
+
+#include "filter_kernels.hpp"
+#include "textio.hpp"
+#include "cli/settings.hpp"
+#include "xindex/bloom.hpp"
+
+namespace aggregate {
+
+static_assert(std::is_trivially_copyable<Acc>::value, "Acc is spilled as raw bytes");
+
+namespace {
+
+double pow10(int dec) {
+    double p = 1.0;
+    for (int i = 0; i < dec; ++i) p *= 10.0;
+    return p;
+}
+
+Wide magnitude(const Wide& w) {
+    if (!w.negative()) return w;
+    Wide m{~w.lo + 1, ~w.hi};
+    if (m.lo == 0) ++m.hi;
+    return m;
+}
+
+// Up to 6 decimals, trailing zeros dropped (as expressions display).
+std::string num_text(double v) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%.6f", v);
+    std::string s = buf;
+    while (!s.empty() && s.back() == '0') s.pop_back();
+    if (!s.empty() && s.back() == '.') s.pop_back();
+    return s == "-0" ? "0" : s;
+}
+
+std::string fixed_text(double v, int dec) {
+    char buf[512];
+    std::snprintf(buf, sizeof(buf), "%.*f", dec, v);
+    return buf;
+}
+
+bool ident_char(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// Offsets where `text` splits at top level (outside quotes, (), [] and
+// {}): at commas if `words` is empty, else before each of `words`
+// standing alone. The first offset is always 0.
+std::vector<size_t> top_level_cuts(const std::string& text, const std::vector<std::string>& words) {
+    std::vector<size_t> cuts{0};
+    char quote = 0;
+    int depth = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        const char c = text[i];
+        if (quote) { if (c == quote) quote = 0; continue; }
+        if (c == '"' || c == '\'') { quote = c; continue; }
+        if (c == '(' || c == '[' || c == '{') { ++depth; continue; }
+        if (c == ')' || c == ']' || c == '}') { depth = std::max(depth - 1, 0); continue; }
+        if (depth > 0) continue;
+        if (words.empty()) {
+            if (c == ',') cuts.push_back(i);
+            continue;
+        }
+        if (i > 0 && ident_char(text[i - 1])) continue;
+        for (const auto& w : words) {
+            const size_t end = i + w.size();
+            if (end <= text.size() && textio::ieq(text.substr(i, w.size()), w) &&
+                (end == text.size() || !ident_char(text[end]))) {
+                cuts.push_back(i);
+                break;
+            }
+        }
+    }
+    return cuts;
+}
+
+// -------- spilled groups ------------------------------------------------------
+// hash u64, first record i32, key length u32, key bytes, one Acc per item.
+
+struct Spilled {
+    uint64_t hash{0};
+    int32_t first{0};
+    std::string key;
+    std::vector<Acc> accs;
+};
+
+bool write_group(std::FILE* f, const GroupTable& t, size_t g) {
+    const uint64_t h = t.hash(g);
+    const int32_t first = t.first(g);
+    const uint32_t len = static_cast<uint32_t>(t.keySize(g));
+    return std::fwrite(&h, sizeof h, 1, f) == 1 && std::fwrite(&first, sizeof first, 1, f) == 1 &&
+           std::fwrite(&len, sizeof len, 1, f) == 1 &&
+           (len == 0 || std::fwrite(t.keyData(g), len, 1, f) == 1) &&
+           (t.items() == 0 || std::fwrite(t.accs(g), sizeof(Acc), t.items(), f) == t.items());
+}
+
+bool read_group(std::FILE* f, size_t items, Spilled& s) {
+    uint32_t len = 0;
+    if (std::fread(&s.hash, sizeof s.hash, 1, f) != 1 || std::fread(&s.first, sizeof s.first, 1, f) != 1 ||
+        std::fread(&len, sizeof len, 1, f) != 1)
+        return false;
+    s.key.resize(len);
+    s.accs.resize(items);
+    return (len == 0 || std::fread(&s.key[0], len, 1, f) == 1) &&
+           (items == 0 || std::fread(s.accs.data(), sizeof(Acc), items, f) == items);
+}
+
+std::FILE* open_file(const std::string& path, const char* mode) {
+    std::FILE* f = std::fopen(path.c_str(), mode);
+    if (f) std::setvbuf(f, nullptr, _IOFBF, 1 << 20);
+    return f;
+}
+
+} // namespace
+
+bool fixedValue(const char* p, size_t len, int dec, int64_t& out) {
+    const char* e = p + len;
+    while (p < e && *p == ' ') ++p;
+    while (e > p && e[-1] == ' ') --e;
+    bool neg = false;
+    if (p < e && (*p == '-' || *p == '+')) { neg = *p == '-'; ++p; }
+    uint64_t v = 0;
+    int digits = 0;
+    int frac = -1; // decimals read; -1 = no point yet
+    for (; p < e; ++p) {
+        if (*p >= '0' && *p <= '9') {
+            if (frac >= dec) continue;
+            if ((v != 0 || *p != '0') && ++digits > 18) return false;
+            v = v * 10 + static_cast<uint64_t>(*p - '0');
+            if (frac >= 0) ++frac;
+        } else if (*p == '.' && frac < 0) {
+            frac = 0;
+        } else {
+            return false;
+        }
+    }
+    for (int f = std::max(frac, 0); f < dec; ++f) {
+        if (v != 0 && ++digits > 18) return false;
+        v *= 10;
+    }
+    out = neg ? -static_cast<int64_t>(v) : static_cast<int64_t>(v);
+    return true;
+}
+
+// -------- Wide ------------------------------------------------------------------
+
+void Wide::add(int64_t v) {
+    const uint64_t before = lo;
+    lo += static_cast<uint64_t>(v);
+    hi += (v < 0 ? ~uint64_t{0} : 0) + (lo < before ? 1 : 0);
+}
+
+void Wide::add(const Wide& w) {
+    const uint64_t before = lo;
+    lo += w.lo;
+    hi += w.hi + (lo < before ? 1 : 0);
+}
+
+double Wide::toDouble() const {
+    const Wide m = magnitude(*this);
+    const double v = std::ldexp(static_cast<double>(m.hi), 64) + static_cast<double>(m.lo);
+    return negative() ? -v : v;
+}
+
+std::string Wide::text(int dec) const {
+    Wide m = magnitude(*this);
+    std::string digits;
+    do {
+        // Divide the four 32-bit limbs by 10, high to low.
+        uint64_t rem = 0;
+        uint32_t limb[4] = {static_cast<uint32_t>(m.hi >> 32), static_cast<uint32_t>(m.hi),
+                            static_cast<uint32_t>(m.lo >> 32), static_cast<uint32_t>(m.lo)};
+        for (uint32_t& l : limb) {
+            const uint64_t cur = (rem << 32) | l;
+            l = static_cast<uint32_t>(cur / 10);
+            rem = cur % 10;
+        }
+        m.hi = (uint64_t{limb[0]} << 32) | limb[1];
+        m.lo = (uint64_t{limb[2]} << 32) | limb[3];
+        digits.push_back(static_cast<char>('0' + rem));
+    } while (m.lo != 0 || m.hi != 0);
+    while (static_cast<int>(digits.size()) <= dec) digits.push_back('0');
+    std::reverse(digits.begin(), digits.end());
+    if (dec > 0) digits.insert(digits.size() - static_cast<size_t>(dec), ".");
+    return negative() ? "-" + digits : digits;
+}
+
+// -------- items -----------------------------------------------------------------
+
+bool fnNamed(const std::string& name, Fn& fn) {
+    static const struct { const char* name; Fn fn; } kFns[] = {
+        {"SUM", Fn::Sum}, {"AVG", Fn::Avg}, {"MIN", Fn::Min}, {"MAX", Fn::Max},
+        {"CNT", Fn::Cnt}, {"STD", Fn::Std}, {"VAR", Fn::Var},
+    };
+    for (const auto& f : kFns)
+        if (name == f.name) { fn = f.fn; return true; }
+    return false;
+}
+
+bool bindItem(Item& it, const std::string& text, const xbase::DbArea& a, std::string& err) {
+    for (int f = 1; f <= a.fieldCount(); ++f) {
+        const auto& fd = a.fields()[static_cast<size_t>(f - 1)];
+        if ((fd.type == 'N' || fd.type == 'F') && textio::ieq(fd.name, text)) {
+            it.fixed = true;
+            it.off = a.fieldOffset(f);
+            it.len = fd.length;
+            it.dec = fd.decimals;
+            return true;
+        }
+    }
+    auto ast = expr::parse(text, err);
+    if (!ast) return false;
+    it.prog = expr::Program::compile(*ast, a, err);
+    if (!it.prog) return false;
+    if (it.prog->type() != expr::Type::Num) { err = "not numeric: " + text; return false; }
+    return true;
+}
+
+void Acc::add(const Item& it, const char* rec) {
+    ++n;
+    if (it.fn == Fn::Cnt) return;
+    double v;
+    int64_t f;
+    if (it.fixed && fixedValue(rec + it.off, it.len, it.dec, f)) {
+        exact.add(f);
+        flo = std::min(flo, f);
+        fhi = std::max(fhi, f);
+        v = static_cast<double>(f) / pow10(it.dec);
+    } else {
+        if (it.fixed) {
+            const std::string text(rec + it.off, it.len);
+            char* end = nullptr;
+            v = std::strtod(text.c_str(), &end);
+            if (end == text.c_str() || text.find_first_not_of(' ', static_cast<size_t>(end - text.c_str())) != std::string::npos) {
+                --n;
+                ++unreadable;
+                return;
+            }
+            inexact = true;
+        } else {
+            v = it.prog->number(rec);
+        }
+        const double t = sum + v;
+        comp += std::fabs(sum) >= std::fabs(v) ? (sum - t) + v : (v - t) + sum;
+        sum = t;
+        lo = std::min(lo, v);
+        hi = std::max(hi, v);
+    }
+    if (it.fn == Fn::Std || it.fn == Fn::Var) {
+        const double d = v - mean;
+        mean += d / static_cast<double>(n);
+        m2 += d * (v - mean);
+    }
+}
+
+void Acc::merge(const Acc& o) {
+    unreadable += o.unreadable;
+    if (o.n == 0) return;
+    const double all = static_cast<double>(n + o.n);
+    const double d = o.mean - mean;
+    m2 += o.m2 + d * d * static_cast<double>(n) * static_cast<double>(o.n) / all;
+    mean += d * static_cast<double>(o.n) / all;
+    n += o.n;
+    exact.add(o.exact);
+    for (double v : {o.sum, o.comp}) {
+        const double t = sum + v;
+        comp += std::fabs(sum) >= std::fabs(v) ? (sum - t) + v : (v - t) + sum;
+        sum = t;
+    }
+    inexact = inexact || o.inexact;
+    lo = std::min(lo, o.lo);
+    hi = std::max(hi, o.hi);
+    flo = std::min(flo, o.flo);
+    fhi = std::max(fhi, o.fhi);
+}
+
+double total(const Item& it, const Acc& a) {
+    return (it.fixed ? a.exact.toDouble() / pow10(it.dec) : 0.0) + a.sum + a.comp;
+}
+
+std::string result(const Item& it, const Acc& a) {
+    const double sum = total(it, a);
+    switch (it.fn) {
+    case Fn::Cnt:
+        return std::to_string(a.n);
+    case Fn::Sum:
+        if (it.fixed && !a.inexact) return a.exact.text(it.dec);
+        return it.fixed ? fixed_text(sum, it.dec) : num_text(sum);
+    case Fn::Avg: {
+        const double avg = a.n ? sum / static_cast<double>(a.n) : 0.0;
+        return it.fixed ? fixed_text(avg, std::max(it.dec, 2)) : num_text(avg);
+    }
+    case Fn::Min:
+    case Fn::Max: {
+        if (a.n == 0) return it.fixed ? fixed_text(0.0, it.dec) : "0";
+        const bool isMin = it.fn == Fn::Min;
+        const bool haveOther = a.lo <= a.hi;
+        if (it.fixed && a.flo <= a.fhi) {
+            const int64_t f = isMin ? a.flo : a.fhi;
+            const double fv = static_cast<double>(f) / pow10(it.dec);
+            if (!haveOther || (isMin ? fv <= a.lo : fv >= a.hi)) {
+                Wide w;
+                w.add(f);
+                return w.text(it.dec);
+            }
+        }
+        const double v = isMin ? a.lo : a.hi;
+        return it.fixed ? fixed_text(v, it.dec) : num_text(v);
+    }
+    case Fn::Std:
+    case Fn::Var: {
+        const double var = a.n ? a.m2 / static_cast<double>(a.n) : 0.0;
+        return num_text(it.fn == Fn::Std ? std::sqrt(var) : var);
+    }
+    }
+    return "";
+}
+
+// -------- keys ------------------------------------------------------------------
+
+void Key::bytes(const char* rec, std::string& out) const {
+    if (raw) out.assign(rec + off, len);
+    else     out = prog->text(rec);
+}
+
+bool bindKey(Key& k, const std::string& text, const xbase::DbArea& a, std::string& err) {
+    for (int f = 1; f <= a.fieldCount(); ++f) {
+        const auto& fd = a.fields()[static_cast<size_t>(f - 1)];
+        if (textio::ieq(fd.name, text)) {
+            k.raw = true;
+            k.off = a.fieldOffset(f);
+            k.len = fd.length;
+            return true;
+        }
+    }
+    auto ast = expr::parse(text, err);
+    if (!ast) return false;
+    k.prog = expr::Program::compile(*ast, a, err);
+    return static_cast<bool>(k.prog);
+}
+
+uint64_t hashKey(const char* p, size_t n) {
+    return xindex::BloomFilter::hash(reinterpret_cast<const uint8_t*>(p), n);
+}
+
+// -------- GroupTable ------------------------------------------------------------
+
+size_t GroupTable::group(const char* key, size_t len, uint64_t h, int32_t first) {
+    if ((size() + 1) * 2 > slots_.size()) grow_();
+    const size_t mask = slots_.size() - 1;
+    for (size_t s = static_cast<size_t>(h) & mask;; s = (s + 1) & mask) {
+        const uint32_t v = slots_[s];
+        if (v == 0) {
+            const size_t g = size();
+            slots_[s] = static_cast<uint32_t>(g + 1);
+            hash_.push_back(h);
+            keys_.append(key, len);
+            keyAt_.push_back(keys_.size());
+            first_.push_back(first);
+            accs_.resize(accs_.size() + items_);
+            return g;
+        }
+        const size_t g = v - 1;
+        if (hash_[g] == h && keySize(g) == len && std::memcmp(keyData(g), key, len) == 0) return g;
+    }
+}
+
+void GroupTable::grow_() {
+    slots_.assign(std::max<size_t>(16, slots_.size() * 2), 0);
+    const size_t mask = slots_.size() - 1;
+    for (size_t g = 0; g < size(); ++g) {
+        size_t s = static_cast<size_t>(hash_[g]) & mask;
+        while (slots_[s] != 0) s = (s + 1) & mask;
+        slots_[s] = static_cast<uint32_t>(g + 1);
+    }
+}
+
+void GroupTable::merge(const GroupTable& o) {
+    for (size_t g = 0; g < o.size(); ++g) {
+        const size_t mine = group(o.keyData(g), o.keySize(g), o.hash(g), o.first(g));
+        first_[mine] = std::min(first_[mine], o.first(g));
+        Acc* acc = accs(mine);
+        const Acc* theirs = o.accs(g);
+        for (size_t k = 0; k < items_; ++k) acc[k].merge(theirs[k]);
+    }
+}
+
+size_t GroupTable::bytes() const {
+    return slots_.size() * sizeof(uint32_t) + keys_.size() +
+           size() * (sizeof(uint64_t) + sizeof(size_t) + sizeof(int32_t) + items_ * sizeof(Acc));
+}
+
+void GroupTable::clear() {
+    slots_.clear();
+    hash_.clear();
+    keyAt_.assign(1, 0);
+    keys_.clear();
+    first_.clear();
+    accs_.clear();
+}
+
+// -------- HashAgg ---------------------------------------------------------------
+
+HashAgg::HashAgg(size_t items, size_t memBytes, std::string spillStem)
+    : items_(items), mem_(memBytes), stem_(std::move(spillStem)), table_(items), parts_(kParts, nullptr) {}
+
+HashAgg::~HashAgg() {
+    for (std::FILE* f : parts_) if (f) std::fclose(f);
+    for (const auto& p : paths_) std::remove(p.c_str());
+}
+
+std::string HashAgg::newPath_() {
+    paths_.push_back(stem_ + ".grp" + std::to_string(files_++) + ".tmp");
+    return paths_.back();
+}
+
+// Append every group of `t` to out[(hash >> shift) % kParts], opening
+// files as needed (their paths go to `names`).
+bool HashAgg::spill_(GroupTable& t, std::vector<std::FILE*>& out, std::vector<std::string>& names,
+                     unsigned shift) {
+    for (size_t g = 0; g < t.size(); ++g) {
+        const size_t p = static_cast<size_t>(t.hash(g) >> shift) % kParts;
+        if (!out[p]) {
+            names.push_back(newPath_());
+            out[p] = open_file(names.back(), "wb");
+            if (!out[p]) return false;
+        }
+        if (!write_group(out[p], t, g)) return false;
+    }
+    t.clear();
+    return true;
+}
+
+void HashAgg::merge(const GroupTable& part) {
+    table_.merge(part);
+    if (table_.bytes() <= mem_ || !ok_) return;
+    std::vector<std::string> names;
+    ok_ = spill_(table_, parts_, names, 60);
+    ++spills_;
+}
+
+// Regroup one partition file. If it outgrows the budget again it is split
+// by the next four hash bits and each piece is regrouped in turn; otherwise
+// its groups are written to a new run file sorted by key.
+bool HashAgg::finishPart_(const std::string& path, unsigned shift, std::vector<std::string>& runs) {
+    std::FILE* in = open_file(path, "rb");
+    if (!in) return false;
+    GroupTable t(items_);
+    std::vector<std::FILE*> sub(kParts, nullptr);
+    std::vector<std::string> subNames;
+    Spilled s;
+    bool ok = true;
+    while (ok && read_group(in, items_, s)) {
+        const size_t g = t.group(s.key.data(), s.key.size(), s.hash, s.first);
+        t.first(g) = std::min(t.first(g), s.first);
+        for (size_t k = 0; k < items_; ++k) t.accs(g)[k].merge(s.accs[k]);
+        // Below 4 bits there is nothing left to split on: keep going.
+        if (t.bytes() > mem_ && shift >= 4) ok = spill_(t, sub, subNames, shift - 4);
+    }
+    std::fclose(in);
+    std::remove(path.c_str());
+    if (!ok) {
+        for (std::FILE* f : sub) if (f) std::fclose(f);
+        return false;
+    }
+    if (!subNames.empty()) {
+        ok = spill_(t, sub, subNames, shift - 4);
+        for (std::FILE* f : sub) if (f) ok = std::fclose(f) == 0 && ok;
+        for (const auto& n : subNames) ok = ok && finishPart_(n, shift - 4, runs);
+        return ok;
+    }
+
+    std::vector<size_t> order(t.size());
+    for (size_t g = 0; g < order.size(); ++g) order[g] = g;
+    std::sort(order.begin(), order.end(), [&](size_t x, size_t y){ return t.key(x) < t.key(y); });
+    runs.push_back(newPath_());
+    std::FILE* out = open_file(runs.back(), "wb");
+    if (!out) return false;
+    for (size_t g : order) ok = ok && write_group(out, t, g);
+    return std::fclose(out) == 0 && ok;
+}
+
+bool HashAgg::finish(const std::function<void(const std::string&, int32_t, const Acc*)>& fn) {
+    if (!ok_) return false;
+    if (!spilled()) {
+        std::vector<size_t> order(table_.size());
+        for (size_t g = 0; g < order.size(); ++g) order[g] = g;
+        std::sort(order.begin(), order.end(), [&](size_t x, size_t y){ return table_.key(x) < table_.key(y); });
+        for (size_t g : order) fn(table_.key(g), table_.first(g), table_.accs(g));
+        return true;
+    }
+
+    std::vector<std::string> names;
+    for (const auto& p : paths_) names.push_back(p);
+    bool ok = spill_(table_, parts_, names, 60);
+    for (std::FILE*& f : parts_) {
+        if (f) ok = std::fclose(f) == 0 && ok;
+        f = nullptr;
+    }
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    std::vector<std::string> runs;
+    for (const auto& n : names) ok = ok && finishPart_(n, 60, runs);
+    if (!ok) return false;
+
+    // Every key is in exactly one run: merge the runs by key.
+    struct Head { Spilled s; size_t run; };
+    auto later = [](const Head* x, const Head* y){ return x->s.key > y->s.key; };
+    std::vector<Head> heads(runs.size());
+    std::vector<std::FILE*> in(runs.size(), nullptr);
+    std::priority_queue<Head*, std::vector<Head*>, decltype(later)> q(later);
+    for (size_t r = 0; r < runs.size(); ++r) {
+        in[r] = open_file(runs[r], "rb");
+        if (!in[r]) ok = false;
+        else if (read_group(in[r], items_, heads[r].s)) { heads[r].run = r; q.push(&heads[r]); }
+    }
+    while (ok && !q.empty()) {
+        Head* h = q.top();
+        q.pop();
+        fn(h->s.key, h->s.first, h->s.accs.data());
+        if (read_group(in[h->run], items_, h->s)) q.push(h);
+    }
+    for (std::FILE* f : in) if (f) std::fclose(f);
+    return ok;
+}
+
+// -------- scans -----------------------------------------------------------------
+
+void scan(xbase::DbArea& a, const std::vector<Item>& items, const Key* key,
+          const cond::Node* filter, const cond::Node* whileCond, int32_t from, int32_t to,
+          const std::function<void(const GroupTable&)>& merge) {
+    if (from > to) return;
+    const size_t blocks = static_cast<size_t>(to - from) / kernels::kBlock + 1;
+    std::vector<std::unique_ptr<GroupTable>> part(blocks);
+    std::vector<char> cut(blocks, 0);
+    kernels::forEachBlock(a, filter, kernels::Deleted::Skip, from, to,
+        [&](const kernels::BlockView& b){
+            const size_t id = static_cast<size_t>(b.first - from) / kernels::kBlock;
+            auto t = std::make_unique<GroupTable>(items.size());
+            std::string k;
+            size_t one = 0; // the only group when there is no key
+            for (size_t i = 0; i < b.sel->n; ++i) {
+                const char* rec = b.rec(i);
+                if (whileCond && rec[0] != xbase::IS_DELETED && !cond::eval(*whileCond, rec)) {
+                    cut[id] = 1;
+                    break;
+                }
+                if (!b.sel->test(i)) continue;
+                const int32_t rn = b.first + static_cast<int32_t>(i);
+                size_t g = one;
+                if (key) {
+                    key->bytes(rec, k);
+                    g = t->group(k.data(), k.size(), hashKey(k.data(), k.size()), rn);
+                } else if (t->size() == 0) {
+                    g = one = t->group("", 0, 0, rn);
+                }
+                Acc* acc = t->accs(g);
+                for (size_t j = 0; j < items.size(); ++j) acc[j].add(items[j], rec);
+            }
+            part[id] = std::move(t);
+        },
+        [&](int32_t first){
+            const size_t id = static_cast<size_t>(first - from) / kernels::kBlock;
+            merge(*part[id]);
+            part[id].reset();
+            return !cut[id];
+        });
+}
+
+// -------- clauses ---------------------------------------------------------------
+
+bool parseClauses(const std::string& line, const std::vector<std::string>& words,
+                  Clauses& out, std::string& err) {
+    std::vector<std::string> all{"ALL", "REST", "NEXT", "FOR", "WHILE"};
+    all.insert(all.end(), words.begin(), words.end());
+    const auto cuts = top_level_cuts(line, all);
+    out.head = textio::trim(line.substr(0, cuts.size() > 1 ? cuts[1] : line.size()));
+    for (size_t k = 1; k < cuts.size(); ++k) {
+        const size_t end = k + 1 < cuts.size() ? cuts[k + 1] : line.size();
+        std::istringstream clause(line.substr(cuts[k], end - cuts[k]));
+        std::string word, rest;
+        clause >> word;
+        std::getline(clause, rest);
+        rest = textio::trim(rest);
+        word = textio::up(word);
+        if (word == "ALL" || word == "REST") {
+            if (!rest.empty()) { err = "unexpected '" + rest + "' after " + word; return false; }
+            out.scope = word == "ALL" ? Clauses::All : Clauses::Rest;
+        } else if (word == "NEXT") {
+            char* e = nullptr;
+            const long n = std::strtol(rest.c_str(), &e, 10);
+            if (rest.empty() || *e != '\0' || n <= 0) { err = "NEXT needs a record count"; return false; }
+            out.scope = Clauses::Next;
+            out.next = static_cast<int32_t>(std::min<long>(n, std::numeric_limits<int32_t>::max()));
+        } else {
+            if (rest.empty()) { err = word + " needs " + (word == "FOR" || word == "WHILE" ? "a condition" : "a value"); return false; }
+            if (out.clause.count(word)) { err = word + " given twice"; return false; }
+            out.clause[word] = rest;
+        }
+    }
+    return true;
+}
+
+std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> out;
+    const auto cuts = top_level_cuts(list, {});
+    for (size_t k = 0; k < cuts.size(); ++k) {
+        const size_t b = cuts[k] + (k > 0 ? 1 : 0);
+        const size_t e = k + 1 < cuts.size() ? cuts[k + 1] : list.size();
+        out.push_back(textio::trim(list.substr(b, e - b)));
+    }
+    return out;
+}
+
+void scopeRange(const xbase::DbArea& a, const Clauses& c, bool hasWhile, int32_t& from, int32_t& to) {
+    const int32_t count = a.recCount();
+    from = 1;
+    to = count;
+    if (c.scope == Clauses::Rest || c.scope == Clauses::Next || (c.scope == Clauses::Default && hasWhile))
+        from = std::max<int32_t>(a.recno(), 1);
+    if (c.scope == Clauses::Next)
+        to = static_cast<int32_t>(std::min<int64_t>(count, int64_t{from} + c.next - 1));
+}
+
+bool checkTarget(const xbase::XBaseEngine& eng, const std::string& dest, std::string& err) {
+    const int area = eng.areaOf(dest);
+    if (area >= 0) {
+        err = dest + " is open in area " + std::to_string(area);
+        return false;
+    }
+    std::error_code ec;
+    if (cli::Settings::safetyOn() && std::filesystem::exists(dest, ec)) {
+        err = dest + " already exists (SET SAFETY OFF to overwrite it)";
+        return false;
+    }
+    return true;
+}
+
+} // namespace aggregate
@@ -0,0 +1,96 @@
+#include "ci_search.hpp"
+
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define CI_SEARCH_SSE2 1
+#endif
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+
+namespace textio {
+
+namespace {
+
+inline unsigned char up(char c) {
+    const unsigned char u = static_cast<unsigned char>(c);
+    return (u >= 'a' && u <= 'z') ? static_cast<unsigned char>(u - 0x20) : u;
+}
+
+inline bool is_letter(unsigned char u) {
+    return (u >= 'A' && u <= 'Z') || (u >= 'a' && u <= 'z');
+}
+
+#if CI_SEARCH_SSE2
+inline unsigned lowest_bit(uint32_t v) {
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward(&i, v);
+    return static_cast<unsigned>(i);
+#else
+    return static_cast<unsigned>(__builtin_ctz(v));
+#endif
+}
+#endif
+
+} // namespace
+
+CiSearch::CiSearch(const std::string& needle) {
+    up_.reserve(needle.size());
+    for (char c : needle) up_.push_back(static_cast<char>(up(c)));
+    if (up_.empty()) return;
+    const unsigned char f = static_cast<unsigned char>(up_.front());
+    const unsigned char l = static_cast<unsigned char>(up_.back());
+    firstMask_ = is_letter(f) ? 0x20 : 0;
+    lastMask_  = is_letter(l) ? 0x20 : 0;
+    firstWant_ = static_cast<unsigned char>(f | firstMask_);
+    lastWant_  = static_cast<unsigned char>(l | lastMask_);
+}
+
+bool CiSearch::matchAt(const char* p) const {
+    // The end bytes already passed the filter; check everything between.
+    for (size_t k = 1; k + 1 < up_.size(); ++k)
+        if (up(p[k]) != static_cast<unsigned char>(up_[k])) return false;
+    if (up(p[0]) != static_cast<unsigned char>(up_.front())) return false;
+    return up(p[up_.size() - 1]) == static_cast<unsigned char>(up_.back());
+}
+
+size_t CiSearch::find(const char* b, const char* e) const {
+    const size_t n = up_.size();
+    if (n == 0) return 0;
+    const size_t hn = static_cast<size_t>(e - b);
+    if (hn < n) return npos;
+    const size_t last = hn - n; // last start position
+    size_t i = 0;
+
+#if CI_SEARCH_SSE2
+    // 16 start positions at a time; both loads stay inside [b, e).
+    const __m128i fw = _mm_set1_epi8(static_cast<char>(firstWant_));
+    const __m128i fm = _mm_set1_epi8(static_cast<char>(firstMask_));
+    const __m128i lw = _mm_set1_epi8(static_cast<char>(lastWant_));
+    const __m128i lm = _mm_set1_epi8(static_cast<char>(lastMask_));
+    for (; i + 16 <= last + 1; i += 16) {
+        const __m128i hf = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        const __m128i hl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + n - 1));
+        const __m128i hit = _mm_and_si128(_mm_cmpeq_epi8(_mm_or_si128(hf, fm), fw),
+                                          _mm_cmpeq_epi8(_mm_or_si128(hl, lm), lw));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hit));
+        while (mask) {
+            const size_t at = i + lowest_bit(mask);
+            if (matchAt(b + at)) return at;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i <= last; ++i) {
+        if ((static_cast<unsigned char>(b[i]) | firstMask_) != firstWant_) continue;
+        if ((static_cast<unsigned char>(b[i + n - 1]) | lastMask_) != lastWant_) continue;
+        if (matchAt(b + i)) return i;
+    }
+    return npos;
+}
+
+} // namespace textio
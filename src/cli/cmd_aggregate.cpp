@@ -0,0 +1,175 @@
+// src/cli/cmd_aggregate.cpp
+// SUM / AVERAGE / CALCULATE over the live records of a scope, optionally
+// GROUP BY a key (one output row per key).
+#include "xbase.hpp"
+#include "aggregate.hpp"
+#include "cond.hpp"
+#include "textio.hpp"
+#include "cli/settings.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+enum class Verb { Sum, Average, Calculate };
+
+// Heading row, then one row per entry of `rows`: column 0 left-aligned
+// when `keyed`, the rest right-aligned.
+void print_table(const std::vector<std::string>& head, const std::vector<std::vector<std::string>>& rows, bool keyed) {
+    std::vector<size_t> width(head.size());
+    for (size_t c = 0; c < head.size(); ++c) width[c] = head[c].size();
+    for (const auto& r : rows)
+        for (size_t c = 0; c < r.size(); ++c) width[c] = std::max(width[c], r[c].size());
+    auto line = [&](const std::vector<std::string>& r) {
+        std::string out;
+        for (size_t c = 0; c < r.size(); ++c) {
+            if (c > 0) out += "  ";
+            const std::string pad(width[c] - r[c].size(), ' ');
+            out += (keyed && c == 0) ? r[c] + pad : pad + r[c];
+        }
+        while (!out.empty() && out.back() == ' ') out.pop_back();
+        std::cout << out << "\n";
+    };
+    line(head);
+    for (const auto& r : rows) line(r);
+}
+
+// A line per item whose field held values that are no number, e.g. the
+// "****" of an overflowed N field; they are left out of its results.
+void print_unreadable(const std::vector<aggregate::Item>& items, const std::vector<int64_t>& unreadable) {
+    for (size_t k = 0; k < items.size(); ++k)
+        if (unreadable[k] > 0)
+            std::cout << items[k].label << ": " << unreadable[k] << " unreadable value(s) left out\n";
+}
+
+void aggregate_cmd(xbase::DbArea& a, std::istringstream& iss, Verb verb) {
+    using namespace aggregate;
+    const char* name = verb == Verb::Sum ? "SUM" : verb == Verb::Average ? "AVERAGE" : "CALCULATE";
+    if (!a.isOpen()) { std::cout << "No table open.\n"; return; }
+
+    std::string line, err;
+    std::getline(iss, line);
+    Clauses c;
+    if (!parseClauses(line, {"GROUP"}, c, err)) { std::cout << name << ": " << err << "\n"; return; }
+
+    std::vector<Item> items;
+    if (c.head.empty()) {
+        if (verb == Verb::Calculate) {
+            std::cout << "Usage: CALCULATE SUM|AVG|MIN|MAX|CNT|STD|VAR(<expr>), ... [scope] [FOR <cond>] [WHILE <cond>] [GROUP BY <key>]\n";
+            return;
+        }
+        for (const auto& fd : a.fields()) {
+            if (fd.type != 'N' && fd.type != 'F') continue;
+            Item it;
+            it.fn = verb == Verb::Sum ? Fn::Sum : Fn::Avg;
+            it.label = textio::up(fd.name);
+            if (!bindItem(it, fd.name, a, err)) { std::cout << name << ": " << err << "\n"; return; }
+            items.push_back(std::move(it));
+        }
+        if (items.empty()) { std::cout << name << ": no numeric fields.\n"; return; }
+    } else {
+        for (std::string text : splitList(c.head)) {
+            Item it;
+            it.label = textio::up(text);
+            if (verb == Verb::Calculate) {
+                const size_t open = text.find('(');
+                if (open == std::string::npos || text.back() != ')' ||
+                    !fnNamed(textio::up(textio::trim(text.substr(0, open))), it.fn)) {
+                    std::cout << "CALCULATE: expected SUM|AVG|MIN|MAX|CNT|STD|VAR(<expr>), got '" << text << "'\n";
+                    return;
+                }
+                text = textio::trim(text.substr(open + 1, text.size() - open - 2));
+                if (it.fn == Fn::Cnt) {
+                    if (!text.empty()) { std::cout << "CALCULATE: CNT() takes no argument\n"; return; }
+                    items.push_back(std::move(it));
+                    continue;
+                }
+            } else {
+                it.fn = verb == Verb::Sum ? Fn::Sum : Fn::Avg;
+            }
+            if (text.empty()) { std::cout << name << ": empty expression\n"; return; }
+            if (!bindItem(it, text, a, err)) { std::cout << name << ": " << err << "\n"; return; }
+            items.push_back(std::move(it));
+        }
+    }
+
+    std::unique_ptr<cond::Node> forNode, whileNode;
+    for (const char* what : {"FOR", "WHILE"}) {
+        auto it = c.clause.find(what);
+        if (it == c.clause.end()) continue;
+        auto node = cond::parse(it->second, err);
+        if (!node) { std::cout << "Syntax error in " << what << ": " << err << "\n"; return; }
+        if (!cond::bind(*node, a, err)) { std::cout << "Error in " << what << ": " << err << "\n"; return; }
+        (what[0] == 'F' ? forNode : whileNode) = std::move(node);
+    }
+
+    std::unique_ptr<Key> key;
+    if (auto g = c.clause.find("GROUP"); g != c.clause.end()) {
+        std::istringstream by(g->second);
+        std::string word, text;
+        by >> word;
+        std::getline(by, text);
+        text = textio::trim(text);
+        if (!textio::ieq(word, "BY") || text.empty()) { std::cout << name << ": expected GROUP BY <key>\n"; return; }
+        key = std::make_unique<Key>();
+        key->label = textio::up(text);
+        if (!bindKey(*key, text, a, err)) { std::cout << name << ": GROUP BY: " << err << "\n"; return; }
+    }
+
+    int32_t from = 0, to = 0;
+    scopeRange(a, c, static_cast<bool>(whileNode), from, to);
+    const char* done = verb == Verb::Sum ? "summed" : verb == Verb::Average ? "averaged" : "";
+
+    std::vector<std::string> head;
+    if (key) head.push_back(key->label);
+    for (const auto& it : items) head.push_back(it.label);
+
+    if (!key) {
+        GroupTable total(items.size());
+        scan(a, items, nullptr, forNode.get(), whileNode.get(), from, to,
+             [&](const GroupTable& part){ total.merge(part); });
+        const std::vector<Acc> none(items.size());
+        const Acc* acc = total.size() ? total.accs(0) : none.data();
+        if (*done) std::cout << acc[0].n + acc[0].unreadable << " record(s) " << done << "\n";
+        std::vector<std::string> row;
+        std::vector<int64_t> unreadable;
+        for (size_t k = 0; k < items.size(); ++k) {
+            row.push_back(result(items[k], acc[k]));
+            unreadable.push_back(acc[k].unreadable);
+        }
+        print_table(head, {row}, false);
+        print_unreadable(items, unreadable);
+        return;
+    }
+
+    HashAgg agg(items.size(), cli::Settings::sortMemBytes(), a.name());
+    scan(a, items, key.get(), forNode.get(), whileNode.get(), from, to,
+         [&](const GroupTable& part){ agg.merge(part); });
+    int64_t n = 0;
+    std::vector<int64_t> unreadable(items.size());
+    std::vector<std::vector<std::string>> rows;
+    const bool ok = agg.finish([&](const std::string& k, int32_t, const Acc* acc){
+        n += acc[0].n + acc[0].unreadable;
+        std::vector<std::string> row{key->raw ? textio::rtrim(k) : k};
+        for (size_t j = 0; j < items.size(); ++j) {
+            row.push_back(result(items[j], acc[j]));
+            unreadable[j] += acc[j].unreadable;
+        }
+        rows.push_back(std::move(row));
+    });
+    if (!ok) { std::cout << name << ": cannot write temporary files next to " << a.name() << "\n"; return; }
+    if (*done) std::cout << n << " record(s) " << done << " in " << rows.size() << " group(s)\n";
+    print_table(head, rows, true);
+    print_unreadable(items, unreadable);
+}
+
+} // namespace
+
+void cmd_SUM(xbase::DbArea& a, std::istringstream& iss)       { aggregate_cmd(a, iss, Verb::Sum); }
+void cmd_AVERAGE(xbase::DbArea& a, std::istringstream& iss)   { aggregate_cmd(a, iss, Verb::Average); }
+void cmd_CALCULATE(xbase::DbArea& a, std::istringstream& iss) { aggregate_cmd(a, iss, Verb::Calculate); }
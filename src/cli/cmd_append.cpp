@@ -1,20 +1,30 @@
 #include <iostream>
 #include <sstream>
 #include "xbase.hpp"
+#include "cli/settings.hpp"
 
 using namespace xbase;
 
 void cmd_APPEND(DbArea& a, std::istringstream& iss) {
     (void)iss;
     if (!a.isOpen()) { std::cout << "No file open\n"; return; }
-    if (!a.appendBlank()) { std::cout << "Append failed.\n"; return; }
-    std::cout << "Appending record " << a.recno() << ". Enter values or ENTER to keep blank.\n";
+    if (a.readOnly()) { std::cout << "Table is open NOUPDATE.\n"; return; }
+    // Values are gathered first so a UNIQUE tag can refuse the record before
+    // anything is written.
+    std::cout << "Appending record " << (a.recCount() + 1) << ". Enter values or ENTER to keep blank.\n";
+    DbArea::Row row(static_cast<size_t>(a.fieldCount()) + 1);
     for (int i = 1; i <= a.fieldCount(); ++i) {
         const auto& f = a.fields()[static_cast<size_t>(i - 1)];
         std::cout << "  " << f.name << " (" << int(f.length) << "): ";
         std::string v; std::getline(std::cin, v);
-        if (!v.empty()) { if (v.size() > f.length) v.resize(f.length); a.set(i, v); }
+        if (!v.empty()) { if (v.size() > f.length) v.resize(f.length); row[static_cast<size_t>(i)] = v; }
     }
-    if (a.writeCurrent()) std::cout << "Record written.\n";
+    const std::string tag = a.uniqueConflict(row, 0);
+    if (!tag.empty()) {
+        if (cli::Settings::duplicatesSkip()) std::cout << "Duplicate key in index " << tag << "; record skipped.\n";
+        else std::cout << "Uniqueness of index " << tag << " is violated.\n";
+        return;
+    }
+    if (a.appendRecords({row})) std::cout << "Record written.\n";
     else std::cout << "Write failed.\n";
 }
@@ -17,6 +17,7 @@ static void wr_le32(unsigned char* p, uint32_t v){ p[0]=v&0xFF; p[1]=(v>>8)&0xFF
 void cmd_APPEND_BLANK(xbase::DbArea& a, std::istringstream& iss)
 {
     if (!a.isOpen()) { std::cout << "No table open.\n"; return; }
+    if (a.readOnly()) { std::cout << "Table is open NOUPDATE.\n"; return; }
 
     long n = 1;
     if (!(iss >> n)) n = 1;
@@ -1,19 +1,23 @@
 // src/cli/cmd_count.cpp
 #include "xbase.hpp"
-#include "predicates.hpp"
+#include "cond.hpp"
+#include "covering.hpp"
+#include "filter_kernels.hpp"
+#include "planner.hpp"
 #include "textio.hpp"
 
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <algorithm>
+#include <memory>
+#include <vector>
 
 namespace {
 
 struct Opts {
     enum Mode { SkipDeleted, IncludeDeleted, OnlyDeleted } mode{SkipDeleted};
-    bool haveFilter{false};
-    std::string fld, op, val;
+    std::string expr;                 // FOR text, empty = no filter
 };
 
 Opts parse_opts(std::istringstream& iss) {
@@ -33,12 +37,9 @@ Opts parse_opts(std::istringstream& iss) {
     std::string forWord;
     if (iss >> forWord) {
         if (textio::ieq(forWord, "FOR")) {
-            if (iss >> o.fld >> o.op) {
-                std::string rest;
-                std::getline(iss, rest);
-                o.val = textio::trim(rest);
-                o.haveFilter = !o.fld.empty() && !o.op.empty() && !o.val.empty();
-            }
+            std::string rest;
+            std::getline(iss, rest);
+            o.expr = textio::trim(rest);
         } else {
             iss.clear();
             iss.seekg(save);
@@ -57,25 +58,51 @@ void cmd_COUNT(xbase::DbArea& a, std::istringstream& iss) {
 
     Opts opt = parse_opts(iss);
 
+    std::unique_ptr<cond::Node> filter;
+    if (!opt.expr.empty()) {
+        std::string err;
+        filter = cond::parse(opt.expr, err);
+        if (!filter) { std::cout << "Syntax error in FOR: " << err << "\n"; return; }
+        if (!cond::bind(*filter, a, err)) { std::cout << "Error in FOR: " << err << "\n"; return; }
+    }
+
     const int32_t total = a.recCount();
     if (total <= 0) { std::cout << 0 << "\n"; return; }
 
-    if (a.recno() <= 0) a.top();
-
-    int64_t cnt = 0;
-    for (int32_t rn = 1; rn <= total; ++rn) {
-        if (!a.gotoRec(rn)) break;
-        if (!a.readCurrent()) continue;
-
-        const bool del = a.isDeleted();
-        if (opt.mode == Opts::SkipDeleted && del) continue;
-        if (opt.mode == Opts::OnlyDeleted && !del) continue;
-
-        if (opt.haveFilter && !predicates::eval(a, opt.fld, opt.op, opt.val))
-            continue;
-
-        ++cnt;
+    // Live records matching a FOR: let the planner pick bitmaps, a tag or
+    // a scan (EXPLAIN COUNT FOR ... shows the choice).
+    if (filter && opt.mode == Opts::SkipDeleted) {
+        const planner::Plan plan = planner::choose(a, filter.get(), {}, /*countOnly=*/true);
+        switch (plan.path) {
+        case planner::Path::Bitmap:
+            std::cout << plan.bitmap->cardinality() << "\n";
+            return;
+        case planner::Path::Covering: {
+            int64_t cnt = 0;
+            covering::scan(a, *plan.cover, filter.get(), 1,
+                           [&](int32_t, const std::vector<std::string>&){ ++cnt; return true; });
+            std::cout << cnt << "\n";
+            return;
+        }
+        case planner::Path::Tag:
+            if (plan.exact) { std::cout << plan.tag->mgr->size() << "\n"; return; }
+            [[fallthrough]];
+        case planner::Path::Index: {
+            // forEach positions on each match; COUNT leaves the record
+            // pointer where it was, as the scan does.
+            const int32_t saved = a.recno();
+            const int64_t cnt = planner::forEach(a, plan, filter.get(), 1, [](int32_t){ return true; });
+            if (saved > 0) a.gotoRec(saved);
+            std::cout << cnt << "\n";
+            return;
+        }
+        case planner::Path::Scan:
+            break;
+        }
     }
 
-    std::cout << cnt << "\n";
+    const auto mode = opt.mode == Opts::SkipDeleted ? kernels::Deleted::Skip
+                    : opt.mode == Opts::OnlyDeleted ? kernels::Deleted::Only
+                    : kernels::Deleted::Any;
+    std::cout << kernels::count(a, filter.get(), mode) << "\n";
 }
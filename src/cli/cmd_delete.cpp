@@ -3,21 +3,20 @@
 #include <string>
 #include "command_registry.hpp"
 #include "textio.hpp"
-#include "predicates.hpp"
+#include "cond.hpp"
+#include "filter_kernels.hpp"
 #include "xbase.hpp"
 
 using namespace std;
 
-// Helper: parse "FOR <field> <op> <value>"
-static bool parse_for_clause(std::istringstream& iss,
-                             std::string& fld, std::string& op, std::string& val)
+// Helper: "FOR <cond>" -> the condition text (rest of the line)
+static bool parse_for_clause(std::istringstream& iss, std::string& expr)
 {
     std::string kw;
-    if (!(iss >> kw)) return false;
-    if (textio::up(kw) != "FOR") return false;
-    if (!(iss >> fld)) return false;
-    if (!(iss >> op )) return false;
-    if (!(iss >> val)) return false;
+    std::streampos save = iss.tellg();
+    if (!(iss >> kw) || textio::up(kw) != "FOR") { iss.clear(); iss.seekg(save); return false; }
+    std::getline(iss, expr);
+    expr = textio::trim(expr);
     return true;
 }
 
@@ -28,6 +27,7 @@ void cmd_DELETE(xbase::DbArea& area, std::istringstream& iss)
         std::cout << "No table is open. Use USE <file> first.\n";
         return;
     }
+    if (area.readOnly()) { std::cout << "Table is open NOUPDATE.\n"; return; }
 
     // Default behavior: DELETE (no args) => delete CURRENT record only
     std::string tok;
@@ -41,18 +41,19 @@ void cmd_DELETE(xbase::DbArea& area, std::istringstream& iss)
     }
     iss.seekg(savepos); // rewind to reparse per mode
 
-    // Modes: ALL | REST | NEXT n | FOR fld op val
-    std::string fld, op, val;
-    if (parse_for_clause(iss, fld, op, val)) {
+    // Modes: ALL | REST | NEXT n | FOR <cond>
+    std::string expr;
+    if (parse_for_clause(iss, expr)) {
         // FOR mode: scan all records and delete matches
+        std::string err;
+        auto filter = cond::parse(expr, err);
+        if (!filter) { std::cout << "Syntax error in FOR: " << err << "\n"; return; }
+        if (!cond::bind(*filter, area, err)) { std::cout << "Error in FOR: " << err << "\n"; return; }
         int32_t deleted = 0;
-        if (!area.top()) { std::cout << "0 deleted\n"; return; }
-        if (!area.readCurrent()) { std::cout << "0 deleted\n"; return; }
-        do {
-            if (predicates::eval(area, fld, op, val)) {
-                if (area.deleteCurrent()) ++deleted;
-            }
-        } while (area.skip(+1) && area.readCurrent());
+        kernels::forEach(area, filter.get(), kernels::Deleted::Any, 1, area.recCount(), [&](int32_t rn){
+            if (area.gotoRec(rn) && area.deleteCurrent()) ++deleted;
+            return true;
+        });
         std::cout << deleted << " deleted\n";
         return;
     }
@@ -104,7 +105,7 @@ void cmd_DELETE(xbase::DbArea& area, std::istringstream& iss)
     }
 
     // If none matched, treat first token as unexpected and print usage
-    std::cout << "Usage: DELETE [ALL | REST | NEXT <n> | FOR <field> <op> <value>]"
+    std::cout << "Usage: DELETE [ALL | REST | NEXT <n> | FOR <cond>]"
               << "  (no args => delete current record)\n";
 }
 
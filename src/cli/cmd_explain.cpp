@@ -0,0 +1,57 @@
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "xbase.hpp"
+#include "textio.hpp"
+#include "cond.hpp"
+#include "covering.hpp"
+#include "planner.hpp"
+
+// EXPLAIN [COUNT | LIST [FIELDS <f1>, <f2>...]] FOR <cond>
+// Show how COUNT / LIST would find the records matching <cond>: the table
+// statistics, each access path with its estimated cost, and the one chosen
+// (see planner.hpp). Nothing is read beyond the indexes. Without a verb
+// the plan is LIST's, with every field.
+void cmd_EXPLAIN(xbase::DbArea& a, std::istringstream& iss) {
+    if (!a.isOpen()) { std::cout << "No table open.\n"; return; }
+
+    std::string rest;
+    std::getline(iss, rest);
+    std::string head, expr;
+    if (!textio::split_word(rest, "FOR", head, expr) || expr.empty()) {
+        std::cout << "Usage: EXPLAIN [COUNT | LIST [FIELDS <f1>, <f2>...]] FOR <cond>\n";
+        return;
+    }
+
+    std::istringstream hs(head);
+    std::string verb;
+    hs >> verb;
+    const bool countOnly = textio::ieq(verb, "COUNT");
+    if (!verb.empty() && !countOnly && !textio::ieq(verb, "LIST")) {
+        std::cout << "EXPLAIN covers COUNT and LIST.\n";
+        return;
+    }
+    std::vector<int> fields;
+    if (!countOnly) {
+        std::string kw, list;
+        if (hs >> kw) {
+            std::getline(hs, list);
+            std::string bad;
+            if (!textio::ieq(kw, "FIELDS")) { std::cout << "Expected FIELDS, got " << kw << "\n"; return; }
+            if (!covering::parseFieldList(a, list, fields, bad)) { std::cout << "Unknown field: " << bad << "\n"; return; }
+        } else {
+            for (int i = 1; i <= a.fieldCount(); ++i) fields.push_back(i);
+        }
+    }
+
+    std::string err;
+    std::unique_ptr<cond::Node> filter = cond::parse(expr, err);
+    if (!filter) { std::cout << "Syntax error in FOR: " << err << "\n"; return; }
+    if (!cond::bind(*filter, a, err)) { std::cout << "Error in FOR: " << err << "\n"; return; }
+
+    const planner::Plan plan = planner::choose(a, filter.get(), fields, countOnly);
+    std::cout << planner::explain(a, plan);
+}
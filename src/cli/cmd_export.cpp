@@ -1,34 +1,108 @@
+#include <atomic>
 #include <fstream>
+#include <memory>
+#include <optional>
 #include <iostream>
 #include <sstream>
+#include <vector>
 #include "xbase.hpp"
 #include "csv.hpp"
+#include "cond.hpp"
+#include "covering.hpp"
+#include "filter_kernels.hpp"
 #include "textio.hpp"
 
 using namespace xbase;
 
+// EXPORT <csvfile> [FIELDS <f1>, <f2>...] [FOR <cond>]
+// Without FOR every record is written, deleted ones included.
 void cmd_EXPORT(DbArea& a, std::istringstream& iss) {
     if (!a.isOpen()) { std::cout << "No file open\n"; return; }
     std::string csvfile; iss >> csvfile;
-    if (csvfile.empty()) { std::cout << "Usage: EXPORT <csvfile>\n"; return; }
+    if (csvfile.empty()) { std::cout << "Usage: EXPORT <csvfile> [FIELDS <f1>, <f2>...] [FOR <cond>]\n"; return; }
     if (!textio::ends_with_ci(csvfile, ".csv")) csvfile += ".csv";
 
+    std::string rest, head, expr;
+    std::getline(iss, rest);
+    const bool haveFor = textio::split_word(rest, "FOR", head, expr);
+
+    std::vector<int> cols;
+    if (!head.empty()) {
+        std::istringstream hs(head);
+        std::string kw, list, bad;
+        hs >> kw;
+        std::getline(hs, list);
+        if (!textio::ieq(kw, "FIELDS")) { std::cout << "Usage: EXPORT <csvfile> [FIELDS <f1>, <f2>...] [FOR <cond>]\n"; return; }
+        if (!covering::parseFieldList(a, list, cols, bad)) { std::cout << "Unknown field: " << bad << "\n"; return; }
+    }
+    if (cols.empty())
+        for (int i = 1; i <= a.fieldCount(); ++i) cols.push_back(i);
+
+    std::unique_ptr<cond::Node> filter;
+    if (haveFor) {
+        std::string err;
+        filter = cond::parse(expr, err);
+        if (!filter) { std::cout << "Syntax error in FOR: " << err << "\n"; return; }
+        if (!cond::bind(*filter, a, err)) { std::cout << "Error in FOR: " << err << "\n"; return; }
+    }
+
     std::ofstream out(csvfile, std::ios::binary);
     if (!out) { std::cout << "Cannot open " << csvfile << " for write.\n"; return; }
 
-    for (int i = 0; i < a.fieldCount(); ++i) {
+    for (size_t i = 0; i < cols.size(); ++i) {
         if (i) out << ",";
-        out << csv::escape(a.fields()[static_cast<size_t>(i)].name);
+        out << csv::escape(a.fields()[static_cast<size_t>(cols[i] - 1)].name);
     }
     out << "\n";
 
-    for (int r = 1; r <= a.recCount(); ++r) {
-        if (!a.gotoRec(r)) break;
-        for (int i = 1; i <= a.fieldCount(); ++i) {
-            if (i > 1) out << ",";
-            out << csv::escape(a.get(i));
+    auto writeRow = [&](const std::vector<std::string>& values) {
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (i) out << ",";
+            out << csv::escape(values[i]);
         }
         out << "\n";
+    };
+
+    int64_t written = 0;
+    // FOR restricts to live records, which a covering tag can serve alone.
+    std::optional<covering::Plan> plan;
+    if (filter) plan = covering::plan(a, cols, filter.get());
+    if (plan) {
+        covering::scan(a, *plan, filter.get(), 1, [&](int32_t, const std::vector<std::string>& values){
+            writeRow(values);
+            ++written;
+            return true;
+        });
+    } else {
+        // Rows are formatted straight from the raw records, a block per
+        // task on the shared pool, and written in record order.
+        std::vector<std::pair<size_t, size_t>> spans; // offset, width
+        for (int c : cols)
+            spans.emplace_back(a.fieldOffset(c), a.fields()[static_cast<size_t>(c - 1)].length);
+        std::atomic<int64_t> rows{0};
+        kernels::transform(a, filter.get(), filter ? kernels::Deleted::Skip : kernels::Deleted::Any,
+                           1, a.recCount(),
+            [&](const kernels::BlockView& b, std::string& text){
+                int64_t n = 0;
+                for (size_t r = 0; r < b.sel->n; ++r) {
+                    if (!b.sel->test(r)) continue;
+                    for (size_t i = 0; i < spans.size(); ++i) {
+                        const char* f = b.rec(r) + spans[i].first;
+                        size_t len = spans[i].second;
+                        while (len > 0 && f[len - 1] == ' ') --len; // as DbArea::get
+                        if (i) text += ',';
+                        text += csv::escape(std::string(f, len));
+                    }
+                    text += '\n';
+                    ++n;
+                }
+                rows += n;
+            },
+            [&](std::string& text){
+                out.write(text.data(), static_cast<std::streamsize>(text.size()));
+                return static_cast<bool>(out);
+            });
+        written = rows;
     }
-    std::cout << "Exported " << a.recCount() << " records to " << csvfile << "\n";
+    std::cout << "Exported " << written << " records to " << csvfile << "\n";
 }
@@ -6,8 +6,18 @@
 #include "xbase.hpp"
 #include "textio.hpp"
 #include "predicates.hpp"
+#include "ci_search.hpp"
+
+namespace {
+
+// Records read per block while scanning.
+constexpr int32_t kFindBlock = 4096;
+
+} // namespace
 
 // FIND <field> <needle>  (needle may be quoted) — case-insensitive substring
+// The field is searched in place in blocks of raw records; values are
+// right-trimmed as get() returns them, the needle is taken as given.
 void cmd_FIND(xbase::DbArea& area, std::istringstream& iss)
 {
     if (!area.isOpen()) { std::cout << "No table open.\n"; return; }
@@ -31,24 +41,29 @@ void cmd_FIND(xbase::DbArea& area, std::istringstream& iss)
         return;
     }
 
-    auto tolc = [](std::string s){
-        std::transform(s.begin(), s.end(), s.begin(),
-            [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
-        return s;
-    };
-    const std::string needle_lc = tolc(needle);
-
-    if (!area.top()) { std::cout << "Empty table.\n"; return; }
+    const int32_t total = area.recCount();
+    if (total <= 0) { std::cout << "Empty table.\n"; return; }
 
     bool any = false;
-    do {
-        if (!area.readCurrent()) continue;
-        const std::string v_lc = tolc(area.get(fidx));
-        if (!needle_lc.empty() && v_lc.find(needle_lc) != std::string::npos) {
-            any = true;
-            std::cout << area.recno() << ": " << area.get(fidx) << "\n";
+    if (!needle.empty()) {
+        const textio::CiSearch search(needle);
+        const size_t cpr = static_cast<size_t>(area.cpr());
+        const size_t off = area.fieldOffset(fidx);
+        const size_t len = area.fields()[static_cast<size_t>(fidx - 1)].length;
+        std::vector<char> buf(static_cast<size_t>(kFindBlock) * cpr);
+        for (int32_t first = 1; first <= total; first += kFindBlock) {
+            const int32_t got = area.readRecords(first, kFindBlock, buf.data());
+            if (got <= 0) break;
+            for (int32_t i = 0; i < got; ++i) {
+                const char* b = buf.data() + static_cast<size_t>(i) * cpr + off;
+                const char* e = b + len;
+                while (e > b && e[-1] == ' ') --e;
+                if (!search.in(b, e)) continue;
+                any = true;
+                std::cout << (first + i) << ": " << std::string(b, e) << "\n";
+            }
         }
-    } while (area.skip(1));
+    }
 
     if (!any) std::cout << "No matches.\n";
 }
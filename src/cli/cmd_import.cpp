@@ -6,11 +6,18 @@
 #include "csv.hpp"
 #include "textio.hpp"
 #include "predicates.hpp"
+#include "cli/settings.hpp"
+#include "xindex/thread_pool.hpp"
 
 using namespace xbase;
 
+namespace {
+constexpr size_t kImportBatch = 4096;
+}
+
 void cmd_IMPORT(DbArea& a, std::istringstream& iss) {
     if (!a.isOpen()) { std::cout << "No file open\n"; return; }
+    if (a.readOnly()) { std::cout << "Table is open NOUPDATE.\n"; return; }
     std::string csvfile; iss >> csvfile;
     if (csvfile.empty()) { std::cout << "Usage: IMPORT <csvfile>\n"; return; }
     if (!textio::ends_with_ci(csvfile, ".csv")) csvfile += ".csv";
@@ -26,17 +33,69 @@ void cmd_IMPORT(DbArea& a, std::istringstream& iss) {
     for (auto &h : headers)
         col2fld.push_back(predicates::field_index_ci(a, textio::trim(h)));
 
-    int imported = 0;
-    while (std::getline(in, line)) {
-        auto cols = csv::split_line(line);
-        if (cols.empty()) continue;
-        if (!a.appendBlank()) { std::cout << "Append failed.\n"; break; }
-        for (size_t c = 0; c < cols.size() && c < col2fld.size(); ++c) {
-            int fi = col2fld[c];
-            if (fi > 0) a.set(fi, cols[c]);
+    // Rows go in batches: the lines of a batch are split on the shared pool,
+    // UNIQUE tags check the whole batch at once (DbArea::uniqueConflicts),
+    // then the survivors are appended together.
+    const bool skipDups = cli::Settings::duplicatesSkip();
+    int imported = 0, skipped = 0;
+    long lineNo = 1;
+    std::vector<DbArea::Row> batch;
+    std::vector<long> lines;
+    std::vector<std::string> text;
+    std::vector<long> textLines;
+    bool stop = false;
+    auto flush = [&]() {
+        std::vector<std::string> tags;
+        const auto bad = a.uniqueConflicts(batch, &tags);
+        size_t keep = batch.size();
+        if (!bad.empty() && !skipDups) {
+            keep = bad.front();
+            std::cout << "Uniqueness of index " << tags.front() << " is violated at line "
+                      << lines[bad.front()] << "; import stopped.\n";
+            stop = true;
+        }
+        std::vector<DbArea::Row> rows;
+        rows.reserve(keep);
+        for (size_t i = 0, b = 0; i < keep; ++i) {
+            if (b < bad.size() && bad[b] == i) { ++b; ++skipped; continue; }
+            rows.push_back(std::move(batch[i]));
+        }
+        if (!a.appendRecords(rows)) { std::cout << "Append failed.\n"; stop = true; }
+        else imported += static_cast<int>(rows.size());
+        batch.clear();
+        lines.clear();
+    };
+    // Split a batch of lines into rows; blank lines give no row.
+    auto parse = [&]() {
+        std::vector<DbArea::Row> rows(text.size());
+        std::vector<char> keep(text.size(), 0);
+        xindex::parallelFor(text.size(), [&](size_t i){
+            auto cols = csv::split_line(text[i]);
+            if (cols.empty()) return;
+            DbArea::Row row(static_cast<size_t>(a.fieldCount()) + 1);
+            for (size_t c = 0; c < cols.size() && c < col2fld.size(); ++c) {
+                int fi = col2fld[c];
+                if (fi > 0) row[static_cast<size_t>(fi)] = cols[c];
+            }
+            rows[i] = std::move(row);
+            keep[i] = 1;
+        });
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (!keep[i]) continue;
+            batch.push_back(std::move(rows[i]));
+            lines.push_back(textLines[i]);
         }
-        if (!a.writeCurrent()) { std::cout << "Write failed at rec " << a.recno() << "\n"; break; }
-        ++imported;
+        text.clear();
+        textLines.clear();
+        if (!batch.empty()) flush();
+    };
+    while (!stop && std::getline(in, line)) {
+        ++lineNo;
+        text.push_back(std::move(line));
+        textLines.push_back(lineNo);
+        if (text.size() == kImportBatch) parse();
     }
+    if (!stop && !text.empty()) parse();
     std::cout << "Imported " << imported << " records from " << csvfile << "\n";
+    if (skipped) std::cout << "Skipped " << skipped << " record(s) with duplicate keys.\n";
 }
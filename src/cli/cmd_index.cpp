@@ -0,0 +1,147 @@
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "xbase.hpp"
+#include "xbase/key_expr.hpp"
+#include "textio.hpp"
+#include "predicates.hpp"
+#include "cond.hpp"
+#include "covering.hpp"
+
+namespace {
+
+// Past this many distinct values a bitmap per value stops paying off.
+constexpr std::size_t kBitmapCardinalityHint = 256;
+
+void usage() {
+    std::cout << "Usage: INDEX ON <field> BITMAP\n"
+                 "       INDEX ON <key expr> TAG <name> [USING BPTREE|BPTMEM|ART|HASH|LSM] [UNIQUE] [STATIC]\n"
+                 "            [BLOOM] [INCLUDE <f1>, <f2>...] [FOR <cond>]\n";
+}
+
+void build_bitmap(xbase::DbArea& a, int idx) {
+    const int32_t keep = a.recno();
+    const bool ok = a.buildBitmapIndex(idx);
+    if (keep > 0) a.gotoRec(keep);
+    if (!ok) { std::cout << "Index build failed (index support not compiled in?).\n"; return; }
+
+    const auto* bmp = a.bitmapIndex(idx);
+    const auto& name = a.fields()[static_cast<size_t>(idx - 1)].name;
+    std::cout << "Bitmap index on " << name << ": " << bmp->distinct()
+              << " distinct value(s), " << bmp->all().cardinality() << " record(s).\n";
+    if (bmp->distinct() > kBitmapCardinalityHint)
+        std::cout << "Note: " << name << " has high cardinality; a bitmap index may not help.\n";
+}
+
+void build_tag(xbase::DbArea& a, const std::string& keyExpr, const std::string& tag, std::istringstream& iss) {
+    std::string rest;
+    std::getline(iss, rest);
+    std::string head, forExpr;
+    if (textio::split_word(rest, "FOR", head, forExpr) && forExpr.empty()) { usage(); return; }
+
+    // Options in any order: [USING kind] [UNIQUE] [STATIC] [BLOOM], then
+    // [INCLUDE f1, f2, ...]
+    std::istringstream hs(head);
+    std::string kw;
+    xbase::DbArea::TagOptions opts;
+    while (hs >> kw) {
+        if (textio::ieq(kw, "USING")) {
+            if (!(hs >> opts.backend)) { usage(); return; }
+        }
+        else if (textio::ieq(kw, "UNIQUE")) opts.unique = true;
+        else if (textio::ieq(kw, "STATIC")) opts.staticLayout = true;
+        else if (textio::ieq(kw, "BLOOM"))  opts.bloom = true;
+        else break;
+        kw.clear();
+    }
+    std::vector<int> include;
+    if (!kw.empty()) {
+        if (!textio::ieq(kw, "INCLUDE")) { usage(); return; }
+        std::string list;
+        std::getline(hs, list);
+        std::string bad;
+        if (!covering::parseFieldList(a, list, include, bad)) {
+            std::cout << "Unknown field in INCLUDE: " << bad << "\n";
+            return;
+        }
+    }
+
+    xbase::DbArea::RecordFilter filter;
+    if (!forExpr.empty()) {
+        std::string err;
+        std::shared_ptr<cond::Node> node = cond::parse(forExpr, err);
+        if (!node) { std::cout << "Syntax error in FOR: " << err << "\n"; return; }
+        if (!cond::bind(*node, a, err)) { std::cout << "Error in FOR: " << err << "\n"; return; }
+        filter = [node](const xbase::DbArea& area){ return cond::eval(*node, area); };
+    }
+
+    std::string err;
+    if (!a.createIndexTag(tag, keyExpr, include, forExpr, std::move(filter), opts, err)) {
+        std::cout << "Index build failed: " << err << "\n";
+        return;
+    }
+    const auto* t = a.indexTag(tag);
+    std::cout << "Index TAG " << t->name << " on " << t->key->text()
+              << ": " << t->mgr->size() << " key(s)";
+    if (!t->include.empty()) {
+        std::cout << " INCLUDE ";
+        for (size_t i = 0; i < t->include.size(); ++i)
+            std::cout << (i ? ", " : "") << a.fields()[static_cast<size_t>(t->include[i] - 1)].name;
+    }
+    if (!t->forExpr.empty()) std::cout << " FOR " << t->forExpr;
+    if (t->mgr->memoryOnly()) std::cout << " USING " << t->mgr->backendKind();
+    if (t->unique) std::cout << " UNIQUE";
+    if (t->mgr->isStatic()) std::cout << " STATIC";
+    if (t->mgr->hasBloom()) std::cout << " BLOOM";
+    if (t->mgr->memoryOnly() && t->mgr->backendPath().empty()) { std::cout << " (in memory)\n"; return; }
+    std::cout << " -> " << (t->mgr->memoryOnly() ? t->mgr->backendPath() : t->mgr->idxPath());
+    if (t->mgr->readOnly()) std::cout << (t->mgr->mapped() ? " (read-only, mapped)" : " (read-only)");
+    std::cout << "\n";
+}
+
+} // namespace
+
+// INDEX ON <field> BITMAP
+// INDEX ON <key expr> TAG <name> [USING <kind>] [UNIQUE] [STATIC] [BLOOM] [INCLUDE <f1>, <f2>...] [FOR <cond>]
+//   <key expr>: a field, or e.g. UPPER(LAST)+DTOS(HIRED) (see KeyExpr)
+void cmd_INDEX(xbase::DbArea& a, std::istringstream& iss) {
+    if (!a.isOpen()) { std::cout << "No table open.\n"; return; }
+
+    std::string on;
+    if (!(iss >> on) || !textio::ieq(on, "ON")) { usage(); return; }
+    std::string rest, keyExpr, tail;
+    std::getline(iss, rest);
+
+    if (textio::split_word(rest, "TAG", keyExpr, tail)) {
+        std::istringstream ts(tail);
+        std::string tag;
+        if (keyExpr.empty() || !(ts >> tag)) { usage(); return; }
+        build_tag(a, keyExpr, tag, ts);
+        return;
+    }
+
+    std::istringstream ks(rest);
+    std::string fld, kind;
+    ks >> fld >> kind;
+    if (!textio::ieq(kind, "BITMAP")) { usage(); return; }
+    const int idx = predicates::field_index_ci(a, fld);
+    if (idx <= 0) { std::cout << "Unknown field: " << fld << "\n"; return; }
+    build_bitmap(a, idx);
+}
+
+// REINDEX: rebuild every tag of the current table. Each tag is built on the
+// side and swapped in only once complete, so a failed rebuild leaves the
+// previous index in place.
+void cmd_REINDEX(xbase::DbArea& a, std::istringstream&) {
+    if (!a.isOpen()) { std::cout << "No table open.\n"; return; }
+    if (a.indexTags().empty()) { std::cout << "No index tags.\n"; return; }
+
+    std::string err;
+    if (!a.reindex(err)) { std::cout << "Reindex failed: " << err << "\n"; return; }
+    for (const auto& t : a.indexTags())
+        std::cout << "Tag " << t.name << ": " << t.mgr->size() << " key(s)\n";
+    std::cout << "Reindexed " << a.indexTags().size() << " tag(s).\n";
+}
@@ -1,6 +1,9 @@
 // src/cli/cmd_list.cpp
 #include "xbase.hpp"
-#include "predicates.hpp"
+#include "cond.hpp"
+#include "covering.hpp"
+#include "filter_kernels.hpp"
+#include "planner.hpp"
 #include "textio.hpp"
 
 #include <iostream>
@@ -10,6 +13,8 @@
 #include <cctype>
 #include <algorithm>
 #include <sstream>
+#include <memory>
+#include <vector>
 
 namespace {
 
@@ -27,11 +32,12 @@ inline bool is_uint(const std::string& s) {
 struct Options {
     bool all{false};            // LIST ALL (show deleted too)
     int  limit{20};             // default page size
-    bool haveFilter{false};     // LIST [N|ALL] FOR <fld> <op> <value...>
-    std::string fld, op, val;
+    std::vector<int> fields;    // FIELDS f1, f2 (1-based); empty = all columns
+    std::string expr;           // LIST [N|ALL] FOR <cond>; empty = no filter
+    bool ok{true};
 };
 
-Options parse_opts(std::istringstream& iss) {
+Options parse_opts(const xbase::DbArea& a, std::istringstream& iss) {
     Options o{};
     std::string tok;
 
@@ -48,20 +54,22 @@ Options parse_opts(std::istringstream& iss) {
         }
     }
 
-    // Optional: FOR <fld> <op> <value...>
-    save = iss.tellg();
-    std::string forWord;
-    if (iss >> forWord) {
-        if (textio::ieq(forWord, "FOR")) {
-            if (iss >> o.fld >> o.op) {
-                std::string rest;
-                std::getline(iss, rest);
-                o.val = textio::trim(rest);
-                o.haveFilter = !o.fld.empty() && !o.op.empty() && !o.val.empty();
-            }
-        } else {
-            iss.clear();
-            iss.seekg(save);
+    // Optional: FIELDS <f1>, <f2>...  then  FOR <fld> <op> <value...>
+    std::string rest;
+    std::getline(iss, rest);
+    std::string head;
+    textio::split_word(rest, "FOR", head, o.expr);
+    if (!head.empty()) {
+        std::istringstream hs(head);
+        std::string kw, list, bad;
+        hs >> kw;
+        std::getline(hs, list);
+        if (!textio::ieq(kw, "FIELDS")) {
+            std::cout << "Usage: LIST [N|ALL] [FIELDS <f1>, <f2>...] [FOR <cond>]\n";
+            o.ok = false;
+        } else if (!covering::parseFieldList(a, list, o.fields, bad)) {
+            std::cout << "Unknown field: " << bad << "\n";
+            o.ok = false;
         }
     }
     return o;
@@ -85,67 +93,111 @@ inline void print_del_flag(bool isDel) {
     }
 }
 
-void print_header(const xbase::DbArea& a, int recw) {
+void print_header(const xbase::DbArea& a, const std::vector<int>& cols, int recw) {
     const auto& Fs = a.fields();
     // Columns: [status(1)] [space] [recno(recw)] [space] [fields...]
     std::cout << ' ' << ' ' << std::setw(recw) << "" << " ";
-    for (const auto& f : Fs) {
+    for (int c : cols) {
+        const auto& f = Fs[static_cast<size_t>(c - 1)];
         std::cout << std::left << std::setw(static_cast<int>(f.length)) << f.name << " ";
     }
     std::cout << std::right << "\n";
 }
 
-void print_row(const xbase::DbArea& a, int recw) {
+// values[i] belongs to column cols[i]
+void print_values(const xbase::DbArea& a, const std::vector<int>& cols, int recw,
+                  bool isDel, int32_t rn, const std::vector<std::string>& values) {
     const auto& Fs = a.fields();
-    print_del_flag(a.isDeleted());
-    std::cout << " " << std::setw(recw) << a.recno() << " ";
-    for (int i = 1; i <= static_cast<int>(Fs.size()); ++i) {
-        std::string s = a.get(i);
-        int w = static_cast<int>(Fs[static_cast<size_t>(i-1)].length);
+    print_del_flag(isDel);
+    std::cout << " " << std::setw(recw) << rn << " ";
+    for (size_t i = 0; i < cols.size(); ++i) {
+        std::string s = values[i];
+        int w = static_cast<int>(Fs[static_cast<size_t>(cols[i] - 1)].length);
         if (static_cast<int>(s.size()) > w) s.resize(static_cast<size_t>(w));
         std::cout << std::left << std::setw(w) << s << " ";
     }
     std::cout << std::right << "\n";
 }
 
+void print_row(const xbase::DbArea& a, const std::vector<int>& cols, int recw) {
+    std::vector<std::string> values;
+    values.reserve(cols.size());
+    for (int c : cols) values.push_back(a.get(c));
+    print_values(a, cols, recw, a.isDeleted(), a.recno(), values);
+}
+
 } // namespace
 
 // Shell entrypoint
 void cmd_LIST(xbase::DbArea& a, std::istringstream& iss) {
     if (!a.isOpen()) { std::cout << "No table open.\n"; return; }
 
-    Options opt = parse_opts(iss);
+    Options opt = parse_opts(a, iss);
+    if (!opt.ok) return;
+    std::unique_ptr<cond::Node> filter;
+    if (!opt.expr.empty()) {
+        std::string err;
+        filter = cond::parse(opt.expr, err);
+        if (!filter) { std::cout << "Syntax error in FOR: " << err << "\n"; return; }
+        if (!cond::bind(*filter, a, err)) { std::cout << "Error in FOR: " << err << "\n"; return; }
+    }
+
     const int32_t total = a.recCount();
     if (total <= 0) { std::cout << "(empty)\n"; return; }
 
     // If ALL, always start from the top; else from current (or top if unset)
     if (opt.all) a.top(); else if (a.recno() <= 0) a.top();
 
+    std::vector<int> cols = opt.fields;
+    if (cols.empty())
+        for (int i = 1; i <= a.fieldCount(); ++i) cols.push_back(i);
+
     const int recw = recno_width(a);
-    print_header(a, recw);
+    print_header(a, cols, recw);
 
     int printed = 0;
     const int32_t start = opt.all ? 1 : a.recno();
-    for (int32_t rn = start; rn <= total; ++rn) {
-        if (!a.gotoRec(rn)) break;
-        if (!a.readCurrent()) continue;
-
-        // default LIST skips deleted
-        if (!opt.all && a.isDeleted()) continue;
+    auto report = [&]{
+        if (!opt.all) {
+            std::cout << printed << " record(s) listed (limit "
+                      << opt.limit << "). Use LIST ALL to show more.\n";
+        } else {
+            std::cout << printed << " record(s) listed.\n";
+        }
+    };
 
-        if (opt.haveFilter && !predicates::eval(a, opt.fld, opt.op, opt.val))
-            continue;
+    // Live records (not LIST ALL): the planner picks a covering tag (rows
+    // straight from the index), bitmaps, a tag or a scan; EXPLAIN LIST FOR
+    // ... shows the choice.
+    if (!opt.all) {
+        const planner::Plan plan = planner::choose(a, filter.get(), cols, /*countOnly=*/false);
+        if (plan.path == planner::Path::Covering) {
+            covering::scan(a, *plan.cover, filter.get(), start,
+                [&](int32_t rn, const std::vector<std::string>& values){
+                    print_values(a, cols, recw, false, rn, values);
+                    ++printed;
+                    return !(opt.limit > 0 && printed >= opt.limit);
+                });
+            report();
+            return;
+        }
+        planner::forEach(a, plan, filter.get(), start, [&](int32_t){
+            print_row(a, cols, recw);
+            ++printed;
+            return opt.limit <= 0 || printed < opt.limit;
+        });
+        report();
+        return;
+    }
 
-        print_row(a, recw);
+    // LIST ALL: every record from the top, deleted ones included; the FOR
+    // is tested on blocks of raw records and only matches are loaded.
+    kernels::forEach(a, filter.get(), kernels::Deleted::Any, start, total, [&](int32_t rn){
+        if (!a.gotoRec(rn)) return false;
+        print_row(a, cols, recw);
         ++printed;
+        return true;
+    });
 
-        if (!opt.all && opt.limit > 0 && printed >= opt.limit) break;
-    }
-
-    if (!opt.all) {
-        std::cout << printed << " record(s) listed (limit "
-                  << opt.limit << "). Use LIST ALL to show more.\n";
-    } else {
-        std::cout << printed << " record(s) listed.\n";
-    }
+    report();
 }
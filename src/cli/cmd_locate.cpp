@@ -1,33 +1,29 @@
 #include <iostream>
 #include <sstream>
 #include <string>
-#include "command_registry.hpp"
 #include "textio.hpp"
-#include "predicates.hpp"
+#include "cond.hpp"
+#include "filter_kernels.hpp"
 #include "xbase.hpp"
 
 using namespace std;
 
-// Minimal parser for: LOCATE FOR <field> <op> <value>
-// Example:  LOCATE FOR LASTNAME = SMITH
-//           LOCATE FOR AGE > 40
-// Value parsing is token-based (no quoted strings yet); extend as needed.
-static bool parse_for_clause(std::istringstream& iss,
-                             std::string& fld, std::string& op, std::string& val)
+// LOCATE FOR <cond>
+// Example:  LOCATE FOR LAST_NAME = SMITH
+//           LOCATE FOR GPA > 3 .AND. IS_ACTIVE = T
+// Scans forward from the current record and stops on the first match
+// (deleted records included), a block at a time (filter_kernels.hpp).
+static bool parse_for_clause(std::istringstream& iss, std::string& expr)
 {
     std::string kw;
     if (!(iss >> kw)) return false;
     if (textio::up(kw) != "FOR") return false;
-
-    if (!(iss >> fld)) return false;
-    if (!(iss >> op )) return false;
-    if (!(iss >> val)) return false;
-
-    return true;
+    std::getline(iss, expr);
+    expr = textio::trim(expr);
+    return !expr.empty();
 }
 
-namespace {
-
+// External linkage: shell.cpp registers it.
 void cmd_LOCATE(xbase::DbArea& area, std::istringstream& iss)
 {
     if (!area.isOpen()) {
@@ -35,11 +31,15 @@ void cmd_LOCATE(xbase::DbArea& area, std::istringstream& iss)
         return;
     }
 
-    std::string fld, op, val;
-    if (!parse_for_clause(iss, fld, op, val)) {
-        std::cout << "Syntax: LOCATE FOR <field> <op> <value>\n";
+    std::string expr;
+    if (!parse_for_clause(iss, expr)) {
+        std::cout << "Syntax: LOCATE FOR <cond>\n";
         return;
     }
+    std::string err;
+    auto filter = cond::parse(expr, err);
+    if (!filter) { std::cout << "Syntax error in FOR: " << err << "\n"; return; }
+    if (!cond::bind(*filter, area, err)) { std::cout << "Error in FOR: " << err << "\n"; return; }
 
     // Start at current record; if not valid, TOP()
     int32_t start = area.recno();
@@ -53,25 +53,15 @@ void cmd_LOCATE(xbase::DbArea& area, std::istringstream& iss)
     }
 
     // Scan from current to EOF
-    bool found = false;
-    do {
-        if (predicates::eval(area, fld, op, val)) {
-            std::cout << "Found at recno " << area.recno() << "\n";
-            found = true;
-            break;
-        }
-    } while (area.skip(+1) && area.readCurrent());
+    int32_t found = 0;
+    kernels::forEach(area, filter.get(), kernels::Deleted::Any, area.recno(), area.recCount(),
+                     [&](int32_t rn){ found = rn; return false; });
 
-    if (!found) {
+    if (found > 0) {
+        area.gotoRec(found);
+        std::cout << "Found at recno " << found << "\n";
+    } else {
+        if (area.recCount() > 0) area.gotoRec(area.recCount()); // left on the last record
         std::cout << "Not found.\n";
     }
 }
-
-} // namespace
-
-// Register command
-static bool s_registered = [](){
-    static cli::CommandRegistry reg;
-    reg.add("LOCATE", &cmd_LOCATE);
-    return true;
-}();
@@ -58,6 +58,7 @@ void cmd_PACK(xbase::DbArea& area, std::istringstream& iss)
         std::cout << "No table is open. Use USE <file> first.\n";
         return;
     }
+    if (area.readOnly()) { std::cout << "Table is open NOUPDATE.\n"; return; }
 
     // Original file path
     const std::string dbfPath = xbase::dbNameWithExt(area.name());
@@ -7,6 +7,7 @@
 #include "xbase.hpp"
 #include "textio.hpp"
 #include "predicates.hpp"
+#include "cli/settings.hpp"
 
 namespace {
 
@@ -30,6 +31,7 @@ bool recall_record_at(std::fstream& io, const xbase::HeaderRec& hdr, int recno)
 
 void cmd_RECALL(xbase::DbArea& a, std::istringstream& iss) {
     if (!a.isOpen()) { std::cout << "No file open\n"; return; }
+    if (a.readOnly()) { std::cout << "Table is open NOUPDATE.\n"; return; }
 
     std::string token;
     std::string forField, forOp, forVal;
@@ -56,7 +58,8 @@ void cmd_RECALL(xbase::DbArea& a, std::istringstream& iss) {
     std::fstream io(a.name(), std::ios::in | std::ios::out | std::ios::binary);
     if (!io) { std::cout << "Cannot open file for update.\n"; return; }
 
-    int recalled = 0;
+    int recalled = 0, skipped = 0;
+    bool stop = false;
 
     auto try_recall = [&](int r){
         if (!a.gotoRec(r)) return;
@@ -65,7 +68,23 @@ void cmd_RECALL(xbase::DbArea& a, std::istringstream& iss) {
         char flag = 0; io.read(&flag, 1);
         if (!io) return;
         if (flag == xbase::IS_DELETED) {
-            if (recall_record_at(io, hdr, r)) ++recalled;
+            // Deleted records stay out of UNIQUE tags; bringing one back must
+            // not duplicate a live key.
+            xbase::DbArea::Row row(static_cast<size_t>(a.fieldCount()) + 1);
+            for (int i = 1; i <= a.fieldCount(); ++i) row[static_cast<size_t>(i)] = a.get(i);
+            const std::string tag = a.uniqueConflict(row, r);
+            if (!tag.empty()) {
+                if (!cli::Settings::duplicatesSkip()) {
+                    std::cout << "Uniqueness of index " << tag << " is violated.\n";
+                    stop = true;
+                } else ++skipped;
+                return;
+            }
+            if (recall_record_at(io, hdr, r)) {
+                ++recalled;
+                io.flush();
+                a.refreshCurrent(); // re-read + index maintenance
+            }
         }
     };
 
@@ -74,15 +93,21 @@ void cmd_RECALL(xbase::DbArea& a, std::istringstream& iss) {
         if (!r) { std::cout << "No current record.\n"; return; }
         try_recall(r);
     } else {
+        // Compiled once; unknown fields leave them null (never true).
+        const auto forPred = forField.empty() ? nullptr
+                           : predicates::Compiled::compile(a, forField, forOp, forVal);
+        const auto whilePred = whileField.empty() ? nullptr
+                             : predicates::Compiled::compile(a, whileField, whileOp, whileVal);
         int start = all ? 1 : (a.recno() ? a.recno() : 1);
-        for (int r = start; r <= a.recCount(); ++r) {
+        for (int r = start; r <= a.recCount() && !stop; ++r) {
             if (!a.gotoRec(r)) break;
-            if (!whileField.empty() && !predicates::eval(a, whileField, whileOp, whileVal)) break;
-            if (forField.empty() || predicates::eval(a, forField, forOp, forVal))
+            if (!whileField.empty() && !(whilePred && whilePred->test(a))) break;
+            if (forField.empty() || (forPred && forPred->test(a)))
                 try_recall(r);
         }
     }
 
     if (a.recno()) a.gotoRec(a.recno());
     std::cout << "Recalled " << recalled << " record(s).\n";
+    if (skipped) std::cout << "Skipped " << skipped << " record(s) with duplicate keys.\n";
 }
@@ -11,6 +11,7 @@
 #include <vector>
 #include <algorithm>
 #include <cctype>
+#include <cmath>
 #include <cstring>
 #include <iomanip>
 
@@ -135,6 +136,7 @@ namespace {
 void cmd_REPLACE(DbArea& a, std::istringstream& iss)
 {
     if (!a.isOpen()) { std::cout << "No table open.\n"; return; }
+    if (a.readOnly()) { std::cout << "Table is open NOUPDATE.\n"; return; }
     if (a.recno() <= 0 || a.recno() > a.recCount()) { std::cout << "Invalid current record.\n"; return; }
 
     // Parse: REPLACE <field> [WITH] <value...>
@@ -167,6 +169,13 @@ void cmd_REPLACE(DbArea& a, std::istringstream& iss)
         return;
     }
 
+    // A UNIQUE tag refuses the new value if another record already has the key.
+    DbArea::Row row(static_cast<size_t>(a.fieldCount()) + 1);
+    for (int i = 1; i <= a.fieldCount(); ++i) row[static_cast<size_t>(i)] = a.get(i);
+    row[static_cast<size_t>(fi) + 1] = cell;
+    const std::string tag = a.uniqueConflict(row, a.recno());
+    if (!tag.empty()) { std::cout << "Uniqueness of index " << tag << " is violated.\n"; return; }
+
     // open file for in-place write
     std::fstream io(a.name(), std::ios::in | std::ios::out | std::ios::binary);
     if (!io) { std::cout << "Open failed: cannot write file\n"; return; }
@@ -186,7 +195,7 @@ void cmd_REPLACE(DbArea& a, std::istringstream& iss)
     std::cout << "Replaced " << m.name << " at recno " << rec << ".\n";
     /* NEW: refresh the engine's field buffer so DISPLAY shows the new values */
     try {
-        a.gotoRec(rec);  // re-read current record into in-memory buffers
+        a.refreshCurrent();  // re-read current record + keep indexes in step
     } catch (...) {
     // ignore – DISPLAY/DUMP will still show on-disk content
 }
@@ -4,10 +4,38 @@
 #include <algorithm>
 
 #include "xbase.hpp"
+#include "xbase/key_expr.hpp"
 #include "textio.hpp"
 #include "predicates.hpp"
 
+namespace {
+
+// SEEK TAG <name> <value>: first entry, in key order, whose key starts with
+// <value>, upper-cased where the tag upper-cases its keys (KeyExpr::fold);
+// otherwise byte for byte. On an unordered tag <value> is blank-padded to
+// the key width and must match.
+void seek_tag(xbase::DbArea& area, const std::string& name, const std::string& value) {
+    const auto* t = area.indexTag(name);
+    if (!t || !t->mgr) { std::cout << "No such tag: " << name << "\n"; return; }
+    const std::string folded = t->key->fold(value);
+    std::vector<uint8_t> key(folded.begin(), folded.end());
+    // No key order (USING HASH): no prefixes either, only whole keys.
+    if (!t->mgr->ordered() && key.size() < t->key->width()) key.resize(t->key->width(), ' ');
+    // A full-width value is an exact key: let the bloom filter rule it out.
+    if (key.size() == t->key->width() && !t->mgr->mayContain(key)) { std::cout << "Not found.\n"; return; }
+    int32_t hit = 0;
+    t->mgr->scanFrom(key, [&](const std::vector<uint8_t>& k, int32_t r){
+        if (k.size() >= key.size() && std::equal(key.begin(), key.end(), k.begin())) hit = r;
+        return false;
+    });
+    if (hit && area.gotoRec(hit)) std::cout << "Found at " << area.recno() << ".\n";
+    else std::cout << "Not found.\n";
+}
+
+} // namespace
+
 // SEEK <field> <value>  (value may be quoted) — case-insensitive exact match
+// SEEK TAG <name> <value> — key-prefix match on an index tag
 void cmd_SEEK(xbase::DbArea& area, std::istringstream& iss)
 {
     if (!area.isOpen()) { std::cout << "No table open.\n"; return; }
@@ -18,7 +46,11 @@ void cmd_SEEK(xbase::DbArea& area, std::istringstream& iss)
     auto args = textio::tokenize(rest);
 
     if (args.size() < 2) {
-        std::cout << "Usage: SEEK <field> <value>\n";
+        std::cout << "Usage: SEEK <field> <value> | SEEK TAG <name> <value>\n";
+        return;
+    }
+    if (args.size() >= 3 && textio::ieq(args[0], "TAG")) {
+        seek_tag(area, args[1], textio::unquote(args[2]));
         return;
     }
 
@@ -38,6 +70,27 @@ void cmd_SEEK(xbase::DbArea& area, std::istringstream& iss)
     };
     const std::string value_lc = tolc(value);
 
+    // An unfiltered tag on a character field answers without a scan.
+    const auto& fdef = area.fields()[static_cast<size_t>(fidx - 1)];
+    for (const auto& t : area.indexTags()) {
+        if (t.field != fidx || !t.forExpr.empty() || !t.mgr || fdef.type != 'C') continue;
+        if (value.size() > fdef.length) break; // cannot match a stored value
+        const auto key = area.tagKey(t, value);
+        if (!t.mgr->mayContain(key)) { std::cout << "Not found.\n"; return; }
+        int32_t best = 0;
+        t.mgr->scanFrom(key, [&](const std::vector<uint8_t>& k, int32_t r){
+            if (k != key) return false;
+            if (!best || r < best) best = r; // first in natural order, like the scan
+            return true;
+        });
+        if (best && area.gotoRec(best)) {
+            std::cout << "Found at " << area.recno() << ".\n";
+            return;
+        }
+        std::cout << "Not found.\n";
+        return;
+    }
+
     if (!area.top()) { std::cout << "Empty table.\n"; return; }
 
     do {
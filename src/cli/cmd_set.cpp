@@ -1,22 +1,25 @@
 #include <iostream>
 #include <sstream>
 #include <string>
-#include "command_registry.hpp"
+#include "xbase.hpp"
 #include "textio.hpp"
 #include "cli/settings.hpp"
+#include "xindex/thread_pool.hpp"
 
 using namespace std;
 
-namespace {
-
 void cmd_SET(xbase::DbArea& /*area*/, std::istringstream& iss)
 {
     // Syntax supported (subset):
     //   SET DELETED ON|OFF
+    //   SET DUPLICATES ERROR|SKIP
+    //   SET THREADS <n>
+    //   SET SORTMEM <megabytes>
+    //   SET SAFETY ON|OFF
     // Future: SET TALK, SET EXACT, etc.
     std::string token;
     if (!(iss >> token)) {
-        std::cout << "SET what? Try: SET DELETED ON|OFF\n";
+        std::cout << "SET what? Try: SET DELETED ON|OFF, SET DUPLICATES ERROR|SKIP, SET THREADS <n>, SET SORTMEM <mb>, SET SAFETY ON|OFF\n";
         return;
     }
     std::string u = textio::up(token);
@@ -40,14 +43,60 @@ void cmd_SET(xbase::DbArea& /*area*/, std::istringstream& iss)
         return;
     }
 
-    std::cout << "Unknown SET option: " << token << "\n";
-}
+    if (u == "DUPLICATES") {
+        std::string val;
+        iss >> val;
+        std::string uv = textio::up(val);
+        if (uv == "ERROR") {
+            cli::Settings::setDuplicatesSkip(false);
+            std::cout << "Duplicate keys in UNIQUE tags now stop the command (SET DUPLICATES ERROR).\n";
+        } else if (uv == "SKIP") {
+            cli::Settings::setDuplicatesSkip(true);
+            std::cout << "Records with duplicate keys in UNIQUE tags are now skipped (SET DUPLICATES SKIP).\n";
+        } else {
+            std::cout << "SET DUPLICATES expects ERROR or SKIP\n";
+        }
+        return;
+    }
 
-} // namespace
+    if (u == "THREADS") {
+        // 0 = one per hardware thread (the default).
+        long n = -1;
+        if (!(iss >> n) || n < 0 || n > 256) {
+            std::cout << "SET THREADS expects 0..256 (0 = " << xindex::ThreadPool::hardwareThreads() << ", one per hardware thread)\n";
+            return;
+        }
+        xindex::ThreadPool::shared().resize(n == 0 ? xindex::ThreadPool::hardwareThreads() : static_cast<unsigned>(n));
+        std::cout << "Parallel work now uses " << xindex::ThreadPool::shared().threads() << " thread(s).\n";
+        return;
+    }
 
-// Register with the CLI on TU load
-static bool s_registered = [](){
-    static cli::CommandRegistry reg;
-    reg.add("SET", &cmd_SET);
-    return true;
-}();
+    if (u == "SORTMEM") {
+        long mb = 0;
+        if (!(iss >> mb) || mb < 1 || mb > 65536) {
+            std::cout << "SET SORTMEM expects 1..65536 (megabytes; now " << cli::Settings::sortMemMB() << ")\n";
+            return;
+        }
+        cli::Settings::setSortMemMB(static_cast<unsigned>(mb));
+        std::cout << "SORT / TOTAL / GROUP BY now spill to disk beyond " << mb << " MB.\n";
+        return;
+    }
+
+    if (u == "SAFETY") {
+        std::string val;
+        iss >> val;
+        std::string uv = textio::up(val);
+        if (uv == "ON") {
+            cli::Settings::setSafety(true);
+            std::cout << "TOTAL / SORT now refuse to overwrite an existing table (SET SAFETY ON).\n";
+        } else if (uv == "OFF") {
+            cli::Settings::setSafety(false);
+            std::cout << "TOTAL / SORT now overwrite an existing table (SET SAFETY OFF).\n";
+        } else {
+            std::cout << "SET SAFETY expects ON or OFF\n";
+        }
+        return;
+    }
+
+    std::cout << "Unknown SET option: " << token << "\n";
+}
@@ -0,0 +1,356 @@
+// src/cli/cmd_sort.cpp
+// SORT TO <table> ON <field> [/A|/D][/C], ... [scope] [FOR <cond>] [WHILE <cond>]
+//
+// Writes the live records in scope to a new table in key order. Each
+// record's fields are encoded into one fixed-width binary key that sorts
+// bytewise (numbers as sign-flipped big-endian integers, /C upper-cased,
+// /D inverted), extracted a block at a time on the pool. (key, recno) pairs
+// are sorted with xindex::parallelSort; when they outgrow SET SORTMEM each
+// sorted chunk is written out as a run and the runs are merged. Ties keep
+// record order. The records are then copied in that order from a mapping
+// of the table.
+#include "xbase.hpp"
+#include "xbase/dbf_writer.hpp"
+#include "aggregate.hpp"
+#include "cond.hpp"
+#include "filter_kernels.hpp"
+#include "textio.hpp"
+#include "cli/settings.hpp"
+#include "xindex/thread_pool.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Runs merged at once; more are merged in passes.
+constexpr size_t kFanIn = 64;
+
+struct SortField {
+    size_t off{0}, len{0};
+    char type{'C'};
+    int dec{0};
+    bool desc{false}, fold{false};
+    size_t width() const { return (type == 'N' || type == 'F') ? 8 : len; }
+};
+
+// The sort key of `rec` into out[0 .. sum of widths).
+void encode(const std::vector<SortField>& fields, const char* rec, uint8_t* out) {
+    for (const auto& f : fields) {
+        const char* p = rec + f.off;
+        if (f.type == 'N' || f.type == 'F') {
+            int64_t v = 0;
+            if (!aggregate::fixedValue(p, f.len, f.dec, v)) {
+                const std::string text(p, f.len);
+                const double d = std::strtod(text.c_str(), nullptr) * std::pow(10.0, f.dec);
+                v = d >= 9.2e18 ? INT64_MAX : d <= -9.2e18 ? INT64_MIN : std::llround(d);
+            }
+            const uint64_t u = static_cast<uint64_t>(v) ^ (uint64_t{1} << 63);
+            for (int i = 0; i < 8; ++i) out[i] = static_cast<uint8_t>(u >> (56 - 8 * i));
+        } else if (f.fold) {
+            for (size_t i = 0; i < f.len; ++i)
+                out[i] = static_cast<uint8_t>(std::toupper(static_cast<unsigned char>(p[i])));
+        } else {
+            std::memcpy(out, p, f.len);
+        }
+        const size_t w = f.width();
+        if (f.desc)
+            for (size_t i = 0; i < w; ++i) out[i] = static_cast<uint8_t>(~out[i]);
+        out += w;
+    }
+}
+
+// One record to sort: its key's first 8 bytes (big-endian, so integer
+// order is key order) and where the rest lives.
+struct Entry {
+    uint64_t prefix;
+    uint32_t idx;   // key number in the chunk's key arena
+    int32_t recno;
+};
+
+uint64_t prefix_of(const uint8_t* key, size_t width) {
+    uint64_t p = 0;
+    for (size_t i = 0; i < 8; ++i) p = (p << 8) | (i < width ? key[i] : 0);
+    return p;
+}
+
+// Keys and entries gathered so far, sorted and flushed as one run.
+struct Chunk {
+    size_t width{0};
+    std::vector<uint8_t> keys; // width bytes per key
+    std::vector<Entry> entries;
+
+    size_t bytes() const { return keys.size() + entries.size() * sizeof(Entry); }
+    const uint8_t* key(const Entry& e) const { return keys.data() + static_cast<size_t>(e.idx) * width; }
+
+    void sort() {
+        xindex::parallelSort(entries.begin(), entries.end(), [&](const Entry& x, const Entry& y){
+            if (x.prefix != y.prefix) return x.prefix < y.prefix;
+            if (width > 8) {
+                const int c = std::memcmp(key(x) + 8, key(y) + 8, width - 8);
+                if (c != 0) return c < 0;
+            }
+            return x.recno < y.recno;
+        });
+    }
+    void clear() {
+        keys.clear();
+        entries.clear();
+    }
+};
+
+std::FILE* open_file(const std::string& path, const char* mode) {
+    std::FILE* f = std::fopen(path.c_str(), mode);
+    if (f) std::setvbuf(f, nullptr, _IOFBF, 1 << 20);
+    return f;
+}
+
+// Runs are files of (key, recno) in order; removed with the object.
+class Runs {
+public:
+    Runs(std::string stem, size_t width) : stem_(std::move(stem)), width_(width) {}
+    ~Runs() { for (const auto& p : made_) std::remove(p.c_str()); }
+
+    bool empty() const { return runs_.empty(); }
+    size_t count() const { return made_.size(); }
+
+    // Write the sorted chunk as a run.
+    bool add(const Chunk& c) {
+        const std::string path = newPath_();
+        std::FILE* f = open_file(path, "wb");
+        if (!f) return false;
+        bool ok = true;
+        for (const auto& e : c.entries)
+            ok = ok && std::fwrite(c.key(e), 1, width_, f) == width_ &&
+                 std::fwrite(&e.recno, sizeof e.recno, 1, f) == 1;
+        ok = std::fclose(f) == 0 && ok;
+        runs_.push_back(path);
+        return ok;
+    }
+
+    // fn(recno) over every run's entries in key order, merging kFanIn runs
+    // into a new one at a time until that many are left.
+    bool merge(const std::function<bool(int32_t)>& fn) {
+        while (runs_.size() > kFanIn) {
+            std::vector<std::string> group(runs_.begin(), runs_.begin() + kFanIn);
+            runs_.erase(runs_.begin(), runs_.begin() + kFanIn);
+            const std::string path = newPath_();
+            std::FILE* out = open_file(path, "wb");
+            if (!out) return false;
+            bool ok = mergeSome_(group, [&](const uint8_t* key, int32_t rn){
+                return std::fwrite(key, 1, width_, out) == width_ && std::fwrite(&rn, sizeof rn, 1, out) == 1;
+            });
+            ok = std::fclose(out) == 0 && ok;
+            if (!ok) return false;
+            runs_.push_back(path);
+        }
+        return mergeSome_(runs_, [&](const uint8_t*, int32_t rn){ return fn(rn); });
+    }
+
+private:
+    std::string stem_;
+    size_t width_;
+    std::vector<std::string> runs_; // not yet merged
+    std::vector<std::string> made_; // every file created
+    unsigned next_{0};
+
+    std::string newPath_() {
+        made_.push_back(stem_ + ".sort" + std::to_string(next_++) + ".tmp");
+        return made_.back();
+    }
+
+    bool mergeSome_(const std::vector<std::string>& paths,
+                    const std::function<bool(const uint8_t*, int32_t)>& fn) {
+        struct Head {
+            std::FILE* f{nullptr};
+            std::vector<uint8_t> key;
+            int32_t recno{0};
+        };
+        std::vector<Head> heads(paths.size());
+        auto read = [&](Head& h) {
+            return std::fread(h.key.data(), 1, width_, h.f) == width_ &&
+                   std::fread(&h.recno, sizeof h.recno, 1, h.f) == 1;
+        };
+        auto later = [&](const Head* x, const Head* y) {
+            const int c = std::memcmp(x->key.data(), y->key.data(), width_);
+            return c != 0 ? c > 0 : x->recno > y->recno;
+        };
+        std::priority_queue<Head*, std::vector<Head*>, decltype(later)> q(later);
+        bool ok = true;
+        for (size_t i = 0; i < paths.size(); ++i) {
+            heads[i].key.resize(width_);
+            heads[i].f = open_file(paths[i], "rb");
+            if (!heads[i].f) ok = false;
+            else if (read(heads[i])) q.push(&heads[i]);
+        }
+        while (ok && !q.empty()) {
+            Head* h = q.top();
+            q.pop();
+            ok = fn(h->key.data(), h->recno);
+            if (read(*h)) q.push(h);
+        }
+        for (auto& h : heads) if (h.f) std::fclose(h.f);
+        return ok;
+    }
+};
+
+// "<name>[/A|/D][/C]" (flags may be combined, e.g. /DC) into `f`.
+bool parse_field(const xbase::DbArea& a, const std::string& spec, SortField& f, std::string& err) {
+    const size_t slash = spec.find('/');
+    const std::string name = textio::trim(spec.substr(0, slash));
+    for (size_t i = slash; i != std::string::npos && i < spec.size(); ++i) {
+        const char c = static_cast<char>(std::toupper(static_cast<unsigned char>(spec[i])));
+        if (c == '/' || c == ' ') continue;
+        if (c == 'A') f.desc = false;
+        else if (c == 'D') f.desc = true;
+        else if (c == 'C') f.fold = true;
+        else { err = "unknown flag in '" + spec + "' (use /A, /D, /C)"; return false; }
+    }
+    for (int i = 1; i <= a.fieldCount(); ++i) {
+        const auto& fd = a.fields()[static_cast<size_t>(i - 1)];
+        if (!textio::ieq(fd.name, name)) continue;
+        f.off = a.fieldOffset(i);
+        f.len = fd.length;
+        f.type = fd.type;
+        f.dec = fd.decimals;
+        if (f.fold && f.type != 'C') { err = "/C only applies to character fields: " + name; return false; }
+        return true;
+    }
+    err = "unknown field " + name;
+    return false;
+}
+
+} // namespace
+
+void cmd_SORT(const xbase::XBaseEngine& eng, xbase::DbArea& a, std::istringstream& iss) {
+    using namespace aggregate;
+    const char* usage = "Usage: SORT TO <table> ON <field> [/A|/D][/C], ... [ALL | REST | NEXT <n>] [FOR <cond>] [WHILE <cond>]\n";
+    if (!a.isOpen()) { std::cout << "No table open.\n"; return; }
+
+    std::string line, err;
+    std::getline(iss, line);
+    Clauses c;
+    if (!parseClauses(line, {"TO", "ON"}, c, err)) { std::cout << "SORT: " << err << "\n"; return; }
+    if (!c.head.empty() || !c.clause.count("TO") || !c.clause.count("ON")) { std::cout << usage; return; }
+
+    std::vector<SortField> fields;
+    for (const auto& spec : splitList(c.clause["ON"])) {
+        SortField f;
+        if (!parse_field(a, spec, f, err)) { std::cout << "SORT: " << err << "\n"; return; }
+        fields.push_back(f);
+    }
+    size_t width = 0;
+    for (const auto& f : fields) width += f.width();
+
+    const std::string dest = xbase::dbNameWithExt(c.clause["TO"]);
+    if (!checkTarget(eng, dest, err)) { std::cout << "SORT: " << err << "\n"; return; }
+
+    std::unique_ptr<cond::Node> forNode, whileNode;
+    for (const char* what : {"FOR", "WHILE"}) {
+        auto it = c.clause.find(what);
+        if (it == c.clause.end()) continue;
+        auto node = cond::parse(it->second, err);
+        if (!node) { std::cout << "Syntax error in " << what << ": " << err << "\n"; return; }
+        if (!cond::bind(*node, a, err)) { std::cout << "Error in " << what << ": " << err << "\n"; return; }
+        (what[0] == 'F' ? forNode : whileNode) = std::move(node);
+    }
+
+    std::unique_ptr<xbase::DbfWriter> out;
+    try {
+        out = std::make_unique<xbase::DbfWriter>(dest, a.fields());
+    } catch (const std::exception& e) {
+        std::cout << "SORT: " << e.what() << "\n";
+        return;
+    }
+
+    int32_t from = 0, to = 0;
+    scopeRange(a, c, static_cast<bool>(whileNode), from, to);
+    from = std::max<int32_t>(from, 1);
+    to = std::min(to, a.recCount());
+
+    // Extract keys a block at a time on the pool; blocks join the chunk in
+    // record order, and a chunk past the budget is sorted and spilled.
+    const size_t budget = cli::Settings::sortMemBytes();
+    Chunk chunk;
+    chunk.width = width;
+    Runs runs(dest, width);
+    bool ok = true;
+    if (from <= to) {
+        const size_t blocks = static_cast<size_t>(to - from) / kernels::kBlock + 1;
+        struct Part { std::vector<uint8_t> keys; std::vector<int32_t> recnos; };
+        std::vector<Part> part(blocks);
+        std::vector<char> cut(blocks, 0);
+        const cond::Node* w = whileNode.get();
+        kernels::forEachBlock(a, forNode.get(), kernels::Deleted::Skip, from, to,
+            [&](const kernels::BlockView& b){
+                const size_t id = static_cast<size_t>(b.first - from) / kernels::kBlock;
+                Part& p = part[id];
+                for (size_t i = 0; i < b.sel->n; ++i) {
+                    const char* rec = b.rec(i);
+                    if (w && rec[0] != xbase::IS_DELETED && !cond::eval(*w, rec)) { cut[id] = 1; break; }
+                    if (!b.sel->test(i)) continue;
+                    p.keys.resize(p.keys.size() + width);
+                    encode(fields, rec, p.keys.data() + p.keys.size() - width);
+                    p.recnos.push_back(b.first + static_cast<int32_t>(i));
+                }
+            },
+            [&](int32_t first){
+                const size_t id = static_cast<size_t>(first - from) / kernels::kBlock;
+                Part& p = part[id];
+                for (size_t i = 0; i < p.recnos.size(); ++i) {
+                    const uint8_t* k = p.keys.data() + i * width;
+                    chunk.entries.push_back({prefix_of(k, width), static_cast<uint32_t>(chunk.entries.size()), p.recnos[i]});
+                }
+                chunk.keys.insert(chunk.keys.end(), p.keys.begin(), p.keys.end());
+                std::vector<uint8_t>().swap(p.keys);
+                std::vector<int32_t>().swap(p.recnos);
+                if (chunk.bytes() > budget) {
+                    chunk.sort();
+                    ok = runs.add(chunk) && ok;
+                    chunk.clear();
+                }
+                return ok && !cut[id];
+            });
+    }
+
+    // Copy the records in key order, from a mapping of the table when it
+    // can be mapped, else through the area (cursor restored).
+    const auto map = a.mapRecords();
+    const int32_t saved = a.recno();
+    auto copy = [&](int32_t rn) {
+        if (map && rn <= map->count()) return out->append(map->record(rn));
+        return a.gotoRec(rn) && out->append(a.recordBytes());
+    };
+    bool written = true;
+    if (ok && runs.empty()) {
+        chunk.sort();
+        for (const auto& e : chunk.entries)
+            if (!(written = copy(e.recno))) break;
+    } else if (ok) {
+        if (!chunk.entries.empty()) {
+            chunk.sort();
+            ok = runs.add(chunk);
+        }
+        chunk.clear();
+        written = ok && runs.merge(copy);
+    }
+    written = out->close() && written;
+    if (!map && saved > 0) a.gotoRec(saved);
+
+    if (!ok) { std::cout << "SORT: cannot write temporary files next to " << dest << "\n"; return; }
+    if (!written) { std::cout << "SORT: write to " << dest << " failed.\n"; return; }
+    std::cout << out->count() << " record(s) sorted to " << dest;
+    if (runs.count() > 0) std::cout << " (" << runs.count() << " run(s) merged)";
+    std::cout << "\n";
+}
@@ -4,6 +4,7 @@
 #include <fstream>
 #include <string>
 #include "xbase.hpp"
+#include "xbase/key_expr.hpp"
 
 using xbase::HeaderRec;
 using xbase::IS_DELETED;
@@ -33,9 +34,22 @@ void cmd_STATUS(xbase::DbArea& a, std::istringstream& iss) {
     in.read(reinterpret_cast<char*>(&hdr), sizeof(hdr));
     if (!in) { std::cout << "Failed to read header\n"; return; }
 
-    std::cout << "File:        " << a.name()     << "\n";
+    std::cout << "File:        " << a.name()     << (a.readOnly() ? " (NOUPDATE)\n" : "\n");
     std::cout << "Records:     " << a.recCount() << "\n";
     std::cout << "Current:     " << a.recno()    << (current_is_deleted(a) ? " [DELETED]\n" : "\n");
     std::cout << "Bytes/rec:   " << a.cpr()      << "\n";
     std::cout << "Data start:  " << hdr.data_start << "\n";
+    for (const auto& t : a.indexTags()) {
+        std::cout << "Tag:         " << t.name << " ON " << t.key->text()
+                  << " (" << t.mgr->size() << " keys)";
+        for (size_t i = 0; i < t.include.size(); ++i)
+            std::cout << (i ? ", " : " INCLUDE ") << a.fields()[static_cast<size_t>(t.include[i] - 1)].name;
+        if (!t.forExpr.empty()) std::cout << " FOR " << t.forExpr;
+        if (t.mgr->memoryOnly()) std::cout << " USING " << t.mgr->backendKind();
+        if (t.unique) std::cout << " UNIQUE";
+        if (t.mgr->isStatic()) std::cout << " STATIC";
+        if (t.mgr->hasBloom()) std::cout << " BLOOM";
+        if (t.mgr->mapped()) std::cout << " MAPPED";
+        std::cout << "\n";
+    }
 }
@@ -0,0 +1,124 @@
+// src/cli/cmd_total.cpp
+// TOTAL ON <key> TO <table> [FIELDS <f1>, ...] [scope] [FOR <cond>] [WHILE <cond>]
+//
+// One record per distinct key in the new table: the group's first record,
+// with the numeric fields summed over the group. Groups are found with a
+// hash aggregation (aggregate::HashAgg), so the table need not be sorted or
+// indexed on the key; they are written in key order.
+#include "xbase.hpp"
+#include "xbase/dbf_writer.hpp"
+#include "aggregate.hpp"
+#include "cond.hpp"
+#include "textio.hpp"
+#include "cli/settings.hpp"
+
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+void cmd_TOTAL(const xbase::XBaseEngine& eng, xbase::DbArea& a, std::istringstream& iss) {
+    using namespace aggregate;
+    const char* usage = "Usage: TOTAL ON <key> TO <table> [FIELDS <f1>, ...] [ALL | REST | NEXT <n>] [FOR <cond>] [WHILE <cond>]\n";
+    if (!a.isOpen()) { std::cout << "No table open.\n"; return; }
+
+    std::string line, err;
+    std::getline(iss, line);
+    Clauses c;
+    if (!parseClauses(line, {"ON", "TO", "FIELDS"}, c, err)) { std::cout << "TOTAL: " << err << "\n"; return; }
+    if (!c.head.empty() || !c.clause.count("ON") || !c.clause.count("TO")) { std::cout << usage; return; }
+
+    Key key;
+    key.label = c.clause["ON"];
+    if (!bindKey(key, key.label, a, err)) { std::cout << "TOTAL ON: " << err << "\n"; return; }
+
+    const std::string dest = xbase::dbNameWithExt(c.clause["TO"]);
+    if (!checkTarget(eng, dest, err)) { std::cout << "TOTAL: " << err << "\n"; return; }
+
+    // Summed fields (1-based), all numeric ones by default.
+    std::vector<int> summed;
+    std::vector<Item> items;
+    auto add_field = [&](int f) {
+        Item it;
+        it.label = a.fields()[static_cast<size_t>(f - 1)].name;
+        bindItem(it, it.label, a, err);
+        items.push_back(std::move(it));
+        summed.push_back(f);
+    };
+    if (auto it = c.clause.find("FIELDS"); it != c.clause.end()) {
+        for (const auto& name : splitList(it->second)) {
+            int f = 0;
+            for (int i = 1; i <= a.fieldCount(); ++i)
+                if (textio::ieq(a.fields()[static_cast<size_t>(i - 1)].name, name)) f = i;
+            if (f == 0) { std::cout << "TOTAL: unknown field " << name << "\n"; return; }
+            const char t = a.fields()[static_cast<size_t>(f - 1)].type;
+            if (t != 'N' && t != 'F') { std::cout << "TOTAL: " << name << " is not numeric\n"; return; }
+            add_field(f);
+        }
+    } else {
+        for (int f = 1; f <= a.fieldCount(); ++f) {
+            const char t = a.fields()[static_cast<size_t>(f - 1)].type;
+            if (t == 'N' || t == 'F') add_field(f);
+        }
+    }
+
+    // A last, hidden column counts the records of each group.
+    items.emplace_back();
+    items.back().fn = Fn::Cnt;
+
+    std::unique_ptr<cond::Node> forNode, whileNode;
+    for (const char* what : {"FOR", "WHILE"}) {
+        auto it = c.clause.find(what);
+        if (it == c.clause.end()) continue;
+        auto node = cond::parse(it->second, err);
+        if (!node) { std::cout << "Syntax error in " << what << ": " << err << "\n"; return; }
+        if (!cond::bind(*node, a, err)) { std::cout << "Error in " << what << ": " << err << "\n"; return; }
+        (what[0] == 'F' ? forNode : whileNode) = std::move(node);
+    }
+
+    std::unique_ptr<xbase::DbfWriter> out;
+    try {
+        out = std::make_unique<xbase::DbfWriter>(dest, a.fields());
+    } catch (const std::exception& e) {
+        std::cout << "TOTAL: " << e.what() << "\n";
+        return;
+    }
+
+    int32_t from = 0, to = 0;
+    scopeRange(a, c, static_cast<bool>(whileNode), from, to);
+    HashAgg agg(items.size(), cli::Settings::sortMemBytes(), dest);
+    const int32_t saved = a.recno();
+    scan(a, items, &key, forNode.get(), whileNode.get(), from, to,
+         [&](const GroupTable& part){ agg.merge(part); });
+
+    // Each group's first record, its summed fields replaced by the totals
+    // (asterisks if a total does not fit the field, as in dBase).
+    int64_t records = 0;
+    std::vector<int64_t> unreadable(summed.size());
+    bool written = true;
+    std::vector<char> rec(static_cast<size_t>(a.cpr()));
+    const bool ok = agg.finish([&](const std::string&, int32_t first, const Acc* acc){
+        if (!a.gotoRec(first)) { written = false; return; }
+        std::copy(a.recordBytes(), a.recordBytes() + rec.size(), rec.begin());
+        rec[0] = xbase::NOT_DELETED;
+        records += acc[summed.size()].n;
+        for (size_t k = 0; k < summed.size(); ++k) {
+            unreadable[k] += acc[k].unreadable;
+            std::string v = result(items[k], acc[k]);
+            const size_t width = items[k].len;
+            v = v.size() > width ? std::string(width, '*') : std::string(width - v.size(), ' ') + v;
+            std::copy(v.begin(), v.end(), rec.begin() + static_cast<std::ptrdiff_t>(items[k].off));
+        }
+        written = out->append(rec.data()) && written;
+    });
+    written = out->close() && written;
+    if (saved > 0) a.gotoRec(saved);
+
+    if (!ok) { std::cout << "TOTAL: cannot write temporary files next to " << dest << "\n"; return; }
+    if (!written) { std::cout << "TOTAL: write to " << dest << " failed.\n"; return; }
+    std::cout << records << " record(s) totalled, " << out->count() << " written to " << dest << "\n";
+    for (size_t k = 0; k < summed.size(); ++k)
+        if (unreadable[k] > 0)
+            std::cout << items[k].label << ": " << unreadable[k] << " unreadable value(s) left out\n";
+}
@@ -12,9 +12,14 @@ static bool file_exists(const std::string& path) {
     return static_cast<bool>(in);
 }
 
+// USE <dbf> [NOUPDATE]
+//   NOUPDATE opens the table read-only; index tags then attach to their
+//   existing files memory-mapped (see INDEX ON ... TAG).
 void cmd_USE(DbArea& a, std::istringstream& iss) {
-    std::string db; iss >> db;
-    if (db.empty()) { std::cout << "Usage: USE <dbf>\n"; return; }
+    std::string db, opt; iss >> db >> opt;
+    if (db.empty()) { std::cout << "Usage: USE <dbf> [NOUPDATE]\n"; return; }
+    const bool readOnly = textio::ieq(opt, "NOUPDATE");
+    if (!opt.empty() && !readOnly) { std::cout << "Usage: USE <dbf> [NOUPDATE]\n"; return; }
     if (!textio::ends_with_ci(db, ".dbf")) db += ".dbf";
 
     if (!file_exists(db)) {
@@ -23,8 +28,9 @@ void cmd_USE(DbArea& a, std::istringstream& iss) {
     }
 
     try {
-        a.open(db); // must not create if absent; DbArea::open should open existing
-        std::cout << "Opened " << db << " with " << a.recCount() << " records.\n";
+        a.open(db, readOnly); // must not create if absent; DbArea::open should open existing
+        std::cout << "Opened " << db << " with " << a.recCount() << " records"
+                  << (readOnly ? " (NOUPDATE)" : "") << ".\n";
     } catch (const std::exception& e) {
         std::cout << "Open failed: " << e.what() << "\n";
     }
@@ -1,5 +1,6 @@
 #include "cmd_version.hpp"
 #include <iostream>
+#include "filter_kernels.hpp"
 
 #ifndef DOTTALKPP_VERSION
 #define DOTTALKPP_VERSION "alpha-v3"
@@ -8,5 +9,6 @@
 void cmd_VERSION(xbase::DbArea& area, std::istringstream& args) {
     (void)area; (void)args;
     std::cout << "dottalk++ " << DOTTALKPP_VERSION
-              << "  (" << __DATE__ << " " << __TIME__ << ")\n";
+              << "  (" << __DATE__ << " " << __TIME__ << ")\n"
+              << "Scan kernels: " << kernels::isa() << ", " << kernels::threads() << " thread(s)\n";
 }
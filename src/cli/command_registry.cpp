@@ -22,9 +22,9 @@ static const std::vector<std::string> verbs = {
     "HELP","AREA","SELECT","USE","QUIT","EXIT",
 
     // implemented commands (registered in shell.cpp)
-    "LIST","FIELDS","COUNT","TOP","BOTTOM","GOTO",
+    "LIST","FIELDS","COUNT","SUM","AVERAGE","CALCULATE","TOTAL","SORT","TOP","BOTTOM","GOTO",
     "APPEND","DELETE","UNDELETE","DISPLAY","RECALL","PACK",
-    "COPY","EXPORT","IMPORT","COLOR",
+    "COPY","EXPORT","IMPORT","COLOR","REINDEX","EXPLAIN",
 
     // planned / not-yet-implemented (will show with * in help())
     "REPLACE","CREATE","STATUS","STRUCT","INDEX","SEEK","FIND","LOCATE","SET","BROWSE","SKIP"
@@ -0,0 +1,457 @@
+#include "cond.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <vector>
+
+#include "predicates.hpp"
+#include "textio.hpp"
+
+namespace {
+
+struct Tok {
+    enum Kind { Word, Quoted, Op, LParen, RParen, And, Or, Not, End } kind{End};
+    std::string text;
+    size_t pos{0}; // offset in the condition text
+};
+
+bool is_op_char(char c) {
+    return c == '=' || c == '!' || c == '<' || c == '>' || c == '#' || c == '$';
+}
+
+// ".AND." / ".OR." / ".NOT." at s[i]; returns keyword length or 0.
+size_t dotted_keyword(const std::string& s, size_t i, Tok::Kind& k) {
+    static const struct { const char* w; Tok::Kind k; } kws[] = {
+        {".AND.", Tok::And}, {".OR.", Tok::Or}, {".NOT.", Tok::Not}
+    };
+    for (const auto& kw : kws) {
+        const std::string w = kw.w;
+        if (s.size() - i >= w.size() && textio::ieq(s.substr(i, w.size()), w)) {
+            k = kw.k;
+            return w.size();
+        }
+    }
+    return 0;
+}
+
+bool lex(const std::string& s, std::vector<Tok>& out, std::string& err) {
+    size_t i = 0;
+    const size_t n = s.size();
+    while (i < n) {
+        const char c = s[i];
+        if (std::isspace(static_cast<unsigned char>(c))) { ++i; continue; }
+        if (c == '(') { out.push_back({Tok::LParen, "(", i}); ++i; continue; }
+        if (c == ')') { out.push_back({Tok::RParen, ")", i}); ++i; continue; }
+
+        Tok::Kind k;
+        if (size_t len = dotted_keyword(s, i, k)) {
+            out.push_back({k, s.substr(i, len), i});
+            i += len;
+            continue;
+        }
+        if (c == '"' || c == '\'') {
+            const size_t close = s.find(c, i + 1);
+            if (close == std::string::npos) { err = "unterminated string"; return false; }
+            out.push_back({Tok::Quoted, s.substr(i + 1, close - i - 1), i});
+            i = close + 1;
+            continue;
+        }
+        if (is_op_char(c)) {
+            size_t j = i;
+            while (j < n && is_op_char(s[j])) ++j;
+            out.push_back({Tok::Op, s.substr(i, j - i), i});
+            i = j;
+            continue;
+        }
+        size_t j = i;
+        while (j < n) {
+            const char d = s[j];
+            if (std::isspace(static_cast<unsigned char>(d)) || d == '(' || d == ')' || is_op_char(d)) break;
+            Tok::Kind kk;
+            if (d == '.' && dotted_keyword(s, j, kk)) break;
+            ++j;
+        }
+        out.push_back({Tok::Word, s.substr(i, j - i), i});
+        i = j;
+    }
+    out.push_back({Tok::End, {}, n});
+    return true;
+}
+
+bool is_ident(const std::string& w) {
+    if (w.empty() || !(std::isalpha(static_cast<unsigned char>(w[0])) || w[0] == '_')) return false;
+    return std::all_of(w.begin(), w.end(), [](char c){
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    });
+}
+
+bool is_arith(const std::string& w) {
+    return w == "+" || w == "-" || w == "*" || w == "/" || w == "%" || w == "^" || w == "**";
+}
+
+class Parser {
+public:
+    Parser(const std::string& src, std::vector<Tok> toks, std::string& err)
+        : src_(src), t_(std::move(toks)), err_(err) {}
+
+    std::unique_ptr<cond::Node> parseAll() {
+        auto n = parseOr();
+        if (n && peek().kind != Tok::End) return fail("unexpected '" + peek().text + "'");
+        return n;
+    }
+
+private:
+    const std::string& src_;
+    std::vector<Tok> t_;
+    size_t p_{0};
+    std::string& err_;
+
+    const Tok& peek() const { return t_[p_]; }
+    const Tok& peekAt(size_t k) const { return t_[std::min(p_ + k, t_.size() - 1)]; }
+    // Where a term may end.
+    bool atBoundary() const {
+        const auto k = peek().kind;
+        return k == Tok::And || k == Tok::Or || k == Tok::RParen || k == Tok::End;
+    }
+    const Tok& take() { return t_[p_ < t_.size() - 1 ? p_++ : p_]; }
+
+    std::unique_ptr<cond::Node> fail(const std::string& m) {
+        if (err_.empty()) err_ = m;
+        return nullptr;
+    }
+
+    static std::unique_ptr<cond::Node> join(cond::Node::Kind k,
+                                            std::unique_ptr<cond::Node> l,
+                                            std::unique_ptr<cond::Node> r) {
+        auto n = std::make_unique<cond::Node>();
+        n->kind = k;
+        n->lhs = std::move(l);
+        n->rhs = std::move(r);
+        return n;
+    }
+
+    std::unique_ptr<cond::Node> parseOr() {
+        auto l = parseAnd();
+        while (l && peek().kind == Tok::Or) {
+            take();
+            auto r = parseAnd();
+            if (!r) return nullptr;
+            l = join(cond::Node::Kind::Or, std::move(l), std::move(r));
+        }
+        return l;
+    }
+
+    std::unique_ptr<cond::Node> parseAnd() {
+        auto l = parseUnary();
+        while (l && peek().kind == Tok::And) {
+            take();
+            auto r = parseUnary();
+            if (!r) return nullptr;
+            l = join(cond::Node::Kind::And, std::move(l), std::move(r));
+        }
+        return l;
+    }
+
+    std::unique_ptr<cond::Node> parseUnary() {
+        const Tok& t = peek();
+        if (t.kind == Tok::Not || (t.kind == Tok::Op && t.text == "!")) {
+            take();
+            auto inner = parseUnary();
+            if (!inner) return nullptr;
+            return join(cond::Node::Kind::Not, std::move(inner), nullptr);
+        }
+        if (t.kind == Tok::LParen) {
+            // A parenthesised condition, unless something other than
+            // .AND. / .OR. / ')' follows it: then the '(' opens an
+            // expression such as (GPA + 1) * 2 > 7.
+            const size_t save = p_;
+            const std::string saveErr = err_;
+            take();
+            auto inner = parseOr();
+            if (inner && peek().kind == Tok::RParen) {
+                take();
+                if (atBoundary()) return inner;
+            }
+            const std::string groupErr = err_;
+            p_ = save;
+            err_ = saveErr;
+            auto e = parseExpr();
+            if (!e && !groupErr.empty() && groupErr != saveErr) err_ = groupErr;
+            return e;
+        }
+        return parseTerm();
+    }
+
+    std::unique_ptr<cond::Node> parseTerm() {
+        if (auto n = parseSimple()) return n;
+        return parseExpr();
+    }
+
+    // <fld> <op> <value> with the value as written; nullptr (and no error)
+    // if the term does not have that shape.
+    std::unique_ptr<cond::Node> parseSimple() {
+        const size_t save = p_;
+        auto no = [&]() -> std::unique_ptr<cond::Node> { p_ = save; return nullptr; };
+
+        if (peek().kind != Tok::Word || !is_ident(peek().text)) return no();
+        auto n = std::make_unique<cond::Node>();
+        n->fld = take().text;
+
+        const Tok& o = peek();
+        if (o.kind == Tok::Op) n->op = o.text;
+        else if (o.kind == Tok::Word && textio::ieq(o.text, "CONTAINS")) n->op = "CONTAINS";
+        else return no();
+        take();
+        if (n->op == "#") n->op = "<>";
+
+        static const char* ops[] = {"=", "==", "!=", "<>", ">", "<", ">=", "<=", "$", "CONTAINS"};
+        bool known = false;
+        for (const char* k : ops) known = known || n->op == k;
+        if (!known) return no();
+
+        if (peek().kind == Tok::Quoted) {
+            n->val = take().text;
+            return atBoundary() ? std::move(n) : no();
+        }
+        // Bare value: words up to the next keyword / ')' / end, without
+        // arithmetic or function calls (those make it an expression).
+        std::string v;
+        while (peek().kind == Tok::Word || peek().kind == Tok::Op) {
+            if (is_arith(peek().text) || peekAt(1).kind == Tok::LParen) return no();
+            const std::string& w = peek().text;
+            if (w[0] == '{') return no(); // {date} literal
+            if (w.size() == 3 && w[0] == '.' && w[2] == '.') return no(); // .T. / .F.
+            if (!v.empty()) v += ' ';
+            v += take().text;
+        }
+        if (v.empty() || !atBoundary()) return no();
+        n->val = v;
+        return n;
+    }
+
+    // Any other term: handed to the expression parser, which stops where
+    // the condition's .AND. / .OR. / ')' take over.
+    std::unique_ptr<cond::Node> parseExpr() {
+        if (peek().kind == Tok::End) return fail("expected a condition");
+        const size_t start = peek().pos;
+        size_t pos = start;
+        std::string e;
+        auto ast = expr::parse(src_, pos, e);
+        if (!ast) return fail(e);
+        while (peek().kind != Tok::End && peek().pos < pos) take();
+        if (peek().pos != pos) return fail("unexpected '" + src_.substr(pos, 12) + "'");
+        auto n = std::make_unique<cond::Node>();
+        n->kind = cond::Node::Kind::Expr;
+        n->ast = std::move(ast);
+        n->text = textio::trim(src_.substr(start, pos - start));
+        return n;
+    }
+};
+
+const xindex::BitmapIndex* bitmap_for(const xbase::DbArea& a, const std::string& fld) {
+    const int idx = predicates::field_index_ci(a, fld);
+    return idx > 0 ? a.bitmapIndex(idx) : nullptr;
+}
+
+// Live records, taken from any bitmap the condition touches (each one covers
+// every non-deleted record exactly once).
+std::optional<xindex::RoaringBitmap> universe(const cond::Node& n, const xbase::DbArea& a) {
+    if (n.kind == cond::Node::Kind::Term) {
+        if (const auto* b = bitmap_for(a, n.fld)) return b->all();
+        return std::nullopt;
+    }
+    if (n.lhs) if (auto u = universe(*n.lhs, a)) return u;
+    if (n.rhs) return universe(*n.rhs, a);
+    return std::nullopt;
+}
+
+std::optional<xindex::RoaringBitmap> bitmap_eval(const cond::Node& n, const xbase::DbArea& a,
+                                                 const xindex::RoaringBitmap& all) {
+    using K = cond::Node::Kind;
+    switch (n.kind) {
+    case K::Term: {
+        const bool eq = n.op == "=" || n.op == "==";
+        const bool ne = n.op == "!=" || n.op == "<>";
+        if (!eq && !ne) return std::nullopt;
+        const auto* b = bitmap_for(a, n.fld);
+        if (!b) return std::nullopt;
+        const auto* hit = b->lookup(xindex::BitmapIndex::normalize(n.val));
+        xindex::RoaringBitmap r = hit ? *hit : xindex::RoaringBitmap{};
+        return eq ? r : all - r;
+    }
+    case K::Expr:
+        return std::nullopt;
+    case K::Not: {
+        auto r = bitmap_eval(*n.lhs, a, all);
+        if (!r) return std::nullopt;
+        return all - *r;
+    }
+    case K::And:
+    case K::Or: {
+        auto l = bitmap_eval(*n.lhs, a, all);
+        if (!l) return std::nullopt;
+        auto r = bitmap_eval(*n.rhs, a, all);
+        if (!r) return std::nullopt;
+        if (n.kind == K::And) *l &= *r;
+        else *l |= *r;
+        return l;
+    }
+    }
+    return std::nullopt;
+}
+
+std::string canon_op(const std::string& op) {
+    if (op == "==") return "=";
+    if (op == "!=") return "<>";
+    if (op == "CONTAINS") return "$";
+    return op;
+}
+
+bool same(const cond::Node& a, const cond::Node& b) {
+    if (a.kind != b.kind) return false;
+    switch (a.kind) {
+    case cond::Node::Kind::Term:
+        return textio::ieq(a.fld, b.fld) && canon_op(a.op) == canon_op(b.op)
+            && textio::ieq(textio::trim(a.val), textio::trim(b.val));
+    case cond::Node::Kind::Expr:
+        return textio::ieq(a.text, b.text);
+    case cond::Node::Kind::Not:
+        return same(*a.lhs, *b.lhs);
+    default:
+        return same(*a.lhs, *b.lhs) && same(*a.rhs, *b.rhs);
+    }
+}
+
+} // namespace
+
+namespace cond {
+
+std::unique_ptr<Node> parse(const std::string& text, std::string& err) {
+    err.clear();
+    std::vector<Tok> toks;
+    if (!lex(text, toks, err)) return nullptr;
+    if (toks.size() == 1) { err = "empty condition"; return nullptr; }
+    return Parser(text, std::move(toks), err).parseAll();
+}
+
+bool bind(Node& n, const xbase::DbArea& a, std::string& err) {
+    if (n.kind == Node::Kind::Term) {
+        n.pred = predicates::Compiled::compile(a, n.fld, n.op, n.val);
+        return true;
+    }
+    if (n.kind == Node::Kind::Expr) {
+        n.prog = expr::Program::compile(*n.ast, a, err);
+        if (!n.prog) return false;
+        if (n.prog->type() != expr::Type::Bool) {
+            err = n.text + " is not a logical expression";
+            n.prog.reset();
+            return false;
+        }
+        return true;
+    }
+    return (!n.lhs || bind(*n.lhs, a, err)) && (!n.rhs || bind(*n.rhs, a, err));
+}
+
+bool hasExpr(const Node& n) {
+    if (n.kind == Node::Kind::Expr) return true;
+    return (n.lhs && hasExpr(*n.lhs)) || (n.rhs && hasExpr(*n.rhs));
+}
+
+bool eval(const Node& n, const xbase::DbArea& a) {
+    switch (n.kind) {
+    case Node::Kind::Term: return n.pred ? n.pred->test(a) : predicates::eval(a, n.fld, n.op, n.val);
+    case Node::Kind::Expr: {
+        if (n.prog) return n.prog->test(a.recordBytes());
+        std::string err;
+        auto p = expr::Program::compile(*n.ast, a, err);
+        return p && p->type() == expr::Type::Bool && p->test(a.recordBytes());
+    }
+    case Node::Kind::And:  return eval(*n.lhs, a) && eval(*n.rhs, a);
+    case Node::Kind::Or:   return eval(*n.lhs, a) || eval(*n.rhs, a);
+    case Node::Kind::Not:  return !eval(*n.lhs, a);
+    }
+    return false;
+}
+
+bool eval(const Node& n, const char* rec) {
+    switch (n.kind) {
+    case Node::Kind::Term: return n.pred && n.pred->testRecord(rec);
+    case Node::Kind::Expr: return n.prog && n.prog->test(rec);
+    case Node::Kind::And:  return eval(*n.lhs, rec) && eval(*n.rhs, rec);
+    case Node::Kind::Or:   return eval(*n.lhs, rec) || eval(*n.rhs, rec);
+    case Node::Kind::Not:  return !eval(*n.lhs, rec);
+    }
+    return false;
+}
+
+bool eval(const Node& n, const ValueFn& value) {
+    switch (n.kind) {
+    case Node::Kind::Term: {
+        const std::string* v = value(n.fld);
+        if (!v) return false;
+        return n.pred ? n.pred->test(*v) : predicates::compare(*v, n.op, n.val);
+    }
+    case Node::Kind::Expr: return false;
+    case Node::Kind::And:  return eval(*n.lhs, value) && eval(*n.rhs, value);
+    case Node::Kind::Or:   return eval(*n.lhs, value) || eval(*n.rhs, value);
+    case Node::Kind::Not:  return !eval(*n.lhs, value);
+    }
+    return false;
+}
+
+void fieldNames(const Node& n, std::vector<std::string>& out) {
+    if (n.kind == Node::Kind::Term) { out.push_back(n.fld); return; }
+    if (n.kind == Node::Kind::Expr) { expr::fieldNames(*n.ast, out); return; }
+    if (n.lhs) fieldNames(*n.lhs, out);
+    if (n.rhs) fieldNames(*n.rhs, out);
+}
+
+std::optional<xindex::RoaringBitmap> bitmapEval(const Node& n, const xbase::DbArea& a) {
+    auto all = universe(n, a);
+    if (!all) return std::nullopt;
+    return bitmap_eval(n, a, *all);
+}
+
+void conjuncts(const Node& n, std::vector<const Node*>& out) {
+    if (n.kind == Node::Kind::And) {
+        conjuncts(*n.lhs, out);
+        conjuncts(*n.rhs, out);
+    } else {
+        out.push_back(&n);
+    }
+}
+
+bool tagCovers(const xbase::DbArea::IndexTag& t, const Node& query, bool* exact) {
+    if (t.forExpr.empty() || !t.mgr) return false;
+    std::string err;
+    auto tf = parse(t.forExpr, err);
+    if (!tf) return false;
+
+    std::vector<const Node*> q, need;
+    conjuncts(query, q);
+    conjuncts(*tf, need);
+    for (const Node* n : need) {
+        bool hit = false;
+        for (const Node* m : q) hit = hit || same(*n, *m);
+        if (!hit) return false;
+    }
+    if (exact) *exact = need.size() == q.size();
+    return true;
+}
+
+const xbase::DbArea::IndexTag* coveringTag(const xbase::DbArea& a, const Node& query, bool* exact) {
+    const xbase::DbArea::IndexTag* best = nullptr;
+    bool bestExact = false;
+    for (const auto& t : a.indexTags()) {
+        bool ex = false;
+        if (!tagCovers(t, query, &ex)) continue;
+        if (!best || t.mgr->size() < best->mgr->size()) {
+            best = &t;
+            bestExact = ex;
+        }
+    }
+    if (exact) *exact = bestExact;
+    return best;
+}
+
+} // namespace cond
@@ -0,0 +1,116 @@
+#include "covering.hpp"
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <utility>
+
+#include "predicates.hpp"
+#include "textio.hpp"
+#include "xindex/thread_pool.hpp"
+
+namespace covering {
+
+namespace {
+
+// Position of 1-based field `f` in t.include, or npos.
+size_t slot_of(const xbase::DbArea::IndexTag& t, int f) {
+    auto it = std::find(t.include.begin(), t.include.end(), f);
+    return it == t.include.end() ? std::string::npos : static_cast<size_t>(it - t.include.begin());
+}
+
+} // namespace
+
+std::optional<Plan> plan(const xbase::DbArea& a, const std::vector<int>& fields,
+                         const cond::Node* filter) {
+    // Covered rows are only field values, which expression terms cannot read.
+    if (filter && cond::hasExpr(*filter)) return std::nullopt;
+
+    std::vector<int> filterFields;
+    if (filter) {
+        std::vector<std::string> names;
+        cond::fieldNames(*filter, names);
+        for (const auto& n : names) {
+            const int f = predicates::field_index_ci(a, n);
+            if (f <= 0) return std::nullopt; // let the scan report it as it always has
+            filterFields.push_back(f);
+        }
+    }
+
+    std::optional<Plan> best;
+    for (const auto& t : a.indexTags()) {
+        if (t.include.empty() || !t.mgr) continue;
+        if (!t.forExpr.empty() && !(filter && cond::tagCovers(t, *filter))) continue;
+
+        Plan p{&t, {}};
+        bool ok = true;
+        for (int f : fields) {
+            const size_t s = slot_of(t, f);
+            if (s == std::string::npos) { ok = false; break; }
+            p.slots.push_back(s);
+        }
+        for (int f : filterFields) ok = ok && slot_of(t, f) != std::string::npos;
+        if (!ok) continue;
+
+        if (!best || t.mgr->size() < best->tag->mgr->size()) best = std::move(p);
+    }
+    return best;
+}
+
+void scan(const xbase::DbArea& a, const Plan& p, const cond::Node* filter, int32_t fromRec,
+          const std::function<bool(int32_t, const std::vector<std::string>&)>& fn) {
+    const auto& t = *p.tag;
+
+    // Entries come in key order; rows are reported in record order.
+    std::vector<std::pair<int32_t, std::vector<std::string>>> rows;
+    rows.reserve(t.mgr->size());
+    t.mgr->forEachEntry([&](const std::vector<uint8_t>&, int32_t r, const std::vector<uint8_t>& payload){
+        if (r >= fromRec) rows.emplace_back(r, a.tagPayload(t, payload));
+        return true;
+    });
+    xindex::parallelSort(rows.begin(), rows.end(),
+                         [](const auto& x, const auto& y){ return x.first < y.first; });
+
+    // Resolve filter field names to payload slots once, not per row.
+    std::map<std::string, size_t> slotByName;
+    if (filter) {
+        std::vector<std::string> names;
+        cond::fieldNames(*filter, names);
+        for (const auto& n : names) {
+            const int f = predicates::field_index_ci(a, n);
+            slotByName[textio::up(n)] = f > 0 ? slot_of(t, f) : std::string::npos;
+        }
+    }
+    const std::vector<std::string>* cur = nullptr;
+    cond::ValueFn value = [&](const std::string& name) -> const std::string* {
+        auto it = slotByName.find(textio::up(name));
+        if (it == slotByName.end() || it->second == std::string::npos) return nullptr;
+        return &(*cur)[it->second];
+    };
+
+    std::vector<std::string> out(p.slots.size());
+    for (const auto& row : rows) {
+        cur = &row.second;
+        if (filter && !cond::eval(*filter, value)) continue;
+        for (size_t i = 0; i < p.slots.size(); ++i) out[i] = row.second[p.slots[i]];
+        if (!fn(row.first, out)) return;
+    }
+}
+
+bool parseFieldList(const xbase::DbArea& a, const std::string& text,
+                    std::vector<int>& out, std::string& bad) {
+    out.clear();
+    std::string item;
+    std::istringstream ss(text);
+    while (std::getline(ss, item, ',')) {
+        item = textio::trim(item);
+        if (item.empty()) continue;
+        const int f = predicates::field_index_ci(a, item);
+        if (f <= 0) { bad = item; return false; }
+        out.push_back(f);
+    }
+    if (out.empty()) { bad = text; return false; }
+    return true;
+}
+
+} // namespace covering
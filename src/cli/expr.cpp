@@ -0,0 +1,1068 @@
+#include "expr.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+
+#include "ci_search.hpp"
+#include "predicates.hpp"
+#include "textio.hpp"
+
+namespace expr {
+
+struct Node {
+    enum class Kind { Num, Str, Date, Bool, Field, Call, Unary, Binary };
+    Kind kind{Kind::Num};
+    double num{0.0};
+    long   day{0};
+    bool   b{false};
+    std::string text; // string literal, field / function name, or operator
+    std::vector<std::shared_ptr<const Node>> args;
+};
+
+namespace {
+
+using NodePtr = std::shared_ptr<const Node>;
+
+// -------- dates ---------------------------------------------------------------
+
+// Day numbers are Julian Day Numbers, so 0 can stand for the empty date.
+constexpr long kJdnOfEpoch = 2440588; // 1970-01-01
+
+long days_from_civil(long y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const long era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<long>(doe) - 719468 + kJdnOfEpoch;
+}
+
+void civil_from_days(long jdn, long& y, unsigned& m, unsigned& d) {
+    const long z = jdn - kJdnOfEpoch + 719468;
+    const long era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast<long>(yoe) + era * 400 + (m <= 2);
+}
+
+bool valid_date(long y, unsigned m, unsigned d) {
+    if (y < 1 || y > 9999 || m < 1 || m > 12 || d < 1) return false;
+    static const unsigned mdays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    const bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    return d <= mdays[m - 1] + (m == 2 && leap ? 1u : 0u);
+}
+
+// "YYYYMMDD" (DBF storage, DTOS); 0 if blank or not a date.
+long day_from_dtos(const char* p, size_t n) {
+    if (n < 8) return 0;
+    long v[3] = {0, 0, 0};
+    const int w[3] = {4, 2, 2};
+    for (int f = 0, i = 0; f < 3; ++f)
+        for (int k = 0; k < w[f]; ++k, ++i) {
+            if (!std::isdigit(static_cast<unsigned char>(p[i]))) return 0;
+            v[f] = v[f] * 10 + (p[i] - '0');
+        }
+    if (!valid_date(v[0], static_cast<unsigned>(v[1]), static_cast<unsigned>(v[2]))) return 0;
+    return days_from_civil(v[0], static_cast<unsigned>(v[1]), static_cast<unsigned>(v[2]));
+}
+
+std::string dtos(long jdn) {
+    if (jdn <= 0) return std::string(8, ' ');
+    long y; unsigned m, d;
+    civil_from_days(jdn, y, m, d);
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "%04ld%02u%02u", y, m, d);
+    return buf;
+}
+
+// "MM/DD/YYYY" (CTOD, {..} literals) or "^YYYY-MM-DD"; 0 if blank / invalid.
+long day_from_text(std::string s) {
+    s = textio::trim(s);
+    if (s.empty()) return 0;
+    long y = 0; unsigned m = 0, d = 0;
+    char c1 = 0, c2 = 0;
+    if (s[0] == '^') {
+        if (std::sscanf(s.c_str() + 1, "%ld%c%u%c%u", &y, &c1, &m, &c2, &d) != 5) return 0;
+    } else {
+        if (std::sscanf(s.c_str(), "%u%c%u%c%ld", &m, &c1, &d, &c2, &y) != 5) return 0;
+        if (y < 100) y += y < 50 ? 2000 : 1900;
+    }
+    return valid_date(y, m, d) ? days_from_civil(y, m, d) : 0;
+}
+
+long today() {
+    const std::time_t t = std::time(nullptr);
+    std::tm tmv{};
+#if defined(_WIN32)
+    localtime_s(&tmv, &t);
+#else
+    localtime_r(&t, &tmv);
+#endif
+    return days_from_civil(tmv.tm_year + 1900, static_cast<unsigned>(tmv.tm_mon + 1),
+                           static_cast<unsigned>(tmv.tm_mday));
+}
+
+// -------- text helpers ----------------------------------------------------------
+
+inline unsigned char up(char c) {
+    return static_cast<unsigned char>(std::toupper(static_cast<unsigned char>(c)));
+}
+
+void trim_range(const char*& b, const char*& e) {
+    while (b < e && std::isspace(static_cast<unsigned char>(*b))) ++b;
+    while (e > b && std::isspace(static_cast<unsigned char>(e[-1]))) --e;
+}
+
+// Case-insensitive compare of the trimmed strings (cond's text rule).
+int compare_text(const std::string& x, const std::string& y) {
+    const char *a = x.data(), *ae = a + x.size(), *b = y.data(), *be = b + y.size();
+    trim_range(a, ae);
+    trim_range(b, be);
+    for (; a < ae && b < be; ++a, ++b) {
+        const unsigned char p = up(*a), q = up(*b);
+        if (p != q) return p < q ? -1 : 1;
+    }
+    if (a < ae) return 1;
+    if (b < be) return -1;
+    return 0;
+}
+
+bool contains_text(const std::string& hay, const std::string& needle) {
+    const char *h = hay.data(), *he = h + hay.size(), *n = needle.data(), *ne = n + needle.size();
+    trim_range(h, he);
+    trim_range(n, ne);
+    const size_t hn = static_cast<size_t>(he - h), nn = static_cast<size_t>(ne - n);
+    if (nn == 0) return true;
+    for (size_t i = 0; i + nn <= hn; ++i) {
+        size_t k = 0;
+        while (k < nn && up(h[i + k]) == up(n[k])) ++k;
+        if (k == nn) return true;
+    }
+    return false;
+}
+
+double number_from(const char* b, const char* e) {
+    trim_range(b, e);
+    const size_t n = static_cast<size_t>(e - b);
+    if (n == 0) return 0.0;
+    char buf[64];
+    if (n >= sizeof(buf)) return std::strtod(std::string(b, e).c_str(), nullptr);
+    std::memcpy(buf, b, n);
+    buf[n] = '\0';
+    return std::strtod(buf, nullptr);
+}
+
+std::string rtrim(std::string s) {
+    while (!s.empty() && s.back() == ' ') s.pop_back();
+    return s;
+}
+
+// STR(n, len, dec): right-justified in `len`, asterisks if it does not fit.
+std::string str_of(double v, int len, int dec) {
+    if (len < 1) len = 1;
+    if (dec < 0) dec = 0;
+    char buf[512];
+    std::snprintf(buf, sizeof(buf), "%.*f", dec, v);
+    std::string s = buf;
+    if (static_cast<int>(s.size()) > len) return std::string(static_cast<size_t>(len), '*');
+    return std::string(static_cast<size_t>(len) - s.size(), ' ') + s;
+}
+
+std::string num_text(double v) {
+    char buf[64];
+    if (std::fabs(v) < 1e15 && v == std::floor(v)) std::snprintf(buf, sizeof(buf), "%.0f", v);
+    else {
+        std::snprintf(buf, sizeof(buf), "%.6f", v);
+        std::string s = buf;
+        while (!s.empty() && s.back() == '0') s.pop_back();
+        if (!s.empty() && s.back() == '.') s.pop_back();
+        return s;
+    }
+    return buf;
+}
+
+// -------- lexer -----------------------------------------------------------------
+
+struct Tok {
+    enum Kind { Num, Str, Date, Ident, Dot, Op, LParen, RParen, Comma, Bad, End } kind{End};
+    std::string text; // Dot: "T", "F", "AND", "OR", "NOT"; Op: canonical operator
+    double num{0.0};
+    size_t pos{0};
+};
+
+// ".T." / ".AND." ... at s[i]: the upper-cased word, or empty.
+std::string dotted(const std::string& s, size_t i) {
+    static const char* words[] = {"T", "F", "Y", "N", "AND", "OR", "NOT"};
+    for (const char* w : words) {
+        const size_t n = std::strlen(w);
+        if (i + n + 2 <= s.size() && s[i + n + 1] == '.' && textio::ieq(s.substr(i + 1, n), w)) {
+            const std::string u = w;
+            return u == "Y" ? "T" : u == "N" ? "F" : u;
+        }
+    }
+    return {};
+}
+
+std::vector<Tok> lex(const std::string& s, size_t i) {
+    std::vector<Tok> out;
+    const size_t n = s.size();
+    auto push = [&](Tok::Kind k, std::string text, size_t at) {
+        Tok t; t.kind = k; t.text = std::move(text); t.pos = at;
+        out.push_back(std::move(t));
+    };
+    while (i < n) {
+        const char c = s[i];
+        if (std::isspace(static_cast<unsigned char>(c))) { ++i; continue; }
+        const size_t at = i;
+        if (c == '(') { push(Tok::LParen, "(", at); ++i; continue; }
+        if (c == ')') { push(Tok::RParen, ")", at); ++i; continue; }
+        if (c == ',') { push(Tok::Comma, ",", at); ++i; continue; }
+        if (c == '.') {
+            const std::string w = dotted(s, i);
+            if (!w.empty()) {
+                const size_t len = (w == "T" || w == "F") ? 3 : w.size() + 2;
+                push(Tok::Dot, w, at);
+                i += len;
+                continue;
+            }
+        }
+        if (std::isdigit(static_cast<unsigned char>(c))
+            || (c == '.' && i + 1 < n && std::isdigit(static_cast<unsigned char>(s[i + 1])))) {
+            char* end = nullptr;
+            const double v = std::strtod(s.c_str() + i, &end);
+            size_t j = static_cast<size_t>(end - s.c_str());
+            // a trailing '.' that starts .AND. etc. is not part of the number
+            if (j > i && s[j - 1] == '.' && !dotted(s, j - 1).empty()) --j;
+            push(Tok::Num, s.substr(i, j - i), at);
+            out.back().num = v;
+            i = j;
+            continue;
+        }
+        if (c == '"' || c == '\'') {
+            const size_t close = s.find(c, i + 1);
+            if (close == std::string::npos) { push(Tok::Bad, "unterminated string", at); break; }
+            push(Tok::Str, s.substr(i + 1, close - i - 1), at);
+            i = close + 1;
+            continue;
+        }
+        if (c == '{') {
+            const size_t close = s.find('}', i + 1);
+            if (close == std::string::npos) { push(Tok::Bad, "unterminated date", at); break; }
+            push(Tok::Date, s.substr(i + 1, close - i - 1), at);
+            i = close + 1;
+            continue;
+        }
+        if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            size_t j = i;
+            while (j < n && (std::isalnum(static_cast<unsigned char>(s[j])) || s[j] == '_')) ++j;
+            push(Tok::Ident, textio::up(s.substr(i, j - i)), at);
+            i = j;
+            continue;
+        }
+        static const char* two[] = {"**", "==", "!=", "<>", "<=", ">="};
+        bool done = false;
+        for (const char* t : two) {
+            if (s.compare(i, 2, t) == 0) {
+                const std::string op = t;
+                push(Tok::Op, op == "**" ? "^" : op == "!=" ? "<>" : op, at);
+                i += 2;
+                done = true;
+                break;
+            }
+        }
+        if (done) continue;
+        if (std::strchr("+-*/%^=<>#$!", c)) {
+            push(Tok::Op, c == '#' ? "<>" : std::string(1, c), at);
+            ++i;
+            continue;
+        }
+        push(Tok::Bad, std::string("unexpected '") + c + "'", at);
+        break;
+    }
+    push(Tok::End, {}, n);
+    return out;
+}
+
+// -------- parser ----------------------------------------------------------------
+
+class Parser {
+public:
+    Parser(std::vector<Tok> toks, std::string& err) : t_(std::move(toks)), err_(err) {}
+
+    // One comparison / operand; stops at .AND. / .OR. / ')' / ',' / end.
+    NodePtr operand() { return rel(); }
+    // A full expression with .AND. / .OR. / .NOT.
+    NodePtr full() { return orx(); }
+
+    const Tok& peek() const { return t_[p_]; }
+
+private:
+    std::vector<Tok> t_;
+    size_t p_{0};
+    std::string& err_;
+
+    const Tok& take() { return t_[p_ < t_.size() - 1 ? p_++ : p_]; }
+    bool isOp(const char* op) const { return peek().kind == Tok::Op && peek().text == op; }
+    bool isDot(const char* w) const { return peek().kind == Tok::Dot && peek().text == w; }
+
+    NodePtr fail(const std::string& m) {
+        if (err_.empty()) err_ = peek().kind == Tok::Bad ? peek().text : m;
+        return nullptr;
+    }
+
+    static std::shared_ptr<Node> make(Node::Kind k, std::string text, std::vector<NodePtr> args) {
+        auto n = std::make_shared<Node>();
+        n->kind = k;
+        n->text = std::move(text);
+        n->args = std::move(args);
+        return n;
+    }
+
+    NodePtr orx() {
+        auto l = andx();
+        while (l && isDot("OR")) {
+            take();
+            auto r = andx();
+            if (!r) return nullptr;
+            l = make(Node::Kind::Binary, "OR", {l, r});
+        }
+        return l;
+    }
+
+    NodePtr andx() {
+        auto l = notx();
+        while (l && isDot("AND")) {
+            take();
+            auto r = notx();
+            if (!r) return nullptr;
+            l = make(Node::Kind::Binary, "AND", {l, r});
+        }
+        return l;
+    }
+
+    NodePtr notx() {
+        if (isDot("NOT") || isOp("!")) {
+            take();
+            auto inner = notx();
+            if (!inner) return nullptr;
+            return make(Node::Kind::Unary, "NOT", {inner});
+        }
+        return rel();
+    }
+
+    NodePtr rel() {
+        auto l = add();
+        if (!l) return nullptr;
+        static const char* rels[] = {"=", "==", "<>", "<", ">", "<=", ">=", "$"};
+        for (const char* r : rels) {
+            if (!isOp(r)) continue;
+            take();
+            auto rhs = add();
+            if (!rhs) return nullptr;
+            return make(Node::Kind::Binary, std::string(r) == "==" ? "=" : r, {l, rhs});
+        }
+        return l;
+    }
+
+    NodePtr add() {
+        auto l = mul();
+        while (l && (isOp("+") || isOp("-"))) {
+            const std::string op = take().text;
+            auto r = mul();
+            if (!r) return nullptr;
+            l = make(Node::Kind::Binary, op, {l, r});
+        }
+        return l;
+    }
+
+    NodePtr mul() {
+        auto l = unary();
+        while (l && (isOp("*") || isOp("/") || isOp("%"))) {
+            const std::string op = take().text;
+            auto r = unary();
+            if (!r) return nullptr;
+            l = make(Node::Kind::Binary, op, {l, r});
+        }
+        return l;
+    }
+
+    NodePtr unary() {
+        if (isOp("-") || isOp("+")) {
+            const std::string op = take().text;
+            auto inner = unary();
+            if (!inner) return nullptr;
+            return op == "-" ? make(Node::Kind::Unary, "-", {inner}) : inner;
+        }
+        return power();
+    }
+
+    NodePtr power() {
+        auto l = primary();
+        if (l && isOp("^")) {
+            take();
+            auto r = unary();
+            if (!r) return nullptr;
+            return make(Node::Kind::Binary, "^", {l, r});
+        }
+        return l;
+    }
+
+    NodePtr primary() {
+        const Tok& t = peek();
+        switch (t.kind) {
+        case Tok::Num: {
+            auto n = make(Node::Kind::Num, {}, {});
+            n->num = take().num;
+            return n;
+        }
+        case Tok::Str:
+            return make(Node::Kind::Str, take().text, {});
+        case Tok::Date: {
+            const std::string body = take().text;
+            auto n = make(Node::Kind::Date, body, {});
+            const long d = day_from_text(body);
+            if (d == 0 && !textio::trim(body).empty()) return fail("bad date {" + body + "}");
+            n->day = d;
+            return n;
+        }
+        case Tok::Dot:
+            if (t.text == "T" || t.text == "F") {
+                auto n = make(Node::Kind::Bool, {}, {});
+                n->b = take().text == "T";
+                return n;
+            }
+            return fail("unexpected ." + t.text + ".");
+        case Tok::Ident: {
+            const std::string name = take().text;
+            if (peek().kind != Tok::LParen) return make(Node::Kind::Field, name, {});
+            take();
+            std::vector<NodePtr> args;
+            if (peek().kind != Tok::RParen) {
+                for (;;) {
+                    auto a = orx();
+                    if (!a) return nullptr;
+                    args.push_back(a);
+                    if (peek().kind != Tok::Comma) break;
+                    take();
+                }
+            }
+            if (peek().kind != Tok::RParen) return fail("missing ')' after arguments of " + name);
+            take();
+            return make(Node::Kind::Call, name, std::move(args));
+        }
+        case Tok::LParen: {
+            take();
+            auto inner = orx();
+            if (!inner) return nullptr;
+            if (peek().kind != Tok::RParen) return fail("missing ')'");
+            take();
+            return inner;
+        }
+        case Tok::End:
+            return fail("expression expected");
+        default:
+            return fail("unexpected '" + t.text + "'");
+        }
+    }
+};
+
+// -------- evaluators ------------------------------------------------------------
+
+struct Value {
+    double n{0.0};
+    long d{0};
+    bool b{false};
+    std::string s;
+};
+
+} // namespace
+
+struct Op {
+    explicit Op(Type t) : type(t) {}
+    virtual ~Op() = default;
+    const Type type;
+    bool constant{false}; // reads no record; folded by the compiler
+    virtual double      num(const char*) const   { return 0.0; }
+    virtual long        day(const char*) const   { return 0; }
+    virtual bool        truth(const char*) const { return false; }
+    virtual std::string str(const char*) const   { return {}; }
+    // Text that sits in the record as is (a C field): its bytes, no copy.
+    virtual bool bytes(const char*, const char*&, const char*&) const { return false; }
+};
+
+namespace {
+
+using OpPtr = std::unique_ptr<const Op>;
+
+Value value_of(const Op& o, const char* r) {
+    Value v;
+    switch (o.type) {
+    case Type::Num:  v.n = o.num(r);   break;
+    case Type::Date: v.d = o.day(r);   break;
+    case Type::Bool: v.b = o.truth(r); break;
+    case Type::Str:  v.s = o.str(r);   break;
+    }
+    return v;
+}
+
+struct Const : Op {
+    Const(Type t, Value v) : Op(t), v_(std::move(v)) { constant = true; }
+    double      num(const char*) const override   { return v_.n; }
+    long        day(const char*) const override   { return v_.d; }
+    bool        truth(const char*) const override { return v_.b; }
+    std::string str(const char*) const override   { return v_.s; }
+    Value v_;
+};
+
+struct Field : Op {
+    Field(Type t, size_t off, size_t len) : Op(t), off_(off), len_(len) {}
+    double num(const char* r) const override { return number_from(r + off_, r + off_ + len_); }
+    long   day(const char* r) const override { return day_from_dtos(r + off_, len_); }
+    bool   truth(const char* r) const override {
+        const char c = r[off_];
+        return c == 'T' || c == 't' || c == 'Y' || c == 'y';
+    }
+    std::string str(const char* r) const override { return std::string(r + off_, len_); }
+    bool bytes(const char* r, const char*& b, const char*& e) const override {
+        b = r + off_;
+        e = b + len_;
+        return true;
+    }
+    size_t off_, len_;
+};
+
+struct Deleted : Op {
+    Deleted() : Op(Type::Bool) {}
+    bool truth(const char* r) const override { return r[0] == xbase::IS_DELETED; }
+};
+
+struct Arith : Op {
+    Arith(char op, OpPtr l, OpPtr r) : Op(Type::Num), op_(op), l_(std::move(l)), r_(std::move(r)) {}
+    double num(const char* rec) const override {
+        const double a = l_->num(rec), b = r_->num(rec);
+        switch (op_) {
+        case '+': return a + b;
+        case '-': return a - b;
+        case '*': return a * b;
+        case '/': return a / b;
+        case '%': return std::fmod(a, b);
+        case '^': return std::pow(a, b);
+        }
+        return 0.0;
+    }
+    char op_;
+    OpPtr l_, r_;
+};
+
+struct Neg : Op {
+    explicit Neg(OpPtr x) : Op(Type::Num), x_(std::move(x)) {}
+    double num(const char* r) const override { return -x_->num(r); }
+    OpPtr x_;
+};
+
+// a + b, or a - b: a's trailing blanks moved to the end.
+struct Concat : Op {
+    Concat(bool trim, OpPtr l, OpPtr r) : Op(Type::Str), trim_(trim), l_(std::move(l)), r_(std::move(r)) {}
+    std::string str(const char* rec) const override {
+        std::string a = l_->str(rec);
+        if (!trim_) return a + r_->str(rec);
+        const size_t n = a.size();
+        a = rtrim(std::move(a));
+        const size_t moved = n - a.size();
+        a += r_->str(rec);
+        a.append(moved, ' ');
+        return a;
+    }
+    bool trim_;
+    OpPtr l_, r_;
+};
+
+// date + n, n + date, date - n
+struct DateShift : Op {
+    DateShift(OpPtr d, OpPtr n, int sign) : Op(Type::Date), d_(std::move(d)), n_(std::move(n)), sign_(sign) {}
+    long day(const char* r) const override {
+        const long d = d_->day(r);
+        return d == 0 ? 0 : d + sign_ * static_cast<long>(std::llround(n_->num(r)));
+    }
+    OpPtr d_, n_;
+    int sign_;
+};
+
+struct DateDiff : Op {
+    DateDiff(OpPtr l, OpPtr r) : Op(Type::Num), l_(std::move(l)), r_(std::move(r)) {}
+    double num(const char* r) const override { return static_cast<double>(l_->day(r) - r_->day(r)); }
+    OpPtr l_, r_;
+};
+
+struct Compare : Op {
+    enum Rel { Eq, Ne, Lt, Gt, Le, Ge, Has };
+    Compare(Rel rel, OpPtr l, OpPtr r) : Op(Type::Bool), rel_(rel), l_(std::move(l)), r_(std::move(r)) {}
+    bool truth(const char* rec) const override {
+        int c = 0;
+        switch (l_->type) {
+        case Type::Num: {
+            const double a = l_->num(rec), b = r_->num(rec);
+            c = a < b ? -1 : (a > b ? 1 : 0);
+            break;
+        }
+        case Type::Date: {
+            const long a = l_->day(rec), b = r_->day(rec);
+            c = a < b ? -1 : (a > b ? 1 : 0);
+            break;
+        }
+        case Type::Bool:
+            c = l_->truth(rec) == r_->truth(rec) ? 0 : 1;
+            break;
+        case Type::Str:
+            if (rel_ == Has) return contains_text(l_->str(rec), r_->str(rec));
+            c = compare_text(l_->str(rec), r_->str(rec));
+            break;
+        }
+        switch (rel_) {
+        case Eq: return c == 0;
+        case Ne: return c != 0;
+        case Lt: return c < 0;
+        case Gt: return c > 0;
+        case Le: return c <= 0;
+        case Ge: return c >= 0;
+        case Has: return false;
+        }
+        return false;
+    }
+    Rel rel_;
+    OpPtr l_, r_;
+};
+
+// text $ "constant": the needle is prepared once (textio::CiSearch) and
+// searched for in the field bytes in place when the left side is a field.
+struct Contains : Op {
+    Contains(OpPtr l, const std::string& needle) : Op(Type::Bool), l_(std::move(l)) {
+        const char *b = needle.data(), *e = b + needle.size();
+        trim_range(b, e);
+        search_ = textio::CiSearch(std::string(b, e));
+    }
+    bool truth(const char* rec) const override {
+        const char *b, *e;
+        if (l_->bytes(rec, b, e)) {
+            trim_range(b, e);
+            return search_.in(b, e);
+        }
+        const std::string s = l_->str(rec);
+        b = s.data();
+        e = b + s.size();
+        trim_range(b, e);
+        return search_.in(b, e);
+    }
+    OpPtr l_;
+    textio::CiSearch search_;
+};
+
+struct Logic : Op {
+    enum Kind { And, Or, Not };
+    Logic(Kind k, OpPtr l, OpPtr r) : Op(Type::Bool), k_(k), l_(std::move(l)), r_(std::move(r)) {}
+    bool truth(const char* rec) const override {
+        switch (k_) {
+        case And: return l_->truth(rec) && r_->truth(rec);
+        case Or:  return l_->truth(rec) || r_->truth(rec);
+        case Not: return !l_->truth(rec);
+        }
+        return false;
+    }
+    Kind k_;
+    OpPtr l_, r_;
+};
+
+struct Iif : Op {
+    Iif(OpPtr c, OpPtr a, OpPtr b) : Op(a->type), c_(std::move(c)), a_(std::move(a)), b_(std::move(b)) {}
+    const Op& pick(const char* r) const { return c_->truth(r) ? *a_ : *b_; }
+    double      num(const char* r) const override   { return pick(r).num(r); }
+    long        day(const char* r) const override   { return pick(r).day(r); }
+    bool        truth(const char* r) const override { return pick(r).truth(r); }
+    std::string str(const char* r) const override   { return pick(r).str(r); }
+    OpPtr c_, a_, b_;
+};
+
+// Library function over evaluated arguments.
+struct Call : Op {
+    using Impl = std::function<void(const std::vector<Value>&, Value&)>;
+    Call(Type t, std::vector<OpPtr> args, Impl impl) : Op(t), args_(std::move(args)), impl_(std::move(impl)) {}
+    Value run(const char* r) const {
+        std::vector<Value> v;
+        v.reserve(args_.size());
+        for (const auto& a : args_) v.push_back(value_of(*a, r));
+        Value out;
+        impl_(v, out);
+        return out;
+    }
+    double      num(const char* r) const override   { return run(r).n; }
+    long        day(const char* r) const override   { return run(r).d; }
+    bool        truth(const char* r) const override { return run(r).b; }
+    std::string str(const char* r) const override   { return run(r).s; }
+    std::vector<OpPtr> args_;
+    Impl impl_;
+};
+
+// -------- compiler --------------------------------------------------------------
+
+const char* type_name(Type t) {
+    switch (t) {
+    case Type::Num:  return "numeric";
+    case Type::Str:  return "character";
+    case Type::Date: return "date";
+    case Type::Bool: return "logical";
+    }
+    return "?";
+}
+
+struct FuncSpec {
+    const char* name;
+    const char* args;  // one letter per argument: N S D L, '*' any; lower case = optional
+    Type result;
+    Call::Impl impl;
+};
+
+Type arg_type(char c) {
+    switch (std::toupper(static_cast<unsigned char>(c))) {
+    case 'N': return Type::Num;
+    case 'D': return Type::Date;
+    case 'L': return Type::Bool;
+    default:  return Type::Str;
+    }
+}
+
+std::string substr1(const std::string& s, double start, double len) {
+    long b = static_cast<long>(start) - 1;
+    if (b < 0) b = 0;
+    if (static_cast<size_t>(b) >= s.size() || len <= 0) return {};
+    return s.substr(static_cast<size_t>(b), static_cast<size_t>(len));
+}
+
+const std::vector<FuncSpec>& functions() {
+    using V = std::vector<Value>;
+    static const std::vector<FuncSpec> fs = {
+        {"UPPER",   "S",   Type::Str,  [](const V& a, Value& o){ o.s = textio::up(a[0].s); }},
+        {"LOWER",   "S",   Type::Str,  [](const V& a, Value& o){
+            o.s = a[0].s;
+            for (auto& c : o.s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }},
+        {"TRIM",    "S",   Type::Str,  [](const V& a, Value& o){ o.s = rtrim(a[0].s); }},
+        {"RTRIM",   "S",   Type::Str,  [](const V& a, Value& o){ o.s = rtrim(a[0].s); }},
+        {"LTRIM",   "S",   Type::Str,  [](const V& a, Value& o){ o.s = a[0].s.substr(std::min(a[0].s.size(), a[0].s.find_first_not_of(' '))); }},
+        {"ALLTRIM", "S",   Type::Str,  [](const V& a, Value& o){ o.s = textio::trim(a[0].s); }},
+        {"LEN",     "S",   Type::Num,  [](const V& a, Value& o){ o.n = static_cast<double>(a[0].s.size()); }},
+        {"SUBSTR",  "SNn", Type::Str,  [](const V& a, Value& o){
+            o.s = substr1(a[0].s, a[1].n, a.size() > 2 ? a[2].n : static_cast<double>(a[0].s.size()));
+        }},
+        {"LEFT",    "SN",  Type::Str,  [](const V& a, Value& o){ o.s = substr1(a[0].s, 1, a[1].n); }},
+        {"RIGHT",   "SN",  Type::Str,  [](const V& a, Value& o){
+            const size_t n = a[1].n <= 0 ? 0 : std::min(a[0].s.size(), static_cast<size_t>(a[1].n));
+            o.s = a[0].s.substr(a[0].s.size() - n);
+        }},
+        {"AT",      "SS",  Type::Num,  [](const V& a, Value& o){
+            const size_t p = a[0].s.empty() ? std::string::npos : a[1].s.find(a[0].s);
+            o.n = p == std::string::npos ? 0.0 : static_cast<double>(p + 1);
+        }},
+        {"STR",     "Nnn", Type::Str,  [](const V& a, Value& o){
+            o.s = str_of(a[0].n, a.size() > 1 ? static_cast<int>(a[1].n) : 10, a.size() > 2 ? static_cast<int>(a[2].n) : 0);
+        }},
+        {"VAL",     "S",   Type::Num,  [](const V& a, Value& o){ o.n = std::strtod(a[0].s.c_str(), nullptr); }},
+        {"ABS",     "N",   Type::Num,  [](const V& a, Value& o){ o.n = std::fabs(a[0].n); }},
+        {"INT",     "N",   Type::Num,  [](const V& a, Value& o){ o.n = std::trunc(a[0].n); }},
+        {"ROUND",   "Nn",  Type::Num,  [](const V& a, Value& o){
+            // keep 10^n a finite, non-zero double; past that the value
+            // already carries fewer digits than asked for, so it stands
+            const double n = a.size() > 1 ? std::clamp(a[1].n, -308.0, 308.0) : 0.0;
+            const double k = std::pow(10.0, n);
+            const double s = a[0].n * k;
+            o.n = std::isfinite(s) ? std::round(s) / k : a[0].n;
+        }},
+        {"MOD",     "NN",  Type::Num,  [](const V& a, Value& o){
+            // xBase MOD takes the sign of the divisor
+            double m = std::fmod(a[0].n, a[1].n);
+            if (m != 0.0 && ((m < 0) != (a[1].n < 0))) m += a[1].n;
+            o.n = m;
+        }},
+        {"DTOS",    "D",   Type::Str,  [](const V& a, Value& o){ o.s = dtos(a[0].d); }},
+        {"STOD",    "S",   Type::Date, [](const V& a, Value& o){ o.d = day_from_dtos(a[0].s.data(), a[0].s.size()); }},
+        {"CTOD",    "S",   Type::Date, [](const V& a, Value& o){ o.d = day_from_text(a[0].s); }},
+        {"DATE",    "",    Type::Date, [](const V&, Value& o){ o.d = today(); }},
+        {"YEAR",    "D",   Type::Num,  [](const V& a, Value& o){
+            long y = 0; unsigned m = 0, d = 0;
+            if (a[0].d > 0) civil_from_days(a[0].d, y, m, d);
+            o.n = static_cast<double>(y);
+        }},
+        {"MONTH",   "D",   Type::Num,  [](const V& a, Value& o){
+            long y = 0; unsigned m = 0, d = 0;
+            if (a[0].d > 0) civil_from_days(a[0].d, y, m, d);
+            o.n = m;
+        }},
+        {"DAY",     "D",   Type::Num,  [](const V& a, Value& o){
+            long y = 0; unsigned m = 0, d = 0;
+            if (a[0].d > 0) civil_from_days(a[0].d, y, m, d);
+            o.n = d;
+        }},
+        {"DOW",     "D",   Type::Num,  [](const V& a, Value& o){
+            // 1 = Sunday; JDN 0 was a Monday
+            o.n = a[0].d > 0 ? static_cast<double>((a[0].d + 1) % 7 + 1) : 0.0;
+        }},
+    };
+    return fs;
+}
+
+class Compiler {
+public:
+    Compiler(const xbase::DbArea& a, std::string& err) : a_(a), err_(err) {}
+
+    OpPtr compile(const Node& n) {
+        OpPtr op = build(n);
+        return op ? fold(std::move(op)) : nullptr;
+    }
+
+private:
+    const xbase::DbArea& a_;
+    std::string& err_;
+
+    OpPtr fail(const std::string& m) {
+        if (err_.empty()) err_ = m;
+        return nullptr;
+    }
+
+    // Replace a sub-tree that reads no record with its value.
+    static OpPtr fold(OpPtr op) {
+        if (!op->constant || dynamic_cast<const Const*>(op.get())) return op;
+        return OpPtr(new Const(op->type, value_of(*op, nullptr)));
+    }
+
+    static bool all_const(const std::vector<const Op*>& ops) {
+        return std::all_of(ops.begin(), ops.end(), [](const Op* o){ return o->constant; });
+    }
+
+    template <class T>
+    static OpPtr with_const(std::unique_ptr<T> op, std::vector<const Op*> kids) {
+        op->constant = all_const(kids);
+        return fold(OpPtr(op.release()));
+    }
+
+    OpPtr build(const Node& n) {
+        switch (n.kind) {
+        case Node::Kind::Num:  { Value v; v.n = n.num; return OpPtr(new Const(Type::Num, v)); }
+        case Node::Kind::Date: { Value v; v.d = n.day; return OpPtr(new Const(Type::Date, v)); }
+        case Node::Kind::Bool: { Value v; v.b = n.b;   return OpPtr(new Const(Type::Bool, v)); }
+        case Node::Kind::Str:  { Value v; v.s = n.text; return OpPtr(new Const(Type::Str, v)); }
+        case Node::Kind::Field: return field(n.text);
+        case Node::Kind::Call:  return call(n);
+        case Node::Kind::Unary: {
+            OpPtr x = compile(*n.args[0]);
+            if (!x) return nullptr;
+            if (n.text == "NOT") {
+                if (x->type != Type::Bool) return fail(".NOT. needs a logical operand");
+                const Op* k = x.get();
+                return with_const(std::make_unique<Logic>(Logic::Not, std::move(x), nullptr), {k});
+            }
+            if (x->type != Type::Num) return fail("unary - needs a number");
+            const Op* k = x.get();
+            return with_const(std::make_unique<Neg>(std::move(x)), {k});
+        }
+        case Node::Kind::Binary: return binary(n);
+        }
+        return fail("bad expression");
+    }
+
+    OpPtr field(const std::string& name) {
+        const int idx = predicates::field_index_ci(a_, name);
+        if (idx <= 0) return fail("unknown field " + name);
+        const auto& f = a_.fields()[static_cast<size_t>(idx - 1)];
+        Type t = Type::Str;
+        switch (std::toupper(static_cast<unsigned char>(f.type))) {
+        case 'N': case 'F': t = Type::Num;  break;
+        case 'D':           t = Type::Date; break;
+        case 'L':           t = Type::Bool; break;
+        default:            t = Type::Str;  break;
+        }
+        return OpPtr(new Field(t, a_.fieldOffset(idx), f.length));
+    }
+
+    OpPtr binary(const Node& n) {
+        const std::string& op = n.text;
+        OpPtr l = compile(*n.args[0]);
+        if (!l) return nullptr;
+        OpPtr r = compile(*n.args[1]);
+        if (!r) return nullptr;
+        const Type lt = l->type, rt = r->type;
+        const std::vector<const Op*> kids{l.get(), r.get()};
+        auto mismatch = [&]{
+            return fail(std::string("type mismatch: ") + type_name(lt) + " " + op + " " + type_name(rt));
+        };
+
+        if (op == "AND" || op == "OR") {
+            if (lt != Type::Bool || rt != Type::Bool) return fail("." + op + ". needs logical operands");
+            return with_const(std::make_unique<Logic>(op == "AND" ? Logic::And : Logic::Or,
+                                                      std::move(l), std::move(r)), kids);
+        }
+
+        static const struct { const char* op; Compare::Rel rel; } rels[] = {
+            {"=", Compare::Eq}, {"<>", Compare::Ne}, {"<", Compare::Lt}, {">", Compare::Gt},
+            {"<=", Compare::Le}, {">=", Compare::Ge}, {"$", Compare::Has}
+        };
+        for (const auto& e : rels) {
+            if (op != e.op) continue;
+            if (lt != rt) return mismatch();
+            if (e.rel == Compare::Has && lt != Type::Str) return fail("$ needs character operands");
+            if (lt == Type::Bool && e.rel != Compare::Eq && e.rel != Compare::Ne)
+                return fail("logical values only compare with = and <>");
+            if (e.rel == Compare::Has && r->constant && !l->constant) {
+                const std::string needle = r->str(nullptr);
+                return std::make_unique<Contains>(std::move(l), needle);
+            }
+            return with_const(std::make_unique<Compare>(e.rel, std::move(l), std::move(r)), kids);
+        }
+
+        if (op == "+" || op == "-") {
+            if (lt == Type::Num && rt == Type::Num)
+                return with_const(std::make_unique<Arith>(op[0], std::move(l), std::move(r)), kids);
+            if (lt == Type::Str && rt == Type::Str)
+                return with_const(std::make_unique<Concat>(op == "-", std::move(l), std::move(r)), kids);
+            if (lt == Type::Date && rt == Type::Num)
+                return with_const(std::make_unique<DateShift>(std::move(l), std::move(r), op == "+" ? 1 : -1), kids);
+            if (lt == Type::Num && rt == Type::Date && op == "+")
+                return with_const(std::make_unique<DateShift>(std::move(r), std::move(l), 1), kids);
+            if (lt == Type::Date && rt == Type::Date && op == "-")
+                return with_const(std::make_unique<DateDiff>(std::move(l), std::move(r)), kids);
+            return mismatch();
+        }
+        if (lt != Type::Num || rt != Type::Num) return mismatch();
+        return with_const(std::make_unique<Arith>(op[0], std::move(l), std::move(r)), kids);
+    }
+
+    OpPtr call(const Node& n) {
+        const std::string& name = n.text;
+        std::vector<OpPtr> args;
+        for (const auto& a : n.args) {
+            OpPtr op = compile(*a);
+            if (!op) return nullptr;
+            args.push_back(std::move(op));
+        }
+        std::vector<const Op*> kids;
+        for (const auto& a : args) kids.push_back(a.get());
+
+        if (name == "DELETED") {
+            if (!args.empty()) return fail("DELETED() takes no arguments");
+            return OpPtr(new Deleted());
+        }
+        if (name == "IIF") {
+            if (args.size() != 3) return fail("IIF() takes 3 arguments");
+            if (args[0]->type != Type::Bool) return fail("IIF() condition must be logical");
+            if (args[1]->type != args[2]->type) return fail("IIF() branches must have the same type");
+            return with_const(std::make_unique<Iif>(std::move(args[0]), std::move(args[1]), std::move(args[2])), kids);
+        }
+        if (name == "EMPTY") {
+            if (args.size() != 1) return fail("EMPTY() takes 1 argument");
+            const Type t = args[0]->type;
+            auto impl = [t](const std::vector<Value>& a, Value& o) {
+                switch (t) {
+                case Type::Num:  o.b = a[0].n == 0.0; break;
+                case Type::Date: o.b = a[0].d == 0;   break;
+                case Type::Bool: o.b = !a[0].b;       break;
+                case Type::Str:  o.b = a[0].s.find_first_not_of(" \t\r\n") == std::string::npos; break;
+                }
+            };
+            return with_const(std::make_unique<Call>(Type::Bool, std::move(args), impl), kids);
+        }
+        if (name == "MIN" || name == "MAX") {
+            if (args.size() != 2) return fail(name + "() takes 2 arguments");
+            const Type t = args[0]->type;
+            if (t != args[1]->type || (t != Type::Num && t != Type::Date))
+                return fail(name + "() needs two numbers or two dates");
+            const bool mx = name == "MAX";
+            auto impl = [mx](const std::vector<Value>& a, Value& o) {
+                const bool second = mx ? (a[1].n > a[0].n || a[1].d > a[0].d) : (a[1].n < a[0].n || a[1].d < a[0].d);
+                o = a[second ? 1 : 0];
+            };
+            return with_const(std::make_unique<Call>(t, std::move(args), impl), kids);
+        }
+
+        for (const auto& f : functions()) {
+            if (name != f.name) continue;
+            const std::string sig = f.args;
+            const size_t required = static_cast<size_t>(std::count_if(sig.begin(), sig.end(),
+                [](char c){ return std::isupper(static_cast<unsigned char>(c)); }));
+            if (args.size() < required || args.size() > sig.size())
+                return fail(name + "() takes " + std::to_string(required)
+                            + (sig.size() > required ? " to " + std::to_string(sig.size()) : std::string())
+                            + " argument(s)");
+            for (size_t i = 0; i < args.size(); ++i)
+                if (args[i]->type != arg_type(sig[i]))
+                    return fail(name + "() argument " + std::to_string(i + 1) + " must be "
+                                + type_name(arg_type(sig[i])));
+            return with_const(std::make_unique<Call>(f.result, std::move(args), f.impl), kids);
+        }
+        return fail("unknown function " + name + "()");
+    }
+};
+
+} // namespace
+
+// -------- public ----------------------------------------------------------------
+
+std::shared_ptr<const Node> parse(const std::string& text, size_t& pos, std::string& err) {
+    err.clear();
+    Parser p(lex(text, pos), err);
+    auto n = p.operand();
+    if (n) pos = p.peek().pos;
+    return n;
+}
+
+std::shared_ptr<const Node> parse(const std::string& text, std::string& err) {
+    err.clear();
+    Parser p(lex(text, 0), err);
+    auto n = p.full();
+    if (n && p.peek().kind != Tok::End) {
+        err = p.peek().kind == Tok::Bad ? p.peek().text : "unexpected '" + p.peek().text + "'";
+        return nullptr;
+    }
+    return n;
+}
+
+void fieldNames(const Node& n, std::vector<std::string>& out) {
+    if (n.kind == Node::Kind::Field) out.push_back(n.text);
+    for (const auto& a : n.args) fieldNames(*a, out);
+}
+
+std::unique_ptr<Program> Program::compile(const Node& n, const xbase::DbArea& a, std::string& err) {
+    err.clear();
+    OpPtr root = Compiler(a, err).compile(n);
+    if (!root) return nullptr;
+    std::unique_ptr<Program> p(new Program());
+    p->root_ = std::move(root);
+    return p;
+}
+
+Program::~Program() = default;
+
+Type Program::type() const { return root_->type; }
+
+bool Program::test(const char* rec) const { return root_->truth(rec); }
+
+double Program::number(const char* rec) const { return root_->num(rec); }
+
+std::string Program::text(const char* rec) const {
+    switch (root_->type) {
+    case Type::Num:  return num_text(root_->num(rec));
+    case Type::Date: return dtos(root_->day(rec));
+    case Type::Bool: return root_->truth(rec) ? "T" : "F";
+    case Type::Str:  return root_->str(rec);
+    }
+    return {};
+}
+
+} // namespace expr
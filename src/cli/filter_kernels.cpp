@@ -0,0 +1,456 @@
+#include "filter_kernels.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+#include "xindex/thread_pool.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define KERNELS_SSE2 1
+#endif
+#if KERNELS_SSE2 && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #include <immintrin.h>
+  #define KERNELS_AVX2 1 // compiled for the AVX2 target, used if the CPU has it
+#endif
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+
+namespace kernels {
+
+namespace {
+
+// Slack after the last record of a block so vector loads of its last field
+// never run off the buffer.
+constexpr size_t kPad = 32;
+
+// -------- text equality ---------------------------------------------------------
+//
+// Compiled's text = is "trimmed field equals the constant, ignoring case".
+// For the usual left-aligned field that is: the field bytes, upper-cased,
+// equal the constant padded with blanks to the field width. The kernels
+// compare that way and answer Equal / NotEqual when the bytes settle it;
+// fields with leading blanks, or other white space where the padding
+// should be, come back Unsure and go through Compiled::testRecord.
+
+enum class Verdict { Equal, NotEqual, Unsure };
+
+struct TextEq {
+    size_t off{0}, len{0};
+    size_t r{0};          // constant length, <= len
+    std::string pat;      // constant + blanks to len, then kPad more
+};
+
+inline unsigned lowest_bit(uint64_t v) {
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward64(&i, v);
+    return static_cast<unsigned>(i);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(v));
+#endif
+}
+
+inline size_t popcount(uint64_t v) {
+#if defined(_MSC_VER)
+    return static_cast<size_t>(__popcnt64(v));
+#else
+    return static_cast<size_t>(__builtin_popcountll(v));
+#endif
+}
+
+inline bool is_space(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+inline unsigned char up(char c) {
+    const unsigned char u = static_cast<unsigned char>(c);
+    return (u >= 'a' && u <= 'z') ? static_cast<unsigned char>(u - 0x20) : u;
+}
+
+// `any`: some byte differs; `head`: some byte of the constant's span does.
+inline Verdict verdict(const char* f, bool any, bool head) {
+    if (!any) return Verdict::Equal;
+    if (head && !is_space(f[0])) return Verdict::NotEqual;
+    return Verdict::Unsure;
+}
+
+Verdict text_eq_scalar(const char* f, const TextEq& t) {
+    bool any = false;
+    for (size_t i = 0; i < t.len; ++i) {
+        if (up(f[i]) == static_cast<unsigned char>(t.pat[i])) continue;
+        if (i < t.r) return verdict(f, true, true);
+        any = true;
+    }
+    return verdict(f, any, false);
+}
+
+// Lanes [0, n) of a W-lane mask, n clamped to W.
+template <unsigned W>
+inline uint32_t lanes(size_t n) {
+    return n >= W ? static_cast<uint32_t>((uint64_t{1} << W) - 1) : static_cast<uint32_t>((uint32_t{1} << n) - 1);
+}
+
+#if KERNELS_SSE2
+// Bytes of f[0..16) that differ from q[0..16) once 'a'..'z' are upper-cased.
+inline uint32_t diff16(const char* f, const char* q) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(f));
+    const __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('a' - 1)),
+                                        _mm_cmplt_epi8(x, _mm_set1_epi8('z' + 1)));
+    x = _mm_sub_epi8(x, _mm_and_si128(lower, _mm_set1_epi8(0x20)));
+    const __m128i eq = _mm_cmpeq_epi8(x, _mm_loadu_si128(reinterpret_cast<const __m128i*>(q)));
+    return ~static_cast<uint32_t>(_mm_movemask_epi8(eq)) & 0xFFFFu;
+}
+
+Verdict text_eq_sse2(const char* f, const TextEq& t) {
+    bool any = false;
+    for (size_t i = 0; i < t.len; i += 16) {
+        const uint32_t d = diff16(f + i, t.pat.data() + i) & lanes<16>(t.len - i);
+        if (!d) continue;
+        if (i < t.r && (d & lanes<16>(t.r - i))) return verdict(f, true, true);
+        any = true;
+    }
+    return verdict(f, any, false);
+}
+#endif
+
+#if KERNELS_AVX2
+__attribute__((target("avx2")))
+inline uint32_t diff32(const char* f, const char* q) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(f));
+    const __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8('a' - 1)),
+                                           _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), x));
+    x = _mm256_sub_epi8(x, _mm256_and_si256(lower, _mm256_set1_epi8(0x20)));
+    const __m256i eq = _mm256_cmpeq_epi8(x, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q)));
+    return ~static_cast<uint32_t>(_mm256_movemask_epi8(eq));
+}
+
+__attribute__((target("avx2")))
+Verdict text_eq_avx2(const char* f, const TextEq& t) {
+    bool any = false;
+    for (size_t i = 0; i < t.len; i += 32) {
+        const uint32_t d = diff32(f + i, t.pat.data() + i) & lanes<32>(t.len - i);
+        if (!d) continue;
+        if (i < t.r && (d & lanes<32>(t.r - i))) return verdict(f, true, true);
+        any = true;
+    }
+    return verdict(f, any, false);
+}
+#endif
+
+using TextEqFn = Verdict (*)(const char*, const TextEq&);
+
+struct Dispatch {
+    TextEqFn textEq{text_eq_scalar};
+    const char* name{"scalar"};
+    Dispatch() {
+#if KERNELS_SSE2
+        textEq = text_eq_sse2;
+        name = "SSE2";
+#endif
+#if KERNELS_AVX2
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) { textEq = text_eq_avx2; name = "AVX2"; }
+#endif
+    }
+};
+const Dispatch kDispatch;
+
+// -------- selection over a block --------------------------------------------------
+
+struct Block {
+    const char* base;
+    size_t cpr;
+    size_t n;
+    const char* rec(size_t i) const { return base + i * cpr; }
+};
+
+// Visit the set bits of `s`.
+template <class F>
+void each_bit(const Selection& s, F&& f) {
+    for (size_t w = 0; w < s.words.size(); ++w) {
+        uint64_t bits = s.words[w];
+        while (bits) {
+            f(w * 64 + lowest_bit(bits));
+            bits &= bits - 1;
+        }
+    }
+}
+
+// The records of `cand` passing `n`, into `out` (a subset of `cand`).
+void select(const cond::Node& n, const Block& b, const Selection& cand, Selection& out) {
+    using K = cond::Node::Kind;
+    out.reset(b.n, false);
+    switch (n.kind) {
+    case K::Term: {
+        if (!n.pred) return;
+        TextEq t;
+        std::string rhs;
+        bool neg = false;
+        if (n.pred->textEquality(t.off, t.len, rhs, neg)) {
+            if (rhs.size() > t.len) { // never equal
+                if (neg) out = cand;
+                return;
+            }
+            t.r = rhs.size();
+            t.pat = rhs;
+            t.pat.append(t.len - t.r + kPad, ' ');
+            const TextEqFn fn = kDispatch.textEq;
+            each_bit(cand, [&](size_t i){
+                const char* rec = b.rec(i);
+                const Verdict v = fn(rec + t.off, t);
+                const bool eq = v == Verdict::Unsure ? n.pred->testRecord(rec) != neg
+                                                     : v == Verdict::Equal;
+                if (eq != neg) out.set(i);
+            });
+            return;
+        }
+        each_bit(cand, [&](size_t i){ if (n.pred->testRecord(b.rec(i))) out.set(i); });
+        return;
+    }
+    case K::Expr:
+        if (!n.prog) return;
+        each_bit(cand, [&](size_t i){ if (n.prog->test(b.rec(i))) out.set(i); });
+        return;
+    case K::And: {
+        Selection l;
+        select(*n.lhs, b, cand, l);
+        select(*n.rhs, b, l, out);
+        return;
+    }
+    case K::Or: {
+        Selection l, rest, r;
+        select(*n.lhs, b, cand, l);
+        rest = cand;
+        for (size_t w = 0; w < rest.words.size(); ++w) rest.words[w] &= ~l.words[w];
+        select(*n.rhs, b, rest, r);
+        for (size_t w = 0; w < out.words.size(); ++w) out.words[w] = l.words[w] | r.words[w];
+        return;
+    }
+    case K::Not: {
+        Selection in;
+        select(*n.lhs, b, cand, in);
+        for (size_t w = 0; w < out.words.size(); ++w) out.words[w] = cand.words[w] & ~in.words[w];
+        return;
+    }
+    }
+}
+
+// The records of `b` passing the delete-flag test and `filter`, into `out`
+// (`live` is scratch).
+void eval_block(const Block& b, const cond::Node* filter, Deleted mode,
+                Selection& live, Selection& out) {
+    Selection& sel = filter ? live : out;
+    sel.reset(b.n, mode == Deleted::Any);
+    if (mode != Deleted::Any) {
+        const bool wantDeleted = mode == Deleted::Only;
+        for (size_t i = 0; i < b.n; ++i)
+            if ((b.rec(i)[0] == xbase::IS_DELETED) == wantDeleted) sel.set(i);
+    }
+    if (filter) select(*filter, b, live, out);
+}
+
+// Per-block work done where the block is evaluated (transform()).
+using Work = std::function<void(const BlockView&, std::string&)>;
+
+// Parallel scan over a mapping of the table: pool tasks take blocks in
+// turn and evaluate them (and run `work`, if any) into a ring of `window`
+// slots; the caller hands the slots to onBlock(first, selection, work
+// output) strictly in block order, and evaluates blocks itself while the
+// one it needs is not ready. Nothing runs more than `window` blocks ahead
+// of the caller, so stopping early (LIST's limit, LOCATE) wastes little.
+template <class F>
+void scan_parallel(const xbase::DbArea::RecordMap& map, size_t cpr, const cond::Node* filter,
+                   Deleted mode, int32_t from, int32_t to, unsigned threads,
+                   const Work* work, F&& onBlock) {
+    const size_t blocks = static_cast<size_t>(to - from) / kBlock + 1;
+    const size_t window = 4 * static_cast<size_t>(threads);
+    struct Slot { Selection sel; std::string out; bool ready{false}; };
+    std::vector<Slot> ring(window);
+    std::mutex mu;
+    std::condition_variable canClaim, isReady;
+    size_t next = 0, consumed = 0;
+    bool stop = false;
+
+    // Evaluate block `id` into its slot.
+    auto evaluate = [&](size_t id, std::vector<char>& buf, Selection& live) {
+        const int32_t first = from + static_cast<int32_t>(id) * kBlock;
+        const size_t n = static_cast<size_t>(std::min(kBlock, to - first + 1));
+        const char* base = map.record(first);
+        // Vector loads may read up to kPad past the block; copy the block
+        // that ends too close to the end of the file.
+        if (map.bytesFrom(base) < n * cpr + kPad) {
+            buf.assign(n * cpr + kPad, ' ');
+            std::memcpy(buf.data(), base, n * cpr);
+            base = buf.data();
+        }
+        Slot& s = ring[id % window];
+        eval_block(Block{base, cpr, n}, filter, mode, live, s.sel);
+        if (work) {
+            s.out.clear();
+            (*work)(BlockView{first, base, cpr, &s.sel}, s.out);
+        }
+        {
+            std::lock_guard<std::mutex> lk(mu);
+            s.ready = true;
+        }
+        isReady.notify_all();
+    };
+    auto claimable = [&]{ return next < blocks && next < consumed + window; };
+
+    xindex::TaskGroup group;
+    for (unsigned t = 1; t < threads; ++t) {
+        group.run([&]{
+            std::vector<char> buf;
+            Selection live;
+            for (;;) {
+                size_t id;
+                {
+                    std::unique_lock<std::mutex> lk(mu);
+                    canClaim.wait(lk, [&]{ return stop || next >= blocks || claimable(); });
+                    if (stop || next >= blocks) return;
+                    id = next++;
+                }
+                evaluate(id, buf, live);
+            }
+        });
+    }
+
+    std::vector<char> buf;
+    Selection live;
+    for (size_t id = 0; id < blocks; ++id) {
+        Slot& s = ring[id % window];
+        for (;;) {
+            std::unique_lock<std::mutex> lk(mu);
+            if (s.ready) break;
+            if (claimable()) {
+                const size_t mine = next++;
+                lk.unlock();
+                evaluate(mine, buf, live);
+                continue;
+            }
+            isReady.wait(lk, [&]{ return s.ready; });
+            break;
+        }
+        const bool more = onBlock(from + static_cast<int32_t>(id) * kBlock, s.sel, s.out);
+        {
+            std::lock_guard<std::mutex> lk(mu);
+            s.ready = false;
+            ++consumed;
+            stop = !more;
+        }
+        canClaim.notify_all();
+        if (!more) break;
+    }
+    {
+        std::lock_guard<std::mutex> lk(mu);
+        stop = true;
+    }
+    canClaim.notify_all();
+    group.wait();
+}
+
+// Read records from..to a block at a time and hand each block's selection
+// to onBlock(first recno of the block, selection, output of `work` on the
+// block); it returns false to stop.
+// Scans of more than one block run on the shared thread pool over a mapping
+// of the file (scan_parallel); otherwise, or if the file cannot be mapped,
+// they read through the area on the calling thread.
+template <class F>
+void scan_blocks(xbase::DbArea& a, const cond::Node* filter, Deleted mode,
+                 int32_t from, int32_t to, const Work* work, F&& onBlock) {
+    from = std::max<int32_t>(from, 1);
+    to = std::min(to, a.recCount());
+    const size_t cpr = static_cast<size_t>(a.cpr());
+    if (from > to || cpr == 0) return;
+
+    const unsigned split = std::min<unsigned>(threads(), static_cast<unsigned>((to - from) / kBlock + 1));
+    if (split > 1) {
+        if (auto map = a.mapRecords()) {
+            to = std::min(to, map->count());
+            if (from > to) return;
+            scan_parallel(*map, cpr, filter, mode, from, to, split, work, onBlock);
+            return;
+        }
+    }
+
+    std::vector<char> buf(static_cast<size_t>(kBlock) * cpr + kPad, ' ');
+    Selection live, hit;
+    std::string out;
+    for (int32_t first = from; first <= to; first += kBlock) {
+        const int32_t want = std::min(kBlock, to - first + 1);
+        const int32_t got = a.readRecords(first, want, buf.data());
+        if (got <= 0) return;
+        eval_block(Block{buf.data(), cpr, static_cast<size_t>(got)}, filter, mode, live, hit);
+        if (work) {
+            out.clear();
+            (*work)(BlockView{first, buf.data(), cpr, &hit}, out);
+        }
+        if (!onBlock(first, hit, out) || got < want) return;
+    }
+}
+
+} // namespace
+
+void Selection::reset(size_t count, bool value) {
+    n = count;
+    words.assign((count + 63) / 64, value ? ~uint64_t{0} : 0);
+    if (value && (count & 63)) words.back() = (uint64_t{1} << (count & 63)) - 1;
+}
+
+size_t Selection::count() const {
+    size_t c = 0;
+    for (uint64_t w : words) c += popcount(w);
+    return c;
+}
+
+int64_t forEach(xbase::DbArea& a, const cond::Node* filter, Deleted mode,
+                int32_t from, int32_t to, const std::function<bool(int32_t)>& fn) {
+    int64_t visited = 0;
+    scan_blocks(a, filter, mode, from, to, nullptr, [&](int32_t first, const Selection& sel, std::string&){
+        bool more = true;
+        each_bit(sel, [&](size_t i){
+            if (!more) return;
+            ++visited;
+            more = fn(first + static_cast<int32_t>(i));
+        });
+        return more;
+    });
+    return visited;
+}
+
+int64_t count(xbase::DbArea& a, const cond::Node* filter, Deleted mode) {
+    int64_t n = 0;
+    scan_blocks(a, filter, mode, 1, a.recCount(), nullptr, [&](int32_t, const Selection& sel, std::string&){
+        n += static_cast<int64_t>(sel.count());
+        return true;
+    });
+    return n;
+}
+
+void transform(xbase::DbArea& a, const cond::Node* filter, Deleted mode, int32_t from, int32_t to,
+               const std::function<void(const BlockView&, std::string&)>& work,
+               const std::function<bool(std::string&)>& emit) {
+    scan_blocks(a, filter, mode, from, to, &work, [&](int32_t, const Selection&, std::string& out){
+        return emit(out);
+    });
+}
+
+void forEachBlock(xbase::DbArea& a, const cond::Node* filter, Deleted mode, int32_t from, int32_t to,
+                  const std::function<void(const BlockView&)>& work,
+                  const std::function<bool(int32_t)>& done) {
+    const Work fold = [&](const BlockView& b, std::string&){ work(b); };
+    scan_blocks(a, filter, mode, from, to, &fold, [&](int32_t first, const Selection&, std::string&){
+        return done(first);
+    });
+}
+
+const char* isa() { return kDispatch.name; }
+
+unsigned threads() { return xindex::ThreadPool::shared().threads(); }
+
+} // namespace kernels
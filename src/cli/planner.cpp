@@ -0,0 +1,266 @@
+#include "planner.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+#include "filter_kernels.hpp"
+#include "predicates.hpp"
+#include "textio.hpp"
+
+namespace planner {
+
+namespace {
+
+using Key = std::vector<uint8_t>;
+
+Key operator+(Key a, const Key& b) {
+    a.insert(a.end(), b.begin(), b.end());
+    return a;
+}
+
+// One key range of a tag; no `high` = to the end.
+struct Range {
+    Key low;
+    std::optional<Key> high;
+};
+
+// Key ranges of a bare-field tag on a character field that hold every
+// live record where "<field> <op> rhs" is true under Compiled's rule
+// (trimmed, case-insensitive). Keys are the field bytes upper-cased, so a
+// value sorts like its trimmed text once its leading blanks are skipped:
+// for each count j of leading spaces there is one range of j spaces + the
+// constant's span, and one of j spaces + a control byte (tabs and the
+// like, which trimming also drops). For > / >= a value too short to hold
+// the constant after its blanks can still sort above it ("ZZ" > "YYY"), so
+// every key with that many leading spaces or more is one more range. Blank
+// fields fall in none but that one. Empty if the term has no such ranges
+// (<>, $, an empty constant, or control bytes in it).
+std::vector<Range> ranges_for(const std::string& op, const std::string& rhs, size_t width) {
+    if (rhs.empty() || rhs.size() > width) return {};
+    for (unsigned char c : rhs)
+        if (c < 0x20) return {};
+    const Key k(rhs.begin(), rhs.end());
+    auto spaces = [](size_t j, Key tail) { return Key(j, ' ') + tail; };
+    auto padded = [&](Key s, uint8_t fill) { s.resize(width, fill); return s; };
+
+    if (op == "<" || op == "<=") return {{{}, padded(k, 0xFF)}};
+    const bool eq = op == "=";
+    if (!eq && op != ">" && op != ">=") return {};
+
+    std::vector<Range> out;
+    for (size_t j = 0; j + rhs.size() <= width; ++j) {
+        const Key low = spaces(j, k);
+        out.push_back({low, eq ? padded(low, ' ') : padded(spaces(j, {}), 0xFF)});
+        out.push_back({spaces(j, {}), padded(spaces(j, Key(1, 0x1F)), 0xFF)});
+    }
+    const size_t shortFrom = width - rhs.size() + 1;
+    if (!eq && shortFrom < width) out.push_back({spaces(shortFrom, {}), padded(spaces(shortFrom, {}), 0xFF)});
+    return out;
+}
+
+struct IndexPick {
+    const xbase::DbArea::IndexTag* tag{nullptr};
+    std::string term;
+    std::vector<int32_t> recnos;
+    double cost{0.0};
+};
+
+// Cheapest INDEX candidate among the .AND. terms. A key is the field's
+// bytes upper-cased, so the term is tested on each key walked and only the
+// records that pass are kept; the walk stops once it costs more than
+// `budget` (then the term is no better than a scan).
+std::optional<IndexPick> pick_index(const xbase::DbArea& a, const cond::Node& filter,
+                                    double budget, std::string& why) {
+    std::vector<const cond::Node*> terms;
+    cond::conjuncts(filter, terms);
+    std::optional<IndexPick> best;
+    why = "no tag on a character field compared with a constant";
+    for (const cond::Node* t : terms) {
+        std::string op, rhs;
+        if (t->kind != cond::Node::Kind::Term || !t->pred || !t->pred->textCompare(op, rhs)) continue;
+        const int f = predicates::field_index_ci(a, t->fld);
+        if (f <= 0 || a.fields()[static_cast<size_t>(f - 1)].type != 'C') continue;
+        const size_t width = a.fields()[static_cast<size_t>(f - 1)].length;
+        const auto ranges = ranges_for(op, rhs, width);
+        if (ranges.empty()) continue;
+
+        for (const auto& tag : a.indexTags()) {
+            if (tag.field != f || !tag.forExpr.empty() || !tag.mgr || !tag.mgr->ordered()) continue;
+            IndexPick cand{&tag, t->fld + " " + op + " \"" + rhs + "\"", {}, 1.0};
+            std::string key;
+            bool over = false;
+            for (const auto& r : ranges) {
+                tag.mgr->scanFrom(r.low, [&](const Key& k, int32_t rec){
+                    if (r.high && k > *r.high) return false;
+                    cand.cost += kEntry;
+                    key.assign(k.begin(), k.end());
+                    if (t->pred->test(key)) {
+                        cand.recnos.push_back(rec);
+                        cand.cost += kRandomRead;
+                    }
+                    over = cand.cost > budget;
+                    return !over;
+                });
+                if (over) break;
+            }
+            if (over) { why = "tag " + tag.name + " on " + cand.term + ": too many records"; continue; }
+            if (!best || cand.cost < best->cost) best = std::move(cand);
+        }
+    }
+    if (best) std::sort(best->recnos.begin(), best->recnos.end());
+    return best;
+}
+
+std::string fmt_num(double v) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.0f", v);
+    return buf;
+}
+
+} // namespace
+
+const char* name(Path p) {
+    switch (p) {
+    case Path::Bitmap:   return "BITMAP";
+    case Path::Covering: return "COVERING";
+    case Path::Tag:      return "TAG";
+    case Path::Index:    return "INDEX";
+    case Path::Scan:     return "SCAN";
+    }
+    return "?";
+}
+
+Stats stats(const xbase::DbArea& a) {
+    Stats s;
+    s.records = a.recCount();
+    s.cpr = a.cpr();
+    for (const auto& t : a.indexTags())
+        if (t.forExpr.empty() && t.mgr) { s.live = static_cast<int64_t>(t.mgr->size()); return s; }
+    for (int f = 1; f <= a.fieldCount(); ++f)
+        if (const auto* b = a.bitmapIndex(f)) { s.live = static_cast<int64_t>(b->all().cardinality()); return s; }
+    return s;
+}
+
+Plan choose(const xbase::DbArea& a, const cond::Node* filter,
+            const std::vector<int>& fields, bool countOnly) {
+    Plan p;
+    const double n = static_cast<double>(a.recCount());
+    p.considered.resize(5);
+    for (int i = 0; i < 5; ++i) p.considered[static_cast<size_t>(i)].path = static_cast<Path>(i);
+    auto& bitmap = p.considered[0];
+    auto& cover  = p.considered[1];
+    auto& tag    = p.considered[2];
+    auto& index  = p.considered[3];
+    auto& scan   = p.considered[4];
+
+    scan = {Path::Scan, true, n, n, fmt_num(n) + " record(s), " + std::to_string(a.cpr()) + " bytes each"};
+
+    if ((p.cover = covering::plan(a, fields, filter))) {
+        const double rows = static_cast<double>(p.cover->tag->mgr->size());
+        cover = {Path::Covering, true, rows, rows * kEntry, "tag " + p.cover->tag->name + " INCLUDEs every field"};
+    } else {
+        cover.detail = "no tag INCLUDEs every field needed";
+    }
+
+    if (!filter) {
+        for (auto* c : {&bitmap, &tag, &index}) c->detail = "no FOR condition";
+    } else if ((p.bitmap = cond::bitmapEval(*filter, a))) {
+        const double rows = static_cast<double>(p.bitmap->cardinality());
+        bitmap = {Path::Bitmap, true, rows, n * kBitmapRec + (countOnly ? 0.0 : rows * kRandomRead),
+                  "bitmap indexes answer every term"};
+    } else {
+        bitmap.detail = "not every term is =/<> on a bitmap-indexed field";
+    }
+
+    if (filter && (p.tag = cond::coveringTag(a, *filter, &p.exact))) {
+        const double rows = static_cast<double>(p.tag->mgr->size());
+        tag = {Path::Tag, true, rows, (countOnly && p.exact) ? 1.0 : rows * kRandomRead,
+               "tag " + p.tag->name + " FOR " + p.tag->forExpr + (p.exact ? " (exact)" : "")};
+    } else if (filter) {
+        tag.detail = "no filtered tag's FOR is among the .AND. terms";
+    }
+
+    std::string why = "no FOR condition";
+    auto pick = filter ? pick_index(a, *filter, n, why) : std::nullopt;
+    if (pick) {
+        const double rows = static_cast<double>(pick->recnos.size());
+        index = {Path::Index, true, rows, pick->cost, "tag " + pick->tag->name + " on " + pick->term};
+    } else {
+        index.detail = why;
+    }
+
+    const Choice* best = &scan;
+    for (const auto& c : p.considered)
+        if (c.usable && c.cost < best->cost) best = &c;
+    p.path = best->path;
+    if (p.path == Path::Index) {
+        p.tag = pick->tag;
+        p.recnos = std::move(pick->recnos);
+    }
+    return p;
+}
+
+int64_t forEach(xbase::DbArea& a, const Plan& p, const cond::Node* filter, int32_t from,
+                const std::function<bool(int32_t)>& fn) {
+    int64_t visited = 0;
+    bool more = true;
+    // Candidates from an index: re-check the delete flag and the condition.
+    auto visit = [&](int32_t rn, bool recheck) {
+        if (rn < from) return true;
+        if (!a.gotoRec(rn)) return true;
+        if (recheck && (a.isDeleted() || (filter && !cond::eval(*filter, a)))) return true;
+        ++visited;
+        more = fn(rn);
+        return more;
+    };
+
+    switch (p.path) {
+    case Path::Bitmap:
+        p.bitmap->forEach([&](uint32_t rn){ return visit(static_cast<int32_t>(rn), false); });
+        break;
+    case Path::Tag: {
+        std::vector<int32_t> recs;
+        recs.reserve(p.tag->mgr->size());
+        p.tag->mgr->forEach([&](const Key&, int32_t r){ recs.push_back(r); return true; });
+        std::sort(recs.begin(), recs.end());
+        for (int32_t rn : recs) if (!visit(rn, true)) break;
+        break;
+    }
+    case Path::Index:
+        for (int32_t rn : p.recnos) if (!visit(rn, true)) break;
+        break;
+    case Path::Covering:
+    case Path::Scan:
+        visited = kernels::forEach(a, filter, kernels::Deleted::Skip, from, a.recCount(),
+                                   [&](int32_t rn){ return !a.gotoRec(rn) || fn(rn); });
+        break;
+    }
+    return visited;
+}
+
+std::string explain(const xbase::DbArea& a, const Plan& p) {
+    const Stats s = stats(a);
+    std::ostringstream out;
+    out << "Table " << a.name() << ": " << s.records << " record(s), " << s.cpr << " bytes each";
+    if (s.live >= 0) {
+        const double del = s.records > 0 ? 100.0 * static_cast<double>(s.records - s.live) / s.records : 0.0;
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.1f", del);
+        out << ", " << s.live << " live (" << buf << "% deleted)";
+    }
+    out << "\n";
+    for (const auto& c : p.considered) {
+        char head[64];
+        if (c.usable)
+            std::snprintf(head, sizeof(head), "  %-9s cost %-10s ~%s row(s)", name(c.path),
+                          fmt_num(c.cost).c_str(), fmt_num(c.rows).c_str());
+        else
+            std::snprintf(head, sizeof(head), "  %-9s -", name(c.path));
+        out << head << (c.usable ? ": " : "  ") << c.detail
+            << (c.path == p.path ? "  <- chosen" : "") << "\n";
+    }
+    return out.str();
+}
+
+} // namespace planner
@@ -4,6 +4,7 @@
 #include <cstdlib>
 #include <algorithm>
 #include <limits>
+#include <cstring>
 
 #include "predicates.hpp"
 #include "textio.hpp"
@@ -12,13 +13,7 @@ namespace {
 
 // case-insensitive find
 bool contains_ci(const std::string& hay, const std::string& needle) {
-    if (needle.empty()) return true;
-    auto up = [](std::string s){
-        for (auto& c : s) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
-        return s;
-    };
-    std::string H = up(hay), N = up(needle);
-    return H.find(N) != std::string::npos;
+    return textio::CiSearch(needle).in(hay);
 }
 
 // trim both ends, leave internal spaces alone
@@ -36,6 +31,29 @@ inline bool parse_number(const std::string& s, double& out) {
     return *end == '\0';
 }
 
+// Upper-case table for the byte compares of Compiled (same folding as
+// std::toupper in the "C" locale).
+struct Fold {
+    unsigned char t[256];
+    Fold() { for (int c = 0; c < 256; ++c) t[c] = static_cast<unsigned char>(std::toupper(c)); }
+};
+const Fold kFold;
+
+inline unsigned char fold(char c) { return kFold.t[static_cast<unsigned char>(c)]; }
+
+// parse_number() over [b, e), which is already trimmed.
+bool parse_number(const char* b, const char* e, double& out) {
+    const size_t n = static_cast<size_t>(e - b);
+    if (n == 0) return false;
+    char buf[256];
+    if (n >= sizeof(buf)) return parse_number(std::string(b, e), out);
+    std::memcpy(buf, b, n);
+    buf[n] = '\0';
+    char* end = nullptr;
+    out = std::strtod(buf, &end);
+    return end == buf + n;
+}
+
 } // namespace
 
 namespace predicates {
@@ -67,9 +85,15 @@ bool eval(const xbase::DbArea& a,
     if (idx <= 0) return false;
 
     // Fetch current record's field value
-    std::string lhs_raw = a.get(idx);
-    std::string rhs_raw = val_in;
+    return compare(a.get(idx), op, val_in);
+}
 
+// Same comparison as eval(), on a field value the caller already has
+// (e.g. from a covering index entry).
+bool compare(const std::string& lhs_raw,
+             const std::string& op,
+             const std::string& rhs_raw)
+{
     // Trim both sides
     std::string lhs = trim_both(lhs_raw);
     std::string rhs = trim_both(rhs_raw);
@@ -133,4 +157,102 @@ bool eval(const xbase::DbArea& a,
     return false;
 }
 
+// -------- Compiled ----------------------------------------------------------
+
+std::unique_ptr<Compiled> Compiled::compile(const xbase::DbArea& a,
+                                            const std::string& fld,
+                                            const std::string& op,
+                                            const std::string& val)
+{
+    const int idx = field_index_ci(a, fld);
+    if (idx <= 0) return nullptr;
+
+    auto c = std::unique_ptr<Compiled>(new Compiled());
+    const std::string OP = textio::up(op);
+    if      (OP == "=" || OP == "==")        c->op_ = Op::Eq;
+    else if (OP == "!=" || OP == "<>")       c->op_ = Op::Ne;
+    else if (OP == ">")                      c->op_ = Op::Gt;
+    else if (OP == "<")                      c->op_ = Op::Lt;
+    else if (OP == ">=")                     c->op_ = Op::Ge;
+    else if (OP == "<=")                     c->op_ = Op::Le;
+    else if (OP == "$" || OP == "CONTAINS")  c->op_ = Op::Contains;
+    else return nullptr;
+
+    c->off_ = a.fieldOffset(idx);
+    c->len_ = a.fields()[static_cast<size_t>(idx - 1)].length;
+    const std::string rhs = trim_both(val);
+    c->rhsNum_ = parse_number(rhs, c->rnum_);
+    c->rhs_ = textio::up(rhs);
+    if (c->op_ == Op::Contains) c->search_ = textio::CiSearch(rhs);
+    return c;
+}
+
+bool Compiled::test(const xbase::DbArea& a) const {
+    const char* b = a.recordBytes() + off_;
+    return test_(b, b + len_);
+}
+
+bool Compiled::test(const std::string& lhs) const {
+    return test_(lhs.data(), lhs.data() + lhs.size());
+}
+
+bool Compiled::textEquality(size_t& off, size_t& len, std::string& rhs, bool& negated) const {
+    if ((op_ != Op::Eq && op_ != Op::Ne) || rhsNum_) return false;
+    off = off_;
+    len = len_;
+    rhs = rhs_;
+    negated = op_ == Op::Ne;
+    return true;
+}
+
+bool Compiled::textCompare(std::string& op, std::string& rhs) const {
+    if (rhsNum_) return false;
+    static const char* names[] = {"=", "<>", ">", "<", ">=", "<=", "$"};
+    op = names[static_cast<int>(op_)];
+    rhs = rhs_;
+    return true;
+}
+
+bool Compiled::test_(const char* b, const char* e) const {
+    while (b < e && std::isspace(static_cast<unsigned char>(*b))) ++b;
+    while (e > b && std::isspace(static_cast<unsigned char>(e[-1]))) --e;
+    const size_t n = static_cast<size_t>(e - b);
+    const std::string& r = rhs_;
+
+    if (op_ == Op::Contains) return search_.in(b, e);
+
+    // Numeric when both sides are numbers; the lhs is only parsed if the
+    // constant is one.
+    double ln = 0.0;
+    if (rhsNum_ && parse_number(b, e, ln)) {
+        switch (op_) {
+        case Op::Eq: return ln == rnum_;
+        case Op::Ne: return ln != rnum_;
+        case Op::Gt: return ln >  rnum_;
+        case Op::Lt: return ln <  rnum_;
+        case Op::Ge: return ln >= rnum_;
+        case Op::Le: return ln <= rnum_;
+        default:     return false;
+        }
+    }
+
+    // Case-insensitive three-way compare, shorter string first on a tie.
+    int cmp = 0;
+    const size_t m = std::min(n, r.size());
+    for (size_t i = 0; i < m && cmp == 0; ++i) {
+        const unsigned char x = fold(b[i]), y = static_cast<unsigned char>(r[i]);
+        if (x != y) cmp = x < y ? -1 : 1;
+    }
+    if (cmp == 0 && n != r.size()) cmp = n < r.size() ? -1 : 1;
+    switch (op_) {
+    case Op::Eq: return cmp == 0;
+    case Op::Ne: return cmp != 0;
+    case Op::Gt: return cmp >  0;
+    case Op::Lt: return cmp <  0;
+    case Op::Ge: return cmp >= 0;
+    case Op::Le: return cmp <= 0;
+    default:     return false;
+    }
+}
+
 } // namespace predicates
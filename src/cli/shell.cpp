@@ -6,6 +6,7 @@
 #include "command_registry.hpp"
 #include "colors.hpp"
 #include "cmd_version.hpp"
+#include "xindex/thread_pool.hpp"
 
 
 using xbase::DbArea;
@@ -22,6 +23,11 @@ void cmd_TOP(xbase::DbArea&, std::istringstream&);
 void cmd_BOTTOM(xbase::DbArea&, std::istringstream&);
 void cmd_GOTO(xbase::DbArea&, std::istringstream&);
 void cmd_COUNT(xbase::DbArea&, std::istringstream&);
+void cmd_SUM(xbase::DbArea&, std::istringstream&);
+void cmd_AVERAGE(xbase::DbArea&, std::istringstream&);
+void cmd_CALCULATE(xbase::DbArea&, std::istringstream&);
+void cmd_TOTAL(const xbase::XBaseEngine&, xbase::DbArea&, std::istringstream&);
+void cmd_SORT(const xbase::XBaseEngine&, xbase::DbArea&, std::istringstream&);
 void cmd_DISPLAY(xbase::DbArea&, std::istringstream&);
 void cmd_DELETE(xbase::DbArea&, std::istringstream&);
 void cmd_RECALL(xbase::DbArea&, std::istringstream&);
@@ -30,6 +36,8 @@ void cmd_COLOR(xbase::DbArea&, std::istringstream&);
 
 void cmd_SEEK(xbase::DbArea&, std::istringstream&);
 void cmd_FIND(xbase::DbArea&, std::istringstream&);
+void cmd_LOCATE(xbase::DbArea&, std::istringstream&);
+void cmd_EXPLAIN(xbase::DbArea&, std::istringstream&);
 
 void cmd_RECNO(xbase::DbArea&, std::istringstream&);
 void cmd_STATUS(xbase::DbArea&, std::istringstream&);
@@ -42,6 +50,9 @@ void cmd_REPLACE(xbase::DbArea&, std::istringstream&);
 void cmd_EDIT(xbase::DbArea&, std::istringstream&);
 
 void cmd_REFRESH(xbase::DbArea&, std::istringstream&);
+void cmd_INDEX(xbase::DbArea&, std::istringstream&);
+void cmd_REINDEX(xbase::DbArea&, std::istringstream&);
+void cmd_SET(xbase::DbArea&, std::istringstream&);
 
 
 void cmd_CREATE(xbase::DbArea&, std::istringstream&);
@@ -107,6 +118,11 @@ int run_shell()
     reg.add("BOTTOM",  [](DbArea& A, std::istringstream& S){ cmd_BOTTOM(A,S); });
     reg.add("GOTO",    [](DbArea& A, std::istringstream& S){ cmd_GOTO(A,S); });
     reg.add("COUNT",   [](DbArea& A, std::istringstream& S){ cmd_COUNT(A,S); });
+    reg.add("SUM",     [](DbArea& A, std::istringstream& S){ cmd_SUM(A,S); });
+    reg.add("AVERAGE", [](DbArea& A, std::istringstream& S){ cmd_AVERAGE(A,S); });
+    reg.add("CALCULATE", [](DbArea& A, std::istringstream& S){ cmd_CALCULATE(A,S); });
+    reg.add("TOTAL",   [&](DbArea& A, std::istringstream& S){ cmd_TOTAL(eng,A,S); });
+    reg.add("SORT",    [&](DbArea& A, std::istringstream& S){ cmd_SORT(eng,A,S); });
     reg.add("DISPLAY", [](DbArea& A, std::istringstream& S){ cmd_DISPLAY(A,S); });
     reg.add("DELETE",  [](DbArea& A, std::istringstream& S){ cmd_DELETE(A,S); });
     reg.add("RECALL",  [](DbArea& A, std::istringstream& S){ cmd_RECALL(A,S); });
@@ -115,6 +131,8 @@ int run_shell()
     reg.add("COLOR",   [](DbArea& A, std::istringstream& S){ cmd_COLOR(A,S); });
     reg.add("SEEK",    [](DbArea& A, std::istringstream& S){ cmd_SEEK(A, S); });
     reg.add("FIND",    [](DbArea& A, std::istringstream& S){ cmd_FIND(A, S); });
+    reg.add("LOCATE",  [](DbArea& A, std::istringstream& S){ cmd_LOCATE(A, S); });
+    reg.add("EXPLAIN", [](DbArea& A, std::istringstream& S){ cmd_EXPLAIN(A, S); });
     reg.add("VERSION", [](DbArea& A, std::istringstream& S){ cmd_VERSION(A, S); }); 
 //  somewhere in command registrations
     reg.add("LIST",    [](DbArea& A, std::istringstream& S){ cmd_LIST(A,S);    });
@@ -136,13 +154,16 @@ int run_shell()
     reg.add("DUMP", [](DbArea& A, std::istringstream& S){ cmd_DUMP(A, S); });
     reg.add("APPEND_BLANK", [](DbArea& A, std::istringstream& S){ cmd_APPEND_BLANK(A, S); });
     reg.add("REFRESH", [](DbArea& A, std::istringstream& S){ cmd_REFRESH(A, S); });
+    reg.add("INDEX",   [](DbArea& A, std::istringstream& S){ cmd_INDEX(A, S); });
+    reg.add("REINDEX", [](DbArea& A, std::istringstream& S){ cmd_REINDEX(A, S); });
+    reg.add("SET",     [](DbArea& A, std::istringstream& S){ cmd_SET(A, S); });
 
 
 #if DOTTALK_WITH_INDEX
      // Clear the console on startup so the prompt is at top of the screen
     {
         std::istringstream _none;
-        cmd_CLEAR(A, _none);   // A is your DbArea in the shell
+        cmd_CLEAR(eng.area(eng.currentArea()), _none);
     }
 
 #endif
@@ -170,5 +191,16 @@ int run_shell()
             std::cout << "Unknown command: " << cmd << std::endl;
         }
     }
+    // Let queued work finish and the workers exit before the areas close.
+    xindex::ThreadPool::shared().shutdown();
+    // Close the areas here rather than at exit, so a tag that cannot be
+    // saved is reported.
+    for (int i = 0; i < MAX_AREA; ++i) {
+        try {
+            eng.area(i).close();
+        } catch (const std::exception& e) {
+            std::cout << "Close failed: " << e.what() << "\n";
+        }
+    }
     return 0;
 }
@@ -0,0 +1,476 @@
+#include "xbase.hpp"
+#include "xbase/key_expr.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+#if DOTTALK_WITH_INDEX
+  #include "xindex/key_codec.hpp"
+#endif
+
+// [INDEX PATCH] Keeping per-area indexes in step with record writes.
+
+namespace xbase {
+
+#if DOTTALK_WITH_INDEX
+namespace {
+
+// Key / FOR text as a tag file records it: upper case outside quotes, runs
+// of blanks as one.
+std::string canonical(const std::string& text) {
+    std::string out;
+    char quote = 0;
+    for (char c : text) {
+        if (quote) { if (c == quote) quote = 0; out += c; continue; }
+        if (c == '"' || c == '\'') quote = c;
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            if (!out.empty() && out.back() != ' ') out += ' ';
+            continue;
+        }
+        out += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    }
+    while (!out.empty() && out.back() == ' ') out.pop_back();
+    return out;
+}
+
+// The tag's KeyDesc: options, plus what it is built from and the table's
+// stamp for the file (checked when a NOUPDATE area attaches it).
+xindex::KeyDesc key_desc(const std::string& dbf, const std::vector<FieldDef>& fields,
+                         const DbArea::IndexTag& t, const DbArea::TagOptions& opts) {
+    xindex::KeyDesc kd{t.name, opts.bloom, opts.staticLayout, opts.backend, opts.unique, {}, {}};
+    kd.definition = "ON " + canonical(t.key->text());
+    if (!t.forExpr.empty()) kd.definition += " FOR " + canonical(t.forExpr);
+    for (size_t i = 0; i < t.include.size(); ++i)
+        kd.definition += (i ? ", " : " INCLUDE ") + fields[static_cast<size_t>(t.include[i] - 1)].name;
+    kd.tableStamp = [dbf]{ return tableStamp(dbf); };
+    return kd;
+}
+
+} // namespace
+#endif
+
+void DbArea::syncIndexes(bool fresh) {
+#if DOTTALK_WITH_INDEX
+    const bool wasIn = !fresh && _del_snapshot != IS_DELETED;
+    const bool isIn  = _del != IS_DELETED;
+
+    for (auto& t : _tags) {
+        if (!t.mgr || !t.key || t.mgr->readOnly()) continue;
+        // A FOR filter can flip either way on an update: the record then
+        // leaves or joins the tag instead of moving within it.
+        const bool was = wasIn && tagAccepts(t, /*snapshot=*/true);
+        const bool is  = isIn  && tagAccepts(t, /*snapshot=*/false);
+        if (was && is) {
+            auto oldK = t.key->eval(_recbuf_snapshot.data());
+            auto newK = t.key->eval(_recbuf.data());
+            if (t.include.empty()) {
+                t.mgr->update(oldK, newK, _crn);
+            } else {
+                auto newP = payloadFrom(_fd, t);
+                if (oldK != newK || payloadFrom(_fd_snapshot, t) != newP)
+                    t.mgr->update(oldK, newK, _crn, std::move(newP));
+            }
+        }
+        else if (was)   t.mgr->erase(t.key->eval(_recbuf_snapshot.data()), _crn);
+        else if (is)    t.mgr->insert(t.key->eval(_recbuf.data()), _crn, payloadFrom(_fd, t));
+    }
+
+    const auto rec = static_cast<std::uint32_t>(_crn);
+    for (auto& t : _bitmaps) {
+        const size_t i = static_cast<size_t>(t.field);
+        if (!t.bmp || i >= _fd.size()) continue;
+        // Values are compared as stored on disk, i.e. cut to the field width.
+        auto valueOf = [&](const std::vector<std::string>& vals) {
+            std::string v = i < vals.size() ? vals[i] : std::string{};
+            if (v.size() > _fields[i - 1].length) v.resize(_fields[i - 1].length);
+            return xindex::BitmapIndex::normalize(v);
+        };
+        if (wasIn && isIn)  t.bmp->update(valueOf(_fd_snapshot), valueOf(_fd), rec);
+        else if (wasIn)     t.bmp->erase(valueOf(_fd_snapshot), rec);
+        else if (isIn)      t.bmp->insert(valueOf(_fd), rec);
+    }
+
+    _fd_snapshot  = _fd;
+    _recbuf_snapshot = _recbuf;
+    _del_snapshot = _del;
+#else
+    (void)fresh;
+#endif
+}
+
+bool DbArea::buildBitmapIndex(int idx) {
+#if DOTTALK_WITH_INDEX
+    if (!isOpen() || idx < 1 || idx > static_cast<int>(_fields.size())) return false;
+
+    size_t off = 1; // skip delete flag
+    for (int i = 1; i < idx; ++i) off += _fields[static_cast<size_t>(i - 1)].length;
+    const size_t len = _fields[static_cast<size_t>(idx - 1)].length;
+
+    // One sequential pass over the raw records; does not disturb the cursor's
+    // field buffer, only the stream position (restored by the next gotoRec).
+    auto bmp = std::make_unique<xindex::BitmapIndex>();
+    std::vector<char> buf(static_cast<size_t>(_hdr.cpr));
+    _fp.clear();
+    _fp.seekg(_hdr.data_start, std::ios::beg);
+    for (int32_t rn = 1; rn <= _hdr.num_of_recs; ++rn) {
+        if (!_fp.read(buf.data(), static_cast<std::streamsize>(buf.size()))) break;
+        if (buf[0] == IS_DELETED) continue;
+        if (off + len > buf.size()) continue;
+        bmp->insert(xindex::BitmapIndex::normalize(std::string(buf.data() + off, len)),
+                    static_cast<std::uint32_t>(rn));
+    }
+    _fp.clear();
+
+    auto it = std::find_if(_bitmaps.begin(), _bitmaps.end(),
+                           [&](const BitmapTag& t){ return t.field == idx; });
+    if (it != _bitmaps.end()) it->bmp = std::move(bmp);
+    else _bitmaps.push_back(BitmapTag{idx, std::move(bmp)});
+    return true;
+#else
+    (void)idx;
+    return false;
+#endif
+}
+
+const xindex::BitmapIndex* DbArea::bitmapIndex(int idx) const {
+    for (const auto& t : _bitmaps)
+        if (t.field == idx) return t.bmp.get();
+    return nullptr;
+}
+
+bool DbArea::tagAccepts(const IndexTag& t, bool snapshot) {
+    if (!t.filter) return true;
+    if (!snapshot) return t.filter(*this);
+    // Filters read fields through get() or recordBytes(); point both at the
+    // old image.
+    std::swap(_fd, _fd_snapshot);
+    std::swap(_recbuf, _recbuf_snapshot);
+    const bool ok = t.filter(*this);
+    std::swap(_recbuf, _recbuf_snapshot);
+    std::swap(_fd, _fd_snapshot);
+    return ok;
+}
+
+bool DbArea::createIndexTag(const std::string& tag, const std::string& keyExpr,
+                            const std::vector<int>& include,
+                            const std::string& forExpr, RecordFilter filter,
+                            const TagOptions& opts, std::string& err) {
+#if DOTTALK_WITH_INDEX
+    if (!isOpen()) { err = "no table open"; return false; }
+    if (tag.empty() || tag.size() > 10) { err = "tag name must be 1..10 characters"; return false; }
+    for (int f : include)
+        if (f < 1 || f > static_cast<int>(_fields.size())) { err = "bad INCLUDE field"; return false; }
+
+    std::string name = tag;
+    for (auto& c : name) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') { err = "bad tag name: " + tag; return false; }
+        c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    }
+    auto it = std::find_if(_tags.begin(), _tags.end(),
+                           [&](const IndexTag& t){ return t.name == name; });
+    if (it == _tags.end() && static_cast<int>(_tags.size()) >= MAX_INDEX) {
+        err = "too many tags (max " + std::to_string(MAX_INDEX) + ")";
+        return false;
+    }
+
+    std::shared_ptr<const KeyExpr> key = KeyExpr::compile(keyExpr, _fields, err);
+    if (!key) { err = "bad key expression: " + err; return false; }
+
+    IndexTag t;
+    t.name = name;
+    t.key = key;
+    t.field = key->field();
+    t.forExpr = forExpr;
+    t.filter = std::move(filter);
+    t.include = include;
+    t.unique = opts.unique;
+    t.mgr = std::make_unique<xindex::IndexManager>();
+
+    // Memory-only backends write nothing, so they build even NOUPDATE.
+    const bool attach = _readOnly && !xindex::makeBackend(opts.backend);
+    try {
+        // A tag of that name shares the file: save its pending writes now,
+        // so its manager has nothing left to write over the new file when
+        // it is replaced (and stays whole if the build fails).
+        if (!attach && it != _tags.end() && it->mgr && !it->mgr->readOnly()) it->mgr->close();
+        // A UNIQUE build stops at the first duplicate, before the file is
+        // touched (KeyDesc::unique).
+        if (attach) t.mgr->openReadOnly(_db_name, key_desc(_db_name, _fields, t, opts));
+        else        fillTag(t, /*create=*/true, opts);
+    } catch (const std::exception& e) {
+        err = e.what();
+        return false;
+    }
+    if (attach && t.unique) {
+        // The file may have been built without UNIQUE. Equal keys come out
+        // next to each other, in any backend.
+        bool first = true;
+        std::vector<uint8_t> prev;
+        int32_t prevRec = 0;
+        t.mgr->forEach([&](const std::vector<uint8_t>& k, int32_t r){
+            if (!first && k == prev) {
+                err = "duplicate key in records " + std::to_string(prevRec) + " and " + std::to_string(r);
+                return false;
+            }
+            first = false;
+            prev = k;
+            prevRec = r;
+            return true;
+        });
+        if (!err.empty()) return false;
+    }
+
+    if (it != _tags.end()) *it = std::move(t);
+    else _tags.push_back(std::move(t));
+    return true;
+#else
+    (void)tag; (void)keyExpr; (void)include; (void)forExpr; (void)filter; (void)opts;
+    err = "index support not compiled in";
+    return false;
+#endif
+}
+
+void DbArea::fillTag(IndexTag& t, bool create, const TagOptions& opts) {
+#if DOTTALK_WITH_INDEX
+    const int32_t keep = _crn;
+    const KeyExpr& key = *t.key;
+    using ScanResult = std::optional<std::pair<std::vector<uint8_t>, bool>>;
+    std::function<ScanResult(int32_t)> scanner;
+    std::vector<char> buf(static_cast<size_t>(_hdr.cpr));
+    if (!t.filter && t.include.empty()) {
+        // Key only: one sequential pass over the raw records, nothing decoded.
+        _fp.clear();
+        _fp.seekg(_hdr.data_start, std::ios::beg);
+        scanner = [&](int32_t r) -> ScanResult {
+            if (r > _hdr.num_of_recs || !_fp.read(buf.data(), static_cast<std::streamsize>(buf.size())))
+                return std::nullopt;
+            if (buf[0] == IS_DELETED) return std::make_pair(std::vector<uint8_t>{}, true);
+            return std::make_pair(key.eval(buf.data()), false);
+        };
+    } else {
+        scanner = [&](int32_t r) -> ScanResult {
+            if (r > _hdr.num_of_recs) return std::nullopt;
+            if (!gotoRec(r) || _del == IS_DELETED) return std::make_pair(std::vector<uint8_t>{}, true);
+            if (t.filter && !t.filter(*this))       return std::make_pair(std::vector<uint8_t>{}, true);
+            return std::make_pair(key.eval(_recbuf.data()), false);
+        };
+    }
+    std::function<std::vector<uint8_t>(int32_t)> payloadOf;
+    if (!t.include.empty()) payloadOf = [&](int32_t){ return payloadFrom(_fd, t); }; // scanner left us on the record
+
+    auto restore = [&]{ _fp.clear(); if (keep > 0) gotoRec(keep); };
+    try {
+        if (create) t.mgr->create(_db_name, key_desc(_db_name, _fields, t, opts), scanner, payloadOf);
+        else        t.mgr->rebuild(scanner, _hdr.num_of_recs, payloadOf);
+    } catch (...) {
+        restore();
+        throw;
+    }
+    restore();
+#else
+    (void)t; (void)create; (void)opts;
+#endif
+}
+
+bool DbArea::reindex(std::string& err) {
+#if DOTTALK_WITH_INDEX
+    if (!isOpen()) { err = "no table open"; return false; }
+    if (_readOnly) { err = "table is open NOUPDATE"; return false; }
+    for (auto& t : _tags) {
+        if (!t.mgr || !t.key) continue;
+        try {
+            fillTag(t, /*create=*/false, TagOptions{}); // rebuild keeps the tag's KeyDesc
+        } catch (const std::exception& e) {
+            err = t.name + ": " + e.what();
+            return false;
+        }
+    }
+    return true;
+#else
+    err = "index support not compiled in";
+    return false;
+#endif
+}
+
+const DbArea::IndexTag* DbArea::indexTag(const std::string& tag) const {
+    for (const auto& t : _tags)
+        if (t.name.size() == tag.size() &&
+            std::equal(t.name.begin(), t.name.end(), tag.begin(),
+                       [](char a, char b){ return a == std::toupper(static_cast<unsigned char>(b)); }))
+            return &t;
+    return nullptr;
+}
+
+std::vector<uint8_t> DbArea::tagKey(const IndexTag& t, const std::string& value) const {
+#if DOTTALK_WITH_INDEX
+    // Bare-field keys are the value upper-cased and padded to the field width.
+    if (t.field < 1 || t.field > static_cast<int>(_fields.size())) return {};
+    return xindex::codec::encodeChar(value, _fields[static_cast<size_t>(t.field - 1)].length, /*upper=*/true);
+#else
+    (void)t; (void)value;
+    return {};
+#endif
+}
+
+// Covering payload: the INCLUDE fields back to back, each space-padded to its
+// field width, i.e. exactly the bytes the record holds for them.
+std::vector<uint8_t> DbArea::payloadFrom(const std::vector<std::string>& vals, const IndexTag& t) const {
+    std::vector<uint8_t> out;
+    for (int f : t.include) {
+        const size_t w = _fields[static_cast<size_t>(f - 1)].length;
+        const std::string& v = static_cast<size_t>(f) < vals.size() ? vals[static_cast<size_t>(f)] : std::string{};
+        const size_t n = std::min(v.size(), w);
+        out.insert(out.end(), v.begin(), v.begin() + static_cast<std::ptrdiff_t>(n));
+        out.insert(out.end(), w - n, static_cast<uint8_t>(' '));
+    }
+    return out;
+}
+
+std::vector<std::string> DbArea::tagPayload(const IndexTag& t, const std::vector<uint8_t>& payload) const {
+    std::vector<std::string> out;
+    out.reserve(t.include.size());
+    size_t off = 0;
+    for (int f : t.include) {
+        const size_t w = _fields[static_cast<size_t>(f - 1)].length;
+        if (off + w > payload.size()) { out.emplace_back(); continue; }
+        out.push_back(rtrim(std::string(payload.begin() + static_cast<std::ptrdiff_t>(off),
+                                        payload.begin() + static_cast<std::ptrdiff_t>(off + w))));
+        off += w;
+    }
+    return out;
+}
+
+void DbArea::uniqueKeys(const Row& row, const std::function<void(size_t, std::vector<uint8_t>)>& fn) {
+#if DOTTALK_WITH_INDEX
+    // Every write comes through here; without a UNIQUE tag it costs nothing.
+    if (std::none_of(_tags.begin(), _tags.end(), [](const IndexTag& t){ return t.unique; })) return;
+    // Lay the row out as the record image FOR filters read.
+    Row keepFd = std::move(_fd);
+    std::vector<char> keepBuf = _recbuf;
+    const char keepDel = _del;
+    auto restore = [&]{ _fd = std::move(keepFd); _recbuf = std::move(keepBuf); _del = keepDel; };
+    _fd = row;
+    _fd.resize(_fields.size() + 1);
+    _del = NOT_DELETED;
+    storeFieldsToBuffer();
+    try {
+        for (size_t i = 0; i < _tags.size(); ++i) {
+            const IndexTag& t = _tags[i];
+            if (t.unique && t.mgr && t.key && tagAccepts(t, /*snapshot=*/false))
+                fn(i, t.key->eval(_recbuf.data()));
+        }
+    } catch (...) {
+        restore();
+        throw;
+    }
+    restore();
+#else
+    (void)row; (void)fn;
+#endif
+}
+
+std::string DbArea::uniqueConflict(const Row& row, int32_t recno) {
+    std::string hit;
+    uniqueKeys(row, [&](size_t i, std::vector<uint8_t> key){
+        if (hit.empty() && _tags[i].mgr->containsOther(key, recno)) hit = _tags[i].name;
+    });
+    return hit;
+}
+
+std::vector<size_t> DbArea::uniqueConflicts(const std::vector<Row>& rows, std::vector<std::string>* tags) {
+    std::vector<size_t> out;
+    if (tags) tags->clear();
+    if (std::none_of(_tags.begin(), _tags.end(), [](const IndexTag& t){ return t.unique; })) return out;
+
+    struct Probe {
+        std::vector<uint8_t> key;
+        size_t row;
+    };
+    std::vector<std::vector<Probe>> perTag(_tags.size());
+    for (size_t r = 0; r < rows.size(); ++r)
+        uniqueKeys(rows[r], [&](size_t i, std::vector<uint8_t> key){ perTag[i].push_back(Probe{std::move(key), r}); });
+
+    // Per tag, equal keys form one group; each group is probed against the
+    // table once, in key order.
+    struct Ref {
+        size_t tag, group;
+    };
+    std::vector<std::vector<Ref>> refs(rows.size()); // row -> its groups, in tag order
+    std::vector<std::vector<char>> inTable(_tags.size());
+    for (size_t i = 0; i < perTag.size(); ++i) {
+        auto& probes = perTag[i];
+        std::stable_sort(probes.begin(), probes.end(),
+                         [](const Probe& a, const Probe& b){ return a.key < b.key; });
+        for (size_t j = 0; j < probes.size(); ++j) {
+            if (j == 0 || probes[j].key != probes[j - 1].key)
+                inTable[i].push_back(_tags[i].mgr->containsOther(probes[j].key, 0));
+            refs[probes[j].row].push_back(Ref{i, inTable[i].size() - 1});
+        }
+    }
+
+    // Rows in order: a key is taken once a row that is going to be appended
+    // holds it, so a row turned away by one tag reserves nothing in the
+    // others. Row -> first tag it breaks.
+    std::vector<std::vector<char>> taken(_tags.size());
+    for (size_t i = 0; i < taken.size(); ++i) taken[i].assign(inTable[i].size(), 0);
+    std::vector<const std::string*> bad(rows.size(), nullptr);
+    for (size_t r = 0; r < rows.size(); ++r) {
+        for (const Ref& x : refs[r]) {
+            if (inTable[x.tag][x.group] || taken[x.tag][x.group]) { bad[r] = &_tags[x.tag].name; break; }
+        }
+        if (!bad[r])
+            for (const Ref& x : refs[r]) taken[x.tag][x.group] = 1;
+    }
+    for (size_t r = 0; r < rows.size(); ++r) {
+        if (!bad[r]) continue;
+        out.push_back(r);
+        if (tags) tags->push_back(*bad[r]);
+    }
+    return out;
+}
+
+bool DbArea::appendRecords(const std::vector<Row>& rows) {
+    if (_readOnly || !isOpen()) return false;
+    if (rows.empty()) return true;
+    _fp.clear();
+    // Over the 0x1A end-of-file marker, if the file has one.
+    _fp.seekp(static_cast<std::streamoff>(_hdr.data_start) + static_cast<std::streamoff>(_hdr.num_of_recs) * _hdr.cpr, std::ios::beg);
+    for (const auto& row : rows) {
+        _fd = row;
+        _fd.resize(_fields.size() + 1);
+        _del = NOT_DELETED;
+        storeFieldsToBuffer();
+        _fp.write(_recbuf.data(), static_cast<std::streamsize>(_recbuf.size()));
+        if (!_fp) return false;
+        _crn = ++_hdr.num_of_recs;
+#if DOTTALK_WITH_INDEX
+        syncIndexes(/*fresh=*/true);
+#endif
+    }
+    _fp.put('\x1A');
+    _fp.seekp(0, std::ios::beg);
+    _fp.write(reinterpret_cast<const char*>(&_hdr), sizeof(HeaderRec));
+    _fp.flush();
+    return static_cast<bool>(_fp) && gotoRec(_hdr.num_of_recs);
+}
+
+bool DbArea::refreshCurrent() {
+    if (_crn == 0) return false;
+    // readCurrent() re-snapshots; keep the pre-write image so the diff is
+    // computed against what the indexes currently hold.
+    auto oldFd  = _fd_snapshot;
+    auto oldBuf = _recbuf_snapshot;
+    char oldDel = _del_snapshot;
+    if (!readCurrent()) return false;
+#if DOTTALK_WITH_INDEX
+    _fd_snapshot  = std::move(oldFd);
+    _recbuf_snapshot = std::move(oldBuf);
+    _del_snapshot = oldDel;
+    syncIndexes(/*fresh=*/false);
+#else
+    (void)oldDel; (void)oldBuf;
+#endif
+    return true;
+}
+
+} // namespace xbase
@@ -3,17 +3,11 @@
 #include <algorithm>
 #include <cctype>
 #include <cstring>
+#include <filesystem>
 #include <vector>
 #include <fstream>
+#include <sstream>
 
-#if DOTTALK_WITH_INDEX
-  // xindex scaffold headers (include only in .cpp)
-  #include "xindex/index_manager.hpp"
-  #include "xindex/index_backend.hpp"
-  #include "xindex/key_codec.hpp"
-  // Use explicit path so it doesn't depend on include_directories order:
-  #include "xindex_scaffold/backends/bpt_backend.hpp"
-#endif
 
 namespace xbase {
 
@@ -38,15 +32,34 @@ std::string dbNameWithExt(std::string s) {
     return s;
 }
 
+std::string tableStamp(const std::string& dbfPath) {
+    std::ifstream in(dbfPath, std::ios::binary);
+    HeaderRec h{};
+    if (!in.read(reinterpret_cast<char*>(&h), sizeof(HeaderRec))) return {};
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(dbfPath, ec);
+    const auto time = std::filesystem::last_write_time(dbfPath, ec);
+    if (ec) return {};
+    std::ostringstream out;
+    out << "recs " << h.num_of_recs << " updated "
+        << int(h.last_updated[0]) << '-' << int(h.last_updated[1]) << '-' << int(h.last_updated[2])
+        << " size " << size << " time " << time.time_since_epoch().count();
+    return out.str();
+}
+
 // ---- DbArea: file/open/structure/navigation ----
 DbArea::DbArea() {}
-DbArea::~DbArea() { close(); }
+DbArea::~DbArea() {
+    try { close(); } catch (const std::exception&) {}
+}
 
-void DbArea::open(const std::string& filename) {
+void DbArea::open(const std::string& filename, bool readOnly) {
     close();
     _db_name = filename;
-    _fp.open(_db_name, std::ios::in | std::ios::out | std::ios::binary);
-    if (!_fp) {
+    _readOnly = readOnly;
+    if (readOnly) _fp.open(_db_name, std::ios::in | std::ios::binary);
+    else          _fp.open(_db_name, std::ios::in | std::ios::out | std::ios::binary);
+    if (!_fp && !readOnly) {
         _fp.clear();
         _fp.open(_db_name, std::ios::out | std::ios::binary);
         _fp.close();
@@ -59,32 +72,32 @@ void DbArea::open(const std::string& filename) {
     _recbuf.assign(_hdr.cpr, ' ');
     _fd.assign(_fields.size()+1, std::string{}); // 1-based
     gotoRec(1);
-
-#if DOTTALK_WITH_INDEX
-    // Initialize an in-memory index tag for staging
-    if (!_idx) {
-        _idx = std::make_unique<xindex::IndexManager>();
-        auto be = std::make_unique<xindex::BptBackend>(); // in-memory demo backend
-        _idx->addTag("TAG1", "<memory>", std::move(be));
-        _idx->setActive("TAG1");
-    }
-#endif
 }
 
 void DbArea::close() {
+    // Table writes first: the tags store the file's stamp as it ends up.
+    if (_fp.is_open()) _fp.flush();
+    std::string failed;
 #if DOTTALK_WITH_INDEX
-    _idx.reset();
-#endif
-    if (_fp.is_open()) {
-        _fp.flush();
-        _fp.close();
+    for (auto& t : _tags) {
+        if (!t.mgr) continue;
+        try {
+            t.mgr->close();
+        } catch (const std::exception& e) {
+            failed += (failed.empty() ? "" : "; ") + t.name + ": " + e.what();
+        }
     }
+    _tags.clear();
+    _bitmaps.clear();
+#endif
+    if (_fp.is_open()) _fp.close();
     _fields.clear();
     _rawFields.clear();
     _recbuf.clear();
     _fd.clear();
     _fd_snapshot.clear();
     _crn = 0;
+    if (!failed.empty()) throw std::runtime_error("index not saved: " + failed);
 }
 
 void DbArea::readHeader() {
@@ -110,6 +123,7 @@ void DbArea::readFields() {
         const char* nm = _rawFields[i].field_name;
         std::string name(nm, nm + 11);
         name.erase(std::find(name.begin(), name.end(), '\0'), name.end());
+        while (!name.empty() && name.back() == ' ') name.pop_back(); // some writers space-pad
         f.name = name;
         f.type = _rawFields[i].field_type;
         f.length = _rawFields[i].field_length;
@@ -137,10 +151,13 @@ bool DbArea::skip(int delta) {
 }
 
 bool DbArea::appendBlank() {
+    if (_readOnly) return false;
+    if (!uniqueConflict(Row(_fields.size() + 1), 0).empty()) return false;
     std::vector<char> blank(_hdr.cpr, ' ');
     blank[0] = NOT_DELETED;
-    _fp.seekp(0, std::ios::end);
+    _fp.seekp(static_cast<std::streamoff>(_hdr.data_start) + static_cast<std::streamoff>(_hdr.num_of_recs) * _hdr.cpr, std::ios::beg);
     _fp.write(blank.data(), blank.size());
+    _fp.put('\x1A');
     if (!_fp) return false;
 
     _hdr.num_of_recs++;
@@ -150,10 +167,7 @@ bool DbArea::appendBlank() {
 
     bool ok = gotoRec(_hdr.num_of_recs);
 #if DOTTALK_WITH_INDEX
-    if (ok && _idx) {
-        _fd_snapshot = _fd;
-        _idx->insert(currentKey(), _hdr.num_of_recs);
-    }
+    if (ok) syncIndexes(/*fresh=*/true);
 #endif
     return ok;
 }
@@ -161,29 +175,20 @@ bool DbArea::appendBlank() {
 bool DbArea::deleteCurrent() {
     if (_crn == 0) return false;
     _del = IS_DELETED;
-    bool ok = writeCurrent();
-#if DOTTALK_WITH_INDEX
-    if (ok && _idx) {
-        _idx->erase(snapshotKey(), _crn);
-    }
-#endif
-    return ok;
+    return writeCurrent(); // index maintenance drops the record there
 }
 
 XBaseEngine::XBaseEngine() {
     for (auto& p : _areas) p = std::make_unique<DbArea>();
 }
 
-#if DOTTALK_WITH_INDEX
-void DbArea::rebuildActiveIndex() {
-    if (!_idx) return;
-    int32_t saved = recno();
-    if (!top()) return;
-    do {
-        _idx->insert(currentKey(), recno());
-    } while (skip(1));
-    if (saved > 0) gotoRec(saved);
+int XBaseEngine::areaOf(const std::string& dbfPath) const {
+    for (int i = 0; i < MAX_AREA; ++i) {
+        std::error_code ec;
+        if (_areas[i]->isOpen() && std::filesystem::equivalent(dbNameWithExt(_areas[i]->name()), dbfPath, ec))
+            return i;
+    }
+    return -1;
 }
-#endif
 
 } // namespace xbase
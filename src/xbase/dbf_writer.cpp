@@ -0,0 +1,73 @@
+#include "xbase/dbf_writer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+namespace xbase {
+
+namespace {
+
+void stamp(HeaderRec& h) {
+    std::time_t now = std::time(nullptr);
+    std::tm tm{};
+#ifdef _WIN32
+    localtime_s(&tm, &now);
+#else
+    tm = *std::localtime(&now);
+#endif
+    h.last_updated[0] = static_cast<uint8_t>(tm.tm_year % 100);
+    h.last_updated[1] = static_cast<uint8_t>(tm.tm_mon + 1);
+    h.last_updated[2] = static_cast<uint8_t>(tm.tm_mday);
+}
+
+} // namespace
+
+DbfWriter::DbfWriter(const std::string& path, const std::vector<FieldDef>& fields) {
+    _out.open(path, std::ios::binary | std::ios::trunc);
+    if (!_out) throw std::runtime_error("Cannot create file: " + path);
+
+    HeaderRec h{};
+    h.version = 0x03;
+    stamp(h);
+    h.data_start = static_cast<int16_t>(sizeof(HeaderRec) + fields.size() * sizeof(FieldRec) + 1);
+    for (const auto& f : fields) _cpr += f.length;
+    h.cpr = static_cast<int16_t>(_cpr);
+    _out.write(reinterpret_cast<const char*>(&h), sizeof h);
+
+    for (const auto& f : fields) {
+        FieldRec r{};
+        std::memcpy(r.field_name, f.name.data(), std::min<size_t>(f.name.size(), sizeof r.field_name - 1));
+        r.field_type = f.type;
+        r.field_length = f.length;
+        r.decimal_places = f.decimals;
+        _out.write(reinterpret_cast<const char*>(&r), sizeof r);
+    }
+    _out.put(static_cast<char>(HEADER_TERM_BYTE));
+    if (!_out) throw std::runtime_error("Cannot write header: " + path);
+}
+
+DbfWriter::~DbfWriter() { close(); }
+
+bool DbfWriter::append(const char* rec) {
+    _out.write(rec, _cpr);
+    if (!_out) return false;
+    ++_count;
+    return true;
+}
+
+bool DbfWriter::close() {
+    if (_closed) return static_cast<bool>(_out);
+    _closed = true;
+    _out.put('\x1A');
+    // Record count at offset 4, after version and date.
+    _out.seekp(4, std::ios::beg);
+    _out.write(reinterpret_cast<const char*>(&_count), sizeof _count);
+    _out.flush();
+    const bool ok = static_cast<bool>(_out);
+    _out.close();
+    return ok;
+}
+
+} // namespace xbase
@@ -0,0 +1,278 @@
+#include "xbase/key_expr.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+namespace xbase {
+
+namespace {
+
+struct Tok {
+    enum Kind { Ident, Number, String, LParen, RParen, Comma, Plus, End } kind{End};
+    std::string text;
+};
+
+bool lex(const std::string& s, std::vector<Tok>& out, std::string& err) {
+    size_t i = 0;
+    while (i < s.size()) {
+        const unsigned char c = static_cast<unsigned char>(s[i]);
+        if (std::isspace(c)) { ++i; continue; }
+        switch (c) {
+        case '(': out.push_back({Tok::LParen, "("}); ++i; continue;
+        case ')': out.push_back({Tok::RParen, ")"}); ++i; continue;
+        case ',': out.push_back({Tok::Comma, ","}); ++i; continue;
+        case '+': out.push_back({Tok::Plus, "+"}); ++i; continue;
+        default: break;
+        }
+        if (c == '"' || c == '\'') {
+            const size_t close = s.find(static_cast<char>(c), i + 1);
+            if (close == std::string::npos) { err = "unterminated string"; return false; }
+            out.push_back({Tok::String, s.substr(i + 1, close - i - 1)});
+            i = close + 1;
+            continue;
+        }
+        size_t j = i;
+        if (std::isdigit(c)) {
+            while (j < s.size() && std::isdigit(static_cast<unsigned char>(s[j]))) ++j;
+            out.push_back({Tok::Number, s.substr(i, j - i)});
+        } else if (std::isalpha(c) || c == '_') {
+            while (j < s.size() && (std::isalnum(static_cast<unsigned char>(s[j])) || s[j] == '_')) ++j;
+            out.push_back({Tok::Ident, s.substr(i, j - i)});
+        } else {
+            err = std::string("unexpected '") + static_cast<char>(c) + "'";
+            return false;
+        }
+        i = j;
+    }
+    out.push_back({Tok::End, {}});
+    return true;
+}
+
+bool ieq(const std::string& a, const char* b) {
+    size_t i = 0;
+    for (; i < a.size() && b[i]; ++i)
+        if (std::toupper(static_cast<unsigned char>(a[i])) != b[i]) return false;
+    return i == a.size() && !b[i];
+}
+
+} // namespace
+
+// Recursive descent straight to postfix; each parse returns the width of
+// the value it leaves on the evaluation stack.
+class KeyExprCompiler {
+public:
+    KeyExprCompiler(std::vector<Tok> toks, const std::vector<FieldDef>& fields, KeyExpr& out)
+        : t_(std::move(toks)), fields_(fields), out_(out) {}
+
+    bool run(std::string& err) {
+        size_t w = 0;
+        if (!expr(w)) { err = err_; return false; }
+        if (peek().kind != Tok::End) { err = "unexpected '" + peek().text + "'"; return false; }
+        if (w == 0) { err = "empty key"; return false; }
+        out_.width_ = w;
+        return true;
+    }
+
+    int lastField() const { return lastField_; }
+
+private:
+    std::vector<Tok> t_;
+    size_t p_{0};
+    const std::vector<FieldDef>& fields_;
+    KeyExpr& out_;
+    std::string err_;
+    int lastField_{0};
+
+    const Tok& peek() const { return t_[p_]; }
+    const Tok& take() { return t_[p_ < t_.size() - 1 ? p_++ : p_]; }
+    bool fail(const std::string& m) { if (err_.empty()) err_ = m; return false; }
+    bool expect(Tok::Kind k, const char* what) {
+        if (peek().kind != k) return fail(std::string("expected ") + what);
+        take();
+        return true;
+    }
+    void emit(KeyExpr::Op op, uint32_t a = 0, uint32_t b = 0) { out_.prog_.push_back({op, a, b}); }
+
+    bool number(uint32_t& n) {
+        if (peek().kind != Tok::Number) return fail("expected a number");
+        n = static_cast<uint32_t>(std::strtoul(take().text.c_str(), nullptr, 10));
+        return true;
+    }
+
+    // Field by name; emits its Load and reports index/type/width.
+    bool field(int& idx, size_t& w) {
+        if (peek().kind != Tok::Ident) return fail("expected field name");
+        const std::string name = take().text;
+        uint32_t off = 1; // delete flag
+        for (size_t i = 0; i < fields_.size(); ++i) {
+            if (upper(fields_[i].name) == upper(name)) {
+                idx = lastField_ = static_cast<int>(i + 1);
+                w = fields_[i].length;
+                emit(KeyExpr::Op::Load, off, static_cast<uint32_t>(w));
+                return true;
+            }
+            off += fields_[i].length;
+        }
+        return fail("unknown field: " + name);
+    }
+
+    static std::string upper(std::string s) {
+        for (auto& c : s) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        return s;
+    }
+
+    bool expr(size_t& w) {
+        if (!term(w)) return false;
+        while (peek().kind == Tok::Plus) {
+            take();
+            size_t rw = 0;
+            if (!term(rw)) return false;
+            emit(KeyExpr::Op::Concat);
+            w += rw;
+        }
+        return true;
+    }
+
+    bool term(size_t& w) {
+        if (peek().kind == Tok::String) {
+            out_.lits_.push_back(take().text);
+            emit(KeyExpr::Op::Lit, static_cast<uint32_t>(out_.lits_.size() - 1));
+            w = out_.lits_.back().size();
+            return true;
+        }
+        if (peek().kind != Tok::Ident) return fail("expected field, string or function");
+        if (t_[p_ + 1].kind != Tok::LParen) {
+            int idx = 0;
+            return field(idx, w);
+        }
+
+        const std::string fn = take().text;
+        take(); // (
+        if (ieq(fn, "UPPER")) {
+            if (!expr(w)) return false;
+            emit(KeyExpr::Op::Upper);
+        } else if (ieq(fn, "SUBSTR")) {
+            size_t inner = 0;
+            uint32_t start = 0, len = 0;
+            if (!expr(inner) || !expect(Tok::Comma, "','") || !number(start)) return false;
+            if (start < 1 || start > inner) return fail("SUBSTR start out of range");
+            len = static_cast<uint32_t>(inner - start + 1);
+            if (peek().kind == Tok::Comma) {
+                take();
+                uint32_t n = 0;
+                if (!number(n)) return false;
+                if (n == 0) return fail("SUBSTR length must be positive");
+                len = std::min(len, n);
+            }
+            emit(KeyExpr::Op::Substr, start - 1, len);
+            w = len;
+        } else if (ieq(fn, "DTOS")) {
+            int idx = 0;
+            if (!field(idx, w)) return false;
+            if (fields_[static_cast<size_t>(idx - 1)].type != 'D') return fail("DTOS needs a date field");
+            // Dates are stored as YYYYMMDD already.
+        } else if (ieq(fn, "STR")) {
+            int idx = 0;
+            size_t fw = 0;
+            uint32_t len = 10, dec = 0;
+            if (!field(idx, fw)) return false;
+            const char ty = fields_[static_cast<size_t>(idx - 1)].type;
+            if (ty != 'N' && ty != 'F') return fail("STR needs a numeric field");
+            if (peek().kind == Tok::Comma) {
+                take();
+                if (!number(len)) return false;
+                if (peek().kind == Tok::Comma) { take(); if (!number(dec)) return false; }
+            }
+            if (len == 0 || len > 64 || dec >= len) return fail("bad STR width");
+            emit(KeyExpr::Op::Str, len, dec);
+            w = len;
+        } else {
+            return fail("unknown function " + fn + "()");
+        }
+        return expect(Tok::RParen, "')'");
+    }
+};
+
+std::unique_ptr<KeyExpr> KeyExpr::compile(const std::string& text,
+                                          const std::vector<FieldDef>& fields,
+                                          std::string& err) {
+    err.clear();
+    std::vector<Tok> toks;
+    if (!lex(text, toks, err)) return nullptr;
+
+    auto k = std::make_unique<KeyExpr>();
+    k->text_ = text;
+    const bool bare = toks.size() == 2 && toks[0].kind == Tok::Ident;
+    KeyExprCompiler c(std::move(toks), fields, *k);
+    if (!c.run(err)) return nullptr;
+
+    // Bare field: classic case-insensitive tag key.
+    if (bare) {
+        k->field_ = c.lastField();
+        k->prog_.push_back({Op::Upper, 0, 0});
+    }
+    return k;
+}
+
+std::vector<uint8_t> KeyExpr::eval(const char* rec) const {
+    std::vector<std::string> st;
+    st.reserve(4);
+    for (const Ins& in : prog_) {
+        switch (in.op) {
+        case Op::Load:
+            st.emplace_back(rec + in.a, in.b);
+            break;
+        case Op::Lit:
+            st.push_back(lits_[in.a]);
+            break;
+        case Op::Upper:
+            for (auto& c : st.back()) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+            break;
+        case Op::Substr:
+            st.back() = st.back().substr(in.a, in.b);
+            break;
+        case Op::Str: {
+            char buf[80];
+            const int n = std::snprintf(buf, sizeof buf, "%*.*f", static_cast<int>(in.a), static_cast<int>(in.b),
+                                        std::strtod(st.back().c_str(), nullptr));
+            st.back() = (n > 0 && static_cast<uint32_t>(n) <= in.a) ? std::string(buf, static_cast<size_t>(n))
+                                                                    : std::string(in.a, '*');
+            break;
+        }
+        case Op::Concat: {
+            std::string r = std::move(st.back());
+            st.pop_back();
+            st.back() += r;
+            break;
+        }
+        }
+    }
+    return std::vector<uint8_t>(st.back().begin(), st.back().end());
+}
+
+std::string KeyExpr::fold(std::string value) const {
+    // Run the program over case masks instead of bytes: 1 = upper-cased.
+    std::vector<std::string> st;
+    for (const Ins& in : prog_) {
+        switch (in.op) {
+        case Op::Load:   st.emplace_back(in.b, '\0'); break;
+        case Op::Lit:    st.emplace_back(lits_[in.a].size(), '\0'); break;
+        case Op::Upper:  std::fill(st.back().begin(), st.back().end(), '\1'); break;
+        case Op::Substr: st.back() = st.back().substr(in.a, in.b); break;
+        case Op::Str:    st.back().assign(in.a, '\0'); break;
+        case Op::Concat: {
+            std::string r = std::move(st.back());
+            st.pop_back();
+            st.back() += r;
+            break;
+        }
+        }
+    }
+    for (size_t i = 0; i < value.size() && i < st.back().size(); ++i)
+        if (st.back()[i]) value[i] = static_cast<char>(std::toupper(static_cast<unsigned char>(value[i])));
+    return value;
+}
+
+} // namespace xbase
@@ -27,7 +27,8 @@ bool DbArea::isDeleted() const {
 }
 
 bool DbArea::writeCurrent() {
-    if (_crn == 0) return false;
+    if (_crn == 0 || _readOnly) return false;
+    if (_del != IS_DELETED && !uniqueConflict(_fd, _crn).empty()) return false;
     storeFieldsToBuffer();
     std::streampos pos = _hdr.data_start + static_cast<std::streamoff>((_crn-1) * _hdr.cpr);
     _fp.seekp(pos, std::ios::beg);
@@ -35,14 +36,7 @@ bool DbArea::writeCurrent() {
     _fp.flush();
     bool ok = static_cast<bool>(_fp);
 #if DOTTALK_WITH_INDEX
-    if (ok && _idx) {
-        auto oldK = snapshotKey();
-        auto newK = currentKey();
-        if (oldK != newK) {
-            _idx->update(oldK, newK, _crn);
-        }
-        _fd_snapshot = _fd;
-    }
+    if (ok) syncIndexes(/*fresh=*/false);
 #endif
     return ok;
 }
@@ -58,6 +52,46 @@ bool DbArea::set(int idx, const std::string& val) {
     return true;
 }
 
+size_t DbArea::fieldOffset(int idx) const {
+    if (idx < 1 || idx > static_cast<int>(_fields.size())) return 0;
+    size_t off = 1;
+    for (int i = 1; i < idx; ++i) off += _fields[static_cast<size_t>(i - 1)].length;
+    return off;
+}
+
+int32_t DbArea::readRecords(int32_t first, int32_t count, char* out) {
+    if (first < 1 || count <= 0 || first > _hdr.num_of_recs || _hdr.cpr <= 0) return 0;
+    count = std::min(count, _hdr.num_of_recs - first + 1);
+    const std::streamoff pos = static_cast<std::streamoff>(_hdr.data_start)
+                             + static_cast<std::streamoff>(first - 1) * _hdr.cpr;
+    _fp.clear();
+    _fp.seekg(pos, std::ios::beg);
+    _fp.read(out, static_cast<std::streamsize>(count) * _hdr.cpr);
+    const auto got = static_cast<int32_t>(_fp.gcount() / _hdr.cpr);
+    if (!_fp) _fp.clear(); // short read at the end of a damaged file
+    return got;
+}
+
+std::unique_ptr<DbArea::RecordMap> DbArea::mapRecords() const {
+    if (!_fp.is_open() || _hdr.cpr <= 0) return nullptr;
+    auto m = std::make_unique<RecordMap>();
+    try {
+        m->file_.open(_db_name);
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+    const auto* data = reinterpret_cast<const char*>(m->file_.data());
+    const size_t size = m->file_.size();
+    const size_t start = static_cast<size_t>(_hdr.data_start);
+    if (size < start) return nullptr;
+    m->base_ = data + start;
+    m->end_ = data + size;
+    m->cpr_ = static_cast<size_t>(_hdr.cpr);
+    m->count_ = static_cast<int32_t>(std::min<size_t>(static_cast<size_t>(_hdr.num_of_recs),
+                                                      (size - start) / m->cpr_));
+    return m;
+}
+
 bool DbArea::loadFieldsFromBuffer() {
     _fd.assign(_fields.size()+1, std::string{});
     size_t off = 1; // first byte is deleted flag
@@ -70,6 +104,8 @@ bool DbArea::loadFieldsFromBuffer() {
     }
 #if DOTTALK_WITH_INDEX
     _fd_snapshot = _fd; // snapshot post-read
+    _recbuf_snapshot = _recbuf;
+    _del_snapshot = _del;
 #endif
     return true;
 }
@@ -82,7 +118,15 @@ void DbArea::storeFieldsToBuffer() {
         const auto& f = _fields[i];
         std::string v = _fd[i+1];
         if (v.size() > f.length) v.resize(f.length);
-        std::memcpy(_recbuf.data()+off, v.data(), v.size());
+        size_t at = 0;
+        if (f.type == 'N' || f.type == 'F') {
+            // Numbers are right-justified on disk; values typed or imported
+            // as "42" would otherwise sort and key differently from "    42".
+            v = rtrim(v);
+            v.erase(0, std::min(v.size(), v.find_first_not_of(' ')));
+            at = f.length - v.size();
+        }
+        std::memcpy(_recbuf.data()+off+at, v.data(), v.size());
         off += f.length;
     }
 }
@@ -108,21 +152,4 @@ int DbArea::firstCharField() const {
     return 0;
 }
 
-std::vector<uint8_t> DbArea::encodeKeyFrom(const std::vector<std::string>& vals) const {
-#if DOTTALK_WITH_INDEX
-    // Stage 1: single CHAR field key (case-insensitive, trimmed)
-    int idx = firstCharField();
-    if (idx <= 0) return {};
-    size_t n = static_cast<size_t>(idx - 1);
-    if (n >= vals.size()) return {};
-    xindex::KeyOptions opt;
-    opt.case_insensitive = true;
-    opt.trim_right_spaces = true;
-    return xindex::KeyCodec::encodeChar(vals[n], opt);
-#else
-    (void)vals;
-    return {};
-#endif
-}
-
 } // namespace xbase
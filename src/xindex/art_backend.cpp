@@ -0,0 +1,628 @@
+#include "xindex/art_backend.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define XINDEX_ART_SSE2 1
+#endif
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+
+namespace xindex {
+
+// -------- node layout ----------------------------------------------------------
+
+struct ArtBackend::Node {
+    std::uint8_t type;
+    explicit Node(std::uint8_t t) : type(t) {}
+};
+
+namespace {
+
+using Node = ArtBackend::Node;
+
+// Prefix bytes stored inline per inner node. Longer compressed paths keep only
+// the first kMaxPrefix bytes; the rest is recovered from any leaf below
+// (every leaf under a node carries the whole path in its key).
+constexpr std::uint32_t kMaxPrefix = 10;
+
+enum : std::uint8_t { kLeaf, kNode4, kNode16, kNode48, kNode256 };
+
+struct Leaf : Node {
+    Key key;
+    std::vector<RecNo> recs; // sorted, no duplicates
+    Leaf(const Key& k, RecNo r) : Node(kLeaf), key(k), recs{r} {}
+};
+
+struct Inner : Node {
+    std::uint32_t prefixLen{0};
+    std::uint8_t  prefix[kMaxPrefix]{};
+    std::uint16_t count{0};
+    Leaf*         term{nullptr}; // key that ends right after this node's prefix
+    explicit Inner(std::uint8_t t) : Node(t) {}
+};
+
+struct Node4   : Inner { std::uint8_t keys[4]{};  Node* child[4]{};  Node4()   : Inner(kNode4)   {} };
+struct Node16  : Inner { std::uint8_t keys[16]{}; Node* child[16]{}; Node16()  : Inner(kNode16)  {} };
+struct Node48  : Inner { std::uint8_t index[256]{}; Node* child[48]{}; Node48() : Inner(kNode48) {} }; // index = slot+1, 0 = empty
+struct Node256 : Inner { Node* child[256]{}; Node256() : Inner(kNode256) {} };
+
+inline bool isLeaf(const Node* n) { return n->type == kLeaf; }
+
+inline int lowestBit(unsigned v) {
+#if defined(_MSC_VER)
+    unsigned long i; _BitScanForward(&i, v); return static_cast<int>(i);
+#else
+    return __builtin_ctz(v);
+#endif
+}
+
+// -------- node helpers -----------------------------------------------------------
+
+void freeInner(Inner* n) {
+    switch (n->type) {
+        case kNode4:   delete static_cast<Node4*>(n);   break;
+        case kNode16:  delete static_cast<Node16*>(n);  break;
+        case kNode48:  delete static_cast<Node48*>(n);  break;
+        case kNode256: delete static_cast<Node256*>(n); break;
+    }
+}
+
+void destroy(Node* n) {
+    if (!n) return;
+    if (isLeaf(n)) { delete static_cast<Leaf*>(n); return; }
+    auto* in = static_cast<Inner*>(n);
+    switch (in->type) {
+        case kNode4:   { auto* x = static_cast<Node4*>(in);   for (int i = 0; i < x->count; ++i) destroy(x->child[i]); break; }
+        case kNode16:  { auto* x = static_cast<Node16*>(in);  for (int i = 0; i < x->count; ++i) destroy(x->child[i]); break; }
+        case kNode48:  { auto* x = static_cast<Node48*>(in);  for (Node* c : x->child) destroy(c); break; }
+        case kNode256: { auto* x = static_cast<Node256*>(in); for (Node* c : x->child) destroy(c); break; }
+    }
+    delete in->term;
+    freeInner(in);
+}
+
+void copyHeader(Inner* dst, const Inner* src) {
+    dst->prefixLen = src->prefixLen;
+    std::memcpy(dst->prefix, src->prefix, kMaxPrefix);
+    dst->count = src->count;
+    dst->term  = src->term;
+}
+
+Node** findChild(Inner* n, std::uint8_t b) {
+    switch (n->type) {
+        case kNode4: {
+            auto* x = static_cast<Node4*>(n);
+            for (int i = 0; i < x->count; ++i) if (x->keys[i] == b) return &x->child[i];
+            return nullptr;
+        }
+        case kNode16: {
+            auto* x = static_cast<Node16*>(n);
+#if XINDEX_ART_SSE2
+            const __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8(static_cast<char>(b)),
+                                               _mm_loadu_si128(reinterpret_cast<const __m128i*>(x->keys)));
+            const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(cmp)) & ((1u << x->count) - 1u);
+            return mask ? &x->child[lowestBit(mask)] : nullptr;
+#else
+            auto* end = x->keys + x->count;
+            auto* it  = std::lower_bound(x->keys, end, b);
+            return (it != end && *it == b) ? &x->child[it - x->keys] : nullptr;
+#endif
+        }
+        case kNode48: {
+            auto* x = static_cast<Node48*>(n);
+            return x->index[b] ? &x->child[x->index[b] - 1] : nullptr;
+        }
+        case kNode256: {
+            auto* x = static_cast<Node256*>(n);
+            return x->child[b] ? &x->child[b] : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+const Node* findChild(const Inner* n, std::uint8_t b) {
+    Node* const* c = findChild(const_cast<Inner*>(n), b);
+    return c ? *c : nullptr;
+}
+
+// First child whose byte is >= from (children are visited in byte order).
+const Node* childFrom(const Inner* n, int from, int& byteOut) {
+    switch (n->type) {
+        case kNode4: {
+            auto* x = static_cast<const Node4*>(n);
+            for (int i = 0; i < x->count; ++i)
+                if (x->keys[i] >= from) { byteOut = x->keys[i]; return x->child[i]; }
+            return nullptr;
+        }
+        case kNode16: {
+            auto* x = static_cast<const Node16*>(n);
+            for (int i = 0; i < x->count; ++i)
+                if (x->keys[i] >= from) { byteOut = x->keys[i]; return x->child[i]; }
+            return nullptr;
+        }
+        case kNode48: {
+            auto* x = static_cast<const Node48*>(n);
+            for (int b = from; b < 256; ++b)
+                if (x->index[b]) { byteOut = b; return x->child[x->index[b] - 1]; }
+            return nullptr;
+        }
+        case kNode256: {
+            auto* x = static_cast<const Node256*>(n);
+            for (int b = from; b < 256; ++b)
+                if (x->child[b]) { byteOut = b; return x->child[b]; }
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+const Leaf* minLeaf(const Node* n) {
+    while (n && !isLeaf(n)) {
+        auto* in = static_cast<const Inner*>(n);
+        if (in->term) return in->term;
+        int b = 0;
+        n = childFrom(in, 0, b);
+    }
+    return static_cast<const Leaf*>(n);
+}
+
+// Insert a child for byte b; grows the node (replacing ref) when full.
+void addChild(Node*& ref, std::uint8_t b, Node* c) {
+    auto* in = static_cast<Inner*>(ref);
+    switch (in->type) {
+        case kNode4: {
+            auto* x = static_cast<Node4*>(in);
+            if (x->count < 4) {
+                int i = 0;
+                while (i < x->count && x->keys[i] < b) ++i;
+                std::memmove(x->keys + i + 1, x->keys + i, static_cast<size_t>(x->count - i));
+                std::memmove(x->child + i + 1, x->child + i, static_cast<size_t>(x->count - i) * sizeof(Node*));
+                x->keys[i] = b; x->child[i] = c; ++x->count;
+                return;
+            }
+            auto* g = new Node16;
+            copyHeader(g, x);
+            std::memcpy(g->keys, x->keys, 4);
+            std::memcpy(g->child, x->child, 4 * sizeof(Node*));
+            delete x;
+            ref = g;
+            addChild(ref, b, c);
+            return;
+        }
+        case kNode16: {
+            auto* x = static_cast<Node16*>(in);
+            if (x->count < 16) {
+                int i = 0;
+                while (i < x->count && x->keys[i] < b) ++i;
+                std::memmove(x->keys + i + 1, x->keys + i, static_cast<size_t>(x->count - i));
+                std::memmove(x->child + i + 1, x->child + i, static_cast<size_t>(x->count - i) * sizeof(Node*));
+                x->keys[i] = b; x->child[i] = c; ++x->count;
+                return;
+            }
+            auto* g = new Node48;
+            copyHeader(g, x);
+            for (int i = 0; i < 16; ++i) {
+                g->child[i] = x->child[i];
+                g->index[x->keys[i]] = static_cast<std::uint8_t>(i + 1);
+            }
+            delete x;
+            ref = g;
+            addChild(ref, b, c);
+            return;
+        }
+        case kNode48: {
+            auto* x = static_cast<Node48*>(in);
+            if (x->count < 48) {
+                int slot = 0;
+                while (x->child[slot]) ++slot;
+                x->child[slot] = c;
+                x->index[b] = static_cast<std::uint8_t>(slot + 1);
+                ++x->count;
+                return;
+            }
+            auto* g = new Node256;
+            copyHeader(g, x);
+            for (int i = 0; i < 256; ++i)
+                if (x->index[i]) g->child[i] = x->child[x->index[i] - 1];
+            delete x;
+            ref = g;
+            addChild(ref, b, c);
+            return;
+        }
+        case kNode256: {
+            auto* x = static_cast<Node256*>(in);
+            x->child[b] = c;
+            ++x->count;
+            return;
+        }
+    }
+}
+
+// A Node4 with a single child and no terminal leaf is folded into that child;
+// an inner node with no children is replaced by its terminal leaf (if any).
+void collapse(Node*& ref) {
+    auto* in = static_cast<Inner*>(ref);
+    if (in->count == 0) {
+        Node* repl = in->term;
+        in->term = nullptr;
+        freeInner(in);
+        ref = repl;
+        return;
+    }
+    if (in->type != kNode4 || in->count != 1 || in->term) return;
+
+    auto* x = static_cast<Node4*>(in);
+    Node* c = x->child[0];
+    if (!isLeaf(c)) {
+        auto* ci = static_cast<Inner*>(c);
+        std::uint8_t buf[kMaxPrefix];
+        std::uint32_t k = 0;
+        for (std::uint32_t i = 0; i < std::min(x->prefixLen, kMaxPrefix) && k < kMaxPrefix; ++i) buf[k++] = x->prefix[i];
+        if (k < kMaxPrefix) buf[k++] = x->keys[0];
+        for (std::uint32_t i = 0; i < std::min(ci->prefixLen, kMaxPrefix) && k < kMaxPrefix; ++i) buf[k++] = ci->prefix[i];
+        ci->prefixLen = x->prefixLen + 1 + ci->prefixLen;
+        std::memcpy(ci->prefix, buf, k);
+    }
+    delete x;
+    ref = c;
+}
+
+// Remove the child for byte b; shrinks the node (replacing ref) when sparse.
+void removeChild(Node*& ref, std::uint8_t b) {
+    auto* in = static_cast<Inner*>(ref);
+    switch (in->type) {
+        case kNode4: {
+            auto* x = static_cast<Node4*>(in);
+            int i = 0;
+            while (i < x->count && x->keys[i] != b) ++i;
+            if (i == x->count) return;
+            std::memmove(x->keys + i, x->keys + i + 1, static_cast<size_t>(x->count - i - 1));
+            std::memmove(x->child + i, x->child + i + 1, static_cast<size_t>(x->count - i - 1) * sizeof(Node*));
+            --x->count;
+            collapse(ref);
+            return;
+        }
+        case kNode16: {
+            auto* x = static_cast<Node16*>(in);
+            int i = 0;
+            while (i < x->count && x->keys[i] != b) ++i;
+            if (i == x->count) return;
+            std::memmove(x->keys + i, x->keys + i + 1, static_cast<size_t>(x->count - i - 1));
+            std::memmove(x->child + i, x->child + i + 1, static_cast<size_t>(x->count - i - 1) * sizeof(Node*));
+            --x->count;
+            if (x->count <= 3) {
+                auto* s = new Node4;
+                copyHeader(s, x);
+                std::memcpy(s->keys, x->keys, x->count);
+                std::memcpy(s->child, x->child, x->count * sizeof(Node*));
+                delete x;
+                ref = s;
+            }
+            return;
+        }
+        case kNode48: {
+            auto* x = static_cast<Node48*>(in);
+            if (!x->index[b]) return;
+            x->child[x->index[b] - 1] = nullptr;
+            x->index[b] = 0;
+            --x->count;
+            if (x->count <= 12) {
+                auto* s = new Node16;
+                copyHeader(s, x);
+                int k = 0;
+                for (int i = 0; i < 256; ++i) {
+                    if (!x->index[i]) continue;
+                    s->keys[k] = static_cast<std::uint8_t>(i);
+                    s->child[k++] = x->child[x->index[i] - 1];
+                }
+                delete x;
+                ref = s;
+            }
+            return;
+        }
+        case kNode256: {
+            auto* x = static_cast<Node256*>(in);
+            if (!x->child[b]) return;
+            x->child[b] = nullptr;
+            --x->count;
+            if (x->count <= 37) {
+                auto* s = new Node48;
+                copyHeader(s, x);
+                int slot = 0;
+                for (int i = 0; i < 256; ++i) {
+                    if (!x->child[i]) continue;
+                    s->child[slot] = x->child[i];
+                    s->index[i] = static_cast<std::uint8_t>(++slot);
+                }
+                delete x;
+                ref = s;
+            }
+            return;
+        }
+    }
+}
+
+// Number of prefix bytes of n matching key from depth (key end counts as mismatch).
+std::uint32_t prefixMatch(const Inner* n, const Key& key, std::size_t depth) {
+    const std::uint32_t stored = std::min(n->prefixLen, kMaxPrefix);
+    std::uint32_t i = 0;
+    for (; i < stored; ++i)
+        if (depth + i >= key.size() || n->prefix[i] != key[depth + i]) return i;
+    if (n->prefixLen > kMaxPrefix) {
+        const Leaf* l = minLeaf(n);
+        for (; i < n->prefixLen; ++i)
+            if (depth + i >= key.size() || l->key[depth + i] != key[depth + i]) return i;
+    }
+    return i;
+}
+
+bool addRec(Leaf* l, RecNo rec) {
+    auto it = std::lower_bound(l->recs.begin(), l->recs.end(), rec);
+    if (it != l->recs.end() && *it == rec) return false;
+    l->recs.insert(it, rec);
+    return true;
+}
+
+bool dropRec(Leaf* l, RecNo rec) {
+    auto it = std::lower_bound(l->recs.begin(), l->recs.end(), rec);
+    if (it == l->recs.end() || *it != rec) return false;
+    l->recs.erase(it);
+    return true;
+}
+
+// Hang a leaf below a fresh inner node whose path ends at depth d.
+void attach(Node*& ref, Leaf* l, std::size_t d) {
+    if (l->key.size() == d) static_cast<Inner*>(ref)->term = l;
+    else addChild(ref, l->key[d], l);
+}
+
+bool insertRec(Node*& ref, const Key& key, std::size_t depth, RecNo rec) {
+    if (!ref) { ref = new Leaf(key, rec); return true; }
+
+    if (isLeaf(ref)) {
+        auto* l = static_cast<Leaf*>(ref);
+        if (l->key == key) return addRec(l, rec);
+        std::size_t lcp = 0;
+        while (depth + lcp < l->key.size() && depth + lcp < key.size() &&
+               l->key[depth + lcp] == key[depth + lcp]) ++lcp;
+        auto* n = new Node4;
+        n->prefixLen = static_cast<std::uint32_t>(lcp);
+        if (lcp) std::memcpy(n->prefix, key.data() + depth, std::min<std::size_t>(lcp, kMaxPrefix));
+        Node* nn = n;
+        attach(nn, l, depth + lcp);
+        attach(nn, new Leaf(key, rec), depth + lcp);
+        ref = nn;
+        return true;
+    }
+
+    auto* n = static_cast<Inner*>(ref);
+    if (n->prefixLen) {
+        const std::uint32_t m = prefixMatch(n, key, depth);
+        if (m < n->prefixLen) {
+            // Split the compressed path at the first mismatching byte.
+            auto* top = new Node4;
+            top->prefixLen = m;
+            std::memcpy(top->prefix, n->prefix, std::min(m, kMaxPrefix));
+
+            const std::uint32_t rest = n->prefixLen - m - 1;
+            std::uint8_t oldByte;
+            if (n->prefixLen <= kMaxPrefix) {
+                oldByte = n->prefix[m];
+                std::memmove(n->prefix, n->prefix + m + 1, rest);
+            } else {
+                const Leaf* l = minLeaf(n);
+                oldByte = l->key[depth + m];
+                std::memcpy(n->prefix, l->key.data() + depth + m + 1, std::min(rest, kMaxPrefix));
+            }
+            n->prefixLen = rest;
+
+            Node* t = top;
+            addChild(t, oldByte, n);
+            attach(t, new Leaf(key, rec), depth + m);
+            ref = t;
+            return true;
+        }
+        depth += n->prefixLen;
+    }
+
+    if (depth == key.size()) {
+        if (n->term) return addRec(n->term, rec);
+        n->term = new Leaf(key, rec);
+        return true;
+    }
+
+    if (Node** c = findChild(n, key[depth])) return insertRec(*c, key, depth + 1, rec);
+    addChild(ref, key[depth], new Leaf(key, rec));
+    return true;
+}
+
+bool eraseRec(Node*& ref, const Key& key, std::size_t depth, RecNo rec) {
+    if (!ref) return false;
+
+    if (isLeaf(ref)) {
+        auto* l = static_cast<Leaf*>(ref);
+        if (l->key != key || !dropRec(l, rec)) return false;
+        if (l->recs.empty()) { delete l; ref = nullptr; }
+        return true;
+    }
+
+    auto* n = static_cast<Inner*>(ref);
+    if (n->prefixLen) {
+        if (prefixMatch(n, key, depth) != n->prefixLen) return false;
+        depth += n->prefixLen;
+    }
+
+    if (depth == key.size()) {
+        if (!n->term || n->term->key != key || !dropRec(n->term, rec)) return false;
+        if (n->term->recs.empty()) {
+            delete n->term;
+            n->term = nullptr;
+            collapse(ref);
+        }
+        return true;
+    }
+
+    const std::uint8_t b = key[depth];
+    Node** c = findChild(n, b);
+    if (!c || !eraseRec(*c, key, depth + 1, rec)) return false;
+    if (!*c) removeChild(ref, b);
+    return true;
+}
+
+// -------- ordered iteration ----------------------------------------------------
+
+// Depth-first walk yielding leaves in key order. Each frame remembers whether
+// the node's terminal leaf was emitted and the next child byte to visit.
+class Iter {
+public:
+    void seekGE(const Node* root, const Key& key) {
+        stack_.clear();
+        pending_ = nullptr;
+        const Node* n = root;
+        std::size_t depth = 0;
+        while (n) {
+            if (isLeaf(n)) {
+                auto* l = static_cast<const Leaf*>(n);
+                if (!(l->key < key)) pending_ = l;
+                return;
+            }
+            auto* in = static_cast<const Inner*>(n);
+            if (in->prefixLen) {
+                const Leaf* ml = in->prefixLen > kMaxPrefix ? minLeaf(in) : nullptr;
+                int cmp = 0;
+                for (std::uint32_t i = 0; i < in->prefixLen; ++i) {
+                    if (depth + i >= key.size()) { cmp = 1; break; } // subtree keys extend key
+                    const std::uint8_t pb = i < kMaxPrefix ? in->prefix[i] : ml->key[depth + i];
+                    if (pb != key[depth + i]) { cmp = pb < key[depth + i] ? -1 : 1; break; }
+                }
+                if (cmp > 0) { stack_.push_back({in, 0, false}); return; }
+                if (cmp < 0) return;
+                depth += in->prefixLen;
+            }
+            if (depth == key.size()) { stack_.push_back({in, 0, false}); return; }
+            const std::uint8_t b = key[depth];
+            stack_.push_back({in, b + 1, true}); // terminal leaf is a proper prefix => smaller
+            n = findChild(in, b);
+            ++depth;
+        }
+    }
+
+    const Leaf* next() {
+        if (pending_) { const Leaf* p = pending_; pending_ = nullptr; return p; }
+        while (!stack_.empty()) {
+            Frame& f = stack_.back();
+            if (!f.termDone) {
+                f.termDone = true;
+                if (f.n->term) return f.n->term;
+            }
+            int b = 0;
+            const Node* c = childFrom(f.n, f.nextByte, b);
+            if (!c) { stack_.pop_back(); continue; }
+            f.nextByte = b + 1;
+            if (isLeaf(c)) return static_cast<const Leaf*>(c);
+            stack_.push_back({static_cast<const Inner*>(c), 0, false});
+        }
+        return nullptr;
+    }
+
+private:
+    struct Frame { const Inner* n; int nextByte; bool termDone; };
+    std::vector<Frame> stack_;
+    const Leaf* pending_{nullptr};
+};
+
+// Cursor over (key, recno) pairs; bound checks stop the walk early.
+// Like the multimap cursors, it is invalidated by mutations of the tree.
+class ArtCursor : public Cursor {
+public:
+    enum class Mode { Equal, Range, Prefix };
+
+    ArtCursor(const Node* root, Key low, Key high, Mode mode)
+        : root_(root), low_(std::move(low)), high_(std::move(high)), mode_(mode) {}
+
+    bool first(Key& outKey, RecNo& outRec) override {
+        it_.seekGE(root_, low_);
+        leaf_ = nullptr;
+        pos_ = 0;
+        started_ = true;
+        done_ = false;
+        return emit_(outKey, outRec);
+    }
+
+    bool next(Key& outKey, RecNo& outRec) override {
+        if (!started_) return first(outKey, outRec);
+        if (leaf_) ++pos_;
+        return emit_(outKey, outRec);
+    }
+
+private:
+    const Node*  root_;
+    Key          low_, high_;
+    Mode         mode_;
+    Iter         it_;
+    const Leaf*  leaf_{nullptr};
+    std::size_t  pos_{0};
+    bool         started_{false};
+    bool         done_{false};
+
+    bool inBounds_(const Key& k) const {
+        switch (mode_) {
+            case Mode::Equal:  return k == low_;
+            case Mode::Range:  return high_.empty() || !(high_ < k);
+            case Mode::Prefix: return k.size() >= low_.size() &&
+                                      std::equal(low_.begin(), low_.end(), k.begin());
+        }
+        return false;
+    }
+
+    bool emit_(Key& outKey, RecNo& outRec) {
+        if (done_) return false;
+        while (!leaf_ || pos_ >= leaf_->recs.size()) {
+            leaf_ = it_.next();
+            pos_ = 0;
+            if (!leaf_ || !inBounds_(leaf_->key)) { leaf_ = nullptr; done_ = true; return false; }
+        }
+        outKey = leaf_->key;
+        outRec = leaf_->recs[pos_];
+        return true;
+    }
+};
+
+} // namespace
+
+// -------- ArtBackend -------------------------------------------------------------
+
+ArtBackend::~ArtBackend() { clear(); }
+
+void ArtBackend::clear() {
+    destroy(root_);
+    root_ = nullptr;
+    entries_ = 0;
+}
+
+void ArtBackend::upsert(const Key& key, RecNo rec) {
+    if (insertRec(root_, key, 0, rec)) ++entries_;
+}
+
+void ArtBackend::erase(const Key& key, RecNo rec) {
+    if (eraseRec(root_, key, 0, rec)) --entries_;
+}
+
+std::unique_ptr<Cursor> ArtBackend::seek(const Key& key) const {
+    return std::unique_ptr<Cursor>(new ArtCursor(root_, key, key, ArtCursor::Mode::Equal));
+}
+
+std::unique_ptr<Cursor> ArtBackend::scan(const Key& low, const Key& high) const {
+    return std::unique_ptr<Cursor>(new ArtCursor(root_, low, high, ArtCursor::Mode::Range));
+}
+
+std::unique_ptr<Cursor> ArtBackend::seekPrefix(const Key& prefix) const {
+    return std::unique_ptr<Cursor>(new ArtCursor(root_, prefix, Key{}, ArtCursor::Mode::Prefix));
+}
+
+} // namespace xindex
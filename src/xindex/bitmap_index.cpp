@@ -0,0 +1,58 @@
+#include "xindex/bitmap_index.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+namespace xindex {
+
+std::string BitmapIndex::normalize(const std::string& raw) {
+    size_t b = 0, e = raw.size();
+    while (b < e && std::isspace(static_cast<unsigned char>(raw[b]))) ++b;
+    while (e > b && std::isspace(static_cast<unsigned char>(raw[e - 1]))) --e;
+    std::string s = raw.substr(b, e - b);
+
+    // Same acceptance rule as predicates' parse_number: whole text is a number.
+    if (!s.empty()) {
+        const char* cs = s.c_str();
+        char* end = nullptr;
+        const double d = std::strtod(cs, &end);
+        if (end != cs && *end == '\0') {
+            char buf[40];
+            std::snprintf(buf, sizeof(buf), "%.17g", d == 0.0 ? 0.0 : d); // fold -0
+            return buf;
+        }
+    }
+    for (auto& c : s) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    return s;
+}
+
+void BitmapIndex::insert(const std::string& value, std::uint32_t rec) {
+    values_[value].add(rec);
+}
+
+void BitmapIndex::erase(const std::string& value, std::uint32_t rec) {
+    auto it = values_.find(value);
+    if (it == values_.end()) return;
+    it->second.remove(rec);
+    if (it->second.empty()) values_.erase(it);
+}
+
+void BitmapIndex::update(const std::string& oldValue, const std::string& newValue, std::uint32_t rec) {
+    if (oldValue == newValue) return;
+    erase(oldValue, rec);
+    insert(newValue, rec);
+}
+
+const RoaringBitmap* BitmapIndex::lookup(const std::string& value) const {
+    auto it = values_.find(value);
+    return it == values_.end() ? nullptr : &it->second;
+}
+
+RoaringBitmap BitmapIndex::all() const {
+    RoaringBitmap out;
+    for (const auto& kv : values_) out |= kv.second;
+    return out;
+}
+
+} // namespace xindex
@@ -25,8 +25,13 @@ bool BptMemBackend::MapCursor::next(Key& outKey, RecNo& outRec) {
 
 // -------- BptMemBackend ------------------------------------------------------
 
+// Keeps one entry per (key, rec), recnos ascending within a key.
 void BptMemBackend::upsert(const Key& key, RecNo rec) {
-    map_.emplace(key, rec);
+    auto range = map_.equal_range(key);
+    auto it = range.first;
+    while (it != range.second && it->second < rec) ++it;
+    if (it != range.second && it->second == rec) return;
+    map_.emplace_hint(it, key, rec);
 }
 
 void BptMemBackend::erase(const Key& key, RecNo rec) {
@@ -45,7 +50,7 @@ std::unique_ptr<Cursor> BptMemBackend::seek(const Key& key) const {
 
 std::unique_ptr<Cursor> BptMemBackend::scan(const Key& low, const Key& high) const {
     auto lo = map_.lower_bound(low);
-    auto hi = map_.upper_bound(high);
+    auto hi = high.empty() ? map_.end() : map_.upper_bound(high);
     return std::unique_ptr<Cursor>(new MapCursor(lo, hi));
 }
 
@@ -0,0 +1,117 @@
+#include "xindex/hash_backend.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace xindex {
+
+// FNV-1a over the key bytes.
+std::size_t HashBackend::KeyHash::operator()(const Key& k) const noexcept {
+    std::uint64_t h = 1469598103934665603ull;
+    for (std::uint8_t b : k) { h ^= b; h *= 1099511628211ull; }
+    return static_cast<std::size_t>(h);
+}
+
+// -------- cursors -----------------------------------------------------------
+
+// The recnos of one key; `entry` is nullptr when the key is absent.
+class HashBackend::ListCursor : public Cursor {
+public:
+    explicit ListCursor(const Map::value_type* entry) : entry_(entry) {}
+
+    bool first(Key& outKey, RecNo& outRec) override {
+        pos_ = 0;
+        started_ = true;
+        return emit_(outKey, outRec);
+    }
+
+    bool next(Key& outKey, RecNo& outRec) override {
+        if (!started_) return first(outKey, outRec);
+        ++pos_;
+        return emit_(outKey, outRec);
+    }
+
+private:
+    const Map::value_type* entry_;
+    std::size_t            pos_{0};
+    bool                   started_{false};
+
+    bool emit_(Key& outKey, RecNo& outRec) {
+        if (!entry_ || pos_ >= entry_->second.size()) return false;
+        outKey = entry_->first;
+        outRec = entry_->second[pos_];
+        return true;
+    }
+};
+
+// Every entry, bucket order. Like the multimap cursors, it is invalidated
+// by upsert/erase.
+class HashBackend::MapCursor : public Cursor {
+public:
+    explicit MapCursor(const Map* map) : map_(map) {}
+
+    bool first(Key& outKey, RecNo& outRec) override {
+        it_ = map_->begin();
+        pos_ = 0;
+        started_ = true;
+        return emit_(outKey, outRec);
+    }
+
+    bool next(Key& outKey, RecNo& outRec) override {
+        if (!started_) return first(outKey, outRec);
+        if (it_ == map_->end()) return false;
+        ++pos_;
+        return emit_(outKey, outRec);
+    }
+
+private:
+    const Map*          map_;
+    Map::const_iterator it_{};
+    std::size_t         pos_{0};
+    bool                started_{false};
+
+    bool emit_(Key& outKey, RecNo& outRec) {
+        for (; it_ != map_->end(); ++it_, pos_ = 0) {
+            if (pos_ < it_->second.size()) {
+                outKey = it_->first;
+                outRec = it_->second[pos_];
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// -------- HashBackend -------------------------------------------------------
+
+void HashBackend::upsert(const Key& key, RecNo rec) {
+    auto& recs = map_[key];
+    auto at = std::lower_bound(recs.begin(), recs.end(), rec);
+    if (at != recs.end() && *at == rec) return;
+    recs.insert(at, rec);
+    ++entries_;
+}
+
+void HashBackend::erase(const Key& key, RecNo rec) {
+    auto it = map_.find(key);
+    if (it == map_.end()) return;
+    auto& recs = it->second;
+    auto at = std::lower_bound(recs.begin(), recs.end(), rec);
+    if (at == recs.end() || *at != rec) return;
+    recs.erase(at);
+    --entries_;
+    if (recs.empty()) map_.erase(it);
+}
+
+std::unique_ptr<Cursor> HashBackend::seek(const Key& key) const {
+    auto it = map_.find(key);
+    return std::unique_ptr<Cursor>(new ListCursor(it == map_.end() ? nullptr : &*it));
+}
+
+std::unique_ptr<Cursor> HashBackend::scan(const Key& low, const Key& high) const {
+    if (!low.empty() || !high.empty())
+        throw std::logic_error("HashBackend: no key order for range scans");
+    return std::unique_ptr<Cursor>(new MapCursor(&map_));
+}
+
+} // namespace xindex
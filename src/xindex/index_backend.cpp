@@ -0,0 +1,26 @@
+#include "xindex/index_backend.hpp"
+#include "xindex/art_backend.hpp"
+#include "xindex/bpt_backend.hpp"
+#include "xindex/common.hpp"
+#include "xindex/hash_backend.hpp"
+#include "xindex/lsm_backend.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+namespace xindex {
+
+std::unique_ptr<IIndexBackend> makeBackend(const std::string& kind) {
+    std::string k = kind;
+    std::transform(k.begin(), k.end(), k.begin(),
+                   [](unsigned char c){ return static_cast<char>(std::toupper(c)); });
+    if (k.empty() || k == kBackendKind_BPTREE) return nullptr;
+    if (k == kBackendKind_BPTMEM) return std::make_unique<BptMemBackend>();
+    if (k == kBackendKind_ART)    return std::make_unique<ArtBackend>();
+    if (k == kBackendKind_HASH)   return std::make_unique<HashBackend>();
+    if (k == kBackendKind_LSM)    return std::make_unique<LsmBackend>();
+    throw std::invalid_argument("unknown index backend: " + kind);
+}
+
+} // namespace xindex
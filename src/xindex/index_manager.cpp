@@ -1,9 +1,26 @@
 #include "xindex/index_manager.hpp"
+#include "xindex/common.hpp"
+#include "xindex/thread_pool.hpp"
+#include <cctype>
+#include <iterator>
 #include <filesystem>
-#include <fstream>
+#include <stdexcept>
 
 namespace xindex {
 
+namespace {
+
+// Throws if two neighbours of the sorted range [first, last) share a key.
+template <class It, class KeyOf, class RecOf>
+void checkUnique(It first, It last, KeyOf key, RecOf rec) {
+    for (It i = first; i != last && std::next(i) != last; ++i)
+        if (key(*i) == key(*std::next(i)))
+            throw std::runtime_error("duplicate key in records " + std::to_string(rec(*i)) +
+                                     " and " + std::to_string(rec(*std::next(i))));
+}
+
+} // namespace
+
 static std::string baseNameNoExt(const std::string& p) {
     std::filesystem::path ph(p);
     auto stem = ph.stem().string();
@@ -15,100 +32,556 @@ std::string IndexManager::replaceExt_(const std::string& path, const std::string
     return baseNameNoExt(path) + newExt;
 }
 
-void IndexManager::open(const std::string& dbfPath,
-                        const KeyDesc& kd,
-                        bool allowBuild,
-                        std::function<std::optional<std::pair<std::vector<uint8_t>, bool>>(int32_t)> scanner)
-{
+void IndexManager::reset_(const std::string& dbfPath, const KeyDesc& kd, bool readOnly) {
     key_ = kd;
-    idxPath_ = replaceExt_(dbfPath, ".idx");
+    std::transform(key_.backend.begin(), key_.backend.end(), key_.backend.begin(),
+                   [](unsigned char c){ return static_cast<char>(std::toupper(c)); });
+    if (key_.backend.empty()) key_.backend = kBackendKind_BPTREE;
+    idxPath_ = replaceExt_(dbfPath, kd.name.empty() ? ".idx" : "." + kd.name + ".idx");
+    readOnly_ = readOnly;
+    hasFile_ = false;
+    stamp_.clear();
+    dirty_ = false;
+    clearLog_();
+    view_.reset();
+    static_.reset();
+    dropBackend_();
+    memoryOnly_ = makeBackend(key_.backend) != nullptr;  // throws for unknown kinds
+    if (key_.staticLayout && memoryOnly_)
+        throw std::invalid_argument("IndexManager: the static layout needs the BPTREE backend");
+}
 
-    // Try load existing
-    try {
-        load_();
-        dirty_ = false;
-        return;
-    } catch (...) {
-        // fallthrough
+void IndexManager::create(const std::string& dbfPath,
+                          const KeyDesc& kd,
+                          std::function<std::optional<std::pair<std::vector<uint8_t>, bool>>(int32_t)> scanner,
+                          std::function<std::vector<uint8_t>(int32_t)> payloadOf)
+{
+    reset_(dbfPath, kd, false);
+    if (memoryOnly_) { rebuildBackend_(std::move(scanner), payloadOf != nullptr); return; }
+    rebuild(std::move(scanner), 0, std::move(payloadOf));
+}
+
+void IndexManager::openReadOnly(const std::string& dbfPath, const KeyDesc& kd) {
+    reset_(dbfPath, kd, true);
+    if (memoryOnly_)
+        throw std::runtime_error("IndexManager: " + key_.backend + " tags are built with the table; there is no file to attach");
+    std::string info;
+    auto view = std::make_unique<TreeView>();
+    if (StaticIndex::isStaticFile(idxPath_)) {
+        loadStatic_(true, info);
+    } else if (view->open(idxPath_)) {
+        info = view->info();
+        view_ = std::move(view);
+    } else {
+        if (!file_.load(idxPath_, tree_, bloom_, true)) bloom_.disable();
+        info = file_.info();
     }
+    checkInfo_(info);
+    hasFile_ = true;
+}
 
-    if (!allowBuild) throw std::runtime_error("IndexManager: missing/invalid index and build not allowed");
+namespace {
 
-    // Build fresh
-    tree_.clear();
-    int32_t r = 1;
-    for (;; ++r) {
-        auto it = scanner(r);
-        if (!it) break;
-        const auto& [keyBytes, isDeleted] = *it;
-        if (!isDeleted && !keyBytes.empty()) tree_.insert(keyBytes, r);
-    }
-    dirty_ = true;
-    save_();
-    dirty_ = false;
+void putString(std::string& out, const std::string& s) {
+    const uint32_t n = static_cast<uint32_t>(s.size());
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>(n >> (8 * i)));
+    out += s;
+}
+bool getString(const std::string& in, size_t& at, std::string& s) {
+    if (in.size() - at < 4) return false;
+    const uint32_t n = TreeFile::le32(reinterpret_cast<const uint8_t*>(in.data() + at));
+    at += 4;
+    if (in.size() - at < n) return false;
+    s = in.substr(at, n);
+    at += n;
+    return true;
+}
+
+} // namespace
+
+// u32 length + definition, u32 length + table stamp.
+std::string IndexManager::info_(const std::string& stamp) const {
+    std::string out;
+    putString(out, key_.definition);
+    putString(out, stamp);
+    return out;
+}
+
+void IndexManager::checkInfo_(const std::string& info) const {
+    const std::string rebuild = " (open the table without NOUPDATE and build the tag again)";
+    std::string def, stamp;
+    size_t at = 0;
+    if (!getString(info, at, def) || !getString(info, at, stamp) || at != info.size())
+        throw std::runtime_error(idxPath_ + " does not record what it was built from" + rebuild);
+    if (def != key_.definition)
+        throw std::runtime_error(idxPath_ + " was built " + def + ", not " + key_.definition + rebuild);
+    if (stamp != stampNow_())
+        throw std::runtime_error(idxPath_ + " is out of date with the table" + rebuild);
+}
+
+void IndexManager::checkWritable_() const {
+    if (readOnly_) throw std::runtime_error("IndexManager: " + idxPath_ + " is open read-only");
 }
 
 void IndexManager::close() {
-    if (dirty_) {
-        try { save_(); } catch (...) {}
-        dirty_ = false;
-    }
+    if (!hasFile_ || readOnly_ || memoryOnly_) return;
+    if (!dirty_ && stampNow_() == stamp_) return;
+    save_();
+    dirty_ = false;
 }
 
-void IndexManager::insert(const std::vector<uint8_t>& key, int32_t recno) {
-    if (key.empty()) return;
-    tree_.insert(key, recno);
+void IndexManager::log_op_(Op op) {
+    checkWritable_();
+    if (!log_.empty() && sorted_ && !before_(log_.back(), op.key, op.rec)) sorted_ = false;
+    // Exact while the log is strictly ascending; resolve_() recounts otherwise.
+    if (op.add) { ++adds_; bloom_.add(op.key); } else ++drops_;
+    log_.push_back(std::move(op));
     dirty_ = true;
+    if (log_.size() >= kMergeBatch) mergePending();
+}
+
+// Backends take point ops directly; they have no use for the log.
+void IndexManager::insert(const std::vector<uint8_t>& key, int32_t recno,
+                          std::vector<uint8_t> payload) {
+    if (!backend_) { log_op_(Op{key, recno, true, std::move(payload)}); return; }
+    checkWritable_();
+    if (!payload.empty()) throw std::invalid_argument("IndexManager: " + key_.backend + " tags carry no payloads");
+    backend_->upsert(key, static_cast<RecNo>(recno));
+    bloom_.add(key);
 }
 
 void IndexManager::erase(const std::vector<uint8_t>& key, int32_t recno) {
-    if (key.empty()) return;
-    tree_.erase(key, recno);
-    dirty_ = true;
+    if (!backend_) { log_op_(Op{key, recno, false, {}}); return; }
+    checkWritable_();
+    backend_->erase(key, static_cast<RecNo>(recno));
+}
+
+void IndexManager::resolve_() const {
+    if (sorted_) return;
+    std::stable_sort(log_.begin(), log_.end(), [](const Op& x, const Op& y){
+        return x.key < y.key || (x.key == y.key && x.rec < y.rec);
+    });
+    std::vector<Op> out;
+    out.reserve(log_.size());
+    adds_ = drops_ = 0;
+    for (size_t i = 0; i < log_.size(); ) {
+        size_t j = i;
+        bool drop = false;
+        Op* add = nullptr;
+        for (; j < log_.size() && log_[j].rec == log_[i].rec && log_[j].key == log_[i].key; ++j) {
+            if (log_[j].add) add = &log_[j];
+            else if (add) add = nullptr; // cancels a logged insert
+            else drop = true;
+        }
+        if (drop) { out.push_back(Op{log_[i].key, log_[i].rec, false, {}}); ++drops_; }
+        if (add)  { out.push_back(std::move(*add)); ++adds_; }
+        i = j;
+    }
+    log_ = std::move(out);
+    sorted_ = true;
 }
 
 void IndexManager::update(const std::vector<uint8_t>& oldKey,
                           const std::vector<uint8_t>& newKey,
                           int32_t recno) {
     if (oldKey == newKey) return;
-    if (!oldKey.empty()) tree_.erase(oldKey, recno);
-    if (!newKey.empty()) tree_.insert(newKey, recno);
-    dirty_ = true;
+    if (!oldKey.empty()) erase(oldKey, recno);
+    if (!newKey.empty()) insert(newKey, recno);
+}
+
+void IndexManager::update(const std::vector<uint8_t>& oldKey,
+                          const std::vector<uint8_t>& newKey,
+                          int32_t recno,
+                          std::vector<uint8_t> payload) {
+    if (!oldKey.empty()) erase(oldKey, recno);
+    if (!newKey.empty()) insert(newKey, recno, std::move(payload));
+}
+
+// Drops first (an update is a drop plus an add of the same recno), then the
+// adds as one sorted batch.
+void IndexManager::mergePending() {
+    if (log_.empty()) return;
+    if (static_) {
+        // A snapshot cannot take inserts: seal a new one from the merged view.
+        auto next = std::make_unique<StaticIndex>();
+        scanEntries_({}, [&](const std::vector<uint8_t>& k, int32_t r, const std::vector<uint8_t>& p){
+            next->append(k, r, p);
+            return true;
+        });
+        next->seal();
+        static_ = std::move(next);
+        clearLog_();
+        if (bloom_.saturated()) rebuildBloom_();
+        return;
+    }
+    resolve_();
+    std::vector<BPlusTree::BatchEntry> batch;
+    batch.reserve(adds_);
+    for (auto& op : log_) {
+        if (!op.add) tree_.erase(op.key, op.rec);
+        else batch.push_back({BPlusTree::Key{std::move(op.key)}, op.rec, std::move(op.payload)});
+    }
+    tree_.insertBatch(batch);
+    clearLog_();
+    if (bloom_.saturated()) rebuildBloom_();
 }
 
 std::optional<int32_t> IndexManager::seekGE(const std::vector<uint8_t>& key) const {
-    return tree_.seekGE(key);
+    if (static_ && log_.empty()) return static_->seekGE(key);
+    if (backend_) {
+        auto c = backend_->ordered() ? backend_->scan(key, {}) : backend_->seek(key);
+        Key k;
+        RecNo r;
+        if (!c->first(k, r)) return std::nullopt;
+        return static_cast<int32_t>(r);
+    }
+    std::optional<int32_t> hit;
+    scanFrom(key, [&](const std::vector<uint8_t>&, int32_t r){ hit = r; return false; });
+    return hit;
+}
+
+bool IndexManager::contains(const std::vector<uint8_t>& key) const {
+    if (!bloom_.mayContain(key)) return false;
+    if (static_ && log_.empty()) return static_->contains(key);
+    if (backend_) {
+        Key k;
+        RecNo r;
+        return backend_->seek(key)->first(k, r);
+    }
+    bool found = false;
+    scanFrom(key, [&](const std::vector<uint8_t>& k, int32_t){ found = k == key; return false; });
+    return found;
+}
+
+bool IndexManager::containsOther(const std::vector<uint8_t>& key, int32_t recno) const {
+    if (!mayContain(key)) return false;
+    bool found = false;
+    scanFrom(key, [&](const std::vector<uint8_t>& k, int32_t r){
+        if (k != key) return false;
+        found = r != recno;
+        return !found;
+    });
+    return found;
 }
 
 void IndexManager::rebuild(std::function<std::optional<std::pair<std::vector<uint8_t>, bool>>(int32_t)> scanner,
-                           int32_t /*recCount*/)
+                           int32_t /*recCount*/,
+                           std::function<std::vector<uint8_t>(int32_t)> payloadOf)
 {
-    tree_.clear();
-    int32_t r = 1;
-    for (;; ++r) {
+    checkWritable_();
+    if (memoryOnly_) { rebuildBackend_(std::move(scanner), payloadOf != nullptr); return; }
+    if (key_.staticLayout) { rebuildStatic_(std::move(scanner), std::move(payloadOf)); return; }
+    // Gather every entry, sort on the shared pool and load the tree in one
+    // sorted batch: each leaf is filled once instead of taking random inserts.
+    std::vector<BPlusTree::BatchEntry> all;
+    for (int32_t r = 1;; ++r) {
         auto it = scanner(r);
         if (!it) break;
-        const auto& [keyBytes, isDeleted] = *it;
-        if (!isDeleted && !keyBytes.empty()) tree_.insert(keyBytes, r);
+        auto& [keyBytes, isDeleted] = *it;
+        if (isDeleted || keyBytes.empty()) continue;
+        all.push_back({BPlusTree::Key{std::move(keyBytes)}, r, payloadOf ? payloadOf(r) : std::vector<uint8_t>{}});
     }
-    dirty_ = true;
+    parallelSort(all.begin(), all.end(), [](const BPlusTree::BatchEntry& a, const BPlusTree::BatchEntry& b){
+        return a.key.bytes != b.key.bytes ? a.key.bytes < b.key.bytes : a.value < b.value;
+    });
+    if (key_.unique)
+        checkUnique(all.begin(), all.end(), [](const BPlusTree::BatchEntry& e) -> const std::vector<uint8_t>& { return e.key.bytes; },
+                    [](const BPlusTree::BatchEntry& e){ return e.value; });
+    BPlusTree fresh;
+    fresh.insertBatch(all);
+    all = {};
+    BloomFilter bloom = bloomFor_(fresh);
+
+    const std::string side = idxPath_ + ".tmp";
+    const std::string stamp = stampNow_();
+    BPlusTree check;
+    TreeFile file;
+    file.setInfo(info_(stamp));
+    try {
+        file.write(side, fresh, bloom);
+
+        // Read back what is about to become the index and make sure it is
+        // whole: same entry count, (key, recno) ascending.
+        BloomFilter unused;
+        file.load(side, check, unused, false);
+        if (!wellFormed_(check, fresh.size()))
+            throw std::runtime_error("IndexManager: rebuilt index failed validation");
+        file.install(idxPath_);
+    } catch (...) {
+        std::error_code ec;
+        std::filesystem::remove(side, ec);
+        throw;
+    }
+
+    tree_ = std::move(check);
+    bloom_ = std::move(bloom);
+    file_ = std::move(file);
+    static_.reset();
+    clearLog_();
+    dirty_ = false;
+    stamp_ = stamp;
+    hasFile_ = true;
 }
 
-void IndexManager::flush() {
-    if (dirty_) save_();
+// Same shadow rebuild, producing a StaticIndex: gather every entry, sort
+// once, lay the snapshot out, write, read back, check, rename, swap.
+void IndexManager::rebuildStatic_(std::function<std::optional<std::pair<std::vector<uint8_t>, bool>>(int32_t)> scanner,
+                                  std::function<std::vector<uint8_t>(int32_t)> payloadOf)
+{
+    struct Entry {
+        std::vector<uint8_t> key;
+        int32_t rec;
+        std::vector<uint8_t> payload;
+    };
+    std::vector<Entry> all;
+    for (int32_t r = 1;; ++r) {
+        auto it = scanner(r);
+        if (!it) break;
+        auto& [keyBytes, isDeleted] = *it;
+        if (isDeleted || keyBytes.empty()) continue;
+        all.push_back(Entry{std::move(keyBytes), r, payloadOf ? payloadOf(r) : std::vector<uint8_t>{}});
+    }
+    parallelSort(all.begin(), all.end(), [](const Entry& a, const Entry& b){
+        return a.key != b.key ? a.key < b.key : a.rec < b.rec;
+    });
+    if (key_.unique)
+        checkUnique(all.begin(), all.end(), [](const Entry& e) -> const std::vector<uint8_t>& { return e.key; },
+                    [](const Entry& e){ return e.rec; });
+    StaticIndex fresh;
+    for (const auto& e : all) fresh.append(e.key, e.rec, e.payload);
+    fresh.seal();
+    all = {};
+    BloomFilter bloom = bloomFor_(fresh);
+
+    const std::string side = idxPath_ + ".tmp";
+    const std::string stamp = stampNow_();
+    auto check = std::make_unique<StaticIndex>();
+    try {
+        saveStatic_(side, fresh, bloom, info_(stamp));
+        std::vector<uint8_t> extra;
+        if (!check->load(side, extra) || !wellFormed_(*check, fresh.size()))
+            throw std::runtime_error("IndexManager: rebuilt index failed validation");
+        install_(side);
+    } catch (...) {
+        std::error_code ec;
+        std::filesystem::remove(side, ec);
+        throw;
+    }
+
+    static_ = std::move(check);
+    bloom_ = std::move(bloom);
+    tree_ = BPlusTree{};
+    file_ = TreeFile{};
+    clearLog_();
     dirty_ = false;
+    stamp_ = stamp;
+    hasFile_ = true;
 }
 
-void IndexManager::load_() {
-    std::ifstream ifs(idxPath_, std::ios::binary);
-    if (!ifs) throw std::runtime_error("IndexManager: cannot open idx for read");
-    tree_.load(ifs);
+// Built on the side and swapped in, like the tree: gather, sort once, check
+// UNIQUE, then fill the backend in key order. Only an on-disk backend writes
+// anything, under a path of its own until the swap.
+void IndexManager::rebuildBackend_(std::function<std::optional<std::pair<std::vector<uint8_t>, bool>>(int32_t)> scanner,
+                                   bool withPayloads)
+{
+    if (withPayloads)
+        throw std::invalid_argument("IndexManager: covering payloads need the BPTREE backend, not " + key_.backend);
+    std::vector<std::pair<Key, int32_t>> all;
+    for (int32_t r = 1;; ++r) {
+        auto it = scanner(r);
+        if (!it) break;
+        auto& [keyBytes, isDeleted] = *it;
+        if (isDeleted || keyBytes.empty()) continue;
+        all.emplace_back(std::move(keyBytes), r);
+    }
+    parallelSort(all.begin(), all.end(), std::less<>{});
+    if (key_.unique)
+        checkUnique(all.begin(), all.end(), [](const std::pair<Key, int32_t>& e) -> const Key& { return e.first; },
+                    [](const std::pair<Key, int32_t>& e){ return e.second; });
+
+    std::unique_ptr<IIndexBackend> fresh = makeBackend(key_.backend);
+    const std::string path = fresh->onDisk() ? freshBackendPath_() : std::string{};
+    BloomFilter bloom;
+    fresh->open(path.empty() ? idxPath_ : path);
+    try {
+        fresh->rebuild();  // starts empty; an on-disk backend writes its manifest, claiming the path
+        for (const auto& [k, r] : all) fresh->upsert(k, static_cast<RecNo>(r));
+        all = {};
+        bloom = bloomFor_(BackendSource{*fresh});
+    } catch (...) {
+        try { fresh->drop(); } catch (...) {}
+        throw;
+    }
+    dropBackend_();
+    backend_ = std::move(fresh);
+    backendPath_ = path;
+    bloom_ = std::move(bloom);
+    tree_ = BPlusTree{};
+    file_ = TreeFile{};
+    clearLog_();
+    dirty_ = false;
+}
+
+// <stem>.<TAG>.<kind>, numbered while that manifest exists: the build being
+// replaced keeps its files until the swap.
+std::string IndexManager::freshBackendPath_() const {
+    std::string ext = "." + key_.backend;
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+    const std::string base = replaceExt_(idxPath_, ext);
+    std::string p = base;
+    for (int n = 2; std::filesystem::exists(p); ++n) p = base + "." + std::to_string(n);
+    return p;
+}
+
+// Failing to delete only leaves files behind; the tag is gone either way.
+void IndexManager::dropBackend_() noexcept {
+    if (!backend_) return;
+    try { backend_->drop(); } catch (...) {}
+    backend_.reset();
+    backendPath_.clear();
+}
+
+// ---- cursors ----
+
+// Reads kBatch entries at a time through scanEntries_(), resuming after the
+// last (key, recno) handed out; bounded to `high` (inclusive) if `bounded`.
+class IndexManager::EntryCursor : public Cursor {
+public:
+    static constexpr size_t kBatch = 512;
+
+    EntryCursor(const IndexManager& m, Key low, Key high, bool bounded)
+        : m_(m), low_(std::move(low)), high_(std::move(high)), bounded_(bounded) {}
+
+    bool first(Key& outKey, RecNo& outRec) override {
+        buf_.clear();
+        pos_ = 0;
+        done_ = false;
+        started_ = true;
+        fill_(low_, nullptr);
+        return emit_(outKey, outRec);
+    }
+
+    bool next(Key& outKey, RecNo& outRec) override {
+        if (!started_) return first(outKey, outRec);
+        if (++pos_ >= buf_.size() && !done_ && !buf_.empty()) {
+            const auto last = buf_.back();
+            buf_.clear();
+            pos_ = 0;
+            fill_(last.first, &last);
+        }
+        return emit_(outKey, outRec);
+    }
+
+private:
+    const IndexManager& m_;
+    Key    low_, high_;
+    bool   bounded_;
+    std::vector<std::pair<Key, RecNo>> buf_;
+    size_t pos_{0};
+    bool   done_{false};
+    bool   started_{false};
+
+    // Entries from `from`, skipping up to and including `after`.
+    void fill_(const Key& from, const std::pair<Key, RecNo>* after) {
+        done_ = true;
+        m_.scanEntries_(from, [&](const std::vector<uint8_t>& k, int32_t r, const std::vector<uint8_t>&){
+            const RecNo rec = static_cast<RecNo>(r);
+            if (after && (k < after->first || (k == after->first && rec <= after->second))) return true;
+            if (bounded_ && high_ < k) return false;
+            if (buf_.size() == kBatch) { done_ = false; return false; }
+            buf_.emplace_back(k, rec);
+            return true;
+        });
+    }
+
+    bool emit_(Key& outKey, RecNo& outRec) {
+        if (pos_ >= buf_.size()) return false;
+        outKey = buf_[pos_].first;
+        outRec = buf_[pos_].second;
+        return true;
+    }
+};
+
+std::unique_ptr<Cursor> IndexManager::seek(const std::vector<uint8_t>& key) const {
+    if (backend_) return backend_->seek(key);
+    return std::make_unique<EntryCursor>(*this, key, key, true);
+}
+
+std::unique_ptr<Cursor> IndexManager::scan(const std::vector<uint8_t>& low, const std::vector<uint8_t>& high) const {
+    if (backend_) return backend_->scan(low, high);
+    return std::make_unique<EntryCursor>(*this, low, high, !high.empty());
+}
+
+// Extra bytes: u32 length + info, then the bloom filter if any.
+void IndexManager::saveStatic_(const std::string& path, const StaticIndex& s, const BloomFilter& b,
+                               const std::string& info) {
+    std::vector<uint8_t> extra;
+    const uint32_t n = static_cast<uint32_t>(info.size());
+    for (int i = 0; i < 4; ++i) extra.push_back(static_cast<uint8_t>(n >> (8 * i)));
+    extra.insert(extra.end(), info.begin(), info.end());
+    if (b.enabled()) b.save(extra);
+    s.save(path, extra);
+}
+
+bool IndexManager::loadStatic_(bool wantBloom, std::string& info) {
+    auto s = std::make_unique<StaticIndex>();
+    std::vector<uint8_t> extra;
+    if (!s->load(idxPath_, extra)) return false;
+    size_t at = 0;
+    info.clear();
+    if (extra.size() >= 4 && extra.size() - 4 >= TreeFile::le32(extra.data())) {
+        at = 4 + TreeFile::le32(extra.data());
+        info.assign(extra.begin() + 4, extra.begin() + static_cast<std::ptrdiff_t>(at));
+    }
+    static_ = std::move(s);
+    tree_ = BPlusTree{};
+    file_ = TreeFile{};
+    key_.staticLayout = true;
+    bloom_.disable();
+    if (wantBloom && at < extra.size()) {
+        const uint8_t* p = extra.data() + at;
+        bloom_.load(p, extra.data() + extra.size());
+    }
+    return true;
+}
+
+void IndexManager::install_(const std::string& side) {
+    std::error_code ec;
+    std::filesystem::remove(TreeFile::journalPath(idxPath_), ec);
+    std::filesystem::rename(side, idxPath_);
+}
+
+void IndexManager::flush() {
+    checkWritable_();
+    if (backend_) { backend_->flush(); return; }
+    if (!hasFile_) return;
+    if (dirty_ || stampNow_() != stamp_) save_();
+    dirty_ = false;
 }
 
 void IndexManager::save_() {
-    std::ofstream ofs(idxPath_, std::ios::binary | std::ios::trunc);
-    if (!ofs) throw std::runtime_error("IndexManager: cannot open idx for write");
-    tree_.save(ofs);
+    mergePending();
+    const std::string stamp = stampNow_();
+    if (static_) {
+        saveStatic_(idxPath_ + ".tmp", *static_, bloom_, info_(stamp));
+        install_(idxPath_ + ".tmp");
+        stamp_ = stamp;
+        return;
+    }
+    file_.setInfo(info_(stamp));
+    if (file_.canFlush(tree_)) {
+        file_.flush(tree_, bloom_);
+    } else {
+        // Whole file: write "<idx>.tmp" and rename it over the index, so a
+        // crash never leaves a half-written .idx behind.
+        TreeFile file;
+        file.setInfo(info_(stamp));
+        file.write(idxPath_ + ".tmp", tree_, bloom_);
+        file.install(idxPath_);
+        file_ = std::move(file);
+    }
+    stamp_ = stamp;
 }
 
 } // namespace xindex
@@ -0,0 +1,641 @@
+#include "xindex/lsm_backend.hpp"
+#include "xindex/bloom.hpp"
+#include "xindex/posting.hpp" // putVarint / getVarint
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <stdexcept>
+
+namespace xindex {
+
+namespace {
+
+constexpr char kRunMagic[4]      = {'L', 'S', 'R', '1'};
+constexpr char kManifestMagic[4] = {'L', 'S', 'M', '1'};
+constexpr std::streamoff kFooterBytes    = 8 + 8 + 4; // count, index offset, magic
+
+using MemOp = LsmBackend::MemOp;
+
+template <class T>
+void writeRaw(std::ostream& os, T v) { os.write(reinterpret_cast<const char*>(&v), sizeof v); }
+
+template <class T>
+T readRaw(std::istream& is) {
+    T v{};
+    is.read(reinterpret_cast<char*>(&v), sizeof v);
+    if (!is) throw std::runtime_error("lsm: truncated file");
+    return v;
+}
+
+template <class T>
+T takeRaw(const std::uint8_t*& p, const std::uint8_t* end) {
+    if (end - p < static_cast<std::ptrdiff_t>(sizeof(T))) throw std::runtime_error("lsm: truncated run index");
+    T v;
+    std::memcpy(&v, p, sizeof v);
+    p += sizeof v;
+    return v;
+}
+
+void putKey(std::vector<std::uint8_t>& out, const Key& k) {
+    putVarint(out, static_cast<std::uint32_t>(k.size()));
+    out.insert(out.end(), k.begin(), k.end());
+}
+
+Key takeKey(const std::uint8_t*& p, const std::uint8_t* end) {
+    const std::uint32_t n = getVarint(p, end);
+    if (static_cast<std::uint32_t>(end - p) < n) throw std::runtime_error("lsm: truncated key");
+    Key k(p, p + n);
+    p += n;
+    return k;
+}
+
+inline bool before(const Key& ak, RecNo ar, const Key& bk, RecNo br) {
+    return ak < bk || (ak == bk && ar < br);
+}
+
+} // namespace
+
+// -------- runs -----------------------------------------------------------------
+
+// An immutable run file. Only the sparse index and the bloom filter live in
+// memory; entries are read a block at a time.
+struct LsmBackend::Run {
+    std::string   path;
+    std::uint64_t seq{0};
+    std::uint64_t count{0};
+    std::uint64_t indexOffset{0};          // end of the entry blocks
+    std::vector<Key>           fenceKeys;  // first entry of each block
+    std::vector<std::uint64_t> fenceOffs;
+    BloomFilter                bloom;      // over the run's distinct keys
+    mutable std::atomic<bool>  obsolete{false}; // delete the file with the last reference
+    mutable std::mutex         inMu;
+    mutable std::ifstream      in;
+
+    ~Run() {
+        if (!obsolete) return;
+        in.close();
+        std::remove(path.c_str());
+    }
+
+    bool mayContain(const Key& k) const { return bloom.mayContain(k); }
+
+    // Raw bytes of block b. One read handle per run, shared by every reader.
+    void readBlock(std::size_t b, std::vector<std::uint8_t>& out) const {
+        const std::uint64_t lo = fenceOffs[b];
+        const std::uint64_t hi = b + 1 < fenceOffs.size() ? fenceOffs[b + 1] : indexOffset;
+        out.resize(static_cast<std::size_t>(hi - lo));
+        std::lock_guard<std::mutex> lk(inMu);
+        if (!in.is_open()) in.open(path, std::ios::binary);
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(lo));
+        in.read(reinterpret_cast<char*>(out.data()), static_cast<std::streamsize>(out.size()));
+        if (!in) throw std::runtime_error("lsm: short read in " + path);
+    }
+
+    // Decode the entry at p into op (reusing its key buffer).
+    static void decode(const std::uint8_t*& p, const std::uint8_t* end, MemOp& op) {
+        const std::uint32_t n = getVarint(p, end);
+        if (static_cast<std::uint32_t>(end - p) < n) throw std::runtime_error("lsm: truncated key");
+        op.key.assign(p, p + n);
+        p += n;
+        op.rec = getVarint(p, end);
+        if (p == end) throw std::runtime_error("lsm: truncated entry");
+        op.live = *p++ != 0;
+    }
+
+    static std::shared_ptr<Run> load(const std::string& path, std::uint64_t seq) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) throw std::runtime_error("lsm: cannot open " + path);
+        in.seekg(-kFooterBytes, std::ios::end);
+        const std::streamoff footerAt = in.tellg();
+        auto run = std::make_shared<Run>();
+        run->path = path;
+        run->seq = seq;
+        run->count = readRaw<std::uint64_t>(in);
+        run->indexOffset = readRaw<std::uint64_t>(in);
+        char magic[4];
+        in.read(magic, 4);
+        if (!in || std::memcmp(magic, kRunMagic, 4) != 0 ||
+            run->indexOffset > static_cast<std::uint64_t>(footerAt))
+            throw std::runtime_error("lsm: bad run file " + path);
+
+        std::vector<std::uint8_t> buf(static_cast<std::size_t>(footerAt - static_cast<std::streamoff>(run->indexOffset)));
+        in.seekg(static_cast<std::streamoff>(run->indexOffset));
+        in.read(reinterpret_cast<char*>(buf.data()), static_cast<std::streamsize>(buf.size()));
+        if (!in) throw std::runtime_error("lsm: short read in " + path);
+
+        const std::uint8_t* p = buf.data();
+        const std::uint8_t* end = p + buf.size();
+        const std::uint32_t blocks = getVarint(p, end);
+        for (std::uint32_t i = 0; i < blocks; ++i) {
+            run->fenceKeys.push_back(takeKey(p, end));
+            run->fenceOffs.push_back(takeRaw<std::uint64_t>(p, end));
+        }
+        run->bloom.load(p, end);
+        return run;
+    }
+};
+
+namespace {
+
+using Run = LsmBackend::Run;
+
+// Streams sorted entries into a new run file.
+class RunWriter {
+public:
+    RunWriter(std::string path, std::uint64_t seq) : path_(std::move(path)), seq_(seq),
+        os_(path_, std::ios::binary | std::ios::trunc) {
+        if (!os_) throw std::runtime_error("lsm: cannot create " + path_);
+        os_.write(kRunMagic, 4);
+        off_ = 4;
+    }
+
+    void add(const MemOp& op) {
+        if (count_ % LsmBackend::kBlockEntries == 0) {
+            flushBlock_();
+            fenceKeys_.push_back(op.key);
+            fenceOffs_.push_back(off_);
+        }
+        if (hashes_.empty() || op.key != lastKey_) {
+            hashes_.push_back(BloomFilter::hash(op.key));
+            lastKey_ = op.key;
+        }
+        putKey(block_, op.key);
+        putVarint(block_, op.rec);
+        block_.push_back(op.live ? 1 : 0);
+        ++count_;
+    }
+
+    std::uint64_t count() const { return count_; }
+
+    std::shared_ptr<Run> finish() {
+        flushBlock_();
+        const std::uint64_t indexOffset = off_;
+
+        std::vector<std::uint8_t> idx;
+        putVarint(idx, static_cast<std::uint32_t>(fenceKeys_.size()));
+        for (std::size_t i = 0; i < fenceKeys_.size(); ++i) {
+            putKey(idx, fenceKeys_[i]);
+            const std::uint64_t off = fenceOffs_[i];
+            idx.insert(idx.end(), reinterpret_cast<const std::uint8_t*>(&off),
+                       reinterpret_cast<const std::uint8_t*>(&off) + sizeof off);
+        }
+        auto run = std::make_shared<Run>();
+        run->bloom.reset(hashes_.size());
+        for (std::uint64_t h : hashes_) run->bloom.addHash(h);
+        run->bloom.save(idx);
+        os_.write(reinterpret_cast<const char*>(idx.data()), static_cast<std::streamsize>(idx.size()));
+
+        writeRaw(os_, count_);
+        writeRaw(os_, indexOffset);
+        os_.write(kRunMagic, 4);
+        os_.close();
+        if (!os_) throw std::runtime_error("lsm: write failed for " + path_);
+
+        run->path = path_;
+        run->seq = seq_;
+        run->count = count_;
+        run->indexOffset = indexOffset;
+        run->fenceKeys = std::move(fenceKeys_);
+        run->fenceOffs = std::move(fenceOffs_);
+        return run;
+    }
+
+    // Drop a half-written file.
+    void abandon() {
+        os_.close();
+        std::remove(path_.c_str());
+    }
+
+private:
+    std::string   path_;
+    std::uint64_t seq_;
+    std::ofstream os_;
+    std::uint64_t off_{0};
+    std::uint64_t count_{0};
+    std::vector<std::uint8_t>  block_;
+    std::vector<Key>           fenceKeys_;
+    std::vector<std::uint64_t> fenceOffs_;
+    std::vector<std::uint64_t> hashes_;  // one per distinct key
+    Key                        lastKey_;
+
+    void flushBlock_() {
+        if (block_.empty()) return;
+        os_.write(reinterpret_cast<const char*>(block_.data()), static_cast<std::streamsize>(block_.size()));
+        off_ += block_.size();
+        block_.clear();
+    }
+};
+
+// -------- merging ----------------------------------------------------------------
+
+// One sorted input of a merge: the memtable or a run.
+struct Source {
+    virtual ~Source() = default;
+    virtual void seek(const Key& low) = 0;
+    virtual bool valid() const = 0;
+    virtual const MemOp& head() const = 0;
+    virtual void advance() = 0;
+};
+
+class MemSource : public Source {
+public:
+    explicit MemSource(const std::vector<MemOp>* mem) : mem_(mem) {}
+    void seek(const Key& low) override {
+        pos_ = static_cast<std::size_t>(std::lower_bound(mem_->begin(), mem_->end(), low,
+            [](const MemOp& o, const Key& k){ return o.key < k; }) - mem_->begin());
+    }
+    bool valid() const override { return pos_ < mem_->size(); }
+    const MemOp& head() const override { return (*mem_)[pos_]; }
+    void advance() override { ++pos_; }
+private:
+    const std::vector<MemOp>* mem_;
+    std::size_t pos_{0};
+};
+
+class RunSource : public Source {
+public:
+    explicit RunSource(std::shared_ptr<const Run> run) : run_(std::move(run)) {}
+    void seek(const Key& low) override {
+        const auto& f = run_->fenceKeys;
+        const std::size_t i = static_cast<std::size_t>(std::lower_bound(f.begin(), f.end(), low) - f.begin());
+        load_(i > 0 ? i - 1 : 0);
+        while (valid() && head().key < low) advance();
+    }
+    bool valid() const override { return valid_; }
+    const MemOp& head() const override { return cur_; }
+    void advance() override {
+        if (p_ < end_) Run::decode(p_, end_, cur_);
+        else load_(block_ + 1);
+    }
+private:
+    std::shared_ptr<const Run> run_;
+    std::size_t block_{0};
+    std::vector<std::uint8_t> buf_;
+    const std::uint8_t* p_{nullptr};
+    const std::uint8_t* end_{nullptr};
+    MemOp cur_;
+    bool valid_{false};
+
+    void load_(std::size_t b) {
+        block_ = b;
+        valid_ = b < run_->fenceOffs.size();
+        if (!valid_) return;
+        run_->readBlock(b, buf_);
+        p_ = buf_.data();
+        end_ = p_ + buf_.size();
+        Run::decode(p_, end_, cur_);
+    }
+};
+
+// Merges sources newest-first: for equal (key, recno) the first source wins
+// and the others are skipped. Tombstones are reported through `live`.
+class Merger {
+public:
+    explicit Merger(std::vector<std::unique_ptr<Source>> srcs) : srcs_(std::move(srcs)) {}
+
+    void seek(const Key& low) { for (auto& s : srcs_) s->seek(low); }
+
+    // Next winning entry, or false when every source is exhausted.
+    bool next(MemOp& out) {
+        Source* win = nullptr;
+        for (auto& s : srcs_) {
+            if (!s->valid()) continue;
+            if (!win || before(s->head().key, s->head().rec, win->head().key, win->head().rec)) win = s.get();
+        }
+        if (!win) return false;
+        out = win->head();
+        for (auto& s : srcs_)
+            while (s->valid() && s->head().rec == out.rec && s->head().key == out.key) s->advance();
+        return true;
+    }
+
+private:
+    std::vector<std::unique_ptr<Source>> srcs_;
+};
+
+// Live entries with low <= key <= high (no upper bound unless `bounded`).
+// Like the multimap cursors, it is invalidated by upsert/erase; runs it
+// reads stay alive through it.
+class LsmCursor : public Cursor {
+public:
+    LsmCursor(std::vector<std::unique_ptr<Source>> srcs, Key low, Key high, bool bounded)
+        : merger_(std::move(srcs)), low_(std::move(low)), high_(std::move(high)), bounded_(bounded) {}
+
+    bool first(Key& outKey, RecNo& outRec) override {
+        merger_.seek(low_);
+        started_ = true;
+        done_ = false;
+        return emit_(outKey, outRec);
+    }
+
+    bool next(Key& outKey, RecNo& outRec) override {
+        if (!started_) return first(outKey, outRec);
+        return emit_(outKey, outRec);
+    }
+
+private:
+    Merger merger_;
+    Key    low_, high_;
+    bool   bounded_;
+    bool   started_{false};
+    bool   done_{false};
+
+    bool emit_(Key& outKey, RecNo& outRec) {
+        MemOp op;
+        while (!done_ && merger_.next(op)) {
+            if (bounded_ && high_ < op.key) break;
+            if (!op.live) continue;
+            outKey = std::move(op.key);
+            outRec = op.rec;
+            return true;
+        }
+        done_ = true;
+        return false;
+    }
+};
+
+} // namespace
+
+// -------- LsmBackend ---------------------------------------------------------------
+
+LsmBackend::~LsmBackend() {
+    try { close(); } catch (...) {}
+}
+
+std::string LsmBackend::runPath_(std::uint64_t seq) const {
+    return path_ + "." + std::to_string(seq) + ".run";
+}
+
+bool LsmBackend::open(const std::string& path) {
+    close();
+    path_ = path;
+    stale_ = false;
+    fileFp_ = 0;
+    nextSeq_ = 1;
+
+    std::ifstream in(path_, std::ios::binary);
+    if (in) {
+        try {
+            char magic[4];
+            in.read(magic, 4);
+            if (!in || std::memcmp(magic, kManifestMagic, 4) != 0) throw std::runtime_error("lsm: bad manifest");
+            fileFp_ = readRaw<std::uint32_t>(in);
+            nextSeq_ = readRaw<std::uint64_t>(in);
+            const std::uint32_t n = readRaw<std::uint32_t>(in);
+            for (std::uint32_t i = 0; i < n; ++i) {
+                const std::uint64_t seq = readRaw<std::uint64_t>(in);
+                runs_.push_back(Run::load(runPath_(seq), seq));
+            }
+        } catch (...) {
+            // Unreadable manifest or run: start empty and let the caller rebuild.
+            runs_.clear();
+            stale_ = true;
+        }
+    }
+    if (fp_ && fileFp_ && fp_ != fileFp_) stale_ = true;
+
+    stop_ = false;
+    worker_ = std::thread(&LsmBackend::workerLoop_, this);
+    return true;
+}
+
+void LsmBackend::close() {
+    if (path_.empty()) return;
+    flush();
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable()) worker_.join();
+
+    std::lock_guard<std::mutex> lk(mu_);
+    writeManifest_();
+    runs_.clear();
+    path_.clear();
+}
+
+void LsmBackend::drop() {
+    if (path_.empty()) return;
+    const std::string manifest = path_;
+    rebuild();  // runs go with their last reference
+    close();
+    std::remove(manifest.c_str());
+}
+
+void LsmBackend::setFingerprint(std::uint32_t fp) {
+    fp_ = fp;
+    if (!path_.empty() && fileFp_ && fp_ != fileFp_) stale_ = true;
+}
+
+void LsmBackend::rebuild() {
+    mem_.clear();
+    memSorted_ = true;
+    std::lock_guard<std::mutex> lk(mu_);
+    for (const auto& r : runs_) r->obsolete = true;
+    runs_.clear();
+    fileFp_ = fp_;
+    stale_ = false;
+    writeManifest_();
+    cv_.notify_all();
+}
+
+void LsmBackend::upsert(const Key& key, RecNo rec) {
+    if (memSorted_ && !mem_.empty() && !before(mem_.back().key, mem_.back().rec, key, rec)) memSorted_ = false;
+    mem_.push_back({key, rec, true});
+    if (mem_.size() >= kMemtableMax) flush();
+}
+
+void LsmBackend::erase(const Key& key, RecNo rec) {
+    if (memSorted_ && !mem_.empty() && !before(mem_.back().key, mem_.back().rec, key, rec)) memSorted_ = false;
+    mem_.push_back({key, rec, false});
+    if (mem_.size() >= kMemtableMax) flush();
+}
+
+// Stable sort keeps op order within a (key, recno); the last op is the one
+// that counts.
+void LsmBackend::sortMem_() const {
+    if (memSorted_) return;
+    std::stable_sort(mem_.begin(), mem_.end(), [](const MemOp& a, const MemOp& b){
+        return before(a.key, a.rec, b.key, b.rec);
+    });
+    std::size_t out = 0;
+    for (std::size_t i = 0; i < mem_.size(); ++i) {
+        if (out && mem_[out - 1].rec == mem_[i].rec && mem_[out - 1].key == mem_[i].key)
+            mem_[out - 1] = std::move(mem_[i]);
+        else if (out != i)
+            mem_[out++] = std::move(mem_[i]);
+        else
+            ++out;
+    }
+    mem_.resize(out);
+    memSorted_ = true;
+}
+
+void LsmBackend::flush() {
+    if (mem_.empty() || path_.empty()) return;
+    sortMem_();
+
+    std::uint64_t seq = 0;
+    {
+        // Back-pressure: let compaction catch up instead of piling up runs.
+        std::unique_lock<std::mutex> lk(mu_);
+        cv_.wait(lk, [&]{ return stop_ || runs_.size() < kStallRuns; });
+        seq = nextSeq_++;
+    }
+
+    RunWriter w(runPath_(seq), seq);
+    std::shared_ptr<Run> run;
+    try {
+        for (const auto& op : mem_) w.add(op);
+        run = w.finish();
+    } catch (...) {
+        w.abandon();
+        throw;
+    }
+
+    std::lock_guard<std::mutex> lk(mu_);
+    runs_.push_back(std::move(run));
+    writeManifest_();
+    mem_.clear();
+    cv_.notify_all();
+}
+
+void LsmBackend::compact() {
+    const RunList in = snapshot_();
+    if (in.size() < 2) return;
+    auto out = mergeRuns_(in);
+    std::lock_guard<std::mutex> lk(mu_);
+    install_(in, std::move(out));
+}
+
+std::size_t LsmBackend::runCount() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return runs_.size();
+}
+
+LsmBackend::RunList LsmBackend::snapshot_() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return runs_;
+}
+
+// "LSM1" | u32 fingerprint | u64 next seq | u32 n | n x u64 run seq.
+// Written to a temp file and renamed over, so a crash leaves either manifest.
+void LsmBackend::writeManifest_() {
+    if (path_.empty()) return;
+    const std::string tmp = path_ + ".tmp";
+    {
+        std::ofstream os(tmp, std::ios::binary | std::ios::trunc);
+        if (!os) throw std::runtime_error("lsm: cannot write " + tmp);
+        os.write(kManifestMagic, 4);
+        writeRaw(os, fp_ ? fp_ : fileFp_);
+        writeRaw(os, nextSeq_);
+        writeRaw(os, static_cast<std::uint32_t>(runs_.size()));
+        for (const auto& r : runs_) writeRaw(os, r->seq);
+        if (!os) throw std::runtime_error("lsm: cannot write " + tmp);
+    }
+    std::filesystem::rename(tmp, path_);
+}
+
+void LsmBackend::workerLoop_() {
+    std::unique_lock<std::mutex> lk(mu_);
+    for (;;) {
+        cv_.wait(lk, [&]{ return stop_ || runs_.size() >= kMaxRuns; });
+        if (stop_) return;
+
+        const RunList in = runs_;
+        lk.unlock();
+        std::shared_ptr<const Run> out;
+        bool ok = true;
+        try { out = mergeRuns_(in); } catch (...) { ok = false; }
+        lk.lock();
+
+        if (ok) {
+            try { install_(in, std::move(out)); } catch (...) { ok = false; }
+        }
+        if (!ok) {
+            // Leave the runs alone until something changes; a read still works.
+            const std::size_t n = runs_.size();
+            cv_.wait(lk, [&]{ return stop_ || runs_.size() != n; });
+        }
+    }
+}
+
+// `in` covers every run older than anything flushed since, so tombstones
+// have nothing left to shadow and are dropped.
+std::shared_ptr<const LsmBackend::Run> LsmBackend::mergeRuns_(const RunList& in) {
+    std::vector<std::unique_ptr<Source>> srcs;
+    for (auto it = in.rbegin(); it != in.rend(); ++it) srcs.push_back(std::make_unique<RunSource>(*it));
+    Merger m(std::move(srcs));
+    m.seek(Key{});
+
+    std::uint64_t seq = 0;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        seq = nextSeq_++;
+    }
+    RunWriter w(runPath_(seq), seq);
+    try {
+        MemOp op;
+        while (m.next(op))
+            if (op.live) w.add(op);
+        if (w.count() == 0) { w.abandon(); return nullptr; }
+        return w.finish();
+    } catch (...) {
+        w.abandon();
+        throw;
+    }
+}
+
+void LsmBackend::install_(const RunList& merged, std::shared_ptr<const Run> out) {
+    const bool samePrefix = merged.size() <= runs_.size() &&
+                            std::equal(merged.begin(), merged.end(), runs_.begin());
+    if (!samePrefix) {
+        // rebuild() or another compaction got there first.
+        if (out) out->obsolete = true;
+        return;
+    }
+    RunList next;
+    if (out) next.push_back(std::move(out));
+    next.insert(next.end(), runs_.begin() + static_cast<std::ptrdiff_t>(merged.size()), runs_.end());
+    runs_.swap(next);
+    writeManifest_();
+    for (const auto& r : merged) r->obsolete = true;
+    cv_.notify_all();
+}
+
+std::unique_ptr<Cursor> LsmBackend::seek(const Key& key) const {
+    sortMem_();
+    std::vector<std::unique_ptr<Source>> srcs;
+    srcs.push_back(std::make_unique<MemSource>(&mem_));
+    const RunList runs = snapshot_();
+    for (auto it = runs.rbegin(); it != runs.rend(); ++it)
+        if ((*it)->mayContain(key)) srcs.push_back(std::make_unique<RunSource>(*it));
+    return std::unique_ptr<Cursor>(new LsmCursor(std::move(srcs), key, key, true));
+}
+
+std::unique_ptr<Cursor> LsmBackend::scan(const Key& low, const Key& high) const {
+    sortMem_();
+    std::vector<std::unique_ptr<Source>> srcs;
+    srcs.push_back(std::make_unique<MemSource>(&mem_));
+    const RunList runs = snapshot_();
+    for (auto it = runs.rbegin(); it != runs.rend(); ++it) srcs.push_back(std::make_unique<RunSource>(*it));
+    return std::unique_ptr<Cursor>(new LsmCursor(std::move(srcs), low, high, !high.empty()));
+}
+
+std::size_t LsmBackend::size() const {
+    std::size_t n = 0;
+    Key k;
+    RecNo r;
+    auto c = scan({}, {});
+    for (bool ok = c->first(k, r); ok; ok = c->next(k, r)) ++n;
+    return n;
+}
+
+} // namespace xindex
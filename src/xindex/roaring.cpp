@@ -0,0 +1,292 @@
+#include "xindex/roaring.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+
+namespace xindex {
+
+// -------- bit helpers ----------------------------------------------------------
+
+std::uint32_t RoaringBitmap::lowestBit_(std::uint64_t w) {
+#if defined(_MSC_VER)
+    unsigned long i; _BitScanForward64(&i, w); return static_cast<std::uint32_t>(i);
+#else
+    return static_cast<std::uint32_t>(__builtin_ctzll(w));
+#endif
+}
+
+std::uint32_t RoaringBitmap::popcount_(std::uint64_t w) {
+#if defined(_MSC_VER)
+    return static_cast<std::uint32_t>(__popcnt64(w));
+#else
+    return static_cast<std::uint32_t>(__builtin_popcountll(w));
+#endif
+}
+
+// -------- container representation ------------------------------------------
+
+void RoaringBitmap::toBitset_(Container& c) {
+    if (c.isBitset()) return;
+    c.bits.assign(kWords, 0);
+    for (std::uint16_t v : c.array) c.bits[v >> 6] |= (std::uint64_t{1} << (v & 63));
+    c.array.clear();
+    c.array.shrink_to_fit();
+}
+
+void RoaringBitmap::toArray_(Container& c) {
+    if (!c.isBitset()) return;
+    std::vector<std::uint16_t> arr;
+    arr.reserve(c.card);
+    for (std::uint32_t w = 0; w < kWords; ++w) {
+        std::uint64_t word = c.bits[w];
+        while (word) {
+            arr.push_back(static_cast<std::uint16_t>(w * 64 + lowestBit_(word)));
+            word &= word - 1;
+        }
+    }
+    c.array.swap(arr);
+    c.bits.clear();
+    c.bits.shrink_to_fit();
+}
+
+void RoaringBitmap::normalize_(Container& c) {
+    if (c.card > kArrayMax) toBitset_(c);
+    else toArray_(c);
+}
+
+RoaringBitmap::Container* RoaringBitmap::find_(std::uint16_t key) {
+    auto it = std::lower_bound(cs_.begin(), cs_.end(), key,
+        [](const Container& c, std::uint16_t k){ return c.key < k; });
+    return (it != cs_.end() && it->key == key) ? &*it : nullptr;
+}
+
+const RoaringBitmap::Container* RoaringBitmap::find_(std::uint16_t key) const {
+    return const_cast<RoaringBitmap*>(this)->find_(key);
+}
+
+// -------- point ops --------------------------------------------------------------
+
+RoaringBitmap RoaringBitmap::range(std::uint32_t lo, std::uint32_t hi) {
+    RoaringBitmap r;
+    for (std::uint64_t cur = lo; cur < hi; ) {
+        const std::uint64_t base = cur & ~std::uint64_t{0xFFFF};
+        const std::uint64_t end  = std::min<std::uint64_t>(hi, base + 0x10000);
+        const std::uint32_t from = static_cast<std::uint32_t>(cur - base);
+        const std::uint32_t to   = static_cast<std::uint32_t>(end - base);
+        Container c;
+        c.key  = static_cast<std::uint16_t>(base >> 16);
+        c.card = to - from;
+        if (c.card > kArrayMax) {
+            c.bits.assign(kWords, 0);
+            for (std::uint32_t v = from; v < to; ++v) c.bits[v >> 6] |= (std::uint64_t{1} << (v & 63));
+        } else {
+            c.array.reserve(c.card);
+            for (std::uint32_t v = from; v < to; ++v) c.array.push_back(static_cast<std::uint16_t>(v));
+        }
+        r.cs_.push_back(std::move(c));
+        cur = end;
+    }
+    return r;
+}
+
+void RoaringBitmap::add(std::uint32_t v) {
+    const std::uint16_t key = static_cast<std::uint16_t>(v >> 16);
+    const std::uint16_t lo  = static_cast<std::uint16_t>(v & 0xFFFF);
+    auto it = std::lower_bound(cs_.begin(), cs_.end(), key,
+        [](const Container& c, std::uint16_t k){ return c.key < k; });
+    if (it == cs_.end() || it->key != key) {
+        Container c;
+        c.key = key;
+        it = cs_.insert(it, std::move(c));
+    }
+    Container& c = *it;
+    if (c.isBitset()) {
+        std::uint64_t& w = c.bits[lo >> 6];
+        const std::uint64_t m = std::uint64_t{1} << (lo & 63);
+        if (!(w & m)) { w |= m; ++c.card; }
+        return;
+    }
+    auto pos = std::lower_bound(c.array.begin(), c.array.end(), lo);
+    if (pos != c.array.end() && *pos == lo) return;
+    c.array.insert(pos, lo);
+    ++c.card;
+    if (c.card > kArrayMax) toBitset_(c);
+}
+
+bool RoaringBitmap::remove(std::uint32_t v) {
+    const std::uint16_t key = static_cast<std::uint16_t>(v >> 16);
+    const std::uint16_t lo  = static_cast<std::uint16_t>(v & 0xFFFF);
+    Container* c = find_(key);
+    if (!c) return false;
+    if (c->isBitset()) {
+        std::uint64_t& w = c->bits[lo >> 6];
+        const std::uint64_t m = std::uint64_t{1} << (lo & 63);
+        if (!(w & m)) return false;
+        w &= ~m;
+        --c->card;
+        if (c->card <= kArrayMax) toArray_(*c);
+    } else {
+        auto pos = std::lower_bound(c->array.begin(), c->array.end(), lo);
+        if (pos == c->array.end() || *pos != lo) return false;
+        c->array.erase(pos);
+        --c->card;
+    }
+    if (c->card == 0) cs_.erase(cs_.begin() + (c - cs_.data()));
+    return true;
+}
+
+bool RoaringBitmap::contains(std::uint32_t v) const {
+    const Container* c = find_(static_cast<std::uint16_t>(v >> 16));
+    if (!c) return false;
+    const std::uint16_t lo = static_cast<std::uint16_t>(v & 0xFFFF);
+    if (c->isBitset()) return (c->bits[lo >> 6] >> (lo & 63)) & 1;
+    return std::binary_search(c->array.begin(), c->array.end(), lo);
+}
+
+std::uint64_t RoaringBitmap::cardinality() const {
+    std::uint64_t n = 0;
+    for (const auto& c : cs_) n += c.card;
+    return n;
+}
+
+bool RoaringBitmap::operator==(const RoaringBitmap& o) const {
+    if (cs_.size() != o.cs_.size()) return false;
+    for (size_t i = 0; i < cs_.size(); ++i) {
+        const Container& a = cs_[i];
+        const Container& b = o.cs_[i];
+        if (a.key != b.key || a.card != b.card) return false;
+        if (a.isBitset() != b.isBitset()) return false; // normalized => same shape
+        if (a.isBitset() ? a.bits != b.bits : a.array != b.array) return false;
+    }
+    return true;
+}
+
+std::vector<std::uint32_t> RoaringBitmap::toVector() const {
+    std::vector<std::uint32_t> out;
+    out.reserve(static_cast<size_t>(cardinality()));
+    forEach([&](std::uint32_t v){ out.push_back(v); return true; });
+    return out;
+}
+
+// -------- container set ops --------------------------------------------------
+
+RoaringBitmap::Container RoaringBitmap::and_(const Container& a, const Container& b) {
+    Container r;
+    r.key = a.key;
+    if (a.isBitset() && b.isBitset()) {
+        r.bits.resize(kWords);
+        for (std::uint32_t w = 0; w < kWords; ++w) {
+            r.bits[w] = a.bits[w] & b.bits[w];
+            r.card += popcount_(r.bits[w]);
+        }
+        normalize_(r);
+        return r;
+    }
+    if (a.isBitset() || b.isBitset()) {
+        const Container& arr = a.isBitset() ? b : a;
+        const Container& bs  = a.isBitset() ? a : b;
+        for (std::uint16_t v : arr.array)
+            if ((bs.bits[v >> 6] >> (v & 63)) & 1) r.array.push_back(v);
+        r.card = static_cast<std::uint32_t>(r.array.size());
+        return r;
+    }
+    std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                          std::back_inserter(r.array));
+    r.card = static_cast<std::uint32_t>(r.array.size());
+    return r;
+}
+
+RoaringBitmap::Container RoaringBitmap::or_(const Container& a, const Container& b) {
+    Container r;
+    r.key = a.key;
+    if (!a.isBitset() && !b.isBitset() && a.card + b.card <= kArrayMax) {
+        std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                       std::back_inserter(r.array));
+        r.card = static_cast<std::uint32_t>(r.array.size());
+        return r;
+    }
+    r.bits.assign(kWords, 0);
+    for (const Container* c : {&a, &b}) {
+        if (c->isBitset()) for (std::uint32_t w = 0; w < kWords; ++w) r.bits[w] |= c->bits[w];
+        else for (std::uint16_t v : c->array) r.bits[v >> 6] |= (std::uint64_t{1} << (v & 63));
+    }
+    for (std::uint64_t w : r.bits) r.card += popcount_(w);
+    normalize_(r);
+    return r;
+}
+
+RoaringBitmap::Container RoaringBitmap::andNot_(const Container& a, const Container& b) {
+    Container r;
+    r.key = a.key;
+    if (a.isBitset()) {
+        r.bits = a.bits;
+        if (b.isBitset()) for (std::uint32_t w = 0; w < kWords; ++w) r.bits[w] &= ~b.bits[w];
+        else for (std::uint16_t v : b.array) r.bits[v >> 6] &= ~(std::uint64_t{1} << (v & 63));
+        for (std::uint64_t w : r.bits) r.card += popcount_(w);
+        normalize_(r);
+        return r;
+    }
+    if (b.isBitset()) {
+        for (std::uint16_t v : a.array)
+            if (!((b.bits[v >> 6] >> (v & 63)) & 1)) r.array.push_back(v);
+    } else {
+        std::set_difference(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                            std::back_inserter(r.array));
+    }
+    r.card = static_cast<std::uint32_t>(r.array.size());
+    return r;
+}
+
+// -------- bitmap set ops -------------------------------------------------------
+
+RoaringBitmap& RoaringBitmap::operator&=(const RoaringBitmap& o) {
+    std::vector<Container> out;
+    size_t i = 0, j = 0;
+    while (i < cs_.size() && j < o.cs_.size()) {
+        if (cs_[i].key < o.cs_[j].key) ++i;
+        else if (o.cs_[j].key < cs_[i].key) ++j;
+        else {
+            Container c = and_(cs_[i], o.cs_[j]);
+            if (c.card) out.push_back(std::move(c));
+            ++i; ++j;
+        }
+    }
+    cs_.swap(out);
+    return *this;
+}
+
+RoaringBitmap& RoaringBitmap::operator|=(const RoaringBitmap& o) {
+    std::vector<Container> out;
+    out.reserve(cs_.size() + o.cs_.size());
+    size_t i = 0, j = 0;
+    while (i < cs_.size() || j < o.cs_.size()) {
+        if (j == o.cs_.size() || (i < cs_.size() && cs_[i].key < o.cs_[j].key)) out.push_back(std::move(cs_[i++]));
+        else if (i == cs_.size() || o.cs_[j].key < cs_[i].key) out.push_back(o.cs_[j++]);
+        else { out.push_back(or_(cs_[i], o.cs_[j])); ++i; ++j; }
+    }
+    cs_.swap(out);
+    return *this;
+}
+
+RoaringBitmap& RoaringBitmap::operator-=(const RoaringBitmap& o) {
+    std::vector<Container> out;
+    out.reserve(cs_.size());
+    size_t j = 0;
+    for (auto& c : cs_) {
+        while (j < o.cs_.size() && o.cs_[j].key < c.key) ++j;
+        if (j < o.cs_.size() && o.cs_[j].key == c.key) {
+            Container d = andNot_(c, o.cs_[j]);
+            if (d.card) out.push_back(std::move(d));
+        } else {
+            out.push_back(std::move(c));
+        }
+    }
+    cs_.swap(out);
+    return *this;
+}
+
+} // namespace xindex
@@ -0,0 +1,267 @@
+#include "xindex/static_index.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+
+namespace xindex {
+
+namespace {
+
+constexpr char kStaticMagic[4] = {'E', 'Y', 'T', '1'};
+constexpr uint32_t kHasPayloads = 1;
+
+// Count of trailing 1 bits.
+inline unsigned trailingOnes(uint64_t k) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_ctzll(~k));
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long i;
+    _BitScanForward64(&i, ~k);
+    return static_cast<unsigned>(i);
+#else
+    unsigned n = 0;
+    while (k & 1) { k >>= 1; ++n; }
+    return n;
+#endif
+}
+
+inline void prefetch(const void* p) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(p);
+#else
+    (void)p;
+#endif
+}
+
+void put32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+void put64(std::vector<uint8_t>& out, uint64_t v) {
+    for (int i = 0; i < 8; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+
+struct Reader {
+    const uint8_t* p;
+    const uint8_t* end;
+    const uint8_t* take(size_t n) {
+        if (static_cast<size_t>(end - p) < n) throw std::runtime_error("StaticIndex: truncated file");
+        const uint8_t* at = p;
+        p += n;
+        return at;
+    }
+    uint32_t u32() { const uint8_t* b = take(4); return uint32_t(b[0]) | uint32_t(b[1]) << 8 | uint32_t(b[2]) << 16 | uint32_t(b[3]) << 24; }
+    uint64_t u64() { const uint64_t lo = u32(); return lo | uint64_t(u32()) << 32; }
+    template <class T>
+    void array(std::vector<T>& v, uint64_t n) {
+        if (n > static_cast<uint64_t>(end - p) / 4) throw std::runtime_error("StaticIndex: truncated file");
+        v.resize(static_cast<size_t>(n));
+        for (auto& x : v) x = static_cast<T>(u32());
+    }
+};
+
+uint64_t fnv1a(const uint8_t* p, size_t n) {
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < n; ++i) { h ^= p[i]; h *= 1099511628211ull; }
+    return h;
+}
+
+} // namespace
+
+// ---- build ----
+
+void StaticIndex::append(const std::vector<uint8_t>& key, int32_t rec, const std::vector<uint8_t>& payload) {
+    const size_t k = keyCount();
+    const bool same = k > 0 && keyEq_(k - 1, key);
+    if (!same) {
+        keyBytes_.insert(keyBytes_.end(), key.begin(), key.end());
+        keyOff_.push_back(static_cast<uint32_t>(keyBytes_.size()));
+        postStart_.push_back(postStart_.back());
+    }
+    recs_.push_back(rec);
+    ++postStart_.back();
+    if (!payload.empty() && payOff_.empty()) payOff_.assign(recs_.size(), 0);
+    if (!payOff_.empty()) {
+        payBytes_.insert(payBytes_.end(), payload.begin(), payload.end());
+        payOff_.push_back(static_cast<uint32_t>(payBytes_.size()));
+    }
+}
+
+void StaticIndex::seal() {
+    const size_t n = keyCount();
+    // Bytes every key starts with (those of the first and last key) say
+    // nothing; the prefixes start after them.
+    lead_ = 0;
+    if (n > 0) {
+        const size_t end = std::min(keyOff_[1], keyOff_[n] - keyOff_[n - 1]);
+        while (lead_ < end && keyBytes_[lead_] == keyBytes_[keyOff_[n - 1] + lead_]) ++lead_;
+    }
+    eyt_.assign(n + 1, 0);
+    rank_.assign(n + 1, 0);
+    // In-order walk of the implicit tree hands out keys in sorted order.
+    size_t next = 0;
+    auto fill = [&](auto&& self, size_t k) -> void {
+        if (k > n) return;
+        self(self, 2 * k);
+        eyt_[k] = prefixAt_(next);
+        rank_[k] = static_cast<uint32_t>(next++);
+        self(self, 2 * k + 1);
+    };
+    fill(fill, 1);
+}
+
+// ---- search ----
+
+uint64_t StaticIndex::prefix_(const uint8_t* p, size_t n) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < 8; ++i) v = v << 8 | (i < n ? p[i] : 0);
+    return v;
+}
+
+bool StaticIndex::keyLess_(size_t i, const std::vector<uint8_t>& k) const {
+    return std::lexicographical_compare(keyBytes_.begin() + keyOff_[i], keyBytes_.begin() + keyOff_[i + 1],
+                                        k.begin(), k.end());
+}
+
+bool StaticIndex::keyEq_(size_t i, const std::vector<uint8_t>& k) const {
+    const size_t len = keyOff_[i + 1] - keyOff_[i];
+    return len == k.size() && std::equal(k.begin(), k.end(), keyBytes_.begin() + keyOff_[i]);
+}
+
+size_t StaticIndex::prefixLowerBound_(uint64_t x) const {
+    const size_t n = keyCount();
+    const uint64_t* e = eyt_.data();
+    size_t k = 1;
+    while (k <= n) {
+        prefetch(e + std::min(16 * k, n));  // four levels down, one line
+        k = 2 * k + (e[k] < x);
+    }
+    // Undo the trailing right turns and the final left one.
+    k >>= trailingOnes(k) + 1;
+    return k ? rank_[k] : n;
+}
+
+size_t StaticIndex::lowerBound(const std::vector<uint8_t>& k) const {
+    const size_t n = keyCount();
+    if (n == 0) return 0;
+    // Against the shared leading bytes first: a key that differs there sorts
+    // before or after all of them.
+    const size_t m = std::min(lead_, k.size());
+    const int c = m ? std::memcmp(k.data(), keyBytes_.data(), m) : 0;
+    if (c < 0 || (c == 0 && k.size() < lead_)) return 0;
+    if (c > 0) return n;
+
+    const uint64_t x = prefix_(k.data() + lead_, k.size() - lead_);
+    size_t lo = prefixLowerBound_(x);
+    if (lo == n || prefixAt_(lo) != x || !keyLess_(lo, k)) return lo;
+    // Keys sharing the prefix are adjacent: gallop over them, then bisect.
+    size_t step = 1, hi = lo + 1;
+    while (hi < n && prefixAt_(hi) == x && keyLess_(hi, k)) {
+        lo = hi;
+        step *= 2;
+        hi = std::min(n, lo + step);
+    }
+    ++lo;  // keyLess_(lo) held
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (keyLess_(mid, k)) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+std::optional<int32_t> StaticIndex::seekGE(const std::vector<uint8_t>& k) const {
+    const size_t i = lowerBound(k);
+    if (i == keyCount()) return std::nullopt;
+    return recs_[postStart_[i]];
+}
+
+bool StaticIndex::contains(const std::vector<uint8_t>& k) const {
+    const size_t i = lowerBound(k);
+    return i < keyCount() && keyEq_(i, k);
+}
+
+// ---- file ----
+// "EYT1" | u32 flags | u64 keys | u64 recs | u64 key bytes | u64 payload bytes
+// | keyOff | postStart | recs | key bytes | [payOff | payload bytes]
+// | u64 extra bytes | extra | u64 checksum
+
+void StaticIndex::save(const std::string& path, const std::vector<uint8_t>& extra) const {
+    std::vector<uint8_t> out(kStaticMagic, kStaticMagic + 4);
+    put32(out, payOff_.empty() ? 0 : kHasPayloads);
+    put64(out, keyCount());
+    put64(out, recs_.size());
+    put64(out, keyBytes_.size());
+    put64(out, payBytes_.size());
+    for (uint32_t v : keyOff_) put32(out, v);
+    for (uint32_t v : postStart_) put32(out, v);
+    for (int32_t r : recs_) put32(out, static_cast<uint32_t>(r));
+    out.insert(out.end(), keyBytes_.begin(), keyBytes_.end());
+    if (!payOff_.empty()) {
+        for (uint32_t v : payOff_) put32(out, v);
+        out.insert(out.end(), payBytes_.begin(), payBytes_.end());
+    }
+    put64(out, extra.size());
+    out.insert(out.end(), extra.begin(), extra.end());
+    put64(out, fnv1a(out.data(), out.size()));
+
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    if (!ofs) throw std::runtime_error("StaticIndex: cannot open " + path + " for write");
+    ofs.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+    ofs.close();
+    if (!ofs) throw std::runtime_error("StaticIndex: write failed for " + path);
+}
+
+bool StaticIndex::isStaticFile(const std::string& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    char magic[4] = {};
+    return ifs.read(magic, 4) && std::equal(magic, magic + 4, kStaticMagic);
+}
+
+bool StaticIndex::load(const std::string& path, std::vector<uint8_t>& extra) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) throw std::runtime_error("StaticIndex: cannot open " + path);
+    const std::vector<uint8_t> buf((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    if (buf.size() < 4 || !std::equal(kStaticMagic, kStaticMagic + 4, buf.begin())) return false;
+    if (buf.size() < 12 || Reader{buf.data() + buf.size() - 8, buf.data() + buf.size()}.u64() !=
+                           fnv1a(buf.data(), buf.size() - 8))
+        throw std::runtime_error("StaticIndex: checksum mismatch in " + path);
+
+    Reader r{buf.data() + 4, buf.data() + buf.size() - 8};
+    const uint32_t flags = r.u32();
+    const uint64_t nKeys = r.u64(), nRecs = r.u64(), keyLen = r.u64(), payLen = r.u64();
+    r.array(keyOff_, nKeys + 1);
+    r.array(postStart_, nKeys + 1);
+    r.array(recs_, nRecs);
+    const uint8_t* kb = r.take(static_cast<size_t>(keyLen));
+    keyBytes_.assign(kb, kb + keyLen);
+    payOff_.clear();
+    payBytes_.clear();
+    if (flags & kHasPayloads) {
+        r.array(payOff_, nRecs + 1);
+        const uint8_t* pb = r.take(static_cast<size_t>(payLen));
+        payBytes_.assign(pb, pb + payLen);
+    }
+    const uint64_t extraLen = r.u64();
+    const uint8_t* xb = r.take(static_cast<size_t>(extraLen));
+    extra.assign(xb, xb + extraLen);
+
+    auto monotone = [](const std::vector<uint32_t>& v, uint64_t last, bool strict) {
+        if (v.empty() || v.front() != 0 || v.back() != last) return false;
+        for (size_t i = 1; i < v.size(); ++i)
+            if (strict ? v[i] <= v[i - 1] : v[i] < v[i - 1]) return false;
+        return true;
+    };
+    if (!monotone(keyOff_, keyLen, false) || !monotone(postStart_, nRecs, true) ||
+        ((flags & kHasPayloads) && !monotone(payOff_, payLen, false)))
+        throw std::runtime_error("StaticIndex: bad offsets in " + path);
+    seal();
+    return true;
+}
+
+} // namespace xindex
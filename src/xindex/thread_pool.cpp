@@ -0,0 +1,161 @@
+#include "xindex/thread_pool.hpp"
+
+#include <chrono>
+
+namespace xindex {
+
+namespace {
+
+// The pool and deque of the worker running on this thread, if any.
+thread_local const ThreadPool* tlsPool = nullptr;
+thread_local size_t tlsSelf = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned threads) { start_(threads); }
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool(hardwareThreads());
+    return pool;
+}
+
+unsigned ThreadPool::hardwareThreads() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ThreadPool::start_(unsigned threads) {
+    const size_t n = threads > 1 ? threads - 1 : 0;
+    stop_ = false;
+    queues_.clear();
+    for (size_t i = 0; i < n; ++i) queues_.push_back(std::make_unique<Queue>());
+    workers_.reserve(n);
+    for (size_t i = 0; i < n; ++i) workers_.emplace_back(&ThreadPool::work_, this, i);
+}
+
+void ThreadPool::resize(unsigned threads) {
+    shutdown();
+    start_(threads);
+}
+
+void ThreadPool::shutdown() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& t : workers_) t.join();
+    workers_.clear();
+    queues_.clear();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    if (workers_.empty()) { task(); return; }
+    const size_t q = tlsPool == this ? tlsSelf : next_.fetch_add(1) % queues_.size();
+    // Count the task before it can be taken, so take_ never runs pending_
+    // below zero.
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        ++pending_;
+    }
+    {
+        std::lock_guard<std::mutex> lk(queues_[q]->mu);
+        queues_[q]->tasks.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+// Own deque from the back, then the others' from the front.
+bool ThreadPool::take_(size_t self, std::function<void()>& task) {
+    const size_t n = queues_.size();
+    for (size_t k = 0; k < n; ++k) {
+        Queue& q = *queues_[(self + k) % n];
+        {
+            std::lock_guard<std::mutex> lk(q.mu);
+            if (q.tasks.empty()) continue;
+            if (k == 0) { task = std::move(q.tasks.back()); q.tasks.pop_back(); }
+            else        { task = std::move(q.tasks.front()); q.tasks.pop_front(); }
+        }
+        std::lock_guard<std::mutex> lk(mu_);
+        --pending_;
+        return true;
+    }
+    return false;
+}
+
+bool ThreadPool::runOne() {
+    if (queues_.empty()) return false;
+    std::function<void()> task;
+    // Outside the pool there is no own deque; start anywhere and steal.
+    const size_t self = tlsPool == this ? tlsSelf : next_.load() % queues_.size();
+    if (!take_(self, task)) return false;
+    task();
+    return true;
+}
+
+void ThreadPool::work_(size_t self) {
+    tlsPool = this;
+    tlsSelf = self;
+    std::function<void()> task;
+    for (;;) {
+        if (take_(self, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(mu_);
+        wake_.wait(lk, [&]{ return stop_ || pending_ > 0; });
+        if (stop_ && pending_ == 0) return;
+    }
+}
+
+// -------- TaskGroup ---------------------------------------------------------------
+
+void TaskGroup::run(std::function<void()> task) {
+    ++left_;
+    pool_.submit([this, task = std::move(task)]{
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lk(mu_);
+            if (!error_) error_ = std::current_exception();
+        }
+        // Notify under the lock: the group may be destroyed as soon as a
+        // waiter sees left_ reach 0.
+        std::lock_guard<std::mutex> lk(mu_);
+        if (--left_ == 0) done_.notify_all();
+    });
+}
+
+void TaskGroup::wait_() {
+    while (left_ > 0) {
+        if (pool_.runOne()) continue;
+        // Nothing queued: the rest are running elsewhere (or about to be
+        // queued by one of them), so check back now and then.
+        std::unique_lock<std::mutex> lk(mu_);
+        done_.wait_for(lk, std::chrono::milliseconds(1), [&]{ return left_ == 0; });
+    }
+    std::lock_guard<std::mutex> lk(mu_); // last task is out of its lock
+}
+
+void TaskGroup::wait() {
+    wait_();
+    if (error_) {
+        auto e = error_;
+        error_ = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+void parallelFor(size_t n, const std::function<void(size_t)>& fn, ThreadPool& pool) {
+    if (n == 0) return;
+    if (n == 1 || pool.threads() == 1) {
+        for (size_t i = 0; i < n; ++i) fn(i);
+        return;
+    }
+    TaskGroup g(pool);
+    for (size_t i = 1; i < n; ++i) g.run([&fn, i]{ fn(i); });
+    fn(0);
+    g.wait();
+}
+
+} // namespace xindex
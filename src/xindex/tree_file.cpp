@@ -0,0 +1,410 @@
+#include "xindex/tree_file.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace xindex {
+
+namespace {
+
+constexpr char kTreeMagic[4]    = {'B', 'P', 'T', '4'};
+constexpr char kJournalMagic[4] = {'J', 'N', 'L', '1'};
+constexpr char kBloomMagic[4]   = {'X', 'B', 'L', 'M'};  // trailer of pre-BPT4 files
+constexpr size_t kHeaderBytes   = 4 + 4 * 3 + 8 + 4 * 7 + 4 + 8 * 2 + 4 * 3 + 8;
+
+// Fixed-width fields are little-endian regardless of host.
+void put32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+void put64(std::vector<uint8_t>& out, uint64_t v) {
+    for (int i = 0; i < 8; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+uint32_t get32(const uint8_t* p) { return TreeFile::le32(p); }
+uint64_t get64(const uint8_t* p) { return TreeFile::le64(p); }
+
+uint64_t fnv1a(const uint8_t* p, size_t n) {
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < n; ++i) { h ^= p[i]; h *= 1099511628211ull; }
+    return h;
+}
+
+std::vector<uint8_t> readAll(const std::string& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) throw std::runtime_error("TreeFile: cannot open " + path);
+    return std::vector<uint8_t>((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+// ---- load ----
+
+bool TreeFile::load(const std::string& path, BPlusTree& t, BloomFilter& b, bool wantBloom) {
+    path_ = path;
+    paged_ = false;
+    ext_.clear();
+    recover_();
+
+    const auto buf = readAll(path_);
+    b.disable();
+    Header h;
+    if (readHeader(buf.data(), buf.size(), h)) return loadPaged_(buf, h, t, b, wantBloom);
+    return loadLegacy_(t, b, wantBloom);
+}
+
+bool TreeFile::readHeader(const uint8_t* f, size_t size, Header& h) {
+    if (size < kPageSize || !std::equal(kTreeMagic, kTreeMagic + 4, f)) return false;
+    if (get64(f + kHeaderBytes - 8) != fnv1a(f, kHeaderBytes - 8))
+        throw std::runtime_error("TreeFile: header checksum mismatch");
+    if (get32(f + 4) != kPageSize) throw std::runtime_error("TreeFile: unsupported page size");
+    h.order      = static_cast<int>(get32(f + 8));
+    h.root       = static_cast<int>(get32(f + 12));
+    h.count      = get64(f + 16);
+    h.nodeCount  = get32(f + 24);
+    h.dirPage    = get32(f + 28);
+    h.dirPages   = get32(f + 32);
+    h.bloomPage  = get32(f + 36);
+    h.bloomPages = get32(f + 40);
+    h.endPage    = get32(f + 44);
+    h.waste      = get32(f + 48);
+    h.bloomBits  = get32(f + 52);
+    h.bloomCap   = get64(f + 56);
+    h.bloomAdded = get64(f + 64);
+    h.infoPage   = get32(f + 72);
+    h.infoPages  = get32(f + 76);
+    h.infoLen    = get32(f + 80);
+
+    const uint64_t filePages = size / kPageSize;
+    auto within = [&](uint64_t page, uint64_t pages) { return page >= 1 && page + pages <= filePages; };
+    if (h.endPage > filePages || !within(h.dirPage, h.dirPages) ||
+        static_cast<uint64_t>(h.dirPages) * kDirPerPage < h.nodeCount ||
+        h.nodeCount == 0 || h.root < 0 || static_cast<uint32_t>(h.root) >= h.nodeCount ||
+        h.bloomBits % 64 ||
+        (h.bloomBits && (!within(h.bloomPage, h.bloomPages) ||
+                         h.bloomBits / 64 > static_cast<uint64_t>(h.bloomPages) * BloomFilter::kWordsPerPage)) ||
+        h.infoLen > static_cast<uint64_t>(h.infoPages) * kPageSize ||
+        (h.infoPages && !within(h.infoPage, h.infoPages)))
+        throw std::runtime_error("TreeFile: bad layout");
+    return true;
+}
+
+TreeFile::Extent TreeFile::readExtent(const uint8_t* f, size_t size, const Header& h, uint32_t id) {
+    const uint8_t* e = f + static_cast<size_t>(h.dirPage + id / kDirPerPage) * kPageSize
+                         + (id % kDirPerPage) * kDirEntry;
+    Extent x;
+    x.page = get32(e); x.pages = get32(e + 4); x.len = get32(e + 8);
+    if (x.page < 1 || static_cast<uint64_t>(x.page) + x.pages > size / kPageSize ||
+        x.len > static_cast<uint64_t>(x.pages) * kPageSize)
+        throw std::runtime_error("TreeFile: bad node extent");
+    return x;
+}
+
+std::string TreeFile::readInfo(const uint8_t* f, const Header& h) {
+    const uint8_t* p = f + static_cast<size_t>(h.infoPage) * kPageSize;
+    return h.infoLen ? std::string(reinterpret_cast<const char*>(p), h.infoLen) : std::string{};
+}
+
+bool TreeFile::loadPaged_(const std::vector<uint8_t>& buf, const Header& h,
+                          BPlusTree& t, BloomFilter& b, bool wantBloom) {
+    const uint8_t* f = buf.data();
+    dirPage_    = h.dirPage;
+    dirPages_   = h.dirPages;
+    bloomPage_  = h.bloomPage;
+    bloomPages_ = h.bloomPages;
+    infoPage_   = h.infoPage;
+    infoPages_  = h.infoPages;
+    info_       = readInfo(f, h);
+    infoDirty_  = false;
+    endPage_    = h.endPage;
+    waste_      = h.waste;
+
+    ext_.resize(h.nodeCount);
+    for (uint32_t id = 0; id < h.nodeCount; ++id) ext_[id] = readExtent(f, buf.size(), h, id);
+
+    t.beginLoad(h.order, h.root, h.nodeCount);
+    for (uint32_t id = 0; id < h.nodeCount; ++id) {
+        const uint8_t* p = f + static_cast<size_t>(ext_[id].page) * kPageSize;
+        t.decodeNode(id, p, p + ext_[id].len);
+    }
+    t.finishLoad();
+    if (t.size() != h.count) throw std::runtime_error("TreeFile: entry count mismatch");
+
+    if (h.bloomBits && wantBloom) {
+        std::vector<uint64_t> words(h.bloomBits / 64);
+        const uint8_t* p = f + static_cast<size_t>(h.bloomPage) * kPageSize;
+        for (size_t i = 0; i < words.size(); ++i) words[i] = get64(p + 8 * i);
+        b.restore(h.bloomBits, static_cast<size_t>(h.bloomCap), static_cast<size_t>(h.bloomAdded), std::move(words));
+    }
+    paged_ = true;
+    return !wantBloom || h.bloomBits != 0;
+}
+
+bool TreeFile::loadLegacy_(BPlusTree& t, BloomFilter& b, bool wantBloom) {
+    std::ifstream ifs(path_, std::ios::binary);
+    if (!ifs) throw std::runtime_error("TreeFile: cannot open " + path_);
+    info_.clear();
+    infoDirty_ = false;
+    t.load(ifs);
+    if (!wantBloom) return true;
+    // Optional trailer: "XBLM" + filter.
+    char magic[4] = {};
+    if (ifs.read(magic, 4) && std::equal(magic, magic + 4, kBloomMagic)) {
+        std::vector<uint8_t> buf((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        const uint8_t* p = buf.data();
+        try { b.load(p, p + buf.size()); return true; } catch (const std::exception&) { b.disable(); }
+    }
+    return false;
+}
+
+// ---- page images ----
+
+std::vector<uint8_t> TreeFile::header_(const BPlusTree& t, const BloomFilter& b) const {
+    std::vector<uint8_t> h(kTreeMagic, kTreeMagic + 4);
+    put32(h, kPageSize);
+    put32(h, static_cast<uint32_t>(t.order()));
+    put32(h, static_cast<uint32_t>(t.root()));
+    put64(h, t.size());
+    put32(h, static_cast<uint32_t>(t.nodeCount()));
+    put32(h, dirPage_);
+    put32(h, dirPages_);
+    put32(h, bloomPage_);
+    put32(h, bloomPages_);
+    put32(h, endPage_);
+    put32(h, waste_);
+    put32(h, b.bits());
+    put64(h, b.capacity());
+    put64(h, b.added());
+    put32(h, infoPage_);
+    put32(h, infoPages_);
+    put32(h, static_cast<uint32_t>(info_.size()));
+    put64(h, fnv1a(h.data(), h.size()));
+    return h;
+}
+
+std::vector<uint8_t> TreeFile::dirImage_(uint32_t i) const {
+    std::vector<uint8_t> out;
+    const size_t lo = static_cast<size_t>(i) * kDirPerPage;
+    const size_t hi = std::min(ext_.size(), lo + kDirPerPage);
+    for (size_t id = lo; id < hi; ++id) {
+        put32(out, ext_[id].page);
+        put32(out, ext_[id].pages);
+        put32(out, ext_[id].len);
+    }
+    return out;
+}
+
+std::vector<uint8_t> TreeFile::bloomImage_(const BloomFilter& b, uint32_t i) {
+    std::vector<uint8_t> out;
+    const auto& w = b.words();
+    const size_t lo = static_cast<size_t>(i) * BloomFilter::kWordsPerPage;
+    const size_t hi = std::min(w.size(), lo + BloomFilter::kWordsPerPage);
+    for (size_t k = lo; k < hi; ++k) put64(out, w[k]);
+    return out;
+}
+
+void TreeFile::stage_(Pages& out, uint32_t page, const std::vector<uint8_t>& bytes) {
+    const uint32_t n = pagesFor_(bytes.size());
+    for (uint32_t i = 0; i < n; ++i) {
+        auto& img = out[page + i];
+        const size_t off = static_cast<size_t>(i) * kPageSize;
+        const size_t len = std::min<size_t>(kPageSize, bytes.size() - std::min(off, bytes.size()));
+        img.assign(kPageSize, 0);
+        std::copy_n(bytes.begin() + static_cast<long>(off), len, img.begin());
+    }
+}
+
+// ---- whole-file write ----
+
+void TreeFile::write(const std::string& path, BPlusTree& t, BloomFilter& b) {
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    if (!ofs) throw std::runtime_error("TreeFile: cannot open " + path + " for write");
+    path_ = path;
+    endPage_ = 1;
+    waste_ = 0;
+    const std::vector<char> zeros(kPageSize, 0);
+    ofs.write(zeros.data(), kPageSize);  // header goes in last
+
+    auto out = [&](const std::vector<uint8_t>& bytes, uint32_t pages) {
+        ofs.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        ofs.write(zeros.data(), static_cast<std::streamsize>(static_cast<size_t>(pages) * kPageSize - bytes.size()));
+    };
+
+    ext_.assign(t.nodeCount(), Extent{});
+    std::vector<uint8_t> img;
+    for (size_t id = 0; id < t.nodeCount(); ++id) {
+        t.encodeNode(id, img);
+        Extent& x = ext_[id];
+        x.pages = pagesFor_(img.size());
+        x.page = alloc_(x.pages);
+        x.len = static_cast<uint32_t>(img.size());
+        out(img, x.pages);
+    }
+
+    // Room for the tree to double before the directory has to move.
+    dirPages_ = pagesFor_(2 * ext_.size() * kDirEntry);
+    dirPage_ = alloc_(dirPages_);
+    for (uint32_t i = 0; i < dirPages_; ++i) out(dirImage_(i), 1);
+
+    bloomPages_ = static_cast<uint32_t>(b.pageCount());
+    bloomPage_ = bloomPages_ ? alloc_(bloomPages_) : 0;
+    for (uint32_t i = 0; i < bloomPages_; ++i) out(bloomImage_(b, i), 1);
+
+    infoPages_ = info_.empty() ? 0 : pagesFor_(info_.size());
+    infoPage_ = infoPages_ ? alloc_(infoPages_) : 0;
+    if (infoPages_) out(std::vector<uint8_t>(info_.begin(), info_.end()), infoPages_);
+    infoDirty_ = false;
+
+    ofs.seekp(0);
+    out(header_(t, b), 1);
+    ofs.close();
+    if (!ofs) throw std::runtime_error("TreeFile: write failed for " + path);
+
+    paged_ = true;
+    t.clearDirty();
+    b.clearDirty();
+}
+
+void TreeFile::install(const std::string& path) {
+    std::error_code ec;
+    std::filesystem::remove(path + ".jnl", ec);
+    std::filesystem::rename(path_, path);
+    path_ = path;
+}
+
+// ---- incremental flush ----
+
+bool TreeFile::canFlush(const BPlusTree& t) const {
+    if (!paged_ || t.nodeCount() < ext_.size()) return false;
+    if (waste_ > 64 && 2 * static_cast<uint64_t>(waste_) > endPage_) return false;
+    size_t dirty = 0;
+    for (size_t id = 0; id < t.nodeCount(); ++id) dirty += t.nodeDirty(id);
+    return dirty < 64 || 2 * dirty <= t.nodeCount();
+}
+
+void TreeFile::flush(BPlusTree& t, BloomFilter& b) {
+    if (!paged_) throw std::runtime_error("TreeFile: flush without a paged file");
+    Pages pages;
+    std::vector<uint8_t> dirDirty(dirPages_, 0);
+    bool dirMoved = false;
+
+    const size_t oldCount = ext_.size();
+    ext_.resize(t.nodeCount());
+    std::vector<uint8_t> img;
+    for (size_t id = 0; id < t.nodeCount(); ++id) {
+        if (id < oldCount && !t.nodeDirty(id)) continue;
+        t.encodeNode(id, img);
+        Extent& x = ext_[id];
+        const uint32_t need = pagesFor_(img.size());
+        if (x.pages < need) {
+            free_(x.pages);
+            x.pages = need;
+            x.page = alloc_(need);
+        }
+        x.len = static_cast<uint32_t>(img.size());
+        stage_(pages, x.page, img);
+        const size_t dp = id / kDirPerPage;
+        if (dp < dirDirty.size()) dirDirty[dp] = 1; else dirMoved = true;
+    }
+
+    if (dirMoved) {
+        free_(dirPages_);
+        dirPages_ = pagesFor_(2 * ext_.size() * kDirEntry);
+        dirPage_ = alloc_(dirPages_);
+        dirDirty.assign(dirPages_, 1);
+    }
+    for (uint32_t i = 0; i < dirPages_; ++i)
+        if (dirDirty[i]) stage_(pages, dirPage_ + i, dirImage_(i));
+
+    const uint32_t bp = static_cast<uint32_t>(b.pageCount());
+    if (bp != bloomPages_) {
+        free_(bloomPages_);
+        bloomPages_ = bp;
+        bloomPage_ = bp ? alloc_(bp) : 0;
+        for (uint32_t i = 0; i < bp; ++i) stage_(pages, bloomPage_ + i, bloomImage_(b, i));
+    } else {
+        for (uint32_t i = 0; i < bp; ++i)
+            if (b.pageDirty(i)) stage_(pages, bloomPage_ + i, bloomImage_(b, i));
+    }
+
+    if (infoDirty_) {
+        const uint32_t need = info_.empty() ? 0 : pagesFor_(info_.size());
+        if (need > infoPages_) {
+            free_(infoPages_);
+            infoPages_ = need;
+            infoPage_ = alloc_(need);
+        }
+        if (!info_.empty()) stage_(pages, infoPage_, std::vector<uint8_t>(info_.begin(), info_.end()));
+    }
+
+    stage_(pages, 0, header_(t, b));
+    commit_(pages);
+    infoDirty_ = false;
+    lastFlushPages_ = pages.size();
+    t.clearDirty();
+    b.clearDirty();
+}
+
+// ---- journal ----
+
+void TreeFile::commit_(const Pages& pages) {
+    std::vector<uint8_t> j(kJournalMagic, kJournalMagic + 4);
+    put32(j, kPageSize);
+    put32(j, static_cast<uint32_t>(pages.size()));
+    j.reserve(j.size() + pages.size() * (4 + kPageSize) + 8);
+    for (const auto& [no, img] : pages) {
+        put32(j, no);
+        j.insert(j.end(), img.begin(), img.end());
+    }
+    put64(j, fnv1a(j.data(), j.size()));
+
+    const std::string jp = journalPath_();
+    {
+        std::ofstream ofs(jp, std::ios::binary | std::ios::trunc);
+        if (!ofs) throw std::runtime_error("TreeFile: cannot open " + jp + " for write");
+        ofs.write(reinterpret_cast<const char*>(j.data()), static_cast<std::streamsize>(j.size()));
+        ofs.close();
+        if (!ofs) throw std::runtime_error("TreeFile: write failed for " + jp);
+    }
+    // The journal is complete: from here a crash is repaired by recover_().
+    apply_(path_, pages);
+    std::filesystem::remove(jp);
+}
+
+void TreeFile::recover_() {
+    const std::string jp = journalPath_();
+    std::error_code ec;
+    if (!std::filesystem::exists(jp, ec)) return;
+
+    const auto j = readAll(jp);
+    bool ok = j.size() >= 12 + 8 && std::equal(kJournalMagic, kJournalMagic + 4, j.begin()) &&
+              get32(j.data() + 4) == kPageSize;
+    if (ok) {
+        const uint64_t n = get32(j.data() + 8);
+        ok = j.size() == 12 + n * (4 + kPageSize) + 8 &&
+             get64(j.data() + j.size() - 8) == fnv1a(j.data(), j.size() - 8);
+    }
+    if (ok) {
+        Pages pages;
+        for (const uint8_t* p = j.data() + 12; p < j.data() + j.size() - 8; p += 4 + kPageSize)
+            pages[get32(p)].assign(p + 4, p + 4 + kPageSize);
+        apply_(path_, pages);
+    }
+    // An incomplete journal means the index was never touched: drop it.
+    std::filesystem::remove(jp, ec);
+}
+
+void TreeFile::apply_(const std::string& path, const Pages& pages) {
+    std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!f) throw std::runtime_error("TreeFile: cannot open " + path + " for update");
+    for (const auto& [no, img] : pages) {
+        f.seekp(static_cast<std::streamoff>(no) * kPageSize);
+        f.write(reinterpret_cast<const char*>(img.data()), static_cast<std::streamsize>(img.size()));
+    }
+    f.close();
+    if (!f) throw std::runtime_error("TreeFile: update failed for " + path);
+}
+
+} // namespace xindex
@@ -0,0 +1,57 @@
+#include "xindex/tree_view.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace xindex {
+
+bool TreeView::open(const std::string& path) {
+    std::error_code ec;
+    if (std::filesystem::exists(TreeFile::journalPath(path), ec))
+        throw std::runtime_error("TreeView: " + path + " has an unfinished update; open it for update once to recover");
+    file_.open(path);
+    if (!TreeFile::readHeader(file_.data(), file_.size(), h_)) {
+        file_.close();
+        return false;
+    }
+    return true;
+}
+
+bool TreeView::mayContain(const std::vector<uint8_t>& key) const {
+    if (!hasBloom()) return true;
+    const uint8_t* w = file_.data() + static_cast<size_t>(h_.bloomPage) * TreeFile::kPageSize;
+    return BloomFilter::forEachProbe(BloomFilter::hash(key), h_.bloomBits, [&](uint64_t bit){
+        return ((TreeFile::le64(w + 8 * (bit >> 6)) >> (bit & 63)) & 1) != 0;
+    });
+}
+
+TreeView::Node TreeView::node_(uint32_t id) const {
+    if (id >= h_.nodeCount) throw std::runtime_error("TreeView: bad node id");
+    const TreeFile::Extent x = TreeFile::readExtent(file_.data(), file_.size(), h_, id);
+    Node n;
+    n.p = file_.data() + static_cast<size_t>(x.page) * TreeFile::kPageSize;
+    n.end = n.p + x.len;
+    if (n.p == n.end) throw std::runtime_error("TreeView: empty node image");
+    n.leaf = *n.p++ != 0;
+    n.next = static_cast<int>(getVarint(n.p, n.end)) - 1;
+    n.nkeys = getVarint(n.p, n.end);
+    if (n.next >= static_cast<int>(h_.nodeCount)) throw std::runtime_error("TreeView: bad leaf link");
+    return n;
+}
+
+bool TreeView::less_(const uint8_t* p, uint32_t n, const std::vector<uint8_t>& lo) {
+    const size_t m = std::min<size_t>(n, lo.size());
+    const int c = m ? std::memcmp(p, lo.data(), m) : 0;
+    return c < 0 || (c == 0 && n < lo.size());
+}
+
+const uint8_t* TreeView::take_(const uint8_t*& p, const uint8_t* end, uint32_t n) {
+    if (static_cast<size_t>(end - p) < n) throw std::runtime_error("TreeView: truncated node");
+    const uint8_t* at = p;
+    p += n;
+    return at;
+}
+
+} // namespace xindex